@@ -0,0 +1,255 @@
+#include "ClusteredLighting.h"
+#include "JobPool.h"
+
+#include <float.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define CLUSTER_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+void ClusteredLighting::Configure(int screenWidth, int screenHeight, int tileSize, int slices, float fovY, float aspect, float nearZ, float farZ)
+{
+	mTilesX = (screenWidth + tileSize - 1) / tileSize;
+	mTilesY = (screenHeight + tileSize - 1) / tileSize;
+	mSlices = slices;
+	mClustersPerSlice = mTilesX * mTilesY;
+	mScreenWidth = screenWidth;
+	mScreenHeight = screenHeight;
+	mTileSize = tileSize;
+	mNearZ = nearZ;
+	mFarZ = farZ;
+
+	float logRange = logf(farZ / nearZ);
+	mConstants.tilesX = mTilesX;
+	mConstants.tilesY = mTilesY;
+	mConstants.slices = mSlices;
+	mConstants.tileSize = tileSize;
+	mConstants.sliceScale = slices / logRange;
+	mConstants.sliceBias = -slices * logf(nearZ) / logRange;
+	mConstants.pixelScale = 1.0f;
+
+	mSliceNear.resize(slices + 1);
+	for (int z = 0; z <= slices; z++)
+		mSliceNear[z] = nearZ * expf(logRange * z / slices);
+
+	// view space x = ndcX * z / P._11, y = ndcY * z / P._22
+	mYScale = 1.0f / tanf(fovY * 0.5f);
+	mXScale = mYScale / aspect;
+
+	size_t total = (size_t)mClustersPerSlice * slices + 3;
+	for (std::vector<float>* bounds : { &mMinX, &mMinY, &mMinZ })
+		bounds->assign(total, FLT_MAX);
+	for (std::vector<float>* bounds : { &mMaxX, &mMaxY, &mMaxZ })
+		bounds->assign(total, -FLT_MAX);
+
+	for (int z = 0; z < slices; z++)
+	{
+		float depths[2] = { mSliceNear[z], mSliceNear[z + 1] };
+		for (int y = 0; y < mTilesY; y++)
+		{
+			float ndcY[2] = { 1.0f - 2.0f * std::min((y + 1) * tileSize, screenHeight) / screenHeight, 1.0f - 2.0f * y * tileSize / screenHeight };
+			for (int x = 0; x < mTilesX; x++)
+			{
+				float ndcX[2] = { 2.0f * x * tileSize / screenWidth - 1.0f, 2.0f * std::min((x + 1) * tileSize, screenWidth) / screenWidth - 1.0f };
+				size_t i = (size_t)z * mClustersPerSlice + y * mTilesX + x;
+
+				// the cluster is a frustum piece, its box spans the corners at both depths
+				for (float depth : depths)
+				{
+					for (int j = 0; j < 2; j++)
+					{
+						mMinX[i] = std::min(mMinX[i], ndcX[j] * depth / mXScale);
+						mMaxX[i] = std::max(mMaxX[i], ndcX[j] * depth / mXScale);
+						mMinY[i] = std::min(mMinY[i], ndcY[j] * depth / mYScale);
+						mMaxY[i] = std::max(mMaxY[i], ndcY[j] * depth / mYScale);
+					}
+				}
+				mMinZ[i] = depths[0];
+				mMaxZ[i] = depths[1];
+			}
+		}
+	}
+
+	mSliceResults.resize(slices);
+	mGrid.assign(GetClusterCount(), ClusterRange());
+	mLightIndices.clear();
+}
+
+ClusteredLighting::TileRect ClusteredLighting::GetTileRect(const PointLight& light) const
+{
+	TileRect rect = { 0, 0, -1, -1 };
+	float zMin = std::max(light.position[2] - light.radius, mNearZ);
+	float zMax = light.position[2] + light.radius;
+	if (zMax < mNearZ || zMin > mFarZ)
+		return rect;
+
+	// x / z over the light's bounding box is extreme at its corners
+	float ndcMinX = FLT_MAX, ndcMaxX = -FLT_MAX, ndcMinY = FLT_MAX, ndcMaxY = -FLT_MAX;
+	for (float z : { zMin, zMax })
+	{
+		for (float sign : { -1.0f, 1.0f })
+		{
+			float ndcX = (light.position[0] + sign * light.radius) * mXScale / z;
+			float ndcY = (light.position[1] + sign * light.radius) * mYScale / z;
+			ndcMinX = std::min(ndcMinX, ndcX);
+			ndcMaxX = std::max(ndcMaxX, ndcX);
+			ndcMinY = std::min(ndcMinY, ndcY);
+			ndcMaxY = std::max(ndcMaxY, ndcY);
+		}
+	}
+	if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f)
+		return rect;
+
+	// pixel y grows downwards
+	float tileScaleX = 0.5f * mScreenWidth / mTileSize;
+	float tileScaleY = 0.5f * mScreenHeight / mTileSize;
+	rect.x0 = std::max((int)((std::max(ndcMinX, -1.0f) + 1.0f) * tileScaleX), 0);
+	rect.x1 = std::min((int)((std::min(ndcMaxX, 1.0f) + 1.0f) * tileScaleX), mTilesX - 1);
+	rect.y0 = std::max((int)((1.0f - std::min(ndcMaxY, 1.0f)) * tileScaleY), 0);
+	rect.y1 = std::min((int)((1.0f - std::max(ndcMinY, -1.0f)) * tileScaleY), mTilesY - 1);
+	return rect;
+}
+
+void ClusteredLighting::AssignSlice(int slice, const PointLight* viewLights, int lightCount)
+{
+	SliceResult& result = mSliceResults[slice];
+	float sliceNear = mSliceNear[slice];
+	float sliceFar = mSliceNear[slice + 1];
+	size_t sliceStart = (size_t)slice * mClustersPerSlice;
+
+	result.counts.assign(mClustersPerSlice, 0);
+	result.hitClusters.clear();
+	result.hitLights.clear();
+
+	// Sphere vs AABB: squared distance from the center to the box, per axis
+	// max(min - c, c - max, 0), compared against radius^2
+	for (int i = 0; i < lightCount; i++)
+	{
+		const PointLight& light = viewLights[i];
+		const TileRect& rect = mLightRects[i];
+		if (rect.x0 > rect.x1 || light.position[2] + light.radius < sliceNear || light.position[2] - light.radius > sliceFar)
+			continue;
+
+		for (int y = rect.y0; y <= rect.y1; y++)
+		{
+			int rowStart = y * mTilesX;
+#ifdef CLUSTER_USE_SSE
+			__m128 cx = _mm_set1_ps(light.position[0]);
+			__m128 cy = _mm_set1_ps(light.position[1]);
+			__m128 cz = _mm_set1_ps(light.position[2]);
+			__m128 radiusSq = _mm_set1_ps(light.radius * light.radius);
+			__m128 zero = _mm_setzero_ps();
+			for (int x = rect.x0; x <= rect.x1; x += 4)
+			{
+				size_t c = sliceStart + rowStart + x;
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinX[c]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&mMaxX[c]))), zero);
+				__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinY[c]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&mMaxY[c]))), zero);
+				__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&mMinZ[c]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&mMaxZ[c]))), zero);
+				__m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				int hits = _mm_movemask_ps(_mm_cmple_ps(distSq, radiusSq));
+
+				// lanes past x1 belong to the next row (or the padding)
+				int lanes = std::min(4, rect.x1 - x + 1);
+				for (int lane = 0; lane < lanes; lane++)
+				{
+					if (hits & (1 << lane))
+					{
+						unsigned int cluster = rowStart + x + lane;
+						result.counts[cluster]++;
+						result.hitClusters.push_back(cluster);
+						result.hitLights.push_back(i);
+					}
+				}
+			}
+#else
+			float radiusSq = light.radius * light.radius;
+			for (int x = rect.x0; x <= rect.x1; x++)
+			{
+				size_t c = sliceStart + rowStart + x;
+				float dx = std::max(std::max(mMinX[c] - light.position[0], light.position[0] - mMaxX[c]), 0.0f);
+				float dy = std::max(std::max(mMinY[c] - light.position[1], light.position[1] - mMaxY[c]), 0.0f);
+				float dz = std::max(std::max(mMinZ[c] - light.position[2], light.position[2] - mMaxZ[c]), 0.0f);
+				if (dx * dx + dy * dy + dz * dz <= radiusSq)
+				{
+					unsigned int cluster = rowStart + x;
+					result.counts[cluster]++;
+					result.hitClusters.push_back(cluster);
+					result.hitLights.push_back(i);
+				}
+			}
+#endif
+		}
+	}
+
+	// Counting sort of the hits by cluster, lights stay in ascending order within a cluster
+	result.offsets.resize(mClustersPerSlice);
+	unsigned int total = 0;
+	for (int c = 0; c < mClustersPerSlice; c++)
+	{
+		result.offsets[c] = total;
+		total += result.counts[c];
+	}
+	result.indices.resize(total);
+	for (size_t hit = 0; hit < result.hitClusters.size(); hit++)
+		result.indices[result.offsets[result.hitClusters[hit]]++] = result.hitLights[hit];
+	// the scatter advanced every offset by its count
+	for (int c = 0; c < mClustersPerSlice; c++)
+		result.offsets[c] -= result.counts[c];
+}
+
+void ClusteredLighting::AssignLights(const PointLight* viewLights, int lightCount, JobPool* pool)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	mLightRects.resize(lightCount);
+	for (int i = 0; i < lightCount; i++)
+		mLightRects[i] = GetTileRect(viewLights[i]);
+
+	if (pool)
+	{
+		pool->ParallelFor(mSlices, 1, [this, viewLights, lightCount](int begin, int end)
+		{
+			for (int slice = begin; slice < end; slice++)
+				AssignSlice(slice, viewLights, lightCount);
+		});
+	}
+	else
+	{
+		for (int slice = 0; slice < mSlices; slice++)
+			AssignSlice(slice, viewLights, lightCount);
+	}
+
+	// Concatenate the slices into the final grid and index list
+	size_t total = 0;
+	for (const SliceResult& result : mSliceResults)
+		total += result.indices.size();
+	mLightIndices.resize(total);
+
+	mStats = ClusterStats();
+	mStats.lightCount = lightCount;
+	mStats.lightReferences = (int)total;
+
+	unsigned int base = 0;
+	for (int slice = 0; slice < mSlices; slice++)
+	{
+		const SliceResult& result = mSliceResults[slice];
+		ClusterRange* grid = &mGrid[(size_t)slice * mClustersPerSlice];
+		for (int c = 0; c < mClustersPerSlice; c++)
+		{
+			grid[c].offset = base + result.offsets[c];
+			grid[c].count = result.counts[c];
+			mStats.maxLightsPerCluster = std::max(mStats.maxLightsPerCluster, (int)result.counts[c]);
+			mStats.occupiedClusters += result.counts[c] ? 1 : 0;
+		}
+		if (!result.indices.empty())
+			memcpy(&mLightIndices[base], result.indices.data(), result.indices.size() * sizeof(unsigned int));
+		base += (unsigned int)result.indices.size();
+	}
+
+	mStats.assignMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
@@ -0,0 +1,128 @@
+//--------------------------------------------------------------------------------------
+// ClusteredLighting - assigns point lights to clusters of the view frustum.
+//
+// The frustum is cut into tilesX * tilesY screen tiles and 'slices' depth slices
+// (exponentially spaced, so clusters are roughly cubic). Every frame the lights are
+// tested against the bounding boxes of the clusters under their screen rectangle
+// (sphere vs AABB, four clusters per SSE instruction) and each cluster gets a compact
+// list of the lights touching it:
+//
+//   grid[cluster] = { offset, count }      lightIndices[offset .. offset + count)
+//
+// The same lists are uploaded to the GPU for Fragment.hlsl (CLUSTERED permutation)
+// and read by the CPU reference shader in CpuShading.h.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <math.h>
+
+#include <vector>
+
+class JobPool;
+
+struct PointLight
+{
+	float position[3];	// view space for AssignLights(), world space for shading
+	float radius;		// no light beyond this distance
+	float color[3];
+	float padding;
+};
+
+struct ClusterRange
+{
+	unsigned int offset;
+	unsigned int count;
+};
+
+// Mirrors CLUSTER_CONSTANT_BUFFER in Fragment.hlsl
+struct ClusterConstants
+{
+	unsigned int tilesX, tilesY, slices, tileSize;
+	float sliceScale, sliceBias;	// slice = floor(log(viewZ) * sliceScale + sliceBias)
+	float pixelScale;				// screen pixels per render target pixel, see SetRenderScale()
+	float padding;
+};
+
+// Cluster a pixel shader invocation reads: SV_Position.xy (pixels, top-left origin) and
+// SV_Position.w (view space depth). Points outside the grid are clamped to the border
+// clusters, exactly like Fragment.hlsl does.
+inline int GetClusterIndex(const ClusterConstants& constants, float pixelX, float pixelY, float viewZ)
+{
+	int x = (int)(pixelX * constants.pixelScale / constants.tileSize);
+	int y = (int)(pixelY * constants.pixelScale / constants.tileSize);
+	int z = viewZ > 0.0f ? (int)floorf(logf(viewZ) * constants.sliceScale + constants.sliceBias) : 0;
+	x = x < 0 ? 0 : (x >= (int)constants.tilesX ? constants.tilesX - 1 : x);
+	y = y < 0 ? 0 : (y >= (int)constants.tilesY ? constants.tilesY - 1 : y);
+	z = z < 0 ? 0 : (z >= (int)constants.slices ? constants.slices - 1 : z);
+	return (z * constants.tilesY + y) * constants.tilesX + x;
+}
+
+struct ClusterStats
+{
+	int lightCount;
+	int lightReferences;		// size of the index list
+	int maxLightsPerCluster;
+	int occupiedClusters;
+	double assignMs;
+};
+
+class ClusteredLighting
+{
+public:
+	// Sets up the cluster grid for a perspective projection (XMMatrixPerspectiveFovLH).
+	// Has to be called again when the viewport or projection changes.
+	void Configure(int screenWidth, int screenHeight, int tileSize, int slices, float fovY, float aspect, float nearZ, float farZ);
+	// For drawing at 'scale' times the configured screen size (dynamic resolution): the
+	// grid stays the same, the shaders scale SV_Position up to screen pixels
+	void SetRenderScale(float scale) { mConstants.pixelScale = 1.0f / scale; }
+
+	// Builds the per-cluster light lists. 'viewLights' are in view space (+z forward).
+	// With a pool the depth slices are processed in parallel.
+	void AssignLights(const PointLight* viewLights, int lightCount, JobPool* pool = nullptr);
+
+	const std::vector<ClusterRange>& GetGrid() const { return mGrid; }
+	const std::vector<unsigned int>& GetLightIndices() const { return mLightIndices; }
+	const ClusterConstants& GetConstants() const { return mConstants; }
+	const ClusterStats& GetStats() const { return mStats; }
+	int GetClusterCount() const { return mTilesX * mTilesY * mSlices; }
+
+private:
+	// Light list of one depth slice, merged into mGrid/mLightIndices afterwards
+	struct SliceResult
+	{
+		std::vector<unsigned int> counts;		// per cluster in the slice
+		std::vector<unsigned int> offsets;		// into 'indices', per cluster
+		std::vector<unsigned int> indices;		// grouped by cluster
+
+		// scratch: (cluster, light) pairs in light order
+		std::vector<unsigned int> hitClusters;
+		std::vector<unsigned int> hitLights;
+	};
+
+	// Screen tiles a light can touch, from the projection of its bounding box
+	struct TileRect
+	{
+		int x0, y0, x1, y1;		// inclusive, x0 > x1 if the light is behind the near plane
+	};
+
+	TileRect GetTileRect(const PointLight& light) const;
+	void AssignSlice(int slice, const PointLight* viewLights, int lightCount);
+
+	int mTilesX = 0, mTilesY = 0, mSlices = 0;
+	int mClustersPerSlice = 0;
+	int mScreenWidth = 0, mScreenHeight = 0, mTileSize = 0;
+	float mXScale = 0.0f, mYScale = 0.0f;	// projection _11 and _22
+	float mNearZ = 0.0f, mFarZ = 0.0f;
+	ClusterConstants mConstants = {};
+
+	// Cluster AABBs in view space, structure of arrays, slice-major. Three floats of
+	// padding at the end so the SSE loop can always load four clusters.
+	std::vector<float> mMinX, mMinY, mMinZ, mMaxX, mMaxY, mMaxZ;
+	std::vector<float> mSliceNear;		// slices + 1 depths
+
+	std::vector<TileRect> mLightRects;
+	std::vector<SliceResult> mSliceResults;
+	std::vector<ClusterRange> mGrid;
+	std::vector<unsigned int> mLightIndices;
+	ClusterStats mStats = {};
+};
@@ -0,0 +1,171 @@
+#include "CommandRecorder.h"
+#include "JobPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+
+void CommandBuffer::Clear()
+{
+	mCommands.clear();
+	mInstances.clear();
+}
+
+void CommandBuffer::SetPass(int pass)
+{
+	mCommands.push_back({ COMMAND_SET_PASS, (unsigned int)pass, 0 });
+}
+
+void CommandBuffer::SetShader(unsigned int shader)
+{
+	mCommands.push_back({ COMMAND_SET_SHADER, shader, 0 });
+}
+
+void CommandBuffer::SetTexture(unsigned int texture)
+{
+	mCommands.push_back({ COMMAND_SET_TEXTURE, texture, 0 });
+}
+
+void CommandBuffer::SetMesh(unsigned int mesh)
+{
+	mCommands.push_back({ COMMAND_SET_MESH, mesh, 0 });
+}
+
+void CommandBuffer::SetInstances(const Float4x4* worlds, int count)
+{
+	mCommands.push_back({ COMMAND_SET_INSTANCES, (unsigned int)mInstances.size(), count });
+	mInstances.insert(mInstances.end(), worlds, worlds + count);
+}
+
+void CommandBuffer::DrawInstanced(int firstInstance, int instanceCount)
+{
+	mCommands.push_back({ COMMAND_DRAW_INSTANCED, (unsigned int)firstInstance, instanceCount });
+}
+
+void CommandBuffer::Replay(RenderBackend& backend) const
+{
+	for (const Command& command : mCommands)
+	{
+		switch (command.type)
+		{
+		case COMMAND_SET_PASS:
+			backend.SetPass((int)command.a);
+			break;
+		case COMMAND_SET_SHADER:
+			backend.SetShader(command.a);
+			break;
+		case COMMAND_SET_TEXTURE:
+			backend.SetTexture(command.a);
+			break;
+		case COMMAND_SET_MESH:
+			backend.SetMesh(command.a);
+			break;
+		case COMMAND_SET_INSTANCES:
+			backend.SetInstances(mInstances.data() + command.a, command.b);
+			break;
+		case COMMAND_DRAW_INSTANCED:
+			backend.DrawInstanced((int)command.a, command.b);
+			break;
+		}
+	}
+}
+
+void RecordCommandLists(const RenderQueue& queue, int listCount, JobPool* pool,
+	const std::function<void(int list, int firstBatch, int endBatch)>& record)
+{
+	int batchCount = (int)queue.GetBatches().size();
+	listCount = std::max(1, std::min(listCount, batchCount));
+	if (batchCount == 0)
+		return;
+
+	auto recordList = [&](int list)
+	{
+		int firstBatch = (int)((long long)batchCount * list / listCount);
+		int endBatch = (int)((long long)batchCount * (list + 1) / listCount);
+		record(list, firstBatch, endBatch);
+	};
+
+	if (!pool || listCount == 1)
+	{
+		for (int list = 0; list < listCount; list++)
+			recordList(list);
+		return;
+	}
+	pool->ParallelFor(listCount, 1, [&recordList](int begin, int end)
+	{
+		for (int list = begin; list < end; list++)
+			recordList(list);
+	});
+}
+
+void CommandRecorder::Record(const RenderQueue& queue, int listCount, JobPool* pool)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	mQueue = &queue;
+	if ((int)mLists.size() < listCount)
+		mLists.resize(listCount);
+	mListCount = 0;
+	RecordCommandLists(queue, listCount, pool, [this](int list, int firstBatch, int endBatch)
+	{
+		mLists[list].Clear();
+		mQueue->SubmitBatches(mLists[list], firstBatch, endBatch);
+	});
+	mListCount = std::min(listCount, (int)queue.GetBatches().size());
+
+	mRecordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void CommandRecorder::Execute(RenderBackend& backend) const
+{
+	if (!mQueue || mListCount == 0)
+		return;
+
+	const std::vector<Float4x4>& instances = mQueue->GetInstances();
+	backend.SetInstances(instances.data(), (int)instances.size());
+	for (int list = 0; list < mListCount; list++)
+		mLists[list].Replay(backend);
+}
+
+std::vector<CommandRecordingTiming> BenchmarkCommandRecording(int drawCount, int iterations)
+{
+	// enough different state that nearly every draw is its own batch
+	std::mt19937 random(7);
+	RenderQueue queue;
+	for (int i = 0; i < drawCount; i++)
+	{
+		float depth = 0.1f + (random() % 10000) / 500.0f;
+		queue.Add(PASS_OPAQUE, random() % 64, random() % 1024, random() % 32, depth, MatrixTranslation(0.0f, 0.0f, depth));
+	}
+	queue.Sort();
+
+	std::vector<CommandRecordingTiming> timings;
+	for (int threads : { 1, 2, 4, 8 })
+	{
+		// the calling thread works too, so 'threads' - 1 workers
+		std::unique_ptr<JobPool> pool;
+		if (threads > 1)
+		{
+			pool.reset(new JobPool(threads - 1));
+			pool->SetTimelineEnabled(false);
+		}
+
+		CommandRecorder recorder;
+		CommandRecordingTiming timing = { threads, 0.0, 0.0 };
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			recorder.Record(queue, threads, pool.get());
+			timing.recordMs += recorder.GetRecordMs();
+
+			NullBackend backend;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			recorder.Execute(backend);
+			timing.executeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+		timing.recordMs /= iterations;
+		timing.executeMs /= iterations;
+		timings.push_back(timing);
+	}
+	return timings;
+}
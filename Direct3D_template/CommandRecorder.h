@@ -0,0 +1,95 @@
+//--------------------------------------------------------------------------------------
+// CommandRecorder - records the draws of a RenderQueue on several threads at once.
+//
+// The sorted batches are split into contiguous ranges, one command list per range,
+// and each range is recorded by a JobPool job. Every list sets its own state from
+// scratch, so executing the lists in index order issues the same draws as
+// RenderQueue::Submit(), whichever thread recorded which list.
+//
+// RecordCommandLists() only does the splitting; the caller decides what a list is.
+// On D3D11 it is a deferred context (see main.cpp). CommandBuffer is the backend
+// neutral list: it stores the RenderBackend calls and replays them later on the
+// submitting thread, which is what CommandRecorder uses.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "RenderQueue.h"
+
+class JobPool;
+
+// Records RenderBackend calls to replay on another backend
+class CommandBuffer : public RenderBackend
+{
+public:
+	void Clear();
+
+	void SetPass(int pass) override;
+	void SetShader(unsigned int shader) override;
+	void SetTexture(unsigned int texture) override;
+	void SetMesh(unsigned int mesh) override;
+	void SetInstances(const Float4x4* worlds, int count) override;	// copies the matrices
+	void DrawInstanced(int firstInstance, int instanceCount) override;
+
+	void Replay(RenderBackend& backend) const;
+	int GetCommandCount() const { return (int)mCommands.size(); }
+
+private:
+	enum CommandType
+	{
+		COMMAND_SET_PASS,
+		COMMAND_SET_SHADER,
+		COMMAND_SET_TEXTURE,
+		COMMAND_SET_MESH,
+		COMMAND_SET_INSTANCES,	// a = first matrix in mInstances, b = count
+		COMMAND_DRAW_INSTANCED,	// a = first instance, b = instance count
+	};
+
+	struct Command
+	{
+		int type;
+		unsigned int a;
+		int b;
+	};
+
+	std::vector<Command> mCommands;
+	std::vector<Float4x4> mInstances;
+};
+
+// Calls record(list, firstBatch, endBatch) for up to 'listCount' ranges of the queue's
+// batches, on the pool when there is one, and returns once all are recorded. Lists
+// without batches are skipped. The ranges hold about the same number of batches
+// (draw calls), which is what recording costs.
+void RecordCommandLists(const RenderQueue& queue, int listCount, JobPool* pool,
+	const std::function<void(int list, int firstBatch, int endBatch)>& record);
+
+// The backend neutral path: CommandBuffers recorded in parallel, executed in order
+class CommandRecorder
+{
+public:
+	void Record(const RenderQueue& queue, int listCount, JobPool* pool);
+
+	// Uploads the instances and replays every list, in list order
+	void Execute(RenderBackend& backend) const;
+
+	double GetRecordMs() const { return mRecordMs; }
+
+private:
+	const RenderQueue* mQueue = nullptr;
+	std::vector<CommandBuffer> mLists;
+	int mListCount = 0;
+	double mRecordMs = 0.0;
+};
+
+struct CommandRecordingTiming
+{
+	int threads;
+	double recordMs;	// RecordCommandLists() into CommandBuffers
+	double executeMs;	// replay into a NullBackend
+};
+
+// Records a sorted queue of 'drawCount' random draws with 1, 2, 4 and 8 threads
+// (one list per thread), averaged over 'iterations'
+std::vector<CommandRecordingTiming> BenchmarkCommandRecording(int drawCount, int iterations = 10);
@@ -0,0 +1,431 @@
+#include "CpuRasterizer.h"
+#include "JobPool.h"
+#include "SceneSystems.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// The D3D11 standard sample patterns, in 1/16 pixel from the pixel center
+	const signed char SAMPLE_POSITIONS_1[1][2] = { { 0, 0 } };
+	const signed char SAMPLE_POSITIONS_2[2][2] = { { 4, 4 }, { -4, -4 } };
+	const signed char SAMPLE_POSITIONS_4[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+	const signed char SAMPLE_POSITIONS_8[8][2] = {
+		{ 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } };
+	const signed char SAMPLE_POSITIONS_16[16][2] = {
+		{ 1, 1 }, { -1, -3 }, { -3, 2 }, { 4, -1 }, { -5, -2 }, { 2, 5 }, { 5, 3 }, { 3, -5 },
+		{ -2, 6 }, { 0, -7 }, { -4, -6 }, { -6, 4 }, { -8, 0 }, { 7, -4 }, { 6, 7 }, { -7, -8 } };
+
+	const signed char (*GetSamplePositions(int sampleCount))[2]
+	{
+		switch (sampleCount)
+		{
+		case 2: return SAMPLE_POSITIONS_2;
+		case 4: return SAMPLE_POSITIONS_4;
+		case 8: return SAMPLE_POSITIONS_8;
+		case 16: return SAMPLE_POSITIONS_16;
+		default: return SAMPLE_POSITIONS_1;
+		}
+	}
+
+	// a * x + b * y + c over the screen
+	struct Plane
+	{
+		float a, b, c;
+
+		float At(float x, float y) const { return a * x + b * y + c; }
+	};
+
+	// The attributes of CpuFragment after the position, divided by w so they can be
+	// interpolated linearly on screen
+	const int ATTRIBUTE_COUNT = 8;
+
+	void GetAttributes(const CpuFragment& fragment, float attributes[ATTRIBUTE_COUNT])
+	{
+		attributes[0] = fragment.worldPos.x;
+		attributes[1] = fragment.worldPos.y;
+		attributes[2] = fragment.worldPos.z;
+		attributes[3] = fragment.worldNor.x;
+		attributes[4] = fragment.worldNor.y;
+		attributes[5] = fragment.worldNor.z;
+		attributes[6] = fragment.u;
+		attributes[7] = fragment.v;
+	}
+
+	// A triangle ready to be rasterized, everything a plane over the screen. The edge
+	// functions are positive inside.
+	struct Triangle
+	{
+		Plane edges[3];
+		bool topLeft[3];
+		Plane depth;
+		Plane invW;
+		Plane attributes[ATTRIBUTE_COUNT];
+		int x0, y0, x1, y1;	// pixels whose samples might be inside
+	};
+
+	unsigned int PackColour(Float3 colour)
+	{
+		auto channel = [](float value) { return (unsigned int)(std::max(0.0f, std::min(value, 1.0f)) * 255.0f + 0.5f); };
+		return channel(colour.x) | channel(colour.y) << 8 | channel(colour.z) << 16 | 0xff000000u;
+	}
+
+	CpuFragment Lerp(const CpuFragment& a, const CpuFragment& b, float t)
+	{
+		CpuFragment result;
+		result.pos = { a.pos.x + (b.pos.x - a.pos.x) * t, a.pos.y + (b.pos.y - a.pos.y) * t, a.pos.z + (b.pos.z - a.pos.z) * t, a.pos.w + (b.pos.w - a.pos.w) * t };
+		result.worldPos = a.worldPos + (b.worldPos - a.worldPos) * t;
+		result.worldNor = a.worldNor + (b.worldNor - a.worldNor) * t;
+		result.u = a.u + (b.u - a.u) * t;
+		result.v = a.v + (b.v - a.v) * t;
+		return result;
+	}
+
+	// 'a', 'b' and 'c' are in front of the near plane. False for back faces (clockwise
+	// is front, like the default rasterizer state), degenerate and off screen triangles.
+	bool SetupTriangle(int width, int height, const CpuFragment& a, const CpuFragment& b, const CpuFragment& c, Triangle& triangle)
+	{
+		const CpuFragment* clip[3] = { &a, &b, &c };
+		float x[3], y[3], z[3], invW[3];
+		for (int i = 0; i < 3; i++)
+		{
+			invW[i] = 1.0f / clip[i]->pos.w;
+			x[i] = (clip[i]->pos.x * invW[i] * 0.5f + 0.5f) * width;
+			y[i] = (0.5f - clip[i]->pos.y * invW[i] * 0.5f) * height;
+			z[i] = clip[i]->pos.z * invW[i];
+		}
+
+		// positive for triangles that are clockwise on screen
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		if (!(area > 0.0f))
+			return false;
+
+		// Every sample lies inside its pixel. The float bounds are clamped first so
+		// vertices close to the near plane can't overflow the conversion.
+		float minX = std::max(std::min(std::min(x[0], x[1]), x[2]), 0.0f);
+		float maxX = std::min(std::max(std::max(x[0], x[1]), x[2]), (float)width);
+		float minY = std::max(std::min(std::min(y[0], y[1]), y[2]), 0.0f);
+		float maxY = std::min(std::max(std::max(y[0], y[1]), y[2]), (float)height);
+		triangle.x0 = (int)minX;
+		triangle.x1 = std::min((int)maxX, width - 1);
+		triangle.y0 = (int)minY;
+		triangle.y1 = std::min((int)maxY, height - 1);
+		if (triangle.x0 > triangle.x1 || triangle.y0 > triangle.y1)
+			return false;
+
+		// edges[i] is the weight of vertex i, times 'area'
+		for (int i = 0; i < 3; i++)
+		{
+			int from = (i + 1) % 3;
+			int to = (i + 2) % 3;
+			Plane& edge = triangle.edges[i];
+			edge.a = -(y[to] - y[from]);
+			edge.b = x[to] - x[from];
+			edge.c = -(edge.a * x[from] + edge.b * y[from]);
+			// left edges go up the screen, top edges are flat and go right
+			triangle.topLeft[i] = edge.a > 0.0f || (edge.a == 0.0f && edge.b > 0.0f);
+		}
+
+		// Values linear on screen are the vertex values weighted by the edge functions
+		float invArea = 1.0f / area;
+		auto makePlane = [&triangle, invArea](float v0, float v1, float v2)
+		{
+			const Plane* e = triangle.edges;
+			return Plane{ (v0 * e[0].a + v1 * e[1].a + v2 * e[2].a) * invArea,
+				(v0 * e[0].b + v1 * e[1].b + v2 * e[2].b) * invArea,
+				(v0 * e[0].c + v1 * e[1].c + v2 * e[2].c) * invArea };
+		};
+		triangle.depth = makePlane(z[0], z[1], z[2]);
+		triangle.invW = makePlane(invW[0], invW[1], invW[2]);
+		float attributes[3][ATTRIBUTE_COUNT];
+		for (int i = 0; i < 3; i++)
+			GetAttributes(*clip[i], attributes[i]);
+		for (int i = 0; i < ATTRIBUTE_COUNT; i++)
+			triangle.attributes[i] = makePlane(attributes[0][i] * invW[0], attributes[1][i] * invW[1], attributes[2][i] * invW[2]);
+		return true;
+	}
+
+	// Clips against the near plane (z >= 0) and appends what is left, 0 to 2 triangles
+	void AddTriangle(int width, int height, const CpuFragment& a, const CpuFragment& b, const CpuFragment& c, std::vector<Triangle>& triangles)
+	{
+		const CpuFragment* in[3] = { &a, &b, &c };
+		CpuFragment polygon[4];
+		int corners = 0;
+		for (int j = 0; j < 3; j++)
+		{
+			const CpuFragment& from = *in[j];
+			const CpuFragment& to = *in[(j + 1) % 3];
+			if (from.pos.z >= 0.0f)
+				polygon[corners++] = from;
+			if ((from.pos.z >= 0.0f) != (to.pos.z >= 0.0f))
+				polygon[corners++] = Lerp(from, to, from.pos.z / (from.pos.z - to.pos.z));
+		}
+
+		for (int j = 2; j < corners; j++)
+		{
+			Triangle triangle;
+			if (SetupTriangle(width, height, polygon[0], polygon[j - 1], polygon[j], triangle))
+				triangles.push_back(triangle);
+		}
+	}
+
+	// Triangles are set up this many at a time, then drawn, to bound the memory
+	const size_t TRIANGLE_BATCH = 16384;
+	const int BAND_ROWS = 16;
+}
+
+void CpuRasterizer::SetTarget(int width, int height, int sampleCount)
+{
+	mWidth = width;
+	mHeight = height;
+	mSampleCount = sampleCount;
+	mColour.resize((size_t)width * height * sampleCount);
+	mDepth.resize((size_t)width * height * sampleCount);
+}
+
+void CpuRasterizer::Clear(Float3 colour)
+{
+	std::fill(mColour.begin(), mColour.end(), PackColour(colour));
+	std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+}
+
+void CpuRasterizer::Draw(const CpuScene& scene, JobPool* pool)
+{
+	Clock::time_point start = Clock::now();
+
+	CpuGeometryShader geometryShader = GetCpuGeometryShader(scene.key);
+	CpuFragmentShader fragmentShader = GetCpuFragmentShader(scene.key);
+	const signed char (*positions)[2] = GetSamplePositions(mSampleCount);
+	float offsets[CPU_MAX_SAMPLES][2];
+	for (int s = 0; s < mSampleCount; s++)
+	{
+		offsets[s][0] = positions[s][0] / 16.0f;
+		offsets[s][1] = positions[s][1] / 16.0f;
+	}
+
+	std::atomic<long long> shadedPixels(0);
+	std::atomic<long long> coveredSamples(0);
+	std::vector<Triangle> triangles;
+	// indices of the triangles reaching into each band, in draw order
+	int bandCount = (mHeight + BAND_ROWS - 1) / BAND_ROWS;
+	std::vector<std::vector<int>> bandTriangles(bandCount);
+	auto drawBand = [&](int band)
+	{
+		int firstRow = band * BAND_ROWS;
+		int endRow = std::min(firstRow + BAND_ROWS, mHeight);
+		long long shaded = 0;
+		long long covered = 0;
+		for (int index : bandTriangles[band])
+		{
+			const Triangle& triangle = triangles[index];
+			int y0 = std::max(triangle.y0, firstRow);
+			int y1 = std::min(triangle.y1, endRow - 1);
+
+			// the edge functions and depth at each sample relative to its pixel center
+			float sampleDelta[CPU_MAX_SAMPLES][4];
+			for (int s = 0; s < mSampleCount; s++)
+			{
+				for (int i = 0; i < 3; i++)
+					sampleDelta[s][i] = triangle.edges[i].a * offsets[s][0] + triangle.edges[i].b * offsets[s][1];
+				sampleDelta[s][3] = triangle.depth.a * offsets[s][0] + triangle.depth.b * offsets[s][1];
+			}
+
+			for (int y = y0; y <= y1; y++)
+			{
+				float centerY = y + 0.5f;
+				for (int x = triangle.x0; x <= triangle.x1; x++)
+				{
+					float centerX = x + 0.5f;
+					float w0 = triangle.edges[0].At(centerX, centerY);
+					float w1 = triangle.edges[1].At(centerX, centerY);
+					float w2 = triangle.edges[2].At(centerX, centerY);
+					float z = triangle.depth.At(centerX, centerY);
+					size_t pixel = ((size_t)y * mWidth + x) * mSampleCount;
+					float* depth = &mDepth[pixel];
+
+					unsigned int mask = 0;
+					for (int s = 0; s < mSampleCount; s++)
+					{
+						float e0 = w0 + sampleDelta[s][0];
+						float e1 = w1 + sampleDelta[s][1];
+						float e2 = w2 + sampleDelta[s][2];
+						bool inside = (triangle.topLeft[0] ? e0 >= 0.0f : e0 > 0.0f) &&
+							(triangle.topLeft[1] ? e1 >= 0.0f : e1 > 0.0f) &&
+							(triangle.topLeft[2] ? e2 >= 0.0f : e2 > 0.0f);
+						if (inside && z + sampleDelta[s][3] < depth[s])
+							mask |= 1u << s;
+					}
+					if (!mask)
+						continue;
+
+					// one shader invocation for every covered sample, at the pixel center
+					float invW = triangle.invW.At(centerX, centerY);
+					float w = 1.0f / invW;
+					float attributes[ATTRIBUTE_COUNT];
+					for (int i = 0; i < ATTRIBUTE_COUNT; i++)
+						attributes[i] = triangle.attributes[i].At(centerX, centerY) * w;
+					CpuFragment fragment;
+					fragment.pos = { centerX, centerY, z, w };
+					fragment.worldPos = { attributes[0], attributes[1], attributes[2] };
+					fragment.worldNor = { attributes[3], attributes[4], attributes[5] };
+					fragment.u = attributes[6];
+					fragment.v = attributes[7];
+					unsigned int colour = PackColour(fragmentShader(fragment, scene.lights, scene.texture));
+					shaded++;
+
+					unsigned int* samples = &mColour[pixel];
+					for (int s = 0; s < mSampleCount; s++)
+					{
+						if (mask & (1u << s))
+						{
+							samples[s] = colour;
+							depth[s] = z + sampleDelta[s][3];
+							covered++;
+						}
+					}
+				}
+			}
+		}
+		shadedPixels += shaded;
+		coveredSamples += covered;
+	};
+
+	auto drawTriangles = [&]()
+	{
+		for (int i = 0; i < (int)triangles.size(); i++)
+		{
+			for (int band = triangles[i].y0 / BAND_ROWS; band <= triangles[i].y1 / BAND_ROWS; band++)
+				bandTriangles[band].push_back(i);
+		}
+		if (pool && bandCount > 1)
+		{
+			pool->ParallelFor(bandCount, 1, [&drawBand](int begin, int end)
+			{
+				for (int band = begin; band < end; band++)
+					drawBand(band);
+			});
+		}
+		else
+		{
+			for (int band = 0; band < bandCount; band++)
+				drawBand(band);
+		}
+		mStats.triangles += (int)triangles.size();
+		triangles.clear();
+		for (std::vector<int>& band : bandTriangles)
+			band.clear();
+	};
+
+	mStats = {};
+	triangles.reserve(TRIANGLE_BATCH + 4);
+	for (int i = 0; i < scene.itemCount; i++)
+	{
+		const DrawItem& item = scene.items[i];
+		if (item.mesh >= scene.meshes->size())
+			continue;
+		const IndexedMesh& mesh = (*scene.meshes)[item.mesh];
+		Float4x4 worldViewProj = Multiply(item.world, scene.viewProj);
+		for (size_t j = 0; j + 2 < mesh.indices.size(); j += 3)
+		{
+			CpuVertex input[3];
+			for (int k = 0; k < 3; k++)
+			{
+				const MeshVertex& vertex = mesh.vertices[mesh.indices[j + k]];
+				input[k] = { { vertex.position.x, vertex.position.y, vertex.position.z, 1.0f }, vertex.u, vertex.v };
+			}
+			CpuFragment output[6];
+			int count = geometryShader(input, item.world, worldViewProj, output);
+			for (int k = 0; k + 2 < count; k += 3)
+				AddTriangle(mWidth, mHeight, output[k], output[k + 1], output[k + 2], triangles);
+			if (triangles.size() >= TRIANGLE_BATCH)
+				drawTriangles();
+		}
+	}
+	drawTriangles();
+	mStats.shadedPixels = shadedPixels;
+	mStats.coveredSamples = coveredSamples;
+
+	mStats.drawMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void CpuRasterizer::Resolve(std::vector<unsigned int>& rgba) const
+{
+	rgba.resize((size_t)mWidth * mHeight);
+	for (size_t pixel = 0; pixel < rgba.size(); pixel++)
+	{
+		const unsigned int* samples = &mColour[pixel * mSampleCount];
+		unsigned int sum[4] = {};
+		for (int s = 0; s < mSampleCount; s++)
+		{
+			for (int channel = 0; channel < 4; channel++)
+				sum[channel] += samples[s] >> (channel * 8) & 0xff;
+		}
+		unsigned int resolved = 0;
+		for (int channel = 0; channel < 4; channel++)
+			resolved |= (sum[channel] + mSampleCount / 2) / mSampleCount << (channel * 8);
+		rgba[pixel] = resolved;
+	}
+}
+
+std::vector<MsaaTiming> BenchmarkMsaa(const CpuScene& scene, int width, int height, Float3 clearColour, JobPool* pool, int iterations)
+{
+	CpuRasterizer reference;
+	reference.SetTarget(width, height, 16);
+	reference.Clear(clearColour);
+	reference.Draw(scene, pool);
+	std::vector<unsigned int> referenceImage;
+	reference.Resolve(referenceImage);
+	std::vector<int> edgePixels;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const unsigned int* samples = reference.GetSamples(x, y);
+			if (std::any_of(samples + 1, samples + 16, [samples](unsigned int sample) { return sample != samples[0]; }))
+				edgePixels.push_back(y * width + x);
+		}
+	}
+
+	std::vector<MsaaTiming> timings;
+	CpuRasterizer rasterizer;
+	std::vector<unsigned int> image;
+	for (int samples = 1; samples <= 8; samples *= 2)
+	{
+		rasterizer.SetTarget(width, height, samples);
+		double totalMs = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			Clock::time_point start = Clock::now();
+			rasterizer.Clear(clearColour);
+			rasterizer.Draw(scene, pool);
+			rasterizer.Resolve(image);
+			totalMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+
+		long long difference = 0;
+		for (int pixel : edgePixels)
+		{
+			for (int channel = 0; channel < 3; channel++)
+			{
+				int a = image[pixel] >> (channel * 8) & 0xff;
+				int b = referenceImage[pixel] >> (channel * 8) & 0xff;
+				difference += a > b ? a - b : b - a;
+			}
+		}
+
+		MsaaTiming timing;
+		timing.samples = samples;
+		timing.drawMs = totalMs / iterations;
+		timing.nsPerSample = timing.drawMs * 1e6 / ((double)width * height * samples);
+		timing.nsPerExtraSample = samples == 1 ? 0.0 : (timing.drawMs - timings[0].drawMs) * 1e6 / ((double)width * height * (samples - 1));
+		timing.shadedPixels = rasterizer.GetStats().shadedPixels;
+		timing.coveredSamples = rasterizer.GetStats().coveredSamples;
+		timing.edgeError = edgePixels.empty() ? 0.0f : (float)(difference / (255.0 * 3.0 * edgePixels.size()));
+		timings.push_back(timing);
+	}
+	return timings;
+}
@@ -0,0 +1,98 @@
+//--------------------------------------------------------------------------------------
+// CpuRasterizer - draws the scene with the shaders of CpuShading.h into a multisampled
+// colour and depth buffer on the CPU, the way D3D11 draws into an MSAA render target.
+//
+// Each pixel a triangle touches gets a coverage mask with one bit per sample. A bit is
+// set where the sample is inside the triangle (at the D3D11 standard sample positions)
+// and passes the depth test against that sample's own depth. Pixels with a non-empty
+// mask run the fragment shader once, at the pixel center like the GPU without centroid
+// interpolation. The colour and depth go to the covered samples only. Resolve()
+// averages the samples of each pixel, like ResolveSubresource(). With one sample the
+// mask is just the pixel center, so this is the plain rasterizer.
+//
+// Depth follows main.cpp: cleared to 1.0, DepthFunc LESS. Colour is stored as RGBA8,
+// like the DXGI_FORMAT_R8G8B8A8_UNORM targets. Back faces are culled like the default
+// rasterizer state, and edges follow the top-left rule, so triangles sharing an edge
+// never both cover a sample on it.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+
+#include "CpuShading.h"
+#include "MathTypes.h"
+#include "MeshLod.h"
+#include "ShaderPermutations.h"
+
+class JobPool;
+struct DrawItem;
+
+const int CPU_MAX_SAMPLES = 16;
+
+// What Draw() needs to draw a frame. All draws use 'texture'; DrawItem::texture is
+// ignored.
+struct CpuScene
+{
+	Float4x4 viewProj;		// row-major, a D3D projection (0 <= z <= w, w = view depth)
+	const DrawItem* items;
+	int itemCount;
+	const std::vector<IndexedMesh>* meshes;	// the mesh table of DrawItem::mesh
+	ShaderKey key;
+	CpuLights lights;
+	CpuTexture texture;
+};
+
+struct CpuRasterizerStats
+{
+	int triangles;				// drawn, after near plane clipping
+	long long shadedPixels;		// fragment shader invocations
+	long long coveredSamples;	// samples written
+	double drawMs;
+};
+
+class CpuRasterizer
+{
+public:
+	// 'sampleCount' is 1, 2, 4, 8 or 16. Contents are undefined until Clear().
+	void SetTarget(int width, int height, int sampleCount);
+	void Clear(Float3 colour);
+
+	// The rows of the target are split in bands drawn in parallel on the pool when there
+	// is one. Every band draws the triangles in order, so the result doesn't depend on
+	// the pool.
+	void Draw(const CpuScene& scene, JobPool* pool = nullptr);
+
+	// One RGBA8 pixel per width * height, the mean of its samples
+	void Resolve(std::vector<unsigned int>& rgba) const;
+
+	int GetWidth() const { return mWidth; }
+	int GetHeight() const { return mHeight; }
+	int GetSampleCount() const { return mSampleCount; }
+	// The 'sampleCount' samples of a pixel, RGBA8
+	const unsigned int* GetSamples(int x, int y) const { return &mColour[(y * mWidth + x) * mSampleCount]; }
+	const CpuRasterizerStats& GetStats() const { return mStats; }
+
+private:
+	int mWidth = 0;
+	int mHeight = 0;
+	int mSampleCount = 0;
+	std::vector<unsigned int> mColour;	// the samples of a pixel are next to each other
+	std::vector<float> mDepth;
+	CpuRasterizerStats mStats = {};
+};
+
+struct MsaaTiming
+{
+	int samples;
+	double drawMs;				// Clear() + Draw() + Resolve(), averaged
+	double nsPerSample;			// drawMs over all samples of the target
+	double nsPerExtraSample;	// what drawMs adds to the 1x time, over the extra samples
+	long long shadedPixels;
+	long long coveredSamples;
+	float edgeError;			// mean difference to the 16x image on its edge pixels, 0 to 1
+};
+
+// Draws 'scene' with 1, 2, 4 and 8 samples, averaged over 'iterations', and compares
+// each resolved image with a 16 sample one. Edge pixels are the pixels whose 16 samples
+// aren't all the same colour.
+std::vector<MsaaTiming> BenchmarkMsaa(const CpuScene& scene, int width, int height, Float3 clearColour, JobPool* pool, int iterations = 3);
@@ -0,0 +1,46 @@
+#include "CpuShading.h"
+
+#include <utility>
+
+Float3 SampleBilinear(const CpuTexture& texture, float u, float v)
+{
+	// texel centers are at (i + 0.5) / size, addressing is clamped
+	float x = u * texture.width - 0.5f;
+	float y = v * texture.height - 0.5f;
+	int x0 = (int)floorf(x);
+	int y0 = (int)floorf(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	Float3 result = { 0.0f, 0.0f, 0.0f };
+	for (int j = 0; j < 2; j++)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			int tx = x0 + i < 0 ? 0 : (x0 + i >= texture.width ? texture.width - 1 : x0 + i);
+			int ty = y0 + j < 0 ? 0 : (y0 + j >= texture.height ? texture.height - 1 : y0 + j);
+			const unsigned char* texel = texture.rgba + (ty * texture.width + tx) * 4;
+			float weight = (i ? fx : 1.0f - fx) * (j ? fy : 1.0f - fy);
+			result = result + Float3{ texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f } * weight;
+		}
+	}
+	return result;
+}
+
+// One entry per key, each pointing at the specialisation for that key
+template <ShaderKey... Keys>
+static CpuFragmentShader LookupFragmentShader(ShaderKey key, std::integer_sequence<ShaderKey, Keys...>)
+{
+	static const CpuFragmentShader table[] = { &ShadeFragment<Keys>... };
+	return table[key];
+}
+
+CpuFragmentShader GetCpuFragmentShader(ShaderKey key)
+{
+	return LookupFragmentShader(key & SHADER_KEY_PS_MASK, std::make_integer_sequence<ShaderKey, SHADER_KEY_COUNT>());
+}
+
+CpuGeometryShader GetCpuGeometryShader(ShaderKey key)
+{
+	return KeyExtrude(key) ? &ExpandTriangle<true> : &ExpandTriangle<false>;
+}
@@ -0,0 +1,199 @@
+//--------------------------------------------------------------------------------------
+// CpuShading - C++ reference versions of GeometryShader.hlsl and Fragment.hlsl.
+//
+// The permutation features are template parameters, so every ShaderKey gets its own
+// function with the disabled features compiled out, the same way the HLSL #if's do.
+// Use GetCpuFragmentShader()/GetCpuGeometryShader() to go from a runtime key to the
+// specialised function.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include "ClusteredLighting.h"
+#include "MathTypes.h"
+#include "ShaderPermutations.h"
+#include "ShadowMaps.h"
+
+// RGBA8 texture, sampled with clamp addressing like gSamplerState
+struct CpuTexture
+{
+	const unsigned char* rgba;
+	int width, height;
+};
+
+// Mirrors FS_CONSTANT_BUFFER, plus the cluster buffers the CLUSTERED permutations read
+// and the shadow maps of the SHADOWS permutations
+struct CpuLights
+{
+	Float3 pos[SHADER_MAX_LIGHTS];
+	Float3 col[SHADER_MAX_LIGHTS];
+
+	const PointLight* clusterLights;	// world space
+	const ClusterRange* clusterGrid;
+	const unsigned int* clusterLightIndices;
+	ClusterConstants clusterConstants;
+
+	const ShadowConstants* shadowConstants;
+	const CpuShadowMaps* shadowMaps;
+};
+
+// Mirrors GS_IN / GS_OUT
+struct CpuVertex
+{
+	Float4 pos;
+	float u, v;
+};
+
+// 'pos' is clip space when it leaves the geometry stage. The fragment stage expects it
+// the way SV_Position reaches a pixel shader: pixel x/y, depth, and w = view space depth.
+struct CpuFragment
+{
+	Float4 pos;
+	Float3 worldPos;
+	Float3 worldNor;
+	float u, v;
+};
+
+//--------------------------------------------------------------------------------------
+// Fragment stage
+//--------------------------------------------------------------------------------------
+Float3 SampleBilinear(const CpuTexture& texture, float u, float v);
+
+template <bool Textured>
+struct TextureStage
+{
+	static Float3 Sample(const CpuTexture& texture, float u, float v) { return SampleBilinear(texture, u, v); }
+};
+
+template <>
+struct TextureStage<false>
+{
+	static Float3 Sample(const CpuTexture&, float, float) { return { 1.0f, 1.0f, 1.0f }; }
+};
+
+// LIGHTING_MODEL != 1 in the shader is half-Lambert
+template <int Model>
+struct DiffuseTerm
+{
+	static float Factor(float NdotL)
+	{
+		float factor = NdotL * 0.5f + 0.5f;
+		return factor * factor;
+	}
+};
+
+template <>
+struct DiffuseTerm<LIGHTING_LAMBERT>
+{
+	static float Factor(float NdotL) { return NdotL > 0.0f ? NdotL : 0.0f; }
+};
+
+template <int Model, int LightCount, bool Clustered, bool Shadowed>
+struct LightingStage
+{
+	static Float3 Shade(Float3 textureCol, const CpuFragment& input, const CpuLights& lights)
+	{
+		Float3 fragmentCol = textureCol * 0.2f;
+		Float3 normal = Normalize(input.worldNor);
+		// LightCount is a constant, the compiler unrolls this like [unroll] does
+		for (int i = 0; i < LightCount; i++)
+		{
+			Float3 toLight = lights.pos[i] - input.worldPos;
+			float visibility = 1.0f;
+			if (Shadowed && i == 0)
+			{
+				// the sun: from lightPos[0] towards the origin, through the shadow maps
+				toLight = lights.pos[0];
+				visibility = ShadowFactor(*lights.shadowConstants, *lights.shadowMaps, input.worldPos, normal, input.pos.w);
+			}
+			float NdotL = Dot(Normalize(toLight), normal);
+			fragmentCol = fragmentCol + textureCol * lights.col[i] * (DiffuseTerm<Model>::Factor(NdotL) * visibility);
+		}
+		return fragmentCol;
+	}
+};
+
+// CLUSTERED: the lights of the fragment's cluster, with the same radius falloff as the
+// shader. Clustered keys are never shadowed.
+template <int Model, int LightCount, bool Shadowed>
+struct LightingStage<Model, LightCount, true, Shadowed>
+{
+	static Float3 Shade(Float3 textureCol, const CpuFragment& input, const CpuLights& lights)
+	{
+		Float3 fragmentCol = textureCol * 0.2f;
+		Float3 normal = Normalize(input.worldNor);
+		int cluster = GetClusterIndex(lights.clusterConstants, input.pos.x, input.pos.y, input.pos.w);
+		ClusterRange range = lights.clusterGrid[cluster];
+		for (unsigned int i = 0; i < range.count; i++)
+		{
+			const PointLight& light = lights.clusterLights[lights.clusterLightIndices[range.offset + i]];
+			Float3 toLight = Float3{ light.position[0], light.position[1], light.position[2] } - input.worldPos;
+			float falloff = 1.0f - Dot(toLight, toLight) / (light.radius * light.radius);
+			falloff = falloff < 0.0f ? 0.0f : (falloff > 1.0f ? 1.0f : falloff);
+			float NdotL = Dot(Normalize(toLight), normal);
+			Float3 color = { light.color[0], light.color[1], light.color[2] };
+			fragmentCol = fragmentCol + textureCol * color * (DiffuseTerm<Model>::Factor(NdotL) * falloff * falloff);
+		}
+		return fragmentCol;
+	}
+};
+
+template <int LightCount, bool Clustered, bool Shadowed>
+struct LightingStage<LIGHTING_UNLIT, LightCount, Clustered, Shadowed>
+{
+	static Float3 Shade(Float3 textureCol, const CpuFragment&, const CpuLights&) { return textureCol; }
+};
+
+// Unlit wins over clustered, both partial specialisations would match otherwise
+template <int LightCount, bool Shadowed>
+struct LightingStage<LIGHTING_UNLIT, LightCount, true, Shadowed>
+{
+	static Float3 Shade(Float3 textureCol, const CpuFragment&, const CpuLights&) { return textureCol; }
+};
+
+template <ShaderKey Key>
+Float3 ShadeFragment(const CpuFragment& input, const CpuLights& lights, const CpuTexture& texture)
+{
+	Float3 textureCol = TextureStage<KeyTextured(Key)>::Sample(texture, input.u, input.v);
+	return LightingStage<KeyLightingModel(Key), KeyLightCount(Key), KeyClustered(Key), KeyShadowed(Key)>::Shade(textureCol, input, lights);
+}
+
+typedef Float3 (*CpuFragmentShader)(const CpuFragment& input, const CpuLights& lights, const CpuTexture& texture);
+
+// Specialisation for the key (bits outside SHADER_KEY_PS_MASK are ignored)
+CpuFragmentShader GetCpuFragmentShader(ShaderKey key);
+
+//--------------------------------------------------------------------------------------
+// Geometry stage, returns the number of vertices written to 'output' (3 or 6)
+//--------------------------------------------------------------------------------------
+template <bool Extrude>
+int ExpandTriangle(const CpuVertex input[3], const Float4x4& world, const Float4x4& worldViewProj, CpuFragment output[6])
+{
+	Float3 p0 = { input[0].pos.x, input[0].pos.y, input[0].pos.z };
+	Float3 p1 = { input[1].pos.x, input[1].pos.y, input[1].pos.z };
+	Float3 p2 = { input[2].pos.x, input[2].pos.y, input[2].pos.z };
+	Float3 n = Normalize(Cross(p1 - p0, p2 - p0));
+	Float4 worldNormal = Mul({ n.x, n.y, n.z, 0.0f }, world);
+
+	int count = 0;
+	for (int copy = 0; copy < (Extrude ? 2 : 1); copy++)
+	{
+		float offset = copy == 0 ? 0.0f : 0.5f;
+		for (int i = 0; i < 3; i++)
+		{
+			Float4 pos = { input[i].pos.x + n.x * offset, input[i].pos.y + n.y * offset, input[i].pos.z + n.z * offset, input[i].pos.w };
+			Float4 worldPos = Mul(pos, world);
+			CpuFragment& element = output[count++];
+			element.pos = Mul(pos, worldViewProj);
+			element.worldPos = { worldPos.x, worldPos.y, worldPos.z };
+			element.worldNor = { worldNormal.x, worldNormal.y, worldNormal.z };
+			element.u = input[i].u;
+			element.v = input[i].v;
+		}
+	}
+	return count;
+}
+
+typedef int (*CpuGeometryShader)(const CpuVertex input[3], const Float4x4& world, const Float4x4& worldViewProj, CpuFragment output[6]);
+
+// Specialisation for the key (bits outside SHADER_KEY_GS_MASK are ignored)
+CpuGeometryShader GetCpuGeometryShader(ShaderKey key);
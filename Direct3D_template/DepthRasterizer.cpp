@@ -0,0 +1,153 @@
+#include "DepthRasterizer.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define DEPTH_RASTERIZER_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// Screen position in pixels (y down) and depth of a clip space vertex
+	struct ScreenVertex
+	{
+		float x, y, z;
+	};
+
+	// Edge function of a -> b: positive on the inside of a triangle with positive area
+	struct Edge
+	{
+		float dx, dy, c;
+
+		float At(float x, float y) const { return dx * x + dy * y + c; }
+	};
+
+	Edge MakeEdge(const ScreenVertex& a, const ScreenVertex& b)
+	{
+		Edge edge;
+		edge.dx = -(b.y - a.y);
+		edge.dy = b.x - a.x;
+		edge.c = -(edge.dx * a.x + edge.dy * a.y);
+		return edge;
+	}
+
+	Float4 Lerp(const Float4& a, const Float4& b, float t)
+	{
+		return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+	}
+
+	// 'a', 'b' and 'c' are in front of the near plane
+	bool RasterizeClipped(float* buffer, int width, int height, const Float4& a, const Float4& b, const Float4& c)
+	{
+		const Float4* clip[3] = { &a, &b, &c };
+		ScreenVertex v[3];
+		for (int i = 0; i < 3; i++)
+		{
+			float invW = 1.0f / clip[i]->w;
+			v[i].x = (clip[i]->x * invW * 0.5f + 0.5f) * width;
+			v[i].y = (0.5f - clip[i]->y * invW * 0.5f) * height;
+			v[i].z = clip[i]->z * invW;
+		}
+
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+		if (area == 0.0f)
+			return false;
+		if (area < 0.0f)
+		{
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		// Pixels whose centers might be inside; the float bounds are clamped first so
+		// vertices close to the near plane can't overflow the conversion
+		float minX = std::max(std::min(std::min(v[0].x, v[1].x), v[2].x), 0.0f);
+		float maxX = std::min(std::max(std::max(v[0].x, v[1].x), v[2].x), (float)width);
+		float minY = std::max(std::min(std::min(v[0].y, v[1].y), v[2].y), 0.0f);
+		float maxY = std::min(std::max(std::max(v[0].y, v[1].y), v[2].y), (float)height);
+		int x0 = (int)minX & ~3;	// whole groups of four
+		int x1 = std::min((int)maxX, width - 1);
+		int y0 = (int)minY;
+		int y1 = std::min((int)maxY, height - 1);
+		if (x0 > x1 || y0 > y1)
+			return false;
+
+		// e0 is the weight of v[0] and so on, times 'area'
+		Edge e0 = MakeEdge(v[1], v[2]);
+		Edge e1 = MakeEdge(v[2], v[0]);
+		Edge e2 = MakeEdge(v[0], v[1]);
+		// depth = v0.z + (v1.z - v0.z) * e1 / area + (v2.z - v0.z) * e2 / area
+		float invArea = 1.0f / area;
+		float dz1 = (v[1].z - v[0].z) * invArea;
+		float dz2 = (v[2].z - v[0].z) * invArea;
+		Edge depth = { dz1 * e1.dx + dz2 * e2.dx, dz1 * e1.dy + dz2 * e2.dy, v[0].z + dz1 * e1.c + dz2 * e2.c };
+
+		float startX = x0 + 0.5f;
+		for (int y = y0; y <= y1; y++)
+		{
+			float centerY = y + 0.5f;
+			float* row = buffer + y * width;
+#ifdef DEPTH_RASTERIZER_USE_SSE
+			const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+			const __m128 zero = _mm_setzero_ps();
+			__m128 w0 = _mm_add_ps(_mm_set1_ps(e0.At(startX, centerY)), _mm_mul_ps(lanes, _mm_set1_ps(e0.dx)));
+			__m128 w1 = _mm_add_ps(_mm_set1_ps(e1.At(startX, centerY)), _mm_mul_ps(lanes, _mm_set1_ps(e1.dx)));
+			__m128 w2 = _mm_add_ps(_mm_set1_ps(e2.At(startX, centerY)), _mm_mul_ps(lanes, _mm_set1_ps(e2.dx)));
+			__m128 z = _mm_add_ps(_mm_set1_ps(depth.At(startX, centerY)), _mm_mul_ps(lanes, _mm_set1_ps(depth.dx)));
+			const __m128 w0Step = _mm_set1_ps(e0.dx * 4.0f);
+			const __m128 w1Step = _mm_set1_ps(e1.dx * 4.0f);
+			const __m128 w2Step = _mm_set1_ps(e2.dx * 4.0f);
+			const __m128 zStep = _mm_set1_ps(depth.dx * 4.0f);
+			for (int x = x0; x <= x1; x += 4)
+			{
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+				__m128 current = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(current, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+				w0 = _mm_add_ps(w0, w0Step);
+				w1 = _mm_add_ps(w1, w1Step);
+				w2 = _mm_add_ps(w2, w2Step);
+				z = _mm_add_ps(z, zStep);
+			}
+#else
+			float w0 = e0.At(startX, centerY);
+			float w1 = e1.At(startX, centerY);
+			float w2 = e2.At(startX, centerY);
+			float z = depth.At(startX, centerY);
+			for (int x = x0; x <= x1; x++)
+			{
+				if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && z < row[x])
+					row[x] = z;
+				w0 += e0.dx;
+				w1 += e1.dx;
+				w2 += e2.dx;
+				z += depth.dx;
+			}
+#endif
+		}
+		return true;
+	}
+}
+
+int RasterizeDepthTriangle(float* depth, int width, int height, const Float4& a, const Float4& b, const Float4& c)
+{
+	// Clip against the near plane (z >= 0), which leaves 0, 3 or 4 corners. Past it w
+	// is positive.
+	const Float4* in[3] = { &a, &b, &c };
+	Float4 polygon[4];
+	int corners = 0;
+	for (int j = 0; j < 3; j++)
+	{
+		const Float4& from = *in[j];
+		const Float4& to = *in[(j + 1) % 3];
+		if (from.z >= 0.0f)
+			polygon[corners++] = from;
+		if ((from.z >= 0.0f) != (to.z >= 0.0f))
+			polygon[corners++] = Lerp(from, to, from.z / (from.z - to.z));
+	}
+
+	int drawn = 0;
+	for (int j = 2; j < corners; j++)
+		drawn += RasterizeClipped(depth, width, height, polygon[0], polygon[j - 1], polygon[j]) ? 1 : 0;
+	return drawn;
+}
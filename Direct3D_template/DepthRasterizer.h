@@ -0,0 +1,20 @@
+//--------------------------------------------------------------------------------------
+// DepthRasterizer - draws triangles into a float depth buffer on the CPU.
+//
+// Same conventions as the D3D depth buffers in main.cpp: 0 = near plane, cleared to
+// 1.0, and a pixel keeps the nearer depth (DepthFunc LESS). Depth is z / w, linear in
+// screen space, sampled at pixel centers. Rows are filled four pixels per SSE
+// instruction where SSE is available.
+//
+// Used for the occluders of OcclusionCulling.h and the CPU shadow maps of ShadowMaps.h.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include "MathTypes.h"
+
+// Draws a triangle of clip space vertices (D3D projection, 0 <= z <= w) into 'depth',
+// 'width' x 'height' pixels with y down. 'width' must be a multiple of 4. The triangle
+// is clipped against the near plane; the other planes are left to the screen bounds
+// (and the far plane to the depth test). Either winding is drawn.
+// Returns the number of triangles drawn after clipping, 0 to 2.
+int RasterizeDepthTriangle(float* depth, int width, int height, const Float4& a, const Float4& b, const Float4& c);
@@ -0,0 +1,73 @@
+#include "DynamicResolution.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+DynamicResolution::DynamicResolution(const DynamicResolutionSettings& settings)
+	: mSettings(settings)
+{
+	Reset(settings.maxScale);
+}
+
+void DynamicResolution::SetSettings(const DynamicResolutionSettings& settings)
+{
+	mSettings = settings;
+	mScale = Quantize(mScale);
+}
+
+float DynamicResolution::Quantize(float scale) const
+{
+	// rounds down to a grid anchored at maxScale, so maxScale itself is always reachable
+	float steps = ceilf((mSettings.maxScale - scale) / mSettings.scaleStep - 1e-4f);
+	scale = mSettings.maxScale - std::max(steps, 0.0f) * mSettings.scaleStep;
+	return std::max(scale, mSettings.minScale);
+}
+
+void DynamicResolution::Reset(float scale)
+{
+	mScale = Quantize(std::min(scale, mSettings.maxScale));
+	mAverageMs = 0.0f;
+	mFramesSinceChange = 0;
+}
+
+float DynamicResolution::Update(float frameMs, float frameScale)
+{
+	if (frameMs <= 0.0f || frameScale <= 0.0f)
+		return mScale;
+
+	// what the frame would have cost at the current scale
+	float ratio = mScale / frameScale;
+	float currentMs = frameMs * ratio * ratio;
+	mAverageMs = mAverageMs == 0.0f ? currentMs : mAverageMs + (currentMs - mAverageMs) * mSettings.smoothing;
+
+	if (++mFramesSinceChange < mSettings.settleFrames)
+		return mScale;
+	bool over = mAverageMs > mSettings.budgetMs;
+	bool under = mAverageMs < mSettings.budgetMs * mSettings.raiseBelow;
+	if (!over && !under)
+		return mScale;
+
+	float wanted = mScale * sqrtf(mSettings.budgetMs * mSettings.targetFraction / mAverageMs);
+	wanted = std::max(wanted, mScale - mSettings.maxStepDown);
+	wanted = std::min(wanted, mScale + mSettings.maxStepUp);
+	wanted = std::min(std::max(wanted, mSettings.minScale), mSettings.maxScale);
+	// going down always drops at least one step of the grid, going up may not make one
+	float scale = Quantize(over ? std::min(wanted, mScale - mSettings.scaleStep) : wanted);
+	if (scale == mScale)
+		return mScale;
+
+	// the average follows the scale, like the frames it will see
+	ratio = scale / mScale;
+	mAverageMs *= ratio * ratio;
+	mScale = scale;
+	mFramesSinceChange = 0;
+	mChanges++;
+	return mScale;
+}
+
+void DynamicResolution::GetRenderSize(int width, int height, int& renderWidth, int& renderHeight) const
+{
+	renderWidth = std::max((int)(width * mScale + 0.5f), 1);
+	renderHeight = std::max((int)(height * mScale + 0.5f), 1);
+}
@@ -0,0 +1,68 @@
+//--------------------------------------------------------------------------------------
+// DynamicResolution - picks the scene's render resolution from measured frame times.
+//
+// The scene is drawn at 'scale' times the back buffer's width and height and then
+// upscaled, so its cost goes roughly with scale^2. Update() takes the time of a drawn
+// frame and the scale it was drawn at. It converts the time to the current scale and
+// adds it to a moving average. When the average is over the budget, or well under it,
+// the scale moves towards the one that would hit the target:
+//
+//   scale' = scale * sqrt(budget * targetFraction / average)
+//
+// Four rules keep it from oscillating:
+//   - a dead band: nothing changes between 'raiseBelow' and 1.0 of the budget
+//   - steps are limited, larger going down than going up
+//   - after a change it waits 'settleFrames' frames before the next one
+//   - scales are multiples of 'scaleStep'
+//
+// There is no D3D in here, so the control loop can be driven by synthetic frame times.
+// GPU timings arrive a few frames late, which the per-frame scale accounts for.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+struct DynamicResolutionSettings
+{
+	float budgetMs = 1000.0f / 60.0f;
+	float targetFraction = 0.85f;	// of the budget, what a change aims for
+	float raiseBelow = 0.7f;		// of the budget, the average has to be below it to scale up
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float maxStepDown = 0.15f;
+	float maxStepUp = 0.05f;
+	float scaleStep = 1.0f / 32.0f;
+	float smoothing = 0.2f;			// weight of a new frame in the average
+	int settleFrames = 10;
+};
+
+class DynamicResolution
+{
+public:
+	explicit DynamicResolution(const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+
+	void SetSettings(const DynamicResolutionSettings& settings);
+	const DynamicResolutionSettings& GetSettings() const { return mSettings; }
+
+	// 'frameMs' is the time of a frame drawn at 'frameScale'. Returns the scale for the
+	// next frame.
+	float Update(float frameMs, float frameScale);
+	// Back to 'scale' with no history, e.g. after a resize
+	void Reset(float scale = 1.0f);
+
+	float GetScale() const { return mScale; }
+	// Average frame time converted to the current scale, 0 before the first Update()
+	float GetAverageMs() const { return mAverageMs; }
+	int GetChangeCount() const { return mChanges; }
+
+	// The scene's size at the current scale for a 'width' x 'height' back buffer, at
+	// least one pixel each way
+	void GetRenderSize(int width, int height, int& renderWidth, int& renderHeight) const;
+
+private:
+	float Quantize(float scale) const;
+
+	DynamicResolutionSettings mSettings;
+	float mScale = 1.0f;
+	float mAverageMs = 0.0f;
+	int mFramesSinceChange = 0;
+	int mChanges = 0;
+};
@@ -0,0 +1,283 @@
+#include "Ecs.h"
+#include "JobPool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mutex>
+
+namespace
+{
+	struct ComponentInfo
+	{
+		size_t size;
+		size_t alignment;
+	};
+
+	std::mutex gComponentMutex;
+	std::vector<ComponentInfo> gComponentTypes;
+
+	unsigned char* AllocateChunkMemory()
+	{
+		// the pointer malloc returned is kept just before the aligned block
+		unsigned char* raw = (unsigned char*)malloc(CHUNK_SIZE + 64 + sizeof(void*));
+		unsigned char* aligned = (unsigned char*)(((size_t)raw + sizeof(void*) + 63) & ~(size_t)63);
+		((void**)aligned)[-1] = raw;
+		return aligned;
+	}
+
+	void FreeChunkMemory(unsigned char* data)
+	{
+		free(((void**)data)[-1]);
+	}
+}
+
+int RegisterComponentType(size_t size, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(gComponentMutex);
+	assert(gComponentTypes.size() < MAX_COMPONENT_TYPES);
+	gComponentTypes.push_back({ size, alignment });
+	return (int)gComponentTypes.size() - 1;
+}
+
+EntityWorld::EntityWorld()
+{
+}
+
+EntityWorld::~EntityWorld()
+{
+	for (std::unique_ptr<Archetype>& archetype : mArchetypes)
+	{
+		for (std::unique_ptr<Chunk>& chunk : archetype->chunks)
+			FreeChunkMemory(chunk->data);
+	}
+}
+
+Archetype* EntityWorld::GetArchetype(ComponentMask mask)
+{
+	auto found = mArchetypeByMask.find(mask);
+	if (found != mArchetypeByMask.end())
+		return found->second;
+
+	std::vector<ComponentInfo> types;
+	{
+		std::lock_guard<std::mutex> lock(gComponentMutex);
+		types = gComponentTypes;
+	}
+
+	// Chunk layout: Entity array, then one array per component in type order,
+	// each aligned for its type. Start from the unpadded estimate and shrink until it fits.
+	size_t bytesPerEntity = sizeof(Entity);
+	for (int type = 0; type < (int)types.size(); type++)
+	{
+		if (mask & (1ull << type))
+			bytesPerEntity += types[type].size;
+	}
+
+	std::unique_ptr<Archetype> archetype(new Archetype());
+	archetype->mask = mask;
+	for (int capacity = (int)(CHUNK_SIZE / bytesPerEntity); capacity > 0; capacity--)
+	{
+		size_t offset = sizeof(Entity) * capacity;
+		for (int type = 0; type < MAX_COMPONENT_TYPES; type++)
+		{
+			archetype->offsets[type] = -1;
+			archetype->sizes[type] = 0;
+			if (type >= (int)types.size() || !(mask & (1ull << type)))
+				continue;
+			archetype->sizes[type] = (int)types[type].size;
+			offset = (offset + types[type].alignment - 1) & ~(types[type].alignment - 1);
+			archetype->offsets[type] = (int)offset;
+			offset += types[type].size * capacity;
+		}
+		if (offset <= CHUNK_SIZE)
+		{
+			archetype->capacity = capacity;
+			break;
+		}
+	}
+	// Not even one entity of this archetype fits in a chunk, AllocateRow would write past its end
+	assert(archetype->capacity > 0);
+
+	Archetype* result = archetype.get();
+	mArchetypes.push_back(std::move(archetype));
+	mArchetypeByMask[mask] = result;
+	return result;
+}
+
+void EntityWorld::AllocateRow(Archetype* archetype, Entity entity)
+{
+	if (archetype->chunks.empty() || archetype->chunks.back()->count == archetype->capacity)
+	{
+		std::unique_ptr<Chunk> chunk(new Chunk());
+		chunk->data = AllocateChunkMemory();
+		chunk->count = 0;
+		archetype->chunks.push_back(std::move(chunk));
+	}
+
+	Chunk* chunk = archetype->chunks.back().get();
+	int row = chunk->count++;
+	((Entity*)chunk->data)[row] = entity;
+	for (int type = 0; type < MAX_COMPONENT_TYPES; type++)
+	{
+		if (archetype->offsets[type] >= 0)
+		{
+			size_t size = archetype->sizes[type];
+			memset(chunk->data + archetype->offsets[type] + size * row, 0, size);
+		}
+	}
+
+	Record& record = mRecords[entity.index];
+	record.archetype = archetype;
+	record.chunk = (int)archetype->chunks.size() - 1;
+	record.row = row;
+}
+
+// Fills the hole with the archetype's last entity so chunks stay dense
+void EntityWorld::FreeRow(Archetype* archetype, int chunkIndex, int row)
+{
+	Chunk* chunk = archetype->chunks[chunkIndex].get();
+	Chunk* last = archetype->chunks.back().get();
+	int lastRow = last->count - 1;
+
+	if (chunk != last || row != lastRow)
+	{
+		Entity moved = ((Entity*)last->data)[lastRow];
+		((Entity*)chunk->data)[row] = moved;
+		for (int type = 0; type < MAX_COMPONENT_TYPES; type++)
+		{
+			if (archetype->offsets[type] >= 0)
+			{
+				size_t size = archetype->sizes[type];
+				memcpy(chunk->data + archetype->offsets[type] + size * row, last->data + archetype->offsets[type] + size * lastRow, size);
+			}
+		}
+		mRecords[moved.index].chunk = chunkIndex;
+		mRecords[moved.index].row = row;
+	}
+
+	if (--last->count == 0)
+	{
+		FreeChunkMemory(last->data);
+		archetype->chunks.pop_back();
+	}
+}
+
+Entity EntityWorld::Create(ComponentMask mask)
+{
+	Entity entity;
+	if (!mFreeIndices.empty())
+	{
+		entity.index = mFreeIndices.back();
+		mFreeIndices.pop_back();
+	}
+	else
+	{
+		entity.index = (unsigned int)mRecords.size();
+		mRecords.push_back(Record());
+		mRecords.back().generation = 0;
+	}
+	entity.generation = mRecords[entity.index].generation;
+
+	AllocateRow(GetArchetype(mask), entity);
+	mEntityCount++;
+	return entity;
+}
+
+void EntityWorld::Destroy(Entity entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	Record& record = mRecords[entity.index];
+	FreeRow(record.archetype, record.chunk, record.row);
+	record.archetype = nullptr;
+	record.generation++;
+	mFreeIndices.push_back(entity.index);
+	mEntityCount--;
+}
+
+bool EntityWorld::IsAlive(Entity entity) const
+{
+	return entity.index < mRecords.size() && mRecords[entity.index].generation == entity.generation
+		&& mRecords[entity.index].archetype != nullptr;
+}
+
+void EntityWorld::ChangeArchetype(Entity entity, ComponentMask mask)
+{
+	Record old = mRecords[entity.index];
+	if (old.archetype->mask == mask)
+		return;
+
+	Archetype* target = GetArchetype(mask);
+	AllocateRow(target, entity);
+	const Record& now = mRecords[entity.index];
+
+	// copy the components both archetypes have, the new ones stay zeroed
+	Chunk* from = old.archetype->chunks[old.chunk].get();
+	Chunk* to = target->chunks[now.chunk].get();
+	for (int type = 0; type < MAX_COMPONENT_TYPES; type++)
+	{
+		if (old.archetype->offsets[type] >= 0 && target->offsets[type] >= 0)
+		{
+			size_t size = target->sizes[type];
+			memcpy(to->data + target->offsets[type] + size * now.row, from->data + old.archetype->offsets[type] + size * old.row, size);
+		}
+	}
+
+	FreeRow(old.archetype, old.chunk, old.row);
+}
+
+void EntityWorld::UpdateQuery(EntityQuery& query)
+{
+	for (; query.mCheckedArchetypes < mArchetypes.size(); query.mCheckedArchetypes++)
+	{
+		Archetype* archetype = mArchetypes[query.mCheckedArchetypes].get();
+		if ((archetype->mask & query.mInclude) == query.mInclude && !(archetype->mask & query.mExclude))
+			query.mArchetypes.push_back(archetype);
+	}
+}
+
+void EntityWorld::ForEachChunk(EntityQuery& query, const std::function<void(const ChunkView&)>& fn)
+{
+	UpdateQuery(query);
+	for (Archetype* archetype : query.mArchetypes)
+	{
+		for (std::unique_ptr<Chunk>& chunk : archetype->chunks)
+			fn({ archetype, chunk.get() });
+	}
+}
+
+void EntityWorld::ForEachChunkParallel(EntityQuery& query, JobPool& pool, const std::function<void(const ChunkView&)>& fn)
+{
+	UpdateQuery(query);
+	std::vector<ChunkView> chunks;
+	for (Archetype* archetype : query.mArchetypes)
+	{
+		for (std::unique_ptr<Chunk>& chunk : archetype->chunks)
+			chunks.push_back({ archetype, chunk.get() });
+	}
+
+	// a few chunks per job, one chunk is often only a couple of microseconds of work
+	pool.ParallelFor((int)chunks.size(), 4, [&chunks, &fn](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			fn(chunks[i]);
+	});
+}
+
+int EntityWorld::CountEntities(EntityQuery& query)
+{
+	int count = 0;
+	ForEachChunk(query, [&count](const ChunkView& view) { count += view.Count(); });
+	return count;
+}
+
+int EntityWorld::GetChunkCount() const
+{
+	int count = 0;
+	for (const std::unique_ptr<Archetype>& archetype : mArchetypes)
+		count += (int)archetype->chunks.size();
+	return count;
+}
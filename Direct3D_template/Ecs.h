@@ -0,0 +1,188 @@
+//--------------------------------------------------------------------------------------
+// Ecs - entities and components stored by archetype.
+//
+// Every distinct set of component types is an archetype. An archetype stores its
+// entities in 16 KB chunks, each chunk holding one array per component type
+// (structure of arrays), so a system touching two components of thousands of
+// entities streams through two dense arrays per chunk.
+//
+// Queries name the components they need (and optionally ones they must not have)
+// and cache the matching archetypes; archetypes are never removed, so a query only
+// has to look at the ones created since it last ran.
+//
+// Components must be trivially copyable, they are moved with memcpy and new ones
+// start out zeroed. One entity's components together must fit in a chunk. Entities
+// must not be created, destroyed or change components while a query is iterating.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+class JobPool;
+
+typedef unsigned long long ComponentMask;
+static const int MAX_COMPONENT_TYPES = 64;
+static const int CHUNK_SIZE = 16 * 1024;
+
+struct Entity
+{
+	unsigned int index;
+	unsigned int generation;	// bumped when the index is reused
+};
+
+inline bool operator==(Entity a, Entity b) { return a.index == b.index && a.generation == b.generation; }
+inline bool operator!=(Entity a, Entity b) { return !(a == b); }
+
+static const Entity INVALID_ENTITY = { 0xffffffff, 0 };
+
+// Component type ids are handed out on first use, in no particular order.
+// At most MAX_COMPONENT_TYPES types.
+int RegisterComponentType(size_t size, size_t alignment);
+
+template <typename T>
+int ComponentType()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+	static_assert(sizeof(Entity) + sizeof(T) <= CHUNK_SIZE, "a chunk must hold at least one entity with this component");
+	static const int type = RegisterComponentType(sizeof(T), alignof(T));
+	return type;
+}
+
+template <typename... Ts>
+ComponentMask ComponentMaskOf()
+{
+	ComponentMask mask = 0;
+	int expand[] = { 0, (mask |= 1ull << ComponentType<Ts>(), 0)... };
+	(void)expand;
+	return mask;
+}
+
+struct Chunk
+{
+	unsigned char* data;		// CHUNK_SIZE bytes, 64 byte aligned
+	int count;
+};
+
+struct Archetype
+{
+	ComponentMask mask;
+	int capacity;								// entities per chunk
+	int offsets[MAX_COMPONENT_TYPES];			// of each component array in a chunk, -1 if absent
+	int sizes[MAX_COMPONENT_TYPES];
+	std::vector<std::unique_ptr<Chunk>> chunks;	// all full except the last one
+};
+
+// The part of a chunk a system sees
+struct ChunkView
+{
+	const Archetype* archetype;
+	Chunk* chunk;
+
+	int Count() const { return chunk->count; }
+	const Entity* GetEntities() const { return (const Entity*)chunk->data; }
+
+	// nullptr if the archetype doesn't have T (only possible for optional components)
+	template <typename T>
+	T* Get() const
+	{
+		int offset = archetype->offsets[ComponentType<T>()];
+		return offset < 0 ? nullptr : (T*)(chunk->data + offset);
+	}
+};
+
+class EntityQuery
+{
+public:
+	EntityQuery(ComponentMask include, ComponentMask exclude = 0) : mInclude(include), mExclude(exclude) {}
+
+private:
+	friend class EntityWorld;
+
+	ComponentMask mInclude;
+	ComponentMask mExclude;
+	std::vector<Archetype*> mArchetypes;	// matches found so far
+	size_t mCheckedArchetypes = 0;			// EntityWorld archetypes already looked at
+};
+
+class EntityWorld
+{
+public:
+	EntityWorld();
+	~EntityWorld();
+
+	EntityWorld(const EntityWorld&) = delete;
+	EntityWorld& operator=(const EntityWorld&) = delete;
+
+	Entity Create(ComponentMask mask);
+	void Destroy(Entity entity);
+	bool IsAlive(Entity entity) const;
+
+	template <typename... Ts>
+	Entity Create() { return Create(ComponentMaskOf<Ts...>()); }
+
+	// nullptr if the entity is dead or doesn't have T. Pointers are invalidated by
+	// any structural change (create/destroy/add/remove).
+	template <typename T>
+	T* Get(Entity entity)
+	{
+		if (!IsAlive(entity))
+			return nullptr;
+		const Record& record = mRecords[entity.index];
+		int offset = record.archetype->offsets[ComponentType<T>()];
+		return offset < 0 ? nullptr : (T*)(record.archetype->chunks[record.chunk]->data + offset) + record.row;
+	}
+
+	// Adding moves the entity to another archetype, the other components keep their values
+	template <typename T>
+	void Add(Entity entity, const T& value = T())
+	{
+		if (!IsAlive(entity))
+			return;
+		ChangeArchetype(entity, mRecords[entity.index].archetype->mask | (1ull << ComponentType<T>()));
+		*Get<T>(entity) = value;
+	}
+
+	template <typename T>
+	void Remove(Entity entity)
+	{
+		if (IsAlive(entity))
+			ChangeArchetype(entity, mRecords[entity.index].archetype->mask & ~(1ull << ComponentType<T>()));
+	}
+
+	// Calls fn for every chunk with entities matching the query
+	void ForEachChunk(EntityQuery& query, const std::function<void(const ChunkView&)>& fn);
+
+	// Same, with the chunks spread over the pool; fn runs concurrently for different chunks
+	void ForEachChunkParallel(EntityQuery& query, JobPool& pool, const std::function<void(const ChunkView&)>& fn);
+
+	int CountEntities(EntityQuery& query);
+	int GetEntityCount() const { return mEntityCount; }
+	int GetArchetypeCount() const { return (int)mArchetypes.size(); }
+	int GetChunkCount() const;
+
+private:
+	struct Record
+	{
+		Archetype* archetype;
+		int chunk;
+		int row;
+		unsigned int generation;
+	};
+
+	Archetype* GetArchetype(ComponentMask mask);
+	void UpdateQuery(EntityQuery& query);
+	void AllocateRow(Archetype* archetype, Entity entity);
+	void FreeRow(Archetype* archetype, int chunk, int row);
+	void ChangeArchetype(Entity entity, ComponentMask mask);
+
+	std::vector<std::unique_ptr<Archetype>> mArchetypes;
+	std::unordered_map<ComponentMask, Archetype*> mArchetypeByMask;
+
+	std::vector<Record> mRecords;			// indexed by Entity::index
+	std::vector<unsigned int> mFreeIndices;
+	int mEntityCount = 0;
+};
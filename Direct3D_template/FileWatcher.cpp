@@ -0,0 +1,197 @@
+#include "FileWatcher.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher()
+{
+#ifdef _WIN32
+	mDirectory = INVALID_HANDLE_VALUE;
+	mStopEvent = nullptr;
+#else
+	mInotify = -1;
+	mStopPipe[0] = mStopPipe[1] = -1;
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+void FileWatcher::AddChange(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mChanges[name] = std::chrono::steady_clock::now();
+}
+
+std::vector<std::string> FileWatcher::TakeChanges(int quietMs)
+{
+	std::vector<std::string> changes;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto it = mChanges.begin(); it != mChanges.end();)
+	{
+		if (now - it->second >= std::chrono::milliseconds(quietMs))
+		{
+			changes.push_back(it->first);
+			it = mChanges.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	return changes;
+}
+
+#ifdef _WIN32
+
+bool FileWatcher::Start(const std::string& directory)
+{
+	Stop();
+
+	mDirectory = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (mDirectory == INVALID_HANDLE_VALUE)
+		return false;
+
+	mStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	mThread = std::thread(&FileWatcher::ThreadMain, this);
+	return true;
+}
+
+void FileWatcher::Stop()
+{
+	if (mThread.joinable())
+	{
+		SetEvent((HANDLE)mStopEvent);
+		mThread.join();
+	}
+	if (mDirectory != INVALID_HANDLE_VALUE)
+		CloseHandle((HANDLE)mDirectory);
+	if (mStopEvent)
+		CloseHandle((HANDLE)mStopEvent);
+	mDirectory = INVALID_HANDLE_VALUE;
+	mStopEvent = nullptr;
+}
+
+void FileWatcher::ThreadMain()
+{
+	// FILE_NOTIFY_INFORMATION needs DWORD alignment
+	DWORD buffer[4096];
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	HANDLE events[2] = { overlapped.hEvent, (HANDLE)mStopEvent };
+
+	while (true)
+	{
+		ResetEvent(overlapped.hEvent);
+		if (!ReadDirectoryChangesW((HANDLE)mDirectory, buffer, sizeof(buffer), FALSE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &overlapped, nullptr))
+			break;
+
+		if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0)
+		{
+			CancelIo((HANDLE)mDirectory);
+			WaitForSingleObject(overlapped.hEvent, INFINITE);
+			break;
+		}
+
+		DWORD bytes = 0;
+		if (!GetOverlappedResult((HANDLE)mDirectory, &overlapped, &bytes, FALSE) || bytes == 0)
+			continue; // buffer overflow, changes were lost
+
+		const char* entry = (const char*)buffer;
+		while (true)
+		{
+			const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)entry;
+			if (info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+			{
+				int length = (int)(info->FileNameLength / sizeof(WCHAR));
+				char name[MAX_PATH * 3];
+				int size = WideCharToMultiByte(CP_UTF8, 0, info->FileName, length, name, sizeof(name), nullptr, nullptr);
+				if (size > 0)
+					AddChange(std::string(name, size));
+			}
+			if (info->NextEntryOffset == 0)
+				break;
+			entry += info->NextEntryOffset;
+		}
+	}
+
+	CloseHandle(overlapped.hEvent);
+}
+
+#else
+
+bool FileWatcher::Start(const std::string& directory)
+{
+	Stop();
+
+	mInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (mInotify < 0)
+		return false;
+	// IN_CLOSE_WRITE for in-place saves, IN_MOVED_TO for editors that write a temp file and rename
+	if (inotify_add_watch(mInotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 || pipe(mStopPipe) != 0)
+	{
+		close(mInotify);
+		mInotify = -1;
+		return false;
+	}
+
+	mThread = std::thread(&FileWatcher::ThreadMain, this);
+	return true;
+}
+
+void FileWatcher::Stop()
+{
+	if (mThread.joinable())
+	{
+		char stop = 1;
+		ssize_t written = write(mStopPipe[1], &stop, 1);
+		(void)written;
+		mThread.join();
+	}
+	for (int* fd : { &mInotify, &mStopPipe[0], &mStopPipe[1] })
+	{
+		if (*fd >= 0)
+			close(*fd);
+		*fd = -1;
+	}
+}
+
+void FileWatcher::ThreadMain()
+{
+	alignas(inotify_event) char buffer[16384];
+	pollfd fds[2] = { { mInotify, POLLIN, 0 }, { mStopPipe[0], POLLIN, 0 } };
+
+	while (true)
+	{
+		if (poll(fds, 2, -1) < 0)
+			continue;
+		if (fds[1].revents)
+			break;
+
+		ssize_t bytes;
+		while ((bytes = read(mInotify, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* entry = buffer; entry < buffer + bytes;)
+			{
+				const inotify_event* event = (const inotify_event*)entry;
+				if (event->len > 0 && !(event->mask & IN_ISDIR))
+					AddChange(event->name);
+				entry += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// FileWatcher - reports files that were written in a directory.
+//
+// A background thread waits on ReadDirectoryChangesW (Windows) or inotify (Linux)
+// and collects the names of changed files. Editors often write a file in several
+// steps, so a change is only handed out once the file has been quiet for a while.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Watches the files directly in 'directory' (not subdirectories).
+	// Returns false if the directory could not be watched.
+	bool Start(const std::string& directory);
+	void Stop();
+
+	// Names (relative to the directory) of files that changed and then saw no
+	// further change for 'quietMs'. Each change is only returned once.
+	std::vector<std::string> TakeChanges(int quietMs = 100);
+
+private:
+	void ThreadMain();
+	void AddChange(const std::string& name);
+
+	std::thread mThread;
+	std::mutex mMutex;
+	std::map<std::string, std::chrono::steady_clock::time_point> mChanges;	// name -> last event
+
+#ifdef _WIN32
+	void* mDirectory;	// HANDLE
+	void* mStopEvent;	// HANDLE
+#else
+	int mInotify;
+	int mStopPipe[2];
+#endif
+};
@@ -1,6 +1,30 @@
 Texture2D txDiffuse : register(t0);
 SamplerState sampAni;
 
+// Permutation defines, set from C++ by ShaderPermutations (see ShaderPermutations.h).
+// The defaults give the original shader when compiled without any defines.
+#ifndef TEXTURED
+#define TEXTURED 1
+#endif
+#ifndef LIGHTING_MODEL
+#define LIGHTING_MODEL 1	// 0 = unlit, 1 = Lambert, 2 = half-Lambert
+#endif
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+#ifndef CLUSTERED
+#define CLUSTERED 0		// lights from the cluster lists (ClusteredLighting.h), LIGHT_COUNT is ignored
+#endif
+#ifndef SHADOWS
+#define SHADOWS 0		// light 0 is a sun shining from lightPos[0] towards the origin, shadowed (ShadowMaps.h)
+#endif
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 4
+#endif
+#ifndef MAX_CASCADES
+#define MAX_CASCADES 4	// at most 4, cascadeSplits is a float4
+#endif
+
 struct GS_OUT
 {
 	float4 Pos : SV_POSITION;
@@ -9,18 +33,139 @@ struct GS_OUT
 	float2 Tex : TEXCOORD;
 };
 
+// Same layout for every permutation, only the first LIGHT_COUNT lights are used
 cbuffer FS_CONSTANT_BUFFER : register(b0)
 {
-	float3 lightPos;
-	float3 lightCol;
+	float4 lightPos[MAX_LIGHTS];
+	float4 lightCol[MAX_LIGHTS];
+};
+
+#if CLUSTERED
+// Mirrors PointLight, positions in world space
+struct PointLight
+{
+	float3 position;
+	float radius;
+	float3 color;
+	float padding;
+};
+
+StructuredBuffer<PointLight> clusterLights : register(t1);
+StructuredBuffer<uint2> clusterGrid : register(t2);				// offset, count per cluster
+StructuredBuffer<uint> clusterLightIndices : register(t3);
+
+// Mirrors ClusterConstants
+cbuffer CLUSTER_CONSTANT_BUFFER : register(b1)
+{
+	uint4 clusterDims;		// tiles x, tiles y, slices, tile size in pixels
+	float4 clusterSlicing;	// slice = floor(log(view z) * x + y), z = screen pixels per target pixel
+};
+#endif
+
+#if SHADOWS
+Texture2DArray shadowMap : register(t4);			// one slice per cascade
+SamplerComparisonState shadowSampler : register(s1);	// LESS_EQUAL, border depth 1
+
+// Mirrors ShadowCascade
+struct ShadowCascade
+{
+	row_major float4x4 viewProj;	// world -> cascade clip space
+	float depthBias;				// in the cascade's depth units
+	float normalOffset;				// world units
+	float2 padding;
 };
 
+// Mirrors ShadowConstants
+cbuffer SHADOW_CONSTANT_BUFFER : register(b2)
+{
+	ShadowCascade cascades[MAX_CASCADES];
+	float4 cascadeSplits;		// view space depth each cascade ends at
+	uint cascadeCount;
+	float shadowTexelSize;		// 1 / map size
+};
+
+// Light 0's visibility, 0 = in shadow: 3x3 bilinear comparison taps in the first
+// cascade reaching past the fragment
+float ShadowFactor(float3 worldPos, float3 normal, float viewDepth)
+{
+	float4 beyond = viewDepth > cascadeSplits;
+	uint cascade = min((uint)dot(beyond, 1.0), cascadeCount - 1);
+
+	ShadowCascade shadowCascade = cascades[cascade];
+	float4 shadowPos = mul(float4(worldPos + normal * shadowCascade.normalOffset, 1.0), shadowCascade.viewProj);
+	float2 uv = float2(shadowPos.x * 0.5 + 0.5, 0.5 - shadowPos.y * 0.5);
+	float depth = shadowPos.z - shadowCascade.depthBias;
+
+	float lit = 0.0;
+	[unroll]
+	for (int y = -1; y <= 1; y++)
+	{
+		[unroll]
+		for (int x = -1; x <= 1; x++)
+			lit += shadowMap.SampleCmpLevelZero(shadowSampler, float3(uv + float2(x, y) * shadowTexelSize, cascade), depth);
+	}
+	return lit / 9.0;
+}
+#endif
+
+float DiffuseFactor(float NdotL)
+{
+#if LIGHTING_MODEL == 1
+	return max(NdotL, 0);
+#else
+	float diffuseFactor = NdotL * 0.5 + 0.5;
+	return diffuseFactor * diffuseFactor;
+#endif
+}
+
 float4 PS_main(GS_OUT input) : SV_Target
 {
+#if TEXTURED
 	float3 textureCol = txDiffuse.Sample(sampAni, input.Tex).xyz;
+#else
+	float3 textureCol = { 1.0, 1.0, 1.0 };
+#endif
+
+#if LIGHTING_MODEL == 0
+	return float4(textureCol, 1.0f);
+#else
 	float3 ambientCol = { 0.2, 0.2, 0.2 };
 	float3 fragmentCol = textureCol * ambientCol;
-	float diffuseFactor = max(dot(normalize(lightPos - input.WorldPos.xyz), normalize(input.WorldNor.xyz)), 0);
-	fragmentCol += textureCol * diffuseFactor * lightCol;
+	float3 normal = normalize(input.WorldNor.xyz);
+
+#if CLUSTERED
+	// SV_Position.w is the view space depth
+	uint3 cell;
+	cell.xy = min((uint2)(input.Pos.xy * clusterSlicing.z) / clusterDims.w, clusterDims.xy - 1);
+	cell.z = (uint)clamp(floor(log(input.Pos.w) * clusterSlicing.x + clusterSlicing.y), 0, clusterDims.z - 1);
+	uint2 range = clusterGrid[(cell.z * clusterDims.y + cell.y) * clusterDims.x + cell.x];
+
+	for (uint i = 0; i < range.y; i++)
+	{
+		PointLight light = clusterLights[clusterLightIndices[range.x + i]];
+		float3 toLight = light.position - input.WorldPos.xyz;
+		float falloff = saturate(1.0 - dot(toLight, toLight) / (light.radius * light.radius));
+		float NdotL = dot(normalize(toLight), normal);
+		fragmentCol += textureCol * DiffuseFactor(NdotL) * falloff * falloff * light.color;
+	}
+#else
+	[unroll]
+	for (int i = 0; i < LIGHT_COUNT; i++)
+	{
+		float3 toLight = lightPos[i].xyz - input.WorldPos.xyz;
+		float visibility = 1.0;
+#if SHADOWS
+		if (i == 0)
+		{
+			// the sun: from lightPos[0] towards the origin, through the shadow maps
+			toLight = lightPos[0].xyz;
+			visibility = ShadowFactor(input.WorldPos.xyz, normal, input.Pos.w);
+		}
+#endif
+		float NdotL = dot(normalize(toLight), normal);
+		fragmentCol += textureCol * DiffuseFactor(NdotL) * lightCol[i].xyz * visibility;
+	}
+#endif
 	return float4(fragmentCol, 1.0f);
+#endif
 };
\ No newline at end of file
@@ -1,7 +1,14 @@
+// Permutation define, set from C++ by ShaderPermutations (see ShaderPermutations.h).
+// 1 = also emit a copy of the triangle pushed out along its normal.
+#ifndef EXTRUDE
+#define EXTRUDE 1
+#endif
+
 struct GS_IN
 {
 	float4 Pos : SV_POSITION;
 	float2 Tex : TEXCOORD;
+	nointerpolation uint Instance : INSTANCE;
 };
 
 struct GS_OUT
@@ -14,13 +21,27 @@ struct GS_OUT
 
 cbuffer GS_CONSTANT_BUFFER : register(b0)
 {
-	matrix world, worldViewProj;
+	matrix viewProj;
+	uint instanceOffset;	// first instance of the current batch in 'instances'
 };
 
+// World matrices of every instance drawn this frame, see RenderQueue
+struct Instance
+{
+	row_major float4x4 world;
+};
+StructuredBuffer<Instance> instances : register(t0);
+
+#if EXTRUDE
 [maxvertexcount(6)]
+#else
+[maxvertexcount(3)]
+#endif
 void GS_main( triangle GS_IN input[3], inout TriangleStream< GS_OUT > output)
 {
 	GS_OUT element;
+	float4x4 world = instances[instanceOffset + input[0].Instance].world;
+	float4x4 worldViewProj = mul(world, viewProj);
 	float4 normal = float4(normalize(cross(input[1].Pos - input[0].Pos, input[2].Pos - input[0].Pos)), 0);
 	for (uint i = 0; i < 3; i++)
 	{
@@ -31,7 +52,8 @@ void GS_main( triangle GS_IN input[3], inout TriangleStream< GS_OUT > output)
 		output.Append(element);
 	}
 	output.RestartStrip();
-	
+
+#if EXTRUDE
 	for (uint i = 0; i < 3; i++)
 	{
 		element.Pos = mul(input[i].Pos + normal*0.5, worldViewProj);
@@ -41,4 +63,5 @@ void GS_main( triangle GS_IN input[3], inout TriangleStream< GS_OUT > output)
 		output.Append(element);
 	}
 	output.RestartStrip();
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "HotReload.h"
+
+bool HotReloader::Start(const std::string& directory)
+{
+	return mWatcher.Start(directory);
+}
+
+void HotReloader::Stop()
+{
+	mWatcher.Stop();
+	mWatcher.TakeChanges(0);
+}
+
+void HotReloader::Watch(const std::string& pattern, std::function<void(const std::string&)> reload)
+{
+	WatchEntry entry = { pattern, reload };
+	mWatches.push_back(entry);
+}
+
+void HotReloader::QueueSwap(std::function<void()> swap)
+{
+	std::lock_guard<std::mutex> lock(mSwapMutex);
+	mSwaps.push_back(std::move(swap));
+}
+
+bool HotReloader::Matches(const std::string& pattern, const std::string& name)
+{
+	if (!pattern.empty() && pattern[0] == '*')
+	{
+		size_t suffix = pattern.size() - 1;
+		return name.size() >= suffix && name.compare(name.size() - suffix, suffix, pattern, 1, suffix) == 0;
+	}
+	return pattern == name;
+}
+
+int HotReloader::Update()
+{
+	for (const std::string& name : mWatcher.TakeChanges())
+	{
+		for (const WatchEntry& entry : mWatches)
+		{
+			if (Matches(entry.pattern, name))
+				entry.reload(name);
+		}
+	}
+
+	std::vector<std::function<void()>> swaps;
+	{
+		std::lock_guard<std::mutex> lock(mSwapMutex);
+		swaps.swap(mSwaps);
+	}
+	for (const std::function<void()>& swap : swaps)
+		swap();
+	return (int)swaps.size();
+}
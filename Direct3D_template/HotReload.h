@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// HotReloader - runs reload callbacks when watched files change on disk.
+//
+// Update() is called once per frame on the render thread. It runs the callback of
+// every watched file that changed; callbacks should only start background work
+// (e.g. ShaderPermutations::Reload() or a job on the pool). Background work that
+// needs to replace something the renderer uses hands a closure to QueueSwap(),
+// and Update() runs those closures before the frame starts, so the swap is a
+// pointer exchange at the frame boundary and the render thread never waits.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FileWatcher.h"
+
+class HotReloader
+{
+public:
+	// Starts watching 'directory'. Returns false if the OS refused.
+	bool Start(const std::string& directory);
+	// Changes not handed out yet are dropped, Update() only applies swaps after this.
+	void Stop();
+
+	// 'pattern' is a file name relative to the directory, or "*.ext" for every file
+	// with that extension. The callback gets the name of the changed file.
+	void Watch(const std::string& pattern, std::function<void(const std::string&)> reload);
+
+	// Safe to call from any thread.
+	void QueueSwap(std::function<void()> swap);
+
+	// Render thread, between frames: starts reloads for changed files and applies
+	// finished swaps. Returns the number of swaps applied.
+	int Update();
+
+private:
+	struct WatchEntry
+	{
+		std::string pattern;
+		std::function<void(const std::string&)> reload;
+	};
+
+	static bool Matches(const std::string& pattern, const std::string& name);
+
+	FileWatcher mWatcher;
+	std::vector<WatchEntry> mWatches;
+
+	std::mutex mSwapMutex;
+	std::vector<std::function<void()>> mSwaps;
+};
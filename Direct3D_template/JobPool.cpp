@@ -0,0 +1,214 @@
+#include "JobPool.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+JobPool::JobPool(int threadCount)
+{
+	if (threadCount <= 0)
+	{
+		int hardwareThreads = (int)std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	mEpoch = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < threadCount; i++)
+		mWorkers.push_back(std::thread(&JobPool::WorkerMain, this, i + 1));
+}
+
+JobPool::~JobPool()
+{
+	WaitAll();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeWorkers.notify_all();
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+double JobPool::NowMs() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - mEpoch).count();
+}
+
+bool JobPool::IsDone(JobId id) const
+{
+	return id < mNextId && mJobs.find(id) == mJobs.end();
+}
+
+JobId JobPool::Submit(const std::string& name, std::function<void()> work, const std::vector<JobId>& dependencies)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	JobId id = mNextId++;
+	Job& job = mJobs[id];
+	job.name = name;
+	job.work = std::move(work);
+
+	for (JobId dependency : dependencies)
+	{
+		auto it = mJobs.find(dependency);
+		if (it == mJobs.end())
+			continue;
+		it->second.dependents.push_back(id);
+		job.pendingDependencies++;
+	}
+
+	if (job.pendingDependencies == 0)
+	{
+		mReady.push_back(id);
+		lock.unlock();
+		mWakeWorkers.notify_one();
+	}
+	return id;
+}
+
+// Called with the lock held, returns with it held again.
+void JobPool::Run(JobId id, int thread, std::unique_lock<std::mutex>& lock)
+{
+	Job& job = mJobs[id];
+	std::function<void()> work = std::move(job.work);
+	std::string name = job.name;
+
+	lock.unlock();
+	double start = NowMs();
+	work();
+	double end = NowMs();
+	lock.lock();
+
+	if (mTimelineEnabled)
+	{
+		JobTiming timing = { name, thread, start, end };
+		mTimeline.push_back(timing);
+	}
+
+	// the map may have rehashed while unlocked
+	auto it = mJobs.find(id);
+	std::vector<JobId> dependents = std::move(it->second.dependents);
+	mJobs.erase(it);
+
+	int released = 0;
+	for (JobId dependent : dependents)
+	{
+		if (--mJobs[dependent].pendingDependencies == 0)
+		{
+			mReady.push_back(dependent);
+			released++;
+		}
+	}
+	if (released > 0)
+		mWakeWorkers.notify_all();
+	mJobFinished.notify_all();
+}
+
+void JobPool::WorkerMain(int thread)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true)
+	{
+		mWakeWorkers.wait(lock, [this] { return mQuit || !mReady.empty(); });
+		if (mReady.empty())
+			return;
+
+		JobId id = mReady.front();
+		mReady.pop_front();
+		Run(id, thread, lock);
+	}
+}
+
+void JobPool::Wait(JobId id)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (!IsDone(id))
+	{
+		// help out instead of blocking, the job we wait for may be queued behind others
+		if (!mReady.empty())
+		{
+			JobId ready = mReady.front();
+			mReady.pop_front();
+			Run(ready, 0, lock);
+		}
+		else
+		{
+			mJobFinished.wait(lock);
+		}
+	}
+}
+
+void JobPool::WaitAll()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (!mJobs.empty())
+	{
+		if (!mReady.empty())
+		{
+			JobId ready = mReady.front();
+			mReady.pop_front();
+			Run(ready, 0, lock);
+		}
+		else
+		{
+			mJobFinished.wait(lock);
+		}
+	}
+}
+
+void JobPool::ParallelFor(int count, int batchSize, const std::function<void(int, int)>& fn)
+{
+	if (batchSize < 1)
+		batchSize = 1;
+
+	std::vector<JobId> batches;
+	for (int begin = 0; begin < count; begin += batchSize)
+	{
+		int end = std::min(begin + batchSize, count);
+		batches.push_back(Submit("ParallelFor", [&fn, begin, end] { fn(begin, end); }));
+	}
+	for (JobId batch : batches)
+		Wait(batch);
+}
+
+void JobPool::SetTimelineEnabled(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mTimelineEnabled = enabled;
+}
+
+std::vector<JobTiming> JobPool::GetTimeline() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mTimeline;
+}
+
+void JobPool::ClearTimeline()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mTimeline.clear();
+	mEpoch = std::chrono::high_resolution_clock::now();
+}
+
+// One line per job, ordered by start time:
+//   [thread 2]    0.12 ..   35.40 ms  ( 35.28 ms)  Vertex.hlsl
+std::string JobPool::TimelineReport() const
+{
+	std::vector<JobTiming> timeline = GetTimeline();
+	std::sort(timeline.begin(), timeline.end(), [](const JobTiming& a, const JobTiming& b) { return a.startMs < b.startMs; });
+
+	std::string report;
+	double first = timeline.empty() ? 0.0 : timeline.front().startMs;
+	double last = 0.0, busy = 0.0;
+	char line[256];
+	for (const JobTiming& timing : timeline)
+	{
+		snprintf(line, sizeof(line), "  [thread %d] %8.2f .. %8.2f ms  (%7.2f ms)  %s\n",
+			timing.thread, timing.startMs, timing.endMs, timing.endMs - timing.startMs, timing.name.c_str());
+		report += line;
+		last = std::max(last, timing.endMs);
+		busy += timing.endMs - timing.startMs;
+	}
+	snprintf(line, sizeof(line), "  %d jobs, %.2f ms wall, %.2f ms busy on %d workers + caller\n",
+		(int)timeline.size(), last - first, busy, GetThreadCount());
+	report += line;
+	return report;
+}
@@ -0,0 +1,87 @@
+//--------------------------------------------------------------------------------------
+// JobPool - a fixed set of worker threads running small jobs.
+//
+// A job may depend on other jobs, it is only started once all of them finished.
+// Waiting threads run queued jobs themselves instead of sleeping, so Wait() can be
+// called from inside a job. Every job's start/end time is recorded so a timeline
+// of e.g. startup work can be printed.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <chrono>
+
+typedef int JobId;
+
+struct JobTiming
+{
+	std::string name;
+	int thread;			// 0 = a thread that called Wait(), 1..n = workers
+	double startMs;		// relative to the pool's creation or ClearTimeline()
+	double endMs;
+};
+
+class JobPool
+{
+public:
+	// threadCount 0 uses one worker per hardware thread (minus the calling thread).
+	explicit JobPool(int threadCount = 0);
+	~JobPool();
+
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+
+	// 'name' only shows up in the timeline. Dependencies that already finished are ignored.
+	JobId Submit(const std::string& name, std::function<void()> work, const std::vector<JobId>& dependencies = {});
+
+	void Wait(JobId id);
+	void WaitAll();
+
+	// Splits [0, count) into batches of 'batchSize' and runs fn(begin, end) for each,
+	// returns when all are done.
+	void ParallelFor(int count, int batchSize, const std::function<void(int, int)>& fn);
+
+	int GetThreadCount() const { return (int)mWorkers.size(); }
+
+	// Recording is on by default, turn it off for pools that run jobs every frame.
+	void SetTimelineEnabled(bool enabled);
+	std::vector<JobTiming> GetTimeline() const;
+	std::string TimelineReport() const;
+	void ClearTimeline();
+
+private:
+	struct Job
+	{
+		std::string name;
+		std::function<void()> work;
+		int pendingDependencies = 0;
+		std::vector<JobId> dependents;
+	};
+
+	void WorkerMain(int thread);
+	bool IsDone(JobId id) const;	// mMutex held
+	void Run(JobId id, int thread, std::unique_lock<std::mutex>& lock);
+	double NowMs() const;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mWakeWorkers;
+	std::condition_variable mJobFinished;
+
+	std::unordered_map<JobId, Job> mJobs;	// submitted and not finished yet
+	std::deque<JobId> mReady;				// all dependencies finished
+	JobId mNextId = 1;
+	bool mQuit = false;
+
+	std::vector<std::thread> mWorkers;
+
+	std::chrono::high_resolution_clock::time_point mEpoch;
+	std::vector<JobTiming> mTimeline;
+	bool mTimelineEnabled = true;
+};
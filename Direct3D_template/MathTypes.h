@@ -0,0 +1,79 @@
+//--------------------------------------------------------------------------------------
+// MathTypes - small vector/matrix types for code that runs without DirectXMath
+// (CpuShading, SceneGraph). Matrices are row-major with row vectors, the same memory
+// layout as XMMATRIX/XMFLOAT4X4, so they can be loaded with XMLoadFloat4x4.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <math.h>
+
+struct Float3
+{
+	float x, y, z;
+};
+
+inline Float3 operator+(Float3 a, Float3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Float3 operator-(Float3 a, Float3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Float3 operator*(Float3 a, Float3 b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+inline Float3 operator*(Float3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+inline float Dot(Float3 a, Float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Float3 Cross(Float3 a, Float3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+inline Float3 Normalize(Float3 v)
+{
+	float length = sqrtf(Dot(v, v));
+	return length > 0.0f ? v * (1.0f / length) : v;
+}
+
+struct Float4
+{
+	float x, y, z, w;
+};
+
+// Row-major, vectors are rows: same convention as mul(v, M) in the shaders
+struct Float4x4
+{
+	float m[4][4];
+};
+
+inline Float4 Mul(Float4 v, const Float4x4& M)
+{
+	return {
+		v.x * M.m[0][0] + v.y * M.m[1][0] + v.z * M.m[2][0] + v.w * M.m[3][0],
+		v.x * M.m[0][1] + v.y * M.m[1][1] + v.z * M.m[2][1] + v.w * M.m[3][1],
+		v.x * M.m[0][2] + v.y * M.m[1][2] + v.z * M.m[2][2] + v.w * M.m[3][2],
+		v.x * M.m[0][3] + v.y * M.m[1][3] + v.z * M.m[2][3] + v.w * M.m[3][3],
+	};
+}
+
+// a * b: applies a first, then b (like XMMatrixMultiply)
+inline Float4x4 Multiply(const Float4x4& a, const Float4x4& b)
+{
+	Float4x4 result;
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column]
+				+ a.m[row][2] * b.m[2][column] + a.m[row][3] * b.m[3][column];
+		}
+	}
+	return result;
+}
+
+inline Float4x4 MatrixIdentity()
+{
+	return { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+}
+
+inline Float4x4 MatrixTranslation(float x, float y, float z)
+{
+	return { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { x, y, z, 1.0f } } };
+}
+
+// Same as XMMatrixRotationY
+inline Float4x4 MatrixRotationY(float angle)
+{
+	float s = sinf(angle);
+	float c = cosf(angle);
+	return { { { c, 0.0f, -s, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { s, 0.0f, c, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+}
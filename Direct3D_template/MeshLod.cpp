@@ -0,0 +1,565 @@
+#include "MeshLod.h"
+#include "JobPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+namespace
+{
+	// Sum of planes ax + by + cz + d = 0, each weighted by the area it came from
+	struct Quadric
+	{
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+		double weight;
+	};
+
+	Quadric PlaneQuadric(Float3 normal, float d, double weight)
+	{
+		double a = normal.x, b = normal.y, c = normal.z;
+		return { a * a * weight, a * b * weight, a * c * weight, a * d * weight, b * b * weight, b * c * weight, b * d * weight,
+			c * c * weight, c * d * weight, (double)d * d * weight, weight };
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		double* target = &q.a2;
+		const double* source = &other.a2;
+		for (int i = 0; i < 11; i++)
+			target[i] += source[i];
+	}
+
+	// Mean squared distance to the planes
+	double EvaluateQuadric(const Quadric& q, Float3 p)
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double sum = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+			+ q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+			+ q.c2 * z * z + 2.0 * q.cd * z + q.d2;
+		return q.weight > 0.0 ? std::max(sum, 0.0) / q.weight : 0.0;
+	}
+
+	struct Collapse
+	{
+		float cost;
+		unsigned int from, to;
+		unsigned int fromVersion, toVersion;
+
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	// The triangles around every vertex, in one array. A list that outgrows its slot
+	// moves to the end of the array with room to spare.
+	class TriangleLists
+	{
+	public:
+		struct Range
+		{
+			const unsigned int* first;
+			const unsigned int* last;
+			const unsigned int* begin() const { return first; }
+			const unsigned int* end() const { return last; }
+		};
+
+		// 'counts' sizes the initial slots
+		void Reset(const std::vector<unsigned int>& counts)
+		{
+			mSlots.resize(counts.size());
+			unsigned int offset = 0;
+			for (size_t i = 0; i < counts.size(); i++)
+			{
+				mSlots[i] = { offset, 0, counts[i] };
+				offset += counts[i];
+			}
+			mPool.resize(offset);
+		}
+
+		Range Get(unsigned int vertex) const
+		{
+			const unsigned int* first = mPool.data() + mSlots[vertex].offset;
+			return { first, first + mSlots[vertex].count };
+		}
+
+		void Push(unsigned int vertex, unsigned int triangle)
+		{
+			mPool[mSlots[vertex].offset + mSlots[vertex].count++] = triangle;
+		}
+
+		void Assign(unsigned int vertex, const std::vector<unsigned int>& triangles)
+		{
+			Slot& slot = mSlots[vertex];
+			if (triangles.size() > slot.capacity)
+			{
+				slot.offset = (unsigned int)mPool.size();
+				slot.capacity = (unsigned int)triangles.size() * 2;
+				mPool.resize(mPool.size() + slot.capacity);
+			}
+			std::copy(triangles.begin(), triangles.end(), mPool.begin() + slot.offset);
+			slot.count = (unsigned int)triangles.size();
+		}
+
+		void Clear(unsigned int vertex) { mSlots[vertex].count = 0; }
+
+	private:
+		struct Slot
+		{
+			unsigned int offset, count, capacity;
+		};
+		std::vector<Slot> mSlots;
+		std::vector<unsigned int> mPool;
+	};
+
+	// Border planes weigh this much more than the triangles, per squared edge length
+	const double BORDER_WEIGHT = 10.0;
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const IndexedMesh& mesh) : mMesh(mesh) {}
+
+		float Run(int targetTriangles, IndexedMesh& output);
+
+	private:
+		Float3 Position(unsigned int vertex) const { return mMesh.vertices[vertex].position; }
+		void Setup();
+		void AddBorderPlane(unsigned int a, unsigned int b);
+		bool PushEdge(unsigned int a, unsigned int b);
+		bool CanCollapse(unsigned int from, unsigned int to);
+		void DoCollapse(unsigned int from, unsigned int to);
+		void Output(IndexedMesh& output) const;
+
+		const IndexedMesh& mMesh;
+		std::vector<unsigned int> mIndices;
+		std::vector<char> mRemoved;							// per triangle
+		TriangleLists mTriangles;							// per vertex, may hold removed ones
+		std::vector<Quadric> mQuadrics;
+		std::vector<unsigned int> mVersions;				// bumped when a vertex's quadric changes
+		std::vector<char> mAlive;
+		std::vector<char> mLocked;							// on a texture seam
+		std::vector<Collapse> mHeap;						// min-heap on cost
+		std::vector<unsigned int> mScratch[2];
+		int mTriangleCount = 0;
+	};
+
+	void Simplifier::Setup()
+	{
+		size_t vertexCount = mMesh.vertices.size();
+		mIndices = mMesh.indices;
+		mTriangleCount = (int)mIndices.size() / 3;
+		mRemoved.assign(mTriangleCount, 0);
+		mQuadrics.assign(vertexCount, Quadric());
+		mVersions.assign(vertexCount, 0);
+		mAlive.assign(vertexCount, 1);
+		mLocked.assign(vertexCount, 0);
+
+		// seams: vertices sharing a position with another vertex
+		struct Key
+		{
+			float x, y, z;
+			unsigned int vertex;
+		};
+		std::vector<Key> keys(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++)
+			keys[i] = { mMesh.vertices[i].position.x, mMesh.vertices[i].position.y, mMesh.vertices[i].position.z, i };
+		std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b)
+		{
+			return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+		});
+		for (size_t i = 1; i < vertexCount; i++)
+		{
+			if (keys[i].x == keys[i - 1].x && keys[i].y == keys[i - 1].y && keys[i].z == keys[i - 1].z)
+				mLocked[keys[i - 1].vertex] = mLocked[keys[i].vertex] = 1;
+		}
+
+		std::vector<unsigned int> counts(vertexCount, 0);
+		for (unsigned int index : mIndices)
+			counts[index]++;
+		mTriangles.Reset(counts);
+
+		// triangle planes
+		for (int triangle = 0; triangle < mTriangleCount; triangle++)
+		{
+			const unsigned int* corner = &mIndices[triangle * 3];
+			Float3 normal = Cross(Position(corner[1]) - Position(corner[0]), Position(corner[2]) - Position(corner[0]));
+			float area = 0.5f * sqrtf(Dot(normal, normal));
+			normal = Normalize(normal);
+			Quadric plane = PlaneQuadric(normal, -Dot(normal, Position(corner[0])), area);
+			for (int i = 0; i < 3; i++)
+			{
+				AddQuadric(mQuadrics[corner[i]], plane);
+				mTriangles.Push(corner[i], triangle);
+			}
+		}
+
+		// every edge once, from its lower vertex; an edge with only one triangle is an
+		// open border and gets a plane through it, perpendicular to the triangle.
+		// Costs need all the planes, so the edges are queued afterwards.
+		std::vector<std::pair<unsigned int, unsigned int>> edges;
+		edges.reserve(mIndices.size() / 2 + vertexCount);
+		std::vector<unsigned int>& neighbours = mScratch[0];
+		for (unsigned int a = 0; a < vertexCount; a++)
+		{
+			neighbours.clear();
+			for (unsigned int triangle : mTriangles.Get(a))
+			{
+				const unsigned int* corner = &mIndices[triangle * 3];
+				for (int i = 0; i < 3; i++)
+				{
+					if (corner[i] > a)
+						neighbours.push_back(corner[i]);
+				}
+			}
+			std::sort(neighbours.begin(), neighbours.end());
+			for (size_t i = 0; i < neighbours.size();)
+			{
+				unsigned int b = neighbours[i];
+				size_t end = i + 1;
+				while (end < neighbours.size() && neighbours[end] == b)
+					end++;
+				if (end - i == 1)
+					AddBorderPlane(a, b);
+				edges.push_back({ a, b });
+				i = end;
+			}
+		}
+		for (const std::pair<unsigned int, unsigned int>& edge : edges)
+			PushEdge(edge.first, edge.second);
+		std::make_heap(mHeap.begin(), mHeap.end(), std::greater<Collapse>());
+	}
+
+	void Simplifier::AddBorderPlane(unsigned int a, unsigned int b)
+	{
+		for (unsigned int triangle : mTriangles.Get(a))
+		{
+			const unsigned int* corner = &mIndices[triangle * 3];
+			if (corner[0] != b && corner[1] != b && corner[2] != b)
+				continue;
+			Float3 faceNormal = Normalize(Cross(Position(corner[1]) - Position(corner[0]), Position(corner[2]) - Position(corner[0])));
+			Float3 edge = Position(b) - Position(a);
+			Float3 normal = Normalize(Cross(edge, faceNormal));
+			Quadric plane = PlaneQuadric(normal, -Dot(normal, Position(a)), BORDER_WEIGHT * Dot(edge, edge));
+			AddQuadric(mQuadrics[a], plane);
+			AddQuadric(mQuadrics[b], plane);
+			return;
+		}
+	}
+
+	// Appends the cheaper direction of a -> b to mHeap, the caller restores the heap
+	// order. Seam vertices only take collapses, so an edge between two has none.
+	bool Simplifier::PushEdge(unsigned int a, unsigned int b)
+	{
+		if (mLocked[a] && mLocked[b])
+			return false;
+		Quadric sum = mQuadrics[a];
+		AddQuadric(sum, mQuadrics[b]);
+		double costToA = mLocked[b] ? 1e30 : EvaluateQuadric(sum, Position(a));
+		double costToB = mLocked[a] ? 1e30 : EvaluateQuadric(sum, Position(b));
+		if (costToA <= costToB)
+			mHeap.push_back({ (float)costToA, b, a, mVersions[b], mVersions[a] });
+		else
+			mHeap.push_back({ (float)costToB, a, b, mVersions[a], mVersions[b] });
+		return true;
+	}
+
+	bool Simplifier::CanCollapse(unsigned int from, unsigned int to)
+	{
+		// the edge must have at most two triangles and the endpoints no other common
+		// neighbours, or the result isn't a manifold
+		std::vector<unsigned int>& fromNeighbours = mScratch[0];
+		std::vector<unsigned int>& toNeighbours = mScratch[1];
+		fromNeighbours.clear();
+		toNeighbours.clear();
+		int sharedTriangles = 0;
+		for (unsigned int triangle : mTriangles.Get(from))
+		{
+			if (mRemoved[triangle])
+				continue;
+			const unsigned int* corner = &mIndices[triangle * 3];
+			bool shared = corner[0] == to || corner[1] == to || corner[2] == to;
+			sharedTriangles += shared;
+			for (int i = 0; i < 3; i++)
+				fromNeighbours.push_back(corner[i]);
+
+			// the triangle keeps its orientation once 'from' sits on 'to'
+			if (!shared)
+			{
+				Float3 p[3], q[3];
+				for (int i = 0; i < 3; i++)
+				{
+					p[i] = Position(corner[i]);
+					q[i] = corner[i] == from ? Position(to) : p[i];
+				}
+				Float3 before = Cross(p[1] - p[0], p[2] - p[0]);
+				Float3 after = Cross(q[1] - q[0], q[2] - q[0]);
+				if (Dot(before, after) <= 0.2f * sqrtf(Dot(before, before) * Dot(after, after)))
+					return false;
+			}
+		}
+		if (sharedTriangles == 0 || sharedTriangles > 2)
+			return false;
+
+		for (unsigned int triangle : mTriangles.Get(to))
+		{
+			if (mRemoved[triangle])
+				continue;
+			const unsigned int* corner = &mIndices[triangle * 3];
+			for (int i = 0; i < 3; i++)
+				toNeighbours.push_back(corner[i]);
+		}
+		std::sort(fromNeighbours.begin(), fromNeighbours.end());
+		fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+		std::sort(toNeighbours.begin(), toNeighbours.end());
+		toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+
+		int common = 0;
+		for (size_t i = 0, j = 0; i < fromNeighbours.size() && j < toNeighbours.size();)
+		{
+			if (fromNeighbours[i] < toNeighbours[j])
+				i++;
+			else if (fromNeighbours[i] > toNeighbours[j])
+				j++;
+			else
+			{
+				common += fromNeighbours[i] != from && fromNeighbours[i] != to;
+				i++;
+				j++;
+			}
+		}
+		return common == sharedTriangles;
+	}
+
+	void Simplifier::DoCollapse(unsigned int from, unsigned int to)
+	{
+		// the triangles of 'to' that survive, then the ones moving over from 'from'
+		std::vector<unsigned int>& toTriangles = mScratch[1];
+		toTriangles.clear();
+		for (unsigned int triangle : mTriangles.Get(to))
+		{
+			const unsigned int* corner = &mIndices[triangle * 3];
+			bool removed = mRemoved[triangle] || corner[0] == from || corner[1] == from || corner[2] == from;
+			if (!removed)
+				toTriangles.push_back(triangle);
+		}
+		for (unsigned int triangle : mTriangles.Get(from))
+		{
+			if (mRemoved[triangle])
+				continue;
+			unsigned int* corner = &mIndices[triangle * 3];
+			if (corner[0] == to || corner[1] == to || corner[2] == to)
+			{
+				mRemoved[triangle] = 1;
+				mTriangleCount--;
+				continue;
+			}
+			for (int i = 0; i < 3; i++)
+			{
+				if (corner[i] == from)
+					corner[i] = to;
+			}
+			toTriangles.push_back(triangle);
+		}
+		mTriangles.Clear(from);
+		mTriangles.Assign(to, toTriangles);
+
+		mAlive[from] = 0;
+		AddQuadric(mQuadrics[to], mQuadrics[from]);
+		mVersions[to]++;
+
+		// every edge of 'to' changed cost
+		std::vector<unsigned int>& neighbours = mScratch[0];
+		neighbours.clear();
+		for (unsigned int triangle : toTriangles)
+		{
+			const unsigned int* corner = &mIndices[triangle * 3];
+			for (int i = 0; i < 3; i++)
+			{
+				if (corner[i] != to)
+					neighbours.push_back(corner[i]);
+			}
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (unsigned int neighbour : neighbours)
+		{
+			if (PushEdge(to, neighbour))
+				std::push_heap(mHeap.begin(), mHeap.end(), std::greater<Collapse>());
+		}
+	}
+
+	void Simplifier::Output(IndexedMesh& output) const
+	{
+		std::vector<unsigned int> remap(mMesh.vertices.size(), ~0u);
+		output.vertices.clear();
+		output.indices.clear();
+		output.indices.reserve(mTriangleCount * 3);
+		for (size_t triangle = 0; triangle < mRemoved.size(); triangle++)
+		{
+			if (mRemoved[triangle])
+				continue;
+			for (int i = 0; i < 3; i++)
+			{
+				unsigned int vertex = mIndices[triangle * 3 + i];
+				if (remap[vertex] == ~0u)
+				{
+					remap[vertex] = (unsigned int)output.vertices.size();
+					output.vertices.push_back(mMesh.vertices[vertex]);
+				}
+				output.indices.push_back(remap[vertex]);
+			}
+		}
+	}
+
+	float Simplifier::Run(int targetTriangles, IndexedMesh& output)
+	{
+		Setup();
+
+		float maxCost = 0.0f;
+		while (mTriangleCount > targetTriangles && !mHeap.empty())
+		{
+			std::pop_heap(mHeap.begin(), mHeap.end(), std::greater<Collapse>());
+			Collapse collapse = mHeap.back();
+			mHeap.pop_back();
+			if (!mAlive[collapse.from] || !mAlive[collapse.to] || mVersions[collapse.from] != collapse.fromVersion || mVersions[collapse.to] != collapse.toVersion)
+				continue;
+			if (!CanCollapse(collapse.from, collapse.to))
+				continue;
+			DoCollapse(collapse.from, collapse.to);
+			maxCost = std::max(maxCost, collapse.cost);
+		}
+
+		Output(output);
+		return sqrtf(maxCost);
+	}
+}
+
+float SimplifyMesh(const IndexedMesh& input, int targetTriangles, IndexedMesh& output)
+{
+	Simplifier simplifier(input);
+	return simplifier.Run(targetTriangles, output);
+}
+
+void BuildLodChain(const IndexedMesh& mesh, LodChain& chain, int maxLevels, float ratio, int minTriangles)
+{
+	chain.levels.clear();
+	chain.levels.push_back({ mesh, 0.0f });
+	while ((int)chain.levels.size() < maxLevels)
+	{
+		const LodLevel& previous = chain.levels.back();
+		int target = (int)(previous.mesh.GetTriangleCount() * ratio);
+		if (target < minTriangles)
+			break;
+
+		// each level starts from the previous one, so the errors add up
+		LodLevel level;
+		level.error = previous.error + SimplifyMesh(previous.mesh, target, level.mesh);
+		if (level.mesh.GetTriangleCount() > previous.mesh.GetTriangleCount() * 0.95f)
+			break;
+		chain.levels.push_back(std::move(level));
+	}
+}
+
+void BuildLodChains(const std::vector<const IndexedMesh*>& meshes, std::vector<LodChain>& chains, JobPool* pool)
+{
+	chains.resize(meshes.size());
+	if (!pool)
+	{
+		for (size_t i = 0; i < meshes.size(); i++)
+			BuildLodChain(*meshes[i], chains[i]);
+		return;
+	}
+	pool->ParallelFor((int)meshes.size(), 1, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			BuildLodChain(*meshes[i], chains[i]);
+	});
+}
+
+LodProjection MakeLodProjection(float fovY, float screenHeight)
+{
+	return { screenHeight / (2.0f * tanf(fovY * 0.5f)) };
+}
+
+int SelectLod(const LodChain& chain, float distance, const LodProjection& projection, int currentLevel, float thresholdPixels, float hysteresis)
+{
+	int levelCount = (int)chain.levels.size();
+	if (levelCount == 0)
+		return 0;
+	float pixelsPerUnit = projection.pixelsPerUnit / std::max(distance, 1e-4f);
+
+	// errors only grow along the chain
+	auto coarsestUnder = [&](float threshold)
+	{
+		int level = 0;
+		while (level + 1 < levelCount && chain.levels[level + 1].error * pixelsPerUnit <= threshold)
+			level++;
+		return level;
+	};
+	int coarse = coarsestUnder(thresholdPixels * (1.0f - hysteresis));
+	int fine = coarsestUnder(thresholdPixels * (1.0f + hysteresis));
+
+	currentLevel = std::min(std::max(currentLevel, 0), levelCount - 1);
+	if (currentLevel < coarse)
+		return coarse;
+	if (currentLevel > fine)
+		return fine;
+	return currentLevel;
+}
+
+IndexedMesh MakeSphereMesh(int rings, int segments)
+{
+	const float pi = 3.14159265f;
+	IndexedMesh mesh;
+	for (int ring = 0; ring <= rings; ring++)
+	{
+		float theta = pi * ring / rings;
+		for (int segment = 0; segment <= segments; segment++)
+		{
+			float phi = 2.0f * pi * segment / segments;
+			MeshVertex vertex;
+			vertex.position = { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) };
+			vertex.u = (float)segment / segments;
+			vertex.v = (float)ring / rings;
+			mesh.vertices.push_back(vertex);
+		}
+	}
+
+	// clockwise seen from outside, like the quad in main.cpp
+	for (int ring = 0; ring < rings; ring++)
+	{
+		for (int segment = 0; segment < segments; segment++)
+		{
+			unsigned int a = ring * (segments + 1) + segment;
+			unsigned int b = a + 1;
+			unsigned int c = a + segments + 1;
+			unsigned int d = c + 1;
+			if (ring != 0)
+				mesh.indices.insert(mesh.indices.end(), { a, b, c });
+			if (ring != rings - 1)
+				mesh.indices.insert(mesh.indices.end(), { b, d, c });
+		}
+	}
+	return mesh;
+}
+
+LodBenchmarkResult BenchmarkLod(int trianglesPerMesh, int meshCount, JobPool* pool)
+{
+	// 2 * segments * (rings - 1) triangles with twice as many segments as rings
+	int rings = std::max(3, (int)sqrtf(trianglesPerMesh / 4.0f) + 1);
+	IndexedMesh sphere = MakeSphereMesh(rings, rings * 2);
+	std::vector<const IndexedMesh*> meshes(meshCount, &sphere);
+
+	LodBenchmarkResult result = {};
+	result.meshCount = meshCount;
+	result.trianglesPerMesh = sphere.GetTriangleCount();
+
+	std::vector<LodChain> chains;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildLodChains(meshes, chains, nullptr);
+	result.serialMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	result.levels = chains.empty() ? 0 : (int)chains[0].levels.size();
+
+	start = std::chrono::high_resolution_clock::now();
+	BuildLodChains(meshes, chains, pool);
+	result.parallelMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return result;
+}
@@ -0,0 +1,92 @@
+//--------------------------------------------------------------------------------------
+// MeshLod - level of detail chains built by mesh simplification, and picking a level
+// from the error it would show on screen.
+//
+// SimplifyMesh() collapses edges in order of their quadric error (Garland-Heckbert):
+// every vertex sums the planes of its triangles, and moving it to a new position costs
+// the squared distance to those planes. Edges collapse into whichever endpoint costs
+// less, so vertices keep their texture coordinates. Collapses that would flip a
+// triangle are skipped, open borders get extra planes so the outline holds, and
+// vertices on texture seams (same position, different uv) never move.
+//
+// A LodChain keeps each level with its error in object space units. SelectLod() turns
+// that into pixels with the projection from transform() and picks the coarsest level
+// that stays under a threshold; a level only changes once the error is a margin past
+// the threshold, so objects sitting at a switching distance don't pop back and forth.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+
+#include "MathTypes.h"
+
+class JobPool;
+
+// Same layout as TriangleVertex in main.cpp
+struct MeshVertex
+{
+	Float3 position;
+	float u, v;
+};
+
+struct IndexedMesh
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<unsigned int> indices;	// triangle list
+
+	int GetTriangleCount() const { return (int)indices.size() / 3; }
+};
+
+// Simplifies 'input' to about 'targetTriangles' (fewer if collapses run out first).
+// Returns the error of the result: roughly how far, in object space units, its surface
+// may be from the input's.
+float SimplifyMesh(const IndexedMesh& input, int targetTriangles, IndexedMesh& output);
+
+struct LodLevel
+{
+	IndexedMesh mesh;
+	float error;	// object space, 0 for the full detail level
+};
+
+// levels[0] is the input mesh, each further level has about 'ratio' of the previous
+// one's triangles. Stops at 'maxLevels' levels or below 'minTriangles'.
+struct LodChain
+{
+	std::vector<LodLevel> levels;
+};
+
+void BuildLodChain(const IndexedMesh& mesh, LodChain& chain, int maxLevels = 5, float ratio = 0.5f, int minTriangles = 32);
+
+// One chain per mesh, the meshes simplified in parallel on the pool
+void BuildLodChains(const std::vector<const IndexedMesh*>& meshes, std::vector<LodChain>& chains, JobPool* pool);
+
+// Screen pixels covered by one object space unit at distance 1
+struct LodProjection
+{
+	float pixelsPerUnit;
+};
+
+// fovY in radians, as given to XMMatrixPerspectiveFovLH
+LodProjection MakeLodProjection(float fovY, float screenHeight);
+
+// The coarsest level whose error covers at most 'thresholdPixels' at 'distance' (view
+// space depth). Starting from 'currentLevel', a coarser level is only taken once its
+// error is 'hysteresis' (a fraction) under the threshold, and a finer one only once
+// the current level's error is that much over it.
+int SelectLod(const LodChain& chain, float distance, const LodProjection& projection, int currentLevel,
+	float thresholdPixels = 1.0f, float hysteresis = 0.25f);
+
+// UV sphere of radius 1 with a texture seam, 2 * segments * (rings - 1) triangles
+IndexedMesh MakeSphereMesh(int rings, int segments);
+
+struct LodBenchmarkResult
+{
+	int meshCount;
+	int trianglesPerMesh;
+	int levels;				// per chain
+	double serialMs;		// all chains on the calling thread
+	double parallelMs;		// BuildLodChains() on the pool
+};
+
+// Builds chains for 'meshCount' spheres of about 'trianglesPerMesh' triangles each
+LodBenchmarkResult BenchmarkLod(int trianglesPerMesh, int meshCount, JobPool* pool);
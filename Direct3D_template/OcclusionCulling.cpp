@@ -0,0 +1,199 @@
+#include "OcclusionCulling.h"
+#include "DepthRasterizer.h"
+#include "JobPool.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+	: mWidth((width + 3) & ~3),
+	mHeight(height),
+	mTestedBoxes(0),
+	mCulledBoxes(0)
+{
+	int levelWidth = mWidth;
+	int levelHeight = mHeight;
+	for (;;)
+	{
+		Level level;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.maxDepth.resize(levelWidth * levelHeight, 1.0f);
+		if (!mLevels.empty())
+			level.minDepth.resize(levelWidth * levelHeight, 1.0f);
+		mLevels.push_back(level);
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+}
+
+void OcclusionCuller::BeginFrame(const Float4x4& viewProj)
+{
+	mViewProj = viewProj;
+	std::fill(mLevels[0].maxDepth.begin(), mLevels[0].maxDepth.end(), 1.0f);
+	mFrameStats = {};
+	mTestedBoxes = 0;
+	mCulledBoxes = 0;
+}
+
+void OcclusionCuller::AddOccluder(const IndexedMesh& mesh, const Float4x4& world)
+{
+	Clock::time_point start = Clock::now();
+
+	Float4x4 worldViewProj = Multiply(world, mViewProj);
+	std::vector<Float4> clip(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const Float3& p = mesh.vertices[i].position;
+		clip[i] = Mul({ p.x, p.y, p.z, 1.0f }, worldViewProj);
+	}
+
+	float* depth = mLevels[0].maxDepth.data();
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		mFrameStats.occluderTriangles += RasterizeDepthTriangle(depth, mWidth, mHeight,
+			clip[mesh.indices[i]], clip[mesh.indices[i + 1]], clip[mesh.indices[i + 2]]);
+	}
+
+	mFrameStats.rasterMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void OcclusionCuller::BuildLevel(int level, int firstRow, int endRow)
+{
+	const Level& source = mLevels[level - 1];
+	Level& target = mLevels[level];
+	// level 0 has no separate min
+	const float* sourceMin = level == 1 ? source.maxDepth.data() : source.minDepth.data();
+	const float* sourceMax = source.maxDepth.data();
+	for (int y = firstRow; y < endRow; y++)
+	{
+		// odd sizes repeat the last row/column
+		int row0 = 2 * y * source.width;
+		int row1 = std::min(2 * y + 1, source.height - 1) * source.width;
+		for (int x = 0; x < target.width; x++)
+		{
+			int column0 = 2 * x;
+			int column1 = std::min(2 * x + 1, source.width - 1);
+			float nearest = std::min(std::min(sourceMin[row0 + column0], sourceMin[row0 + column1]),
+				std::min(sourceMin[row1 + column0], sourceMin[row1 + column1]));
+			float farthest = std::max(std::max(sourceMax[row0 + column0], sourceMax[row0 + column1]),
+				std::max(sourceMax[row1 + column0], sourceMax[row1 + column1]));
+			target.minDepth[y * target.width + x] = nearest;
+			target.maxDepth[y * target.width + x] = farthest;
+		}
+	}
+}
+
+void OcclusionCuller::BuildHiZ(JobPool* pool)
+{
+	Clock::time_point start = Clock::now();
+
+	// Each level needs the whole previous one, so only the rows of a level run in
+	// parallel, and only where there are enough of them
+	for (int level = 1; level < (int)mLevels.size(); level++)
+	{
+		int rows = mLevels[level].height;
+		if (pool && rows >= 64)
+		{
+			pool->ParallelFor(rows, 16, [this, level](int begin, int end)
+			{
+				BuildLevel(level, begin, end);
+			});
+		}
+		else
+			BuildLevel(level, 0, rows);
+	}
+
+	mHiZEnd = Clock::now();
+	mFrameStats.hiZMs = std::chrono::duration<double, std::milli>(mHiZEnd - start).count();
+}
+
+void OcclusionCuller::GetDepthRange(int level, int x0, int y0, int x1, int y1, float& nearest, float& farthest) const
+{
+	const Level& source = mLevels[level];
+	const float* minDepth = level == 0 ? source.maxDepth.data() : source.minDepth.data();
+	nearest = FLT_MAX;
+	farthest = 0.0f;
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			nearest = std::min(nearest, minDepth[y * source.width + x]);
+			farthest = std::max(farthest, source.maxDepth[y * source.width + x]);
+		}
+	}
+}
+
+bool OcclusionCuller::IsBoxVisible(const Float3& boxMin, const Float3& boxMax)
+{
+	mTestedBoxes++;
+
+	float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		Float4 position = { corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y, corner & 4 ? boxMax.z : boxMin.z, 1.0f };
+		Float4 clip = Mul(position, mViewProj);
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+			return true;	// crosses the near plane
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * mWidth;
+		float y = (0.5f - clip.y * invW * 0.5f) * mHeight;
+		float z = clip.z * invW;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, z);
+		maxZ = std::max(maxZ, z);
+	}
+
+	// Every pixel the rectangle touches, even partly
+	if (maxX < 0.0f || maxY < 0.0f || minX >= mWidth || minY >= mHeight)
+		return true;	// off screen, left to frustum culling
+	int x0 = (int)std::max(minX, 0.0f);
+	int y0 = (int)std::max(minY, 0.0f);
+	int x1 = (int)std::min(maxX, (float)(mWidth - 1));
+	int y1 = (int)std::min(maxY, (float)(mHeight - 1));
+
+	int level = 0;
+	while (level + 1 < (int)mLevels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	float nearest, farthest;
+	GetDepthRange(level, x0 >> level, y0 >> level, x1 >> level, y1 >> level, nearest, farthest);
+	if (minZ > farthest)
+	{
+		mCulledBoxes++;
+		return false;
+	}
+	if (maxZ < nearest || level == 0)
+		return true;
+
+	// Partly behind the occluders, the finer level may still hide it
+	level--;
+	GetDepthRange(level, x0 >> level, y0 >> level, x1 >> level, y1 >> level, nearest, farthest);
+	if (minZ > farthest)
+	{
+		mCulledBoxes++;
+		return false;
+	}
+	return true;
+}
+
+void OcclusionCuller::EndFrame()
+{
+	mFrameStats.testMs = std::chrono::duration<double, std::milli>(Clock::now() - mHiZEnd).count();
+	mFrameStats.testedBoxes = mTestedBoxes;
+	mFrameStats.culledBoxes = mCulledBoxes;
+	mStats = mFrameStats;
+}
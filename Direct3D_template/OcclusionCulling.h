@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// OcclusionCulling - hierarchical Z occlusion culling on the CPU.
+//
+// A few large occluder meshes are rasterized into a low resolution depth buffer by
+// DepthRasterizer.h, with the conventions of the D3D depth buffer in main.cpp:
+// cleared to 1.0, 0 = near plane, nearer depth wins (DepthFunc LESS). The
+// buffer then becomes a pyramid where every texel holds the min and max depth of the
+// 2x2 texels under it.
+//
+// An occludee's world space box is projected to a screen rectangle and its nearest
+// depth. The test reads the level where the rectangle spans at most 2x2 texels: the
+// box is hidden if it is behind the farthest occluder depth there. If not, and the
+// box is not wholly in front of the nearest depth, the next finer level gets a look
+// too. Boxes crossing the near plane or off screen always count as visible.
+//
+//   BeginFrame(viewProj)  AddOccluder() ...  BuildHiZ()  IsBoxVisible() ...  EndFrame()
+//
+// IsBoxVisible() only reads the pyramid and may be called from several threads.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "MathTypes.h"
+#include "MeshLod.h"
+
+class JobPool;
+
+struct OcclusionStats
+{
+	int occluderTriangles;	// rasterized, after near plane clipping
+	int testedBoxes;
+	int culledBoxes;
+	double rasterMs;		// all AddOccluder() calls
+	double hiZMs;			// BuildHiZ()
+	double testMs;			// from the end of BuildHiZ() to EndFrame()
+};
+
+class OcclusionCuller
+{
+public:
+	// The width is rounded up to a multiple of 4
+	OcclusionCuller(int width, int height);
+
+	// 'viewProj' is row-major (clip = v * viewProj), a D3D projection (0 <= z <= w)
+	void BeginFrame(const Float4x4& viewProj);
+	void AddOccluder(const IndexedMesh& mesh, const Float4x4& world);
+	void BuildHiZ(JobPool* pool = nullptr);
+
+	// False if the world space box is hidden behind the occluders
+	bool IsBoxVisible(const Float3& boxMin, const Float3& boxMax);
+	void EndFrame();
+
+	int GetWidth() const { return mWidth; }
+	int GetHeight() const { return mHeight; }
+	int GetLevelCount() const { return (int)mLevels.size(); }
+	// Level 0 is the rasterized depth buffer
+	const float* GetMaxDepth(int level) const { return mLevels[level].maxDepth.data(); }
+	const OcclusionStats& GetStats() const { return mStats; }
+
+private:
+	struct Level
+	{
+		int width, height;
+		std::vector<float> minDepth;	// empty for level 0, where min = max
+		std::vector<float> maxDepth;
+	};
+
+	void BuildLevel(int level, int firstRow, int endRow);
+	// Farthest and nearest depth of texels [x0, x1] x [y0, y1] of 'level'
+	void GetDepthRange(int level, int x0, int y0, int x1, int y1, float& nearest, float& farthest) const;
+
+	int mWidth, mHeight;
+	Float4x4 mViewProj = {};
+	std::vector<Level> mLevels;
+
+	std::atomic<int> mTestedBoxes;
+	std::atomic<int> mCulledBoxes;
+	std::chrono::high_resolution_clock::time_point mHiZEnd;
+	OcclusionStats mStats = {};
+	OcclusionStats mFrameStats = {};
+};
@@ -0,0 +1,283 @@
+#include "RenderQueue.h"
+#include "JobPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+
+// Below this many draws one thread sorts faster than splitting the work
+static const int PARALLEL_SORT_THRESHOLD = 16384;
+
+SortKey MakeSortKey(int pass, unsigned int shader, unsigned int texture, unsigned int mesh, float depth)
+{
+	const SortKey idMask = (1 << SORT_KEY_ID_BITS) - 1;
+	const SortKey depthMax = (1 << SORT_KEY_DEPTH_BITS) - 1;
+	depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+	SortKey bucket = (SortKey)(depth * depthMax);
+
+	SortKey key = (SortKey)(pass & 15) << 60;
+	if (pass == PASS_TRANSPARENT)
+	{
+		// back to front first, state only breaks ties
+		key |= (depthMax - bucket) << 36;
+		key |= (shader & idMask) << 24;
+		key |= (texture & idMask) << 12;
+		key |= (mesh & idMask);
+	}
+	else
+	{
+		key |= (shader & idMask) << 48;
+		key |= (texture & idMask) << 36;
+		key |= (mesh & idMask) << 24;
+		key |= bucket;
+	}
+	return key;
+}
+
+void RenderQueue::Clear()
+{
+	mDraws.clear();
+	mEntries.clear();
+	mInstances.clear();
+	mBatches.clear();
+}
+
+void RenderQueue::SetDepthRange(float nearZ, float farZ)
+{
+	mNearZ = nearZ;
+	mFarZ = farZ;
+}
+
+void RenderQueue::Add(int pass, unsigned int shader, unsigned int texture, unsigned int mesh, float depth, const Float4x4& world)
+{
+	float normalized = (depth - mNearZ) / (mFarZ - mNearZ);
+	mEntries.push_back({ MakeSortKey(pass, shader, texture, mesh, normalized), (unsigned int)mDraws.size() });
+	mDraws.push_back({ shader, texture, mesh, pass, world });
+}
+
+// LSD radix sort, 8 bits per pass. Digits that are the same for every key are
+// skipped. Each block of entries builds its own histogram, so blocks can scatter
+// in parallel and the sort stays stable.
+void RenderQueue::RadixSort(JobPool* pool)
+{
+	int count = (int)mEntries.size();
+	int blocks = pool && count >= PARALLEL_SORT_THRESHOLD ? pool->GetThreadCount() + 1 : 1;
+	int blockSize = (count + blocks - 1) / blocks;
+	mScratch.resize(count);
+	mHistograms.resize(256 * blocks);
+
+	// which digits differ at all
+	SortKey orBits = 0, andBits = ~(SortKey)0;
+	for (const SortEntry& entry : mEntries)
+	{
+		orBits |= entry.key;
+		andBits &= entry.key;
+	}
+	SortKey varying = orBits ^ andBits;
+
+	auto forBlocks = [pool, blocks](const std::function<void(int)>& fn)
+	{
+		if (blocks == 1)
+			fn(0);
+		else
+			pool->ParallelFor(blocks, 1, [&fn](int begin, int end) { for (int block = begin; block < end; block++) fn(block); });
+	};
+
+	SortEntry* source = mEntries.data();
+	SortEntry* target = mScratch.data();
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		if (!((varying >> shift) & 0xff))
+			continue;
+
+		forBlocks([&](int block)
+		{
+			unsigned int* histogram = &mHistograms[256 * block];
+			std::fill(histogram, histogram + 256, 0u);
+			int end = std::min(count, (block + 1) * blockSize);
+			for (int i = block * blockSize; i < end; i++)
+				histogram[(source[i].key >> shift) & 0xff]++;
+		});
+
+		// digit-major, block-minor prefix sum: block b's entries for a digit follow block b-1's
+		unsigned int offset = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			for (int block = 0; block < blocks; block++)
+			{
+				unsigned int digitCount = mHistograms[256 * block + digit];
+				mHistograms[256 * block + digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		forBlocks([&](int block)
+		{
+			unsigned int* next = &mHistograms[256 * block];
+			int end = std::min(count, (block + 1) * blockSize);
+			for (int i = block * blockSize; i < end; i++)
+				target[next[(source[i].key >> shift) & 0xff]++] = source[i];
+		});
+		std::swap(source, target);
+	}
+
+	if (source != mEntries.data())
+		mEntries.swap(mScratch);
+}
+
+void RenderQueue::Sort(JobPool* pool)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	RadixSort(pool);
+
+	// runs with the same state become one instanced draw
+	mBatches.clear();
+	mInstances.resize(mEntries.size());
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		const Draw& draw = mDraws[mEntries[i].draw];
+		mInstances[i] = draw.world;
+		if (!mBatches.empty())
+		{
+			RenderBatch& last = mBatches.back();
+			if (last.pass == draw.pass && last.shader == draw.shader && last.texture == draw.texture && last.mesh == draw.mesh)
+			{
+				last.instanceCount++;
+				continue;
+			}
+		}
+		mBatches.push_back({ draw.pass, draw.shader, draw.texture, draw.mesh, (int)i, 1 });
+	}
+
+	mStats.draws = (int)mDraws.size();
+	mStats.batches = (int)mBatches.size();
+	mStats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+namespace
+{
+	// Forwards only the state that differs from the previous call; the first call sets everything
+	class StateFilter
+	{
+	public:
+		StateFilter(RenderBackend& backend, RenderQueueStats* stats) : mBackend(backend), mStats(stats) {}
+
+		void Set(int pass, unsigned int shader, unsigned int texture, unsigned int mesh)
+		{
+			if (pass != mPass)
+			{
+				mBackend.SetPass(mPass = pass);
+				if (mStats)
+					mStats->passChanges++;
+			}
+			if (shader != mShader)
+			{
+				mBackend.SetShader(mShader = shader);
+				if (mStats)
+					mStats->shaderChanges++;
+			}
+			if (texture != mTexture)
+			{
+				mBackend.SetTexture(mTexture = texture);
+				if (mStats)
+					mStats->textureChanges++;
+			}
+			if (mesh != mMesh)
+			{
+				mBackend.SetMesh(mMesh = mesh);
+				if (mStats)
+					mStats->meshChanges++;
+			}
+		}
+
+	private:
+		RenderBackend& mBackend;
+		RenderQueueStats* mStats;
+		int mPass = -1;
+		unsigned int mShader = ~0u, mTexture = ~0u, mMesh = ~0u;
+	};
+}
+
+void RenderQueue::SubmitBatches(RenderBackend& backend, int begin, int end, RenderQueueStats* stats) const
+{
+	StateFilter state(backend, stats);
+	for (int i = begin; i < end; i++)
+	{
+		const RenderBatch& batch = mBatches[i];
+		state.Set(batch.pass, batch.shader, batch.texture, batch.mesh);
+		backend.DrawInstanced(batch.firstInstance, batch.instanceCount);
+	}
+}
+
+void RenderQueue::Submit(RenderBackend& backend, bool sorted)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	mStats.passChanges = mStats.shaderChanges = mStats.textureChanges = mStats.meshChanges = 0;
+
+	if (sorted)
+	{
+		if (!mInstances.empty())
+			backend.SetInstances(mInstances.data(), (int)mInstances.size());
+		SubmitBatches(backend, 0, (int)mBatches.size(), &mStats);
+	}
+	else
+	{
+		StateFilter state(backend, &mStats);
+		std::vector<Float4x4> worlds(mDraws.size());
+		for (size_t i = 0; i < mDraws.size(); i++)
+			worlds[i] = mDraws[i].world;
+		if (!worlds.empty())
+			backend.SetInstances(worlds.data(), (int)worlds.size());
+		for (size_t i = 0; i < mDraws.size(); i++)
+		{
+			state.Set(mDraws[i].pass, mDraws[i].shader, mDraws[i].texture, mDraws[i].mesh);
+			backend.DrawInstanced((int)i, 1);
+		}
+	}
+
+	mStats.submitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+RenderQueueBenchmark BenchmarkRenderQueue(int drawCount, JobPool* pool, int iterations)
+{
+	std::mt19937 random(42);
+	struct Input
+	{
+		unsigned int shader, texture, mesh;
+		float depth;
+	};
+	std::vector<Input> inputs(drawCount);
+	for (Input& input : inputs)
+	{
+		input.shader = random() % 16;
+		input.texture = random() % 64;
+		input.mesh = random() % 8;
+		input.depth = 0.1f + (random() % 10000) / 500.0f;
+	}
+
+	RenderQueue queue;
+	RenderQueueBenchmark result = {};
+	result.draws = drawCount;
+	double totalMs = 0.0;
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		queue.Clear();
+		for (const Input& input : inputs)
+			queue.Add(PASS_OPAQUE, input.shader, input.texture, input.mesh, input.depth, MatrixTranslation(0.0f, 0.0f, input.depth));
+
+		NullBackend backend;
+		queue.Sort(pool);
+		queue.Submit(backend);
+		totalMs += queue.GetStats().sortMs + queue.GetStats().submitMs;
+		result.sortedStateChanges = backend.passChanges + backend.shaderChanges + backend.textureChanges + backend.meshChanges;
+		result.batches = queue.GetStats().batches;
+	}
+	result.drawsPerSecond = drawCount * iterations / (totalMs / 1000.0);
+
+	NullBackend unsorted;
+	queue.Submit(unsorted, false);
+	result.unsortedStateChanges = unsorted.passChanges + unsorted.shaderChanges + unsorted.textureChanges + unsorted.meshChanges;
+	return result;
+}
@@ -0,0 +1,155 @@
+//--------------------------------------------------------------------------------------
+// RenderQueue - sorts draws by a 64-bit key and merges them into instanced batches.
+//
+// Every draw gets a key with its pass in the top bits, then for opaque passes the
+// shader, texture and mesh (so draws sharing state end up next to each other) and a
+// front-to-back depth bucket; transparent passes put a back-to-front depth bucket
+// before the state. The keys are radix sorted (8 bits per pass, spread over the
+// JobPool for large queues) and runs of draws with the same pass/shader/texture/mesh
+// become one instanced draw.
+//
+// Submit() talks to a RenderBackend and only issues the state changes that are needed.
+// NullBackend just counts, for measuring the queue without a GPU.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+
+#include "MathTypes.h"
+
+class JobPool;
+
+typedef unsigned long long SortKey;
+
+enum RenderPass
+{
+	PASS_OPAQUE = 0,
+	PASS_TRANSPARENT = 1,
+	PASS_OVERLAY = 2,
+};
+
+// Ids are truncated to 12 bits, the depth bucket is 24 bits
+static const int SORT_KEY_ID_BITS = 12;
+static const int SORT_KEY_DEPTH_BITS = 24;
+
+// 'depth' in [0, 1], 0 = near
+SortKey MakeSortKey(int pass, unsigned int shader, unsigned int texture, unsigned int mesh, float depth);
+
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+
+	// Blend and depth state of a RenderPass
+	virtual void SetPass(int pass) = 0;
+	virtual void SetShader(unsigned int shader) = 0;
+	virtual void SetTexture(unsigned int texture) = 0;
+	virtual void SetMesh(unsigned int mesh) = 0;
+	// World matrices of every instance of the frame, in batch order
+	virtual void SetInstances(const Float4x4* worlds, int count) = 0;
+	virtual void DrawInstanced(int firstInstance, int instanceCount) = 0;
+};
+
+// Counts what it is asked to do
+class NullBackend : public RenderBackend
+{
+public:
+	void SetPass(int) override { passChanges++; }
+	void SetShader(unsigned int) override { shaderChanges++; }
+	void SetTexture(unsigned int) override { textureChanges++; }
+	void SetMesh(unsigned int) override { meshChanges++; }
+	void SetInstances(const Float4x4*, int count) override { instancesUploaded += count; }
+	void DrawInstanced(int, int instanceCount) override { drawCalls++; instancesDrawn += instanceCount; }
+
+	long long passChanges = 0;
+	long long shaderChanges = 0;
+	long long textureChanges = 0;
+	long long meshChanges = 0;
+	long long drawCalls = 0;
+	long long instancesDrawn = 0;
+	long long instancesUploaded = 0;
+};
+
+// A run of sorted draws sharing pass, shader, texture and mesh, drawn as one instanced draw
+struct RenderBatch
+{
+	int pass;
+	unsigned int shader, texture, mesh;
+	int firstInstance, instanceCount;
+};
+
+struct RenderQueueStats
+{
+	int draws;
+	int batches;
+	int passChanges;
+	int shaderChanges;
+	int textureChanges;
+	int meshChanges;
+	double sortMs;		// radix sort and batch building
+	double submitMs;
+};
+
+class RenderQueue
+{
+public:
+	void Clear();
+
+	// 'depth' is view space z, bucketed with SetDepthRange()
+	void Add(int pass, unsigned int shader, unsigned int texture, unsigned int mesh, float depth, const Float4x4& world);
+	void SetDepthRange(float nearZ, float farZ);
+
+	// Sorts by key and builds the batches; with a pool large queues sort in parallel
+	void Sort(JobPool* pool = nullptr);
+
+	// Issues the batches of the last Sort(), or the draws one by one in submission
+	// order if 'sorted' is false (for comparison)
+	void Submit(RenderBackend& backend, bool sorted = true);
+
+	// Issues batches [begin, end) of the last Sort() without uploading the instances,
+	// setting all state first as a fresh context needs. Safe to call for different
+	// ranges from several threads; 'stats' (optional) gets the state changes added.
+	void SubmitBatches(RenderBackend& backend, int begin, int end, RenderQueueStats* stats = nullptr) const;
+
+	int GetDrawCount() const { return (int)mDraws.size(); }
+	const std::vector<RenderBatch>& GetBatches() const { return mBatches; }
+	const std::vector<Float4x4>& GetInstances() const { return mInstances; }
+	const RenderQueueStats& GetStats() const { return mStats; }
+
+private:
+	struct Draw
+	{
+		unsigned int shader, texture, mesh;
+		int pass;
+		Float4x4 world;
+	};
+
+	struct SortEntry
+	{
+		SortKey key;
+		unsigned int draw;
+	};
+
+	void RadixSort(JobPool* pool);
+
+	float mNearZ = 0.1f, mFarZ = 20.0f;
+	std::vector<Draw> mDraws;
+	std::vector<SortEntry> mEntries;
+	std::vector<SortEntry> mScratch;
+	std::vector<unsigned int> mHistograms;	// 256 per block
+	std::vector<Float4x4> mInstances;
+	std::vector<RenderBatch> mBatches;
+	RenderQueueStats mStats = {};
+};
+
+struct RenderQueueBenchmark
+{
+	int draws;
+	int batches;
+	double drawsPerSecond;			// sort + submit to the NullBackend
+	long long unsortedStateChanges;	// pass + shader + texture + mesh changes in submission order
+	long long sortedStateChanges;
+};
+
+// 'drawCount' random draws over 16 shaders, 64 textures and 8 meshes
+RenderQueueBenchmark BenchmarkRenderQueue(int drawCount, JobPool* pool, int iterations = 10);
@@ -0,0 +1,186 @@
+#include "SceneGraph.h"
+#include "JobPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+// Levels smaller than this are not worth splitting into jobs
+static const int PARALLEL_BATCH_SIZE = 2048;
+
+NodeId SceneGraph::AddNode(NodeId parent, const Float4x4& local)
+{
+	int parentIndex = parent == INVALID_NODE ? -1 : mIndexOfNode[parent];
+	int depth = parentIndex < 0 ? 0 : mDepth[parentIndex] + 1;
+	if (!mDepth.empty() && depth < mDepth.back())
+		mNeedsSort = true;
+
+	NodeId node = (NodeId)mIndexOfNode.size();
+	mIndexOfNode.push_back((int)mParent.size());
+	mNodeOfIndex.push_back(node);
+	mParent.push_back(parentIndex);
+	mDepth.push_back(depth);
+	mLocal.push_back(local);
+	mWorld.push_back(MatrixIdentity());
+	mDirty.push_back(1);
+	return node;
+}
+
+void SceneGraph::Clear()
+{
+	mParent.clear();
+	mDepth.clear();
+	mLocal.clear();
+	mWorld.clear();
+	mDirty.clear();
+	mNodeOfIndex.clear();
+	mIndexOfNode.clear();
+	mLevelStart.clear();
+	mNeedsSort = false;
+}
+
+void SceneGraph::SetLocal(NodeId node, const Float4x4& local)
+{
+	int index = mIndexOfNode[node];
+	mLocal[index] = local;
+	mDirty[index] = 1;
+}
+
+const Float4x4& SceneGraph::GetLocal(NodeId node) const
+{
+	return mLocal[mIndexOfNode[node]];
+}
+
+const Float4x4& SceneGraph::GetWorld(NodeId node) const
+{
+	return mWorld[mIndexOfNode[node]];
+}
+
+// Stable counting sort by depth, keeps siblings in insertion order
+void SceneGraph::SortByDepth()
+{
+	int count = (int)mParent.size();
+	int levels = 0;
+	for (int depth : mDepth)
+		levels = depth + 1 > levels ? depth + 1 : levels;
+
+	mLevelStart.assign(levels + 1, 0);
+	for (int depth : mDepth)
+		mLevelStart[depth + 1]++;
+	for (int level = 0; level < levels; level++)
+		mLevelStart[level + 1] += mLevelStart[level];
+
+	if (mNeedsSort)
+	{
+		std::vector<int> newIndex(count);
+		std::vector<int> next(mLevelStart.begin(), mLevelStart.end() - 1);
+		for (int i = 0; i < count; i++)
+			newIndex[i] = next[mDepth[i]]++;
+
+		std::vector<int> parent(count), depth(count);
+		std::vector<Float4x4> local(count), world(count);
+		std::vector<unsigned char> dirty(count);
+		std::vector<NodeId> nodeOfIndex(count);
+		for (int i = 0; i < count; i++)
+		{
+			int j = newIndex[i];
+			parent[j] = mParent[i] < 0 ? -1 : newIndex[mParent[i]];
+			depth[j] = mDepth[i];
+			local[j] = mLocal[i];
+			world[j] = mWorld[i];
+			dirty[j] = mDirty[i];
+			nodeOfIndex[j] = mNodeOfIndex[i];
+			mIndexOfNode[mNodeOfIndex[i]] = j;
+		}
+		mParent.swap(parent);
+		mDepth.swap(depth);
+		mLocal.swap(local);
+		mWorld.swap(world);
+		mDirty.swap(dirty);
+		mNodeOfIndex.swap(nodeOfIndex);
+		mNeedsSort = false;
+	}
+}
+
+// Nodes in [begin, end) all have the same depth, so their parents are final
+int SceneGraph::UpdateRange(int begin, int end)
+{
+	int updated = 0;
+	for (int i = begin; i < end; i++)
+	{
+		int parent = mParent[i];
+		if (parent >= 0)
+			mDirty[i] |= mDirty[parent];
+		if (!mDirty[i])
+			continue;
+
+		mWorld[i] = parent >= 0 ? Multiply(mLocal[i], mWorld[parent]) : mLocal[i];
+		updated++;
+	}
+	return updated;
+}
+
+void SceneGraph::Update(JobPool* pool)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	if (mNeedsSort || (int)mLevelStart.size() < 2 || mLevelStart.back() != (int)mParent.size())
+		SortByDepth();
+
+	int levels = (int)mLevelStart.size() - 1;
+	std::atomic<int> updated(0);
+	for (int level = 0; level < levels; level++)
+	{
+		int begin = mLevelStart[level];
+		int end = mLevelStart[level + 1];
+		if (pool && end - begin > PARALLEL_BATCH_SIZE)
+		{
+			pool->ParallelFor(end - begin, PARALLEL_BATCH_SIZE, [this, begin, &updated](int first, int last)
+			{
+				updated += UpdateRange(begin + first, begin + last);
+			});
+		}
+		else
+		{
+			updated += UpdateRange(begin, end);
+		}
+	}
+
+	// a level reads the flags of the one above, so they can only be cleared at the end
+	std::fill(mDirty.begin(), mDirty.end(), (unsigned char)0);
+
+	mStats.nodeCount = (int)mParent.size();
+	mStats.levelCount = levels;
+	mStats.updatedNodes = updated;
+	mStats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+double BenchmarkSceneGraph(int nodeCount, float dirtyFraction, JobPool* pool, int iterations)
+{
+	SceneGraph graph;
+	std::mt19937 random(1234);
+	std::vector<NodeId> nodes;
+	nodes.reserve(nodeCount);
+	for (int i = 0; i < nodeCount; i++)
+	{
+		NodeId parent = i == 0 ? INVALID_NODE : nodes[(i - 1) / 8];
+		Float4x4 local = Multiply(MatrixRotationY(0.001f * i), MatrixTranslation(0.0f, 0.1f, 1.0f));
+		nodes.push_back(graph.AddNode(parent, local));
+	}
+	graph.Update(pool);
+
+	int dirtyCount = (int)(nodeCount * dirtyFraction);
+	double totalMs = 0.0;
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < dirtyCount; i++)
+		{
+			NodeId node = nodes[std::uniform_int_distribution<int>(0, nodeCount - 1)(random)];
+			graph.SetLocal(node, graph.GetLocal(node));
+		}
+		graph.Update(pool);
+		totalMs += graph.GetStats().updateMs;
+	}
+	return totalMs / iterations;
+}
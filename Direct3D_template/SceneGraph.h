@@ -0,0 +1,74 @@
+//--------------------------------------------------------------------------------------
+// SceneGraph - parent/child transform hierarchy in flat arrays.
+//
+// Nodes are stored sorted by depth (roots first, then their children, ...), so a
+// parent's world matrix is always computed before its children's and the update is a
+// linear walk over the arrays. Nodes within one depth level don't depend on each
+// other and are updated in parallel. Only nodes whose local matrix changed, and
+// everything below them, are recomputed.
+//
+// Nodes are referred to by a stable NodeId; the array index of a node changes when
+// new nodes get sorted in.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+
+#include "MathTypes.h"
+
+class JobPool;
+
+typedef int NodeId;
+static const NodeId INVALID_NODE = -1;
+
+struct SceneGraphStats
+{
+	int nodeCount;
+	int levelCount;
+	int updatedNodes;		// world matrices recomputed by the last Update()
+	double updateMs;
+};
+
+class SceneGraph
+{
+public:
+	// 'parent' must already exist (or be INVALID_NODE for a root).
+	NodeId AddNode(NodeId parent, const Float4x4& local = MatrixIdentity());
+	void Clear();
+
+	// Marks the node and its subtree for the next Update()
+	void SetLocal(NodeId node, const Float4x4& local);
+	const Float4x4& GetLocal(NodeId node) const;
+
+	// Valid after Update()
+	const Float4x4& GetWorld(NodeId node) const;
+
+	// Recomputes the world matrices of dirty subtrees. With a pool, levels with
+	// enough nodes are split over the workers.
+	void Update(JobPool* pool = nullptr);
+
+	int GetNodeCount() const { return (int)mParent.size(); }
+	const SceneGraphStats& GetStats() const { return mStats; }
+
+private:
+	void SortByDepth();
+	int UpdateRange(int begin, int end);
+
+	// Per node, in depth order
+	std::vector<int> mParent;			// array index, -1 for roots
+	std::vector<int> mDepth;
+	std::vector<Float4x4> mLocal;
+	std::vector<Float4x4> mWorld;
+	std::vector<unsigned char> mDirty;	// local changed, or an ancestor is recomputed
+	std::vector<NodeId> mNodeOfIndex;
+
+	std::vector<int> mIndexOfNode;		// NodeId -> array index
+	std::vector<int> mLevelStart;		// first index of every depth, plus the end
+	bool mNeedsSort = false;			// nodes were appended out of depth order
+
+	SceneGraphStats mStats = {};
+};
+
+// Builds a tree of 'nodeCount' nodes with 8 children per node, marks a random
+// 'dirtyFraction' of them dirty and times Update(), averaged over 'iterations'.
+double BenchmarkSceneGraph(int nodeCount, float dirtyFraction, JobPool* pool, int iterations = 10);
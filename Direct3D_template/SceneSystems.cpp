@@ -0,0 +1,296 @@
+#include "SceneSystems.h"
+#include "JobPool.h"
+
+#include <chrono>
+
+namespace
+{
+	struct Plane
+	{
+		Float3 normal;
+		float distance;
+	};
+
+	// Frustum planes of a D3D projection (0 <= z <= w), pointing inwards
+	void GetFrustumPlanes(const Float4x4& m, Plane planes[6])
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			int axis = i / 2;
+			float sign = (i & 1) ? -1.0f : 1.0f;
+			// near: z >= 0, the other five: -w <= x, y and z <= w
+			float column[4];
+			for (int row = 0; row < 4; row++)
+				column[row] = i == 4 ? m.m[row][2] : m.m[row][3] + sign * m.m[row][axis];
+			Float3 normal = { column[0], column[1], column[2] };
+			float length = sqrtf(Dot(normal, normal));
+			planes[i].normal = normal * (1.0f / length);
+			planes[i].distance = column[3] / length;
+		}
+	}
+
+	void SpinEntities(Spin* spin, int count, float deltaTime)
+	{
+		for (int i = 0; i < count; i++)
+			spin[i].angle += spin[i].speed * deltaTime;
+	}
+
+	void GetWorldSphere(const Float4x4& world, const BoundingSphere& bounds, Float3& center, float& radius)
+	{
+		Float4 position = Mul({ bounds.center.x, bounds.center.y, bounds.center.z, 1.0f }, world);
+		center = { position.x, position.y, position.z };
+		// the largest axis scale keeps the sphere conservative
+		float scaleSq = 0.0f;
+		for (int row = 0; row < 3; row++)
+		{
+			Float3 axis = { world.m[row][0], world.m[row][1], world.m[row][2] };
+			scaleSq = Dot(axis, axis) > scaleSq ? Dot(axis, axis) : scaleSq;
+		}
+		radius = bounds.radius * sqrtf(scaleSq);
+	}
+
+	bool IsSphereVisible(const Plane planes[6], const Float4x4& world, const BoundingSphere& bounds)
+	{
+		Float3 center;
+		float radius;
+		GetWorldSphere(world, bounds, center, radius);
+		for (int i = 0; i < 6; i++)
+		{
+			if (Dot(planes[i].normal, center) + planes[i].distance < -radius)
+				return false;
+		}
+		return true;
+	}
+}
+
+SceneSystems::SceneSystems()
+	: mSpinQuery(ComponentMaskOf<Spin>()),
+	mLocalQuery(ComponentMaskOf<Position, WorldTransform>()),
+	mNodeQuery(ComponentMaskOf<SceneNode, WorldTransform>()),
+	mCullQuery(ComponentMaskOf<WorldTransform, BoundingSphere, Visible>()),
+	mOccluderQuery(ComponentMaskOf<Occluder, WorldTransform, Visible>()),
+	mLodQuery(ComponentMaskOf<LodGroup, WorldTransform, BoundingSphere, Visible, Renderable>()),
+	mDrawQuery(ComponentMaskOf<WorldTransform, Visible, Renderable>())
+{
+}
+
+void SceneSystems::SetLodChains(const std::vector<LodChain>* chains, const LodProjection& projection)
+{
+	mLodChains = chains;
+	mLodProjection = projection;
+}
+
+void SceneSystems::SetOcclusion(OcclusionCuller* culler, const std::vector<IndexedMesh>* occluderMeshes)
+{
+	mOcclusion = culler;
+	mOccluderMeshes = occluderMeshes;
+}
+
+void SceneSystems::Run(EntityWorld& world, EntityQuery& query, JobPool* pool, const std::function<void(const ChunkView&)>& fn)
+{
+	if (pool)
+		world.ForEachChunkParallel(query, *pool, fn);
+	else
+		world.ForEachChunk(query, fn);
+}
+
+void SceneSystems::Update(EntityWorld& world, SceneGraph& scene, float deltaTime, const Float4x4& viewProj, JobPool* pool)
+{
+	Run(world, mSpinQuery, pool, [deltaTime](const ChunkView& chunk)
+	{
+		SpinEntities(chunk.Get<Spin>(), chunk.Count(), deltaTime);
+	});
+
+	// Entities in the scene graph only set their local matrix here, SetLocal() on
+	// different nodes is safe from several threads
+	Run(world, mLocalQuery, pool, [&scene](const ChunkView& chunk)
+	{
+		const Spin* spin = chunk.Get<Spin>();
+		const Position* position = chunk.Get<Position>();
+		const SceneNode* node = chunk.Get<SceneNode>();
+		WorldTransform* transform = chunk.Get<WorldTransform>();
+		for (int i = 0; i < chunk.Count(); i++)
+		{
+			Float4x4 local = MatrixTranslation(position[i].value.x, position[i].value.y, position[i].value.z);
+			if (spin)
+				local = Multiply(MatrixRotationY(spin[i].angle), local);
+			if (node)
+				scene.SetLocal(node[i].node, local);
+			else
+				transform[i].world = local;
+		}
+	});
+
+	scene.Update(pool);
+	Run(world, mNodeQuery, pool, [&scene](const ChunkView& chunk)
+	{
+		const SceneNode* node = chunk.Get<SceneNode>();
+		WorldTransform* transform = chunk.Get<WorldTransform>();
+		for (int i = 0; i < chunk.Count(); i++)
+			transform[i].world = scene.GetWorld(node[i].node);
+	});
+
+	Plane planes[6];
+	GetFrustumPlanes(viewProj, planes);
+	Run(world, mCullQuery, pool, [&planes](const ChunkView& chunk)
+	{
+		const WorldTransform* transform = chunk.Get<WorldTransform>();
+		const BoundingSphere* bounds = chunk.Get<BoundingSphere>();
+		Visible* visible = chunk.Get<Visible>();
+		for (int i = 0; i < chunk.Count(); i++)
+			visible[i].visible = IsSphereVisible(planes, transform[i].world, bounds[i]);
+	});
+
+	// The occluders are drawn on this thread, the tests run in parallel
+	if (mOcclusion && mOccluderMeshes)
+	{
+		mOcclusion->BeginFrame(viewProj);
+		world.ForEachChunk(mOccluderQuery, [this](const ChunkView& chunk)
+		{
+			const Occluder* occluder = chunk.Get<Occluder>();
+			const WorldTransform* transform = chunk.Get<WorldTransform>();
+			const Visible* visible = chunk.Get<Visible>();
+			for (int i = 0; i < chunk.Count(); i++)
+			{
+				if (visible[i].visible && occluder[i].mesh < mOccluderMeshes->size())
+					mOcclusion->AddOccluder((*mOccluderMeshes)[occluder[i].mesh], transform[i].world);
+			}
+		});
+		mOcclusion->BuildHiZ(pool);
+
+		Run(world, mCullQuery, pool, [this](const ChunkView& chunk)
+		{
+			const WorldTransform* transform = chunk.Get<WorldTransform>();
+			const BoundingSphere* bounds = chunk.Get<BoundingSphere>();
+			Visible* visible = chunk.Get<Visible>();
+			for (int i = 0; i < chunk.Count(); i++)
+			{
+				if (!visible[i].visible)
+					continue;
+				Float3 center;
+				float radius;
+				GetWorldSphere(transform[i].world, bounds[i], center, radius);
+				Float3 extent = { radius, radius, radius };
+				visible[i].visible = mOcclusion->IsBoxVisible(center - extent, center + extent);
+			}
+		});
+		mOcclusion->EndFrame();
+	}
+
+	// Only visible entities change level, hidden ones pick up where they left off
+	if (mLodChains)
+	{
+		Run(world, mLodQuery, pool, [this, &viewProj](const ChunkView& chunk)
+		{
+			LodGroup* lod = chunk.Get<LodGroup>();
+			const WorldTransform* transform = chunk.Get<WorldTransform>();
+			const BoundingSphere* bounds = chunk.Get<BoundingSphere>();
+			const Visible* visible = chunk.Get<Visible>();
+			Renderable* renderable = chunk.Get<Renderable>();
+			for (int i = 0; i < chunk.Count(); i++)
+			{
+				if (!visible[i].visible || lod[i].chain >= mLodChains->size())
+					continue;
+				// clip space w of the bounds' center is its view space depth
+				Float4 center = Mul({ bounds[i].center.x, bounds[i].center.y, bounds[i].center.z, 1.0f }, transform[i].world);
+				float depth = Mul(center, viewProj).w;
+				lod[i].level = SelectLod((*mLodChains)[lod[i].chain], depth, mLodProjection, lod[i].level);
+				renderable[i].mesh = lod[i].firstMesh + lod[i].level;
+			}
+		});
+	}
+
+	// Single threaded so the draw order stays stable from frame to frame
+	mDrawList.clear();
+	mShadowCasters.clear();
+	mCulledCount = 0;
+	world.ForEachChunk(mDrawQuery, [this](const ChunkView& chunk)
+	{
+		const WorldTransform* transform = chunk.Get<WorldTransform>();
+		const Visible* visible = chunk.Get<Visible>();
+		const Renderable* renderable = chunk.Get<Renderable>();
+		for (int i = 0; i < chunk.Count(); i++)
+		{
+			DrawItem item = { transform[i].world, renderable[i].mesh, renderable[i].texture };
+			if (visible[i].visible)
+				mDrawList.push_back(item);
+			else
+				mCulledCount++;
+			mShadowCasters.push_back(item);
+		}
+	});
+}
+
+EcsBenchmarkResult BenchmarkEcs(int entityCount, int iterations)
+{
+	// The baseline: every component of an entity in one struct, plus some data the
+	// systems never touch, as game objects tend to have
+	struct GameObject
+	{
+		Spin spin;
+		Position position;
+		WorldTransform transform;
+		BoundingSphere bounds;
+		Visible visible;
+		Renderable renderable;
+		char name[32];
+		Float4x4 previousWorld;
+	};
+
+	// 90 degree perspective looking down +z, near plane at 0.1
+	Float4x4 viewProj = { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, -0.1f, 0.0f } } };
+	Plane planes[6];
+	GetFrustumPlanes(viewProj, planes);
+
+	std::vector<GameObject> objects(entityCount);
+	EntityWorld world;
+	EntityQuery spinQuery(ComponentMaskOf<Spin>());
+	EntityQuery cullQuery(ComponentMaskOf<WorldTransform, BoundingSphere, Visible>());
+	for (int i = 0; i < entityCount; i++)
+	{
+		Float4x4 transform = MatrixTranslation((float)(i % 100) - 50.0f, 0.0f, (float)(i / 100 % 100));
+		objects[i] = GameObject();
+		objects[i].spin.speed = 1.0f;
+		objects[i].transform.world = transform;
+		objects[i].bounds.radius = 1.0f;
+
+		Entity entity = world.Create<Spin, Position, WorldTransform, BoundingSphere, Visible, Renderable>();
+		world.Get<Spin>(entity)->speed = 1.0f;
+		world.Get<WorldTransform>(entity)->world = transform;
+		world.Get<BoundingSphere>(entity)->radius = 1.0f;
+	}
+
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (GameObject& object : objects)
+			object.spin.angle += object.spin.speed * 0.016f;
+		for (GameObject& object : objects)
+			object.visible.visible = IsSphereVisible(planes, object.transform.world, object.bounds);
+	}
+	double aosUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+	start = Clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		world.ForEachChunk(spinQuery, [](const ChunkView& chunk)
+		{
+			SpinEntities(chunk.Get<Spin>(), chunk.Count(), 0.016f);
+		});
+		world.ForEachChunk(cullQuery, [&planes](const ChunkView& chunk)
+		{
+			const WorldTransform* transform = chunk.Get<WorldTransform>();
+			const BoundingSphere* bounds = chunk.Get<BoundingSphere>();
+			Visible* visible = chunk.Get<Visible>();
+			for (int i = 0; i < chunk.Count(); i++)
+				visible[i].visible = IsSphereVisible(planes, transform[i].world, bounds[i]);
+		});
+	}
+	double ecsUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+	EcsBenchmarkResult result;
+	result.ecsPerUs = (double)entityCount * iterations / ecsUs;
+	result.aosPerUs = (double)entityCount * iterations / aosUs;
+	return result;
+}
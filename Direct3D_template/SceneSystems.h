@@ -0,0 +1,140 @@
+//--------------------------------------------------------------------------------------
+// SceneSystems - the per-frame scene update, as systems over the EntityWorld.
+//
+//   spin        Spin.angle += Spin.speed * dt
+//   transform   local matrix from Spin/Position; entities with a SceneNode go through
+//               the SceneGraph so they inherit their parent's transform
+//   culling     world space BoundingSphere against the view frustum -> Visible
+//   occlusion   optional: visible Occluder meshes are drawn into an OcclusionCuller and
+//               the box around every visible BoundingSphere is tested against it
+//   lod         LodGroup level from the screen space error of its chain, and the
+//               Renderable mesh to match
+//   draw list   one DrawItem per visible Renderable, and one per Renderable, visible
+//               or not, in the shadow caster list: casters out of view can still
+//               shadow what is in view
+//
+// Every system except the draw list and drawing the occluders runs its chunks in
+// parallel on the JobPool.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+
+#include "Ecs.h"
+#include "MathTypes.h"
+#include "MeshLod.h"
+#include "OcclusionCulling.h"
+#include "SceneGraph.h"
+
+// Components
+struct Spin
+{
+	float angle;	// radians around y
+	float speed;	// radians per second
+};
+
+struct Position
+{
+	Float3 value;
+};
+
+struct SceneNode
+{
+	NodeId node;
+};
+
+struct WorldTransform
+{
+	Float4x4 world;
+};
+
+struct BoundingSphere
+{
+	Float3 center;	// local space
+	float radius;
+};
+
+struct Visible
+{
+	int visible;
+};
+
+// Ids into the renderer's mesh and texture tables
+struct Renderable
+{
+	unsigned int mesh;
+	unsigned int texture;
+};
+
+// The levels of chain 'chain' are meshes firstMesh, firstMesh + 1, ...
+struct LodGroup
+{
+	unsigned int chain;
+	unsigned int firstMesh;
+	int level;
+};
+
+// Drawn into the occlusion buffer while visible, see SetOcclusion()
+struct Occluder
+{
+	unsigned int mesh;	// into the occluder mesh table
+};
+
+struct DrawItem
+{
+	Float4x4 world;
+	unsigned int mesh;
+	unsigned int texture;
+};
+
+// Throughput of the spin + culling systems against the same loops over an array of
+// structs holding every component, in entities per microsecond
+struct EcsBenchmarkResult
+{
+	double ecsPerUs;
+	double aosPerUs;
+};
+
+class SceneSystems
+{
+public:
+	SceneSystems();
+
+	// 'viewProj' is row-major (clip = v * viewProj), like the matrices in MathTypes.h
+	void Update(EntityWorld& world, SceneGraph& scene, float deltaTime, const Float4x4& viewProj, JobPool* pool);
+
+	// Chains for LodGroup, kept by the caller. 'projection' should match viewProj.
+	void SetLodChains(const std::vector<LodChain>* chains, const LodProjection& projection);
+
+	// Occlusion culling after the frustum, with meshes for Occluder, both kept by the
+	// caller. A null 'culler' turns it off.
+	void SetOcclusion(OcclusionCuller* culler, const std::vector<IndexedMesh>* occluderMeshes);
+
+	const std::vector<DrawItem>& GetDrawList() const { return mDrawList; }
+	const std::vector<DrawItem>& GetShadowCasters() const { return mShadowCasters; }
+	int GetCulledCount() const { return mCulledCount; }
+
+private:
+	void Run(EntityWorld& world, EntityQuery& query, JobPool* pool, const std::function<void(const ChunkView&)>& fn);
+
+	EntityQuery mSpinQuery;
+	EntityQuery mLocalQuery;
+	EntityQuery mNodeQuery;
+	EntityQuery mCullQuery;
+	EntityQuery mOccluderQuery;
+	EntityQuery mLodQuery;
+	EntityQuery mDrawQuery;
+
+	const std::vector<LodChain>* mLodChains = nullptr;
+	LodProjection mLodProjection = {};
+
+	OcclusionCuller* mOcclusion = nullptr;
+	const std::vector<IndexedMesh>* mOccluderMeshes = nullptr;
+
+	std::vector<DrawItem> mDrawList;
+	std::vector<DrawItem> mShadowCasters;
+	int mCulledCount = 0;
+};
+
+// Runs both versions over 'entityCount' entities, single threaded
+EcsBenchmarkResult BenchmarkEcs(int entityCount, int iterations = 10);
@@ -0,0 +1,264 @@
+#include "ShaderCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <set>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MakeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MakeDirectory(path) mkdir(path, 0755)
+#endif
+
+// Bumped when the file layout below changes
+static const unsigned int CACHE_MAGIC = 0x31434853; // "SHC1"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double ElapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//--------------------------------------------------------------------------------------
+// FNV-1a, 64 bit. Every field is hashed with its length first so that
+// e.g. ("AB","C") and ("A","BC") give different keys.
+//--------------------------------------------------------------------------------------
+static void HashBytes(unsigned long long& hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+static void HashString(unsigned long long& hash, const std::string& str)
+{
+	unsigned long long size = str.size();
+	HashBytes(hash, &size, sizeof(size));
+	HashBytes(hash, str.data(), str.size());
+}
+
+bool ReadFileContents(const std::string& path, std::string& contents)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	contents.resize(size > 0 ? (size_t)size : 0);
+	size_t read = size > 0 ? fread(&contents[0], 1, (size_t)size, file) : 0;
+	fclose(file);
+	return read == contents.size();
+}
+
+static std::string DirectoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Hashes the contents of every file pulled in with #include, depth first.
+// Includes are looked up next to the file that includes them, like the
+// standard D3D include handler does. Conditional includes are hashed too,
+// which at worst causes an unnecessary recompile.
+static bool HashIncludes(unsigned long long& hash, const std::string& path, const std::string& source, std::set<std::string>& visited)
+{
+	size_t pos = 0;
+	while ((pos = source.find("#include", pos)) != std::string::npos)
+	{
+		pos += 8;
+		size_t open = source.find_first_of("\"<\n", pos);
+		if (open == std::string::npos || source[open] == '\n')
+			continue;
+		size_t close = source.find_first_of(source[open] == '"' ? "\"\n" : ">\n", open + 1);
+		if (close == std::string::npos || source[close] == '\n')
+			continue;
+
+		std::string includePath = DirectoryOf(path) + source.substr(open + 1, close - open - 1);
+		if (!visited.insert(includePath).second)
+			continue;
+
+		std::string includeSource;
+		if (!ReadFileContents(includePath, includeSource))
+			return false;
+		HashString(hash, includePath);
+		HashString(hash, includeSource);
+		if (!HashIncludes(hash, includePath, includeSource, visited))
+			return false;
+	}
+	return true;
+}
+
+ShaderCache::ShaderCache(const std::string& directory, ShaderCompileFunc compile, const std::string& salt)
+	: mDirectory(directory), mSalt(salt), mCompile(compile)
+{
+	if (!mDirectory.empty())
+		MakeDirectory(mDirectory.c_str());
+}
+
+bool ShaderCache::Hash(const ShaderDesc& desc, unsigned long long* hash, std::string* source) const
+{
+	std::string contents;
+	if (!ReadFileContents(desc.path, contents))
+		return false;
+
+	unsigned long long h = 14695981039346656037ULL;
+	HashString(h, mSalt);
+	HashString(h, desc.path);
+	HashString(h, contents);
+	std::set<std::string> visited;
+	if (!HashIncludes(h, desc.path, contents, visited))
+		return false;
+	for (size_t i = 0; i < desc.defines.size(); i++)
+	{
+		HashString(h, desc.defines[i].name);
+		HashString(h, desc.defines[i].definition);
+	}
+	HashString(h, desc.entryPoint);
+	HashString(h, desc.target);
+	HashBytes(h, &desc.flags, sizeof(desc.flags));
+
+	*hash = h;
+	if (source)
+		source->swap(contents);
+	return true;
+}
+
+bool ShaderCache::Get(const ShaderDesc& desc, std::vector<char>& bytecode, std::string* errors)
+{
+	Clock::time_point start = Clock::now();
+	unsigned long long hash = 0;
+	std::string source;
+	bool hashed = Hash(desc, &hash, &source);
+	double hashMs = ElapsedMs(start);
+
+	if (!hashed)
+	{
+		if (errors)
+			*errors = "ShaderCache: could not read " + desc.path + " or one of its includes\n";
+		std::lock_guard<std::mutex> lock(mStatsMutex);
+		mStats.hashMs += hashMs;
+		mStats.failures++;
+		return false;
+	}
+
+	start = Clock::now();
+	bool hit = Load(hash, bytecode);
+	double loadMs = ElapsedMs(start);
+	if (hit)
+	{
+		std::lock_guard<std::mutex> lock(mStatsMutex);
+		mStats.hashMs += hashMs;
+		mStats.loadMs += loadMs;
+		mStats.hits++;
+		return true;
+	}
+
+	start = Clock::now();
+	std::string compileErrors;
+	bool compiled = mCompile(desc, source, bytecode, compileErrors);
+	double compileMs = ElapsedMs(start);
+	if (compiled)
+		Store(hash, bytecode);
+	else if (errors)
+		*errors = compileErrors;
+
+	std::lock_guard<std::mutex> lock(mStatsMutex);
+	mStats.hashMs += hashMs;
+	mStats.loadMs += loadMs;
+	mStats.compileMs += compileMs;
+	mStats.misses++;
+	if (!compiled)
+		mStats.failures++;
+	return compiled;
+}
+
+ShaderCacheStats ShaderCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mStatsMutex);
+	return mStats;
+}
+
+void ShaderCache::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(mStatsMutex);
+	mStats = ShaderCacheStats();
+}
+
+std::string ShaderCache::CachePath(unsigned long long hash) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.cso", hash);
+	return mDirectory.empty() ? std::string(name) : mDirectory + "/" + name;
+}
+
+// File layout: magic, hash, size, bytecode.
+// The hash is stored again so a truncated or foreign file is never used.
+bool ShaderCache::Load(unsigned long long hash, std::vector<char>& bytecode) const
+{
+	FILE* file = fopen(CachePath(hash).c_str(), "rb");
+	if (!file)
+		return false;
+
+	unsigned int magic = 0, size = 0;
+	unsigned long long storedHash = 0;
+	bool ok = fread(&magic, sizeof(magic), 1, file) == 1 && magic == CACHE_MAGIC
+		&& fread(&storedHash, sizeof(storedHash), 1, file) == 1 && storedHash == hash
+		&& fread(&size, sizeof(size), 1, file) == 1 && size > 0;
+	if (ok)
+	{
+		bytecode.resize(size);
+		ok = fread(bytecode.data(), 1, size, file) == size;
+	}
+	fclose(file);
+	return ok;
+}
+
+// Written to a temporary file first so another process never sees half a file.
+bool ShaderCache::Store(unsigned long long hash, const std::vector<char>& bytecode) const
+{
+	std::string path = CachePath(hash);
+	// unique per thread, the same shader may be compiled by two jobs at once
+	std::string tempPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	FILE* file = fopen(tempPath.c_str(), "wb");
+	if (!file)
+		return false;
+
+	unsigned int magic = CACHE_MAGIC;
+	unsigned int size = (unsigned int)bytecode.size();
+	bool ok = fwrite(&magic, sizeof(magic), 1, file) == 1
+		&& fwrite(&hash, sizeof(hash), 1, file) == 1
+		&& fwrite(&size, sizeof(size), 1, file) == 1
+		&& fwrite(bytecode.data(), 1, size, file) == size;
+	ok = fclose(file) == 0 && ok;
+
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(tempPath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+		remove(tempPath.c_str());
+	return ok;
+}
+
+JobId SubmitShaderCompile(JobPool& pool, ShaderCache& cache, ShaderCompileJob& compile)
+{
+	ShaderCompileJob* target = &compile;
+	ShaderCache* shaderCache = &cache;
+	compile.job = pool.Submit(compile.desc.path + " " + compile.desc.entryPoint, [target, shaderCache]
+	{
+		target->succeeded = shaderCache->Get(target->desc, target->bytecode, &target->errors);
+	});
+	return compile.job;
+}
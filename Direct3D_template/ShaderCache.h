@@ -0,0 +1,95 @@
+//--------------------------------------------------------------------------------------
+// ShaderCache - keeps compiled shader bytecode on disk so shaders only get compiled
+// when something that affects the output changed.
+//
+// The key is a 64-bit hash of the shader source, the contents of every file it
+// #includes, the defines, entry point, target profile and compile flags.
+// The compiler itself is passed in as a function, so this file does not depend
+// on d3dcompiler and can be driven by any stand-in compiler.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "JobPool.h"
+
+struct ShaderMacro
+{
+	std::string name;
+	std::string definition;
+};
+
+struct ShaderDesc
+{
+	std::string path;			// e.g. "Vertex.hlsl"
+	std::string entryPoint;		// e.g. "VS_main"
+	std::string target;			// e.g. "vs_5_0"
+	std::vector<ShaderMacro> defines;
+	unsigned int flags = 0;		// D3DCOMPILE_xxx
+};
+
+// Compiles 'source' (the contents of desc.path) into 'bytecode'.
+// On failure returns false and fills 'errors'.
+typedef bool (*ShaderCompileFunc)(const ShaderDesc& desc, const std::string& source, std::vector<char>& bytecode, std::string& errors);
+
+struct ShaderCacheStats
+{
+	int hits = 0;			// loaded from disk
+	int misses = 0;			// had to compile
+	int failures = 0;		// missing source or compile error
+	double hashMs = 0.0;	// reading and hashing sources
+	double loadMs = 0.0;	// reading cached bytecode
+	double compileMs = 0.0;	// time inside the compile function
+};
+
+class ShaderCache
+{
+public:
+	// directory: where .cso files are stored, created if missing.
+	// salt: anything else that should invalidate the cache (e.g. the compiler version).
+	ShaderCache(const std::string& directory, ShaderCompileFunc compile, const std::string& salt = "");
+
+	// Fills 'bytecode' from the cache, compiling and storing it on a miss.
+	// Safe to call from several threads at once.
+	bool Get(const ShaderDesc& desc, std::vector<char>& bytecode, std::string* errors = nullptr);
+
+	// Hash of everything that affects the compiled output. Returns false if the
+	// source (or one of its includes) could not be read. 'source' receives the
+	// contents of desc.path so it does not have to be read twice.
+	bool Hash(const ShaderDesc& desc, unsigned long long* hash, std::string* source = nullptr) const;
+
+	ShaderCacheStats GetStats() const;
+	void ResetStats();
+
+private:
+	std::string CachePath(unsigned long long hash) const;
+	bool Load(unsigned long long hash, std::vector<char>& bytecode) const;
+	bool Store(unsigned long long hash, const std::vector<char>& bytecode) const;
+
+	std::string mDirectory;
+	std::string mSalt;
+	ShaderCompileFunc mCompile;
+
+	mutable std::mutex mStatsMutex;
+	ShaderCacheStats mStats;
+};
+
+// One shader compiled (or loaded) on a JobPool, see SubmitShaderCompile().
+struct ShaderCompileJob
+{
+	ShaderDesc desc;
+	std::vector<char> bytecode;
+	std::string errors;
+	bool succeeded = false;
+	JobId job = 0;
+};
+
+// Queues cache.Get() for 'compile' on the pool and stores the job id in compile.job,
+// so other work (e.g. creating an input layout) can depend on just this shader.
+// 'compile' must stay alive until the job finished.
+JobId SubmitShaderCompile(JobPool& pool, ShaderCache& cache, ShaderCompileJob& compile);
+
+// Reads a whole file, returns false if it could not be opened.
+bool ReadFileContents(const std::string& path, std::string& contents);
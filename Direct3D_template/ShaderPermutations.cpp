@@ -0,0 +1,184 @@
+#include "ShaderPermutations.h"
+
+void GetShaderDefines(ShaderKey key, std::vector<ShaderMacro>& defines)
+{
+	defines.push_back({ "EXTRUDE", KeyExtrude(key) ? "1" : "0" });
+	defines.push_back({ "TEXTURED", KeyTextured(key) ? "1" : "0" });
+	defines.push_back({ "LIGHTING_MODEL", std::to_string(KeyLightingModel(key)) });
+	defines.push_back({ "LIGHT_COUNT", std::to_string(KeyLightCount(key)) });
+	defines.push_back({ "CLUSTERED", KeyClustered(key) ? "1" : "0" });
+	defines.push_back({ "SHADOWS", KeyShadowed(key) ? "1" : "0" });
+	defines.push_back({ "MAX_LIGHTS", std::to_string(SHADER_MAX_LIGHTS) });
+	defines.push_back({ "MAX_CASCADES", std::to_string(SHADOW_MAX_CASCADES) });
+}
+
+ShaderPermutations::ShaderPermutations(ShaderCache& cache, JobPool& pool, const ShaderDesc& base, ShaderKey mask,
+	ShaderCreateFunc create, ShaderReleaseFunc release)
+	: mCache(cache), mPool(pool), mBase(base), mMask(mask), mCreate(create), mRelease(release),
+	mPermutations(new Permutation[SHADER_KEY_COUNT])
+{
+	for (int i = 0; i < SHADER_KEY_COUNT; i++)
+	{
+		mPermutations[i].state = NOT_REQUESTED;
+		mPermutations[i].reloadState = NOT_REQUESTED;
+	}
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+	ReleaseShaders();
+}
+
+// Compiles 'compile' on the pool, creates the object and then publishes 'state'.
+// 'compile' and 'shader' belong to the job until 'state' leaves COMPILING.
+void ShaderPermutations::SubmitCompile(ShaderKey key, ShaderCompileJob& compile, void** shader, std::atomic<int>& state)
+{
+	// Only the defines this stage cares about go into the desc (and the cache key),
+	// MAX_LIGHTS changes the constant buffer layout so every stage gets it.
+	compile.desc = mBase;
+	std::vector<ShaderMacro> defines;
+	GetShaderDefines(key, defines);
+	for (const ShaderMacro& define : defines)
+	{
+		bool used = define.name == "MAX_LIGHTS" || define.name == "MAX_CASCADES"
+			|| (define.name == "EXTRUDE" && (mMask & SHADER_KEY_EXTRUDE))
+			|| (define.name == "TEXTURED" && (mMask & SHADER_KEY_TEXTURED))
+			|| (define.name == "LIGHTING_MODEL" && (mMask & SHADER_KEY_LIGHTING_MASK))
+			|| (define.name == "LIGHT_COUNT" && (mMask & SHADER_KEY_LIGHT_COUNT_MASK))
+			|| (define.name == "CLUSTERED" && (mMask & SHADER_KEY_CLUSTERED))
+			|| (define.name == "SHADOWS" && (mMask & SHADER_KEY_SHADOWED));
+		if (used)
+			compile.desc.defines.push_back(define);
+	}
+
+	state.store(COMPILING, std::memory_order_relaxed);
+	ShaderCompileJob* target = &compile;
+	std::atomic<int>* targetState = &state;
+	ShaderCache* cache = &mCache;
+	ShaderCreateFunc create = mCreate;
+	compile.job = mPool.Submit(mBase.path + " #" + std::to_string(key), [target, shader, targetState, cache, create]
+	{
+		target->succeeded = cache->Get(target->desc, target->bytecode, &target->errors);
+		if (target->succeeded && create)
+			*shader = create(target->bytecode);
+		targetState->store(target->succeeded ? READY : FAILED, std::memory_order_release);
+	});
+}
+
+const std::vector<char>* ShaderPermutations::Get(ShaderKey key)
+{
+	key &= mMask;
+	Permutation& permutation = mPermutations[key];
+
+	int state = permutation.state.load(std::memory_order_acquire);
+	if (state == READY)
+		return &permutation.compile.bytecode;
+	if (state == NOT_REQUESTED)
+		SubmitCompile(key, permutation.compile, &permutation.shader, permutation.state);
+	return nullptr;
+}
+
+const std::vector<char>* ShaderPermutations::GetBlocking(ShaderKey key)
+{
+	const std::vector<char>* bytecode = Get(key);
+	if (bytecode)
+		return bytecode;
+
+	Permutation& permutation = mPermutations[key & mMask];
+	mPool.Wait(permutation.compile.job);
+	return permutation.state.load(std::memory_order_acquire) == READY ? &permutation.compile.bytecode : nullptr;
+}
+
+void* ShaderPermutations::GetShader(ShaderKey key)
+{
+	return Get(key) ? mPermutations[key & mMask].shader : nullptr;
+}
+
+std::string ShaderPermutations::GetErrors(ShaderKey key) const
+{
+	const Permutation& permutation = mPermutations[key & mMask];
+	return permutation.state.load(std::memory_order_acquire) == FAILED ? permutation.compile.errors : std::string();
+}
+
+void ShaderPermutations::Reload()
+{
+	for (int key = 0; key < SHADER_KEY_COUNT; key++)
+	{
+		Permutation& permutation = mPermutations[key];
+		int state = permutation.state.load(std::memory_order_acquire);
+		if (state != READY && state != FAILED)
+			continue;
+
+		// ApplyReloads() starts it again once the running one is swapped in
+		if (permutation.reloadState.load(std::memory_order_acquire) != NOT_REQUESTED)
+		{
+			permutation.reloadAgain = true;
+			continue;
+		}
+
+		permutation.reload = ShaderCompileJob();
+		permutation.reloadShader = nullptr;
+		SubmitCompile(key, permutation.reload, &permutation.reloadShader, permutation.reloadState);
+	}
+}
+
+int ShaderPermutations::ApplyReloads(std::string* errors)
+{
+	int swapped = 0;
+	bool reloadAgain = false;
+	for (int key = 0; key < SHADER_KEY_COUNT; key++)
+	{
+		Permutation& permutation = mPermutations[key];
+		int reloadState = permutation.reloadState.load(std::memory_order_acquire);
+		if (reloadState != READY && reloadState != FAILED)
+			continue;
+
+		if (reloadState == READY)
+		{
+			if (permutation.shader && mRelease)
+				mRelease(permutation.shader);
+			permutation.shader = permutation.reloadShader;
+			permutation.compile.bytecode.swap(permutation.reload.bytecode);
+			permutation.compile.errors.clear();
+			permutation.state.store(READY, std::memory_order_release);
+			swapped++;
+		}
+		else if (errors)
+		{
+			*errors += permutation.reload.errors;
+		}
+
+		permutation.reload = ShaderCompileJob();
+		permutation.reloadShader = nullptr;
+		permutation.reloadState.store(NOT_REQUESTED, std::memory_order_release);
+		reloadAgain |= permutation.reloadAgain;
+		permutation.reloadAgain = false;
+	}
+
+	if (reloadAgain)
+		Reload();
+	return swapped;
+}
+
+void ShaderPermutations::ReleaseShaders()
+{
+	for (int i = 0; i < SHADER_KEY_COUNT; i++)
+	{
+		// jobs still running would create objects after this
+		Permutation& permutation = mPermutations[i];
+		if (permutation.state.load() == COMPILING)
+			mPool.Wait(permutation.compile.job);
+		if (permutation.reloadState.load() == COMPILING)
+			mPool.Wait(permutation.reload.job);
+
+		if (mRelease)
+		{
+			if (permutation.shader)
+				mRelease(permutation.shader);
+			if (permutation.reloadShader)
+				mRelease(permutation.reloadShader);
+		}
+		permutation.shader = nullptr;
+		permutation.reloadShader = nullptr;
+	}
+}
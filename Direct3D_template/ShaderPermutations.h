@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// ShaderPermutations - compile-time feature flags for the scene shaders.
+//
+// Every combination of features is a ShaderKey, a small bitmask that doubles as an
+// array index. The key is turned into #defines (EXTRUDE, TEXTURED, LIGHTING_MODEL,
+// LIGHT_COUNT, CLUSTERED, SHADOWS) and each permutation is compiled the first time it is asked for,
+// on the JobPool and through the ShaderCache.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "JobPool.h"
+#include "ShaderCache.h"
+
+enum LightingModel
+{
+	LIGHTING_UNLIT = 0,
+	LIGHTING_LAMBERT = 1,
+	LIGHTING_HALF_LAMBERT = 2,
+};
+
+// Size of the light arrays in the light constant buffer (MAX_LIGHTS in Fragment.hlsl)
+static const int SHADER_MAX_LIGHTS = 4;
+
+// Size of the cascade array in the shadow constant buffer (MAX_CASCADES in Fragment.hlsl)
+static const int SHADOW_MAX_CASCADES = 4;
+
+// Key layout:
+//   bit  0    EXTRUDE          geometry shader
+//   bit  1    TEXTURED         pixel shader
+//   bits 2-3  LIGHTING_MODEL   pixel shader
+//   bits 4-6  LIGHT_COUNT      pixel shader
+//   bit  7    CLUSTERED        pixel shader, lights come from the cluster lists instead
+//                              of the constant buffer and LIGHT_COUNT is unused
+//   bit  8    SHADOWS          pixel shader, light 0 is a sun shining from lightPos[0]
+//                              towards the origin, shadowed by cascaded shadow maps
+typedef unsigned int ShaderKey;
+
+static const ShaderKey SHADER_KEY_EXTRUDE = 1 << 0;
+static const ShaderKey SHADER_KEY_TEXTURED = 1 << 1;
+static const int SHADER_KEY_LIGHTING_SHIFT = 2;
+static const ShaderKey SHADER_KEY_LIGHTING_MASK = 3 << SHADER_KEY_LIGHTING_SHIFT;
+static const int SHADER_KEY_LIGHT_COUNT_SHIFT = 4;
+static const ShaderKey SHADER_KEY_LIGHT_COUNT_MASK = 7 << SHADER_KEY_LIGHT_COUNT_SHIFT;
+static const ShaderKey SHADER_KEY_CLUSTERED = 1 << 7;
+static const ShaderKey SHADER_KEY_SHADOWED = 1 << 8;
+static const int SHADER_KEY_COUNT = 1 << 9;
+
+// Bits each stage actually reads, permutations that only differ elsewhere share bytecode
+static const ShaderKey SHADER_KEY_GS_MASK = SHADER_KEY_EXTRUDE;
+static const ShaderKey SHADER_KEY_PS_MASK = SHADER_KEY_TEXTURED | SHADER_KEY_LIGHTING_MASK | SHADER_KEY_LIGHT_COUNT_MASK | SHADER_KEY_CLUSTERED | SHADER_KEY_SHADOWED;
+
+// A clustered key always has a light count of 0 so it maps to a single permutation, and
+// no shadows since it doesn't use light 0
+constexpr ShaderKey MakeShaderKey(bool extrude, bool textured, int lightingModel, int lightCount, bool clustered = false, bool shadowed = false)
+{
+	return (extrude ? SHADER_KEY_EXTRUDE : 0)
+		| (textured ? SHADER_KEY_TEXTURED : 0)
+		| (((ShaderKey)lightingModel << SHADER_KEY_LIGHTING_SHIFT) & SHADER_KEY_LIGHTING_MASK)
+		| (clustered ? SHADER_KEY_CLUSTERED
+			: (ShaderKey)(lightCount < 0 ? 0 : (lightCount > SHADER_MAX_LIGHTS ? SHADER_MAX_LIGHTS : lightCount)) << SHADER_KEY_LIGHT_COUNT_SHIFT)
+		| (shadowed && !clustered ? SHADER_KEY_SHADOWED : 0);
+}
+
+constexpr bool KeyExtrude(ShaderKey key) { return (key & SHADER_KEY_EXTRUDE) != 0; }
+constexpr bool KeyTextured(ShaderKey key) { return (key & SHADER_KEY_TEXTURED) != 0; }
+constexpr int KeyLightingModel(ShaderKey key) { return (int)((key & SHADER_KEY_LIGHTING_MASK) >> SHADER_KEY_LIGHTING_SHIFT); }
+constexpr bool KeyClustered(ShaderKey key) { return (key & SHADER_KEY_CLUSTERED) != 0; }
+constexpr bool KeyShadowed(ShaderKey key) { return (key & SHADER_KEY_SHADOWED) != 0; }
+constexpr int KeyLightCount(ShaderKey key)
+{
+	return (int)((key & SHADER_KEY_LIGHT_COUNT_MASK) >> SHADER_KEY_LIGHT_COUNT_SHIFT) > SHADER_MAX_LIGHTS
+		? SHADER_MAX_LIGHTS : (int)((key & SHADER_KEY_LIGHT_COUNT_MASK) >> SHADER_KEY_LIGHT_COUNT_SHIFT);
+}
+
+// The #defines for the bits in 'key', MAX_LIGHTS and MAX_CASCADES are always set.
+void GetShaderDefines(ShaderKey key, std::vector<ShaderMacro>& defines);
+
+// Creates the API object (e.g. an ID3D11PixelShader) from bytecode. Runs on a JobPool
+// worker right after compiling, so the render thread never waits for it.
+typedef void* (*ShaderCreateFunc)(const std::vector<char>& bytecode);
+typedef void (*ShaderReleaseFunc)(void* shader);
+
+class ShaderPermutations
+{
+public:
+	// Permutations of 'base' that differ in the key bits in 'mask', other bits are ignored.
+	// 'create'/'release' are optional, without them GetShader() always returns nullptr.
+	ShaderPermutations(ShaderCache& cache, JobPool& pool, const ShaderDesc& base, ShaderKey mask,
+		ShaderCreateFunc create = nullptr, ShaderReleaseFunc release = nullptr);
+	~ShaderPermutations();
+
+	// Bytecode for the key, or nullptr while it is still compiling (or failed).
+	// The first call for a key queues the compile. Meant to be called from one thread.
+	const std::vector<char>* Get(ShaderKey key);
+
+	// Like Get(), but waits for the compile to finish.
+	const std::vector<char>* GetBlocking(ShaderKey key);
+
+	// The object made by 'create' for the key, nullptr while compiling. Same rules as Get().
+	void* GetShader(ShaderKey key);
+
+	// Compile errors for a permutation that failed, empty otherwise.
+	std::string GetErrors(ShaderKey key) const;
+
+	// Recompiles every permutation requested so far in the background, e.g. after the
+	// source changed on disk. Results are kept aside until ApplyReloads().
+	void Reload();
+
+	// Call on the render thread between frames. Swaps in reloaded permutations that
+	// finished compiling and releases the old objects; a permutation that fails to
+	// compile keeps its old version and its errors are appended to 'errors'.
+	// Returns the number of permutations swapped.
+	int ApplyReloads(std::string* errors = nullptr);
+
+	// Releases all objects, call before the device goes away.
+	void ReleaseShaders();
+
+private:
+	enum State
+	{
+		NOT_REQUESTED,
+		COMPILING,
+		READY,
+		FAILED,
+	};
+
+	struct Permutation
+	{
+		std::atomic<int> state;
+		ShaderCompileJob compile;
+		void* shader = nullptr;
+
+		// Reload() results waiting for ApplyReloads()
+		std::atomic<int> reloadState;
+		ShaderCompileJob reload;
+		void* reloadShader = nullptr;
+		bool reloadAgain = false;	// Reload() was called while a reload was compiling
+	};
+
+	void SubmitCompile(ShaderKey key, ShaderCompileJob& compile, void** shader, std::atomic<int>& state);
+
+	ShaderCache& mCache;
+	JobPool& mPool;
+	ShaderDesc mBase;
+	ShaderKey mMask;
+	ShaderCreateFunc mCreate;
+	ShaderReleaseFunc mRelease;
+	std::unique_ptr<Permutation[]> mPermutations;
+};
@@ -0,0 +1,191 @@
+#include "ShadowMaps.h"
+#include "CpuShading.h"
+#include "DepthRasterizer.h"
+#include "JobPool.h"
+#include "SceneSystems.h"
+
+#include <float.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+	// World position of a view space point, for a view matrix without scaling
+	Float3 ViewToWorld(const Float4x4& view, Float3 p)
+	{
+		// p = world * R + t, and the inverse of R is its transpose
+		Float3 d = { p.x - view.m[3][0], p.y - view.m[3][1], p.z - view.m[3][2] };
+		return {
+			d.x * view.m[0][0] + d.y * view.m[0][1] + d.z * view.m[0][2],
+			d.x * view.m[1][0] + d.y * view.m[1][1] + d.z * view.m[1][2],
+			d.x * view.m[2][0] + d.y * view.m[2][1] + d.z * view.m[2][2],
+		};
+	}
+}
+
+void ComputeShadowCascades(const Float4x4& view, float fovY, float aspect, float nearZ, float farZ,
+	Float3 lightDirection, const ShadowSettings& settings, ShadowConstants& constants)
+{
+	int count = std::max(1, std::min(settings.cascadeCount, SHADOW_MAX_CASCADES));
+	float tanY = tanf(fovY * 0.5f);
+	float tanX = tanY * aspect;
+	float slopeSq = tanX * tanX + tanY * tanY;	// of the frustum's corner edges
+
+	// Light space axes, like XMMatrixLookToLH
+	Float3 forward = Normalize(lightDirection);
+	Float3 up = fabsf(forward.y) > 0.99f ? Float3{ 1.0f, 0.0f, 0.0f } : Float3{ 0.0f, 1.0f, 0.0f };
+	Float3 right = Normalize(Cross(up, forward));
+	up = Cross(forward, right);
+
+	constants = {};
+	constants.cascadeCount = (unsigned int)count;
+	constants.texelSize = 1.0f / settings.mapSize;
+	float sliceNear = nearZ;
+	for (int i = 0; i < SHADOW_MAX_CASCADES; i++)
+	{
+		if (i >= count)
+		{
+			constants.cascadeSplits[i] = FLT_MAX;
+			continue;
+		}
+		float t = (float)(i + 1) / count;
+		float sliceFar = settings.splitLambda * nearZ * powf(farZ / nearZ, t) + (1.0f - settings.splitLambda) * (nearZ + (farZ - nearZ) * t);
+		constants.cascadeSplits[i] = sliceFar;
+
+		// Smallest sphere around the slice's corners: on the view axis, as far from the
+		// near corners as from the far ones (or at the far plane for wide slices)
+		float centerZ = std::min(0.5f * (1.0f + slopeSq) * (sliceNear + sliceFar), sliceFar);
+		float nearDistanceSq = sliceNear * sliceNear * slopeSq + (centerZ - sliceNear) * (centerZ - sliceNear);
+		float farDistanceSq = sliceFar * sliceFar * slopeSq + (sliceFar - centerZ) * (sliceFar - centerZ);
+		float radius = sqrtf(std::max(nearDistanceSq, farDistanceSq));
+		Float3 center = ViewToWorld(view, { 0.0f, 0.0f, centerZ });
+
+		// Two texels of border for the snapping and the PCF taps
+		float texel = 2.0f * radius / (settings.mapSize - 4);
+		float halfWidth = 0.5f * texel * settings.mapSize;
+		float centerX = floorf(Dot(center, right) / texel) * texel;
+		float centerY = floorf(Dot(center, up) / texel) * texel;
+		float minDepth = Dot(center, forward) - radius - settings.casterDistance;
+		float depthRange = 2.0f * radius + settings.casterDistance;
+
+		ShadowCascade& cascade = constants.cascades[i];
+		cascade.viewProj = { {
+			{ right.x / halfWidth, up.x / halfWidth, forward.x / depthRange, 0.0f },
+			{ right.y / halfWidth, up.y / halfWidth, forward.y / depthRange, 0.0f },
+			{ right.z / halfWidth, up.z / halfWidth, forward.z / depthRange, 0.0f },
+			{ -centerX / halfWidth, -centerY / halfWidth, -minDepth / depthRange, 1.0f },
+		} };
+		cascade.depthBias = settings.depthBiasTexels * texel / depthRange;
+		cascade.normalOffset = settings.normalOffsetTexels * texel;
+		sliceNear = sliceFar;
+	}
+}
+
+void CpuShadowMaps::Render(const ShadowConstants& constants, int mapSize, const DrawItem* casters, int casterCount,
+	const std::vector<IndexedMesh>& meshes, ShaderKey key, JobPool* pool)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	mMapSize = mapSize;
+	CpuGeometryShader geometryShader = GetCpuGeometryShader(key);
+	std::atomic<int> triangles(0);
+	auto renderCascade = [&](int cascade)
+	{
+		std::vector<float>& depth = mDepth[cascade];
+		depth.assign(mapSize * mapSize, 1.0f);
+		int drawn = 0;
+		for (int i = 0; i < casterCount; i++)
+		{
+			const DrawItem& caster = casters[i];
+			if (caster.mesh >= meshes.size())
+				continue;
+			const IndexedMesh& mesh = meshes[caster.mesh];
+			Float4x4 worldViewProj = Multiply(caster.world, constants.cascades[cascade].viewProj);
+			for (size_t j = 0; j + 2 < mesh.indices.size(); j += 3)
+			{
+				CpuVertex input[3];
+				for (int k = 0; k < 3; k++)
+				{
+					const MeshVertex& vertex = mesh.vertices[mesh.indices[j + k]];
+					input[k] = { { vertex.position.x, vertex.position.y, vertex.position.z, 1.0f }, vertex.u, vertex.v };
+				}
+				CpuFragment output[6];
+				int count = geometryShader(input, caster.world, worldViewProj, output);
+				for (int k = 0; k + 2 < count; k += 3)
+					drawn += RasterizeDepthTriangle(depth.data(), mapSize, mapSize, output[k].pos, output[k + 1].pos, output[k + 2].pos);
+			}
+		}
+		triangles += drawn;
+	};
+
+	int cascadeCount = (int)constants.cascadeCount;
+	if (pool && cascadeCount > 1)
+	{
+		pool->ParallelFor(cascadeCount, 1, [&renderCascade](int begin, int end)
+		{
+			for (int cascade = begin; cascade < end; cascade++)
+				renderCascade(cascade);
+		});
+	}
+	else
+	{
+		for (int cascade = 0; cascade < cascadeCount; cascade++)
+			renderCascade(cascade);
+	}
+	mTriangles = triangles;
+
+	mRenderMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+float CpuShadowMaps::SampleCompare(int cascade, float u, float v, float depth) const
+{
+	// texel centers are at (i + 0.5) / size, outside the map is the border depth
+	float x = u * mMapSize - 0.5f;
+	float y = v * mMapSize - 0.5f;
+	int x0 = (int)floorf(x);
+	int y0 = (int)floorf(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	const std::vector<float>& map = mDepth[cascade];
+	float lit = 0.0f;
+	for (int j = 0; j < 2; j++)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			int tx = x0 + i;
+			int ty = y0 + j;
+			bool inside = tx >= 0 && ty >= 0 && tx < mMapSize && ty < mMapSize;
+			float texel = inside ? map[ty * mMapSize + tx] : 1.0f;
+			float weight = (i ? fx : 1.0f - fx) * (j ? fy : 1.0f - fy);
+			lit += depth <= texel ? weight : 0.0f;
+		}
+	}
+	return lit;
+}
+
+float ShadowFactor(const ShadowConstants& constants, const CpuShadowMaps& maps, Float3 worldPos, Float3 normal, float viewDepth)
+{
+	// the first cascade reaching past the fragment, the last one for anything beyond
+	unsigned int cascade = 0;
+	for (int i = 0; i < SHADOW_MAX_CASCADES; i++)
+		cascade += viewDepth > constants.cascadeSplits[i] ? 1 : 0;
+	cascade = std::min(cascade, constants.cascadeCount - 1);
+
+	const ShadowCascade& shadowCascade = constants.cascades[cascade];
+	Float3 position = worldPos + normal * shadowCascade.normalOffset;
+	Float4 shadowPos = Mul({ position.x, position.y, position.z, 1.0f }, shadowCascade.viewProj);
+	float u = shadowPos.x * 0.5f + 0.5f;
+	float v = 0.5f - shadowPos.y * 0.5f;
+	float depth = shadowPos.z - shadowCascade.depthBias;
+
+	float lit = 0.0f;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+			lit += maps.SampleCompare((int)cascade, u + x * constants.texelSize, v + y * constants.texelSize, depth);
+	}
+	return lit / 9.0f;
+}
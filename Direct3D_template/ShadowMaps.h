@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------
+// ShadowMaps - cascaded shadow maps for the sun (light 0 of the SHADOWS permutations).
+//
+// The view frustum is split into up to SHADOW_MAX_CASCADES slices, the split distances
+// blending logarithmic and uniform spacing. Each cascade is an orthographic projection
+// along the light around the bounding sphere of its slice. The sphere only depends on
+// the split distances, so the projection keeps its scale however the camera turns, and
+// its center is snapped to whole texels in light space: when the camera moves, the
+// shadow map contents slide by whole texels instead of shimmering. The depth range
+// reaches 'casterDistance' further towards the light so casters outside the camera's
+// view still land in the map.
+//
+// Fragment.hlsl picks the cascade from the view space depth and filters with PCF, a
+// 3x3 grid of bilinear comparison taps (SampleCmpLevelZero). CpuShadowMaps draws the
+// same maps with DepthRasterizer.h and ShadowFactor() samples them the same way, for
+// the CPU reference shader in CpuShading.h.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+
+#include "MathTypes.h"
+#include "MeshLod.h"
+#include "ShaderPermutations.h"
+
+class JobPool;
+struct DrawItem;
+
+// Mirrors ShadowCascade in Fragment.hlsl
+struct ShadowCascade
+{
+	Float4x4 viewProj;		// world -> cascade clip space
+	float depthBias;		// in the cascade's depth units
+	float normalOffset;		// world units along the surface normal
+	float padding[2];
+};
+
+// Mirrors SHADOW_CONSTANT_BUFFER
+struct ShadowConstants
+{
+	ShadowCascade cascades[SHADOW_MAX_CASCADES];
+	float cascadeSplits[SHADOW_MAX_CASCADES];	// view space depth each cascade ends at
+	unsigned int cascadeCount;
+	float texelSize;							// 1 / map size
+	float padding[2];
+};
+
+struct ShadowSettings
+{
+	int cascadeCount = 3;
+	int mapSize = 1024;				// a multiple of 4
+	float splitLambda = 0.75f;		// 1 = logarithmic splits, 0 = uniform
+	float casterDistance = 20.0f;
+	// both grow with the world size of a texel, which differs per cascade
+	float depthBiasTexels = 1.5f;
+	float normalOffsetTexels = 1.0f;
+};
+
+// 'view' is the camera's view matrix (rotation and translation only), the projection
+// is XMMatrixPerspectiveFovLH(fovY, aspect, nearZ, farZ). 'lightDirection' is the
+// direction the light travels in, world space.
+void ComputeShadowCascades(const Float4x4& view, float fovY, float aspect, float nearZ, float farZ,
+	Float3 lightDirection, const ShadowSettings& settings, ShadowConstants& constants);
+
+// The shadow pass on the CPU: one depth map per cascade, cleared to 1.0, with every
+// caster going through the geometry stage of the scene shader first (EXTRUDE), as the
+// GPU pass draws them.
+class CpuShadowMaps
+{
+public:
+	// 'meshes' is the mesh table of DrawItem::mesh. The cascades are drawn in parallel
+	// on the pool when there is one.
+	void Render(const ShadowConstants& constants, int mapSize, const DrawItem* casters, int casterCount,
+		const std::vector<IndexedMesh>& meshes, ShaderKey key, JobPool* pool = nullptr);
+
+	// Bilinear comparison of 'depth' against the map, like SampleCmpLevelZero with a
+	// LESS_EQUAL comparison sampler and border depth 1.0: 1 = lit
+	float SampleCompare(int cascade, float u, float v, float depth) const;
+
+	int GetMapSize() const { return mMapSize; }
+	const float* GetDepth(int cascade) const { return mDepth[cascade].data(); }
+	int GetTriangleCount() const { return mTriangles; }
+	double GetRenderMs() const { return mRenderMs; }
+
+private:
+	int mMapSize = 0;
+	std::vector<float> mDepth[SHADOW_MAX_CASCADES];
+	int mTriangles = 0;
+	double mRenderMs = 0.0;
+};
+
+// Light 0's visibility at a surface point, 0 = in shadow. Mirrors ShadowFactor() in
+// Fragment.hlsl.
+float ShadowFactor(const ShadowConstants& constants, const CpuShadowMaps& maps, Float3 worldPos, Float3 normal, float viewDepth);
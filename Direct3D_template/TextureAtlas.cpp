@@ -0,0 +1,177 @@
+#include "TextureAtlas.h"
+
+#include <string.h>
+#include <chrono>
+
+// Own private copy of the packer, imgui_draw.cpp compiles its copy as static as well.
+// Being static, the parts of it this file doesn't call warn as unused, same as in imgui_draw.cpp.
+#ifdef _MSC_VER
+#pragma warning (disable: 4505) // unreferenced local function has been removed (reported at the end of the file, so not popped)
+#endif
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-function"
+#endif
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imgui/imstb_rectpack.h"
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+TextureAtlas::TextureAtlas(int width, int height, int padding, int mipLevels)
+	: mWidth(width), mHeight(height), mPadding(padding), mMipLevels(mipLevels < 1 ? 1 : mipLevels)
+{
+	mAlign = 1 << (mMipLevels - 1);
+	mGutter = mPadding * mAlign;
+	mStats.totalBuildMs = 0.0;
+	Reset();
+}
+
+void TextureAtlas::Reset()
+{
+	mPixels.assign((size_t)mWidth * mHeight * 4, 0);
+	mRegions.clear();
+	mPending.clear();
+
+	int blocksX = mWidth / mAlign;
+	int blocksY = mHeight / mAlign;
+	mPackContext.assign(sizeof(stbrp_context), 0);
+	mPackNodes.assign(sizeof(stbrp_node) * blocksX, 0);
+	stbrp_init_target((stbrp_context*)mPackContext.data(), blocksX, blocksY, (stbrp_node*)mPackNodes.data(), blocksX);
+
+	mImageTexels = 0;
+	mStats.imageCount = 0;
+	mStats.packedCount = 0;
+	mStats.usedHeight = 0;
+	mStats.efficiency = 0.0f;
+	mStats.fillRatio = 0.0f;
+	mStats.lastBuildMs = 0.0;
+	mDirty = true;
+}
+
+int TextureAtlas::Add(const unsigned char* rgba, int width, int height)
+{
+	AtlasRegion region;
+	memset(&region, 0, sizeof(region));
+	region.width = width;
+	region.height = height;
+	mRegions.push_back(region);
+
+	PendingImage image;
+	image.id = (int)mRegions.size() - 1;
+	image.width = width;
+	image.height = height;
+	image.rgba.assign(rgba, rgba + (size_t)width * height * 4);
+	mPending.push_back(image);
+
+	mStats.imageCount++;
+	return image.id;
+}
+
+bool TextureAtlas::Build()
+{
+	if (mPending.empty())
+		return true;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Sizes are in units of mAlign texels, including the gutter on both sides
+	std::vector<stbrp_rect> rects(mPending.size());
+	for (size_t i = 0; i < mPending.size(); i++)
+	{
+		memset(&rects[i], 0, sizeof(stbrp_rect));
+		rects[i].id = (int)i;
+		rects[i].w = (stbrp_coord)((mPending[i].width + 2 * mGutter + mAlign - 1) / mAlign);
+		rects[i].h = (stbrp_coord)((mPending[i].height + 2 * mGutter + mAlign - 1) / mAlign);
+	}
+
+	bool allPacked = stbrp_pack_rects((stbrp_context*)mPackContext.data(), rects.data(), (int)rects.size()) != 0;
+
+	std::vector<PendingImage> failed;
+	for (size_t i = 0; i < rects.size(); i++)
+	{
+		const PendingImage& image = mPending[rects[i].id];
+		if (!rects[i].was_packed)
+		{
+			failed.push_back(image);
+			continue;
+		}
+
+		int x = rects[i].x * mAlign + mGutter;
+		int y = rects[i].y * mAlign + mGutter;
+		Blit(image, x, y);
+
+		AtlasRegion& region = mRegions[image.id];
+		region.x = x;
+		region.y = y;
+		region.uvOffset[0] = (float)x / mWidth;
+		region.uvOffset[1] = (float)y / mHeight;
+		region.uvScale[0] = (float)image.width / mWidth;
+		region.uvScale[1] = (float)image.height / mHeight;
+		region.packed = true;
+
+		int bottom = (rects[i].y + rects[i].h) * mAlign;
+		if (bottom > mStats.usedHeight)
+			mStats.usedHeight = bottom;
+		mImageTexels += (long long)image.width * image.height;
+		mStats.packedCount++;
+	}
+	// Images that did not fit stay pending, but they won't fit later either: the next
+	// Build() only has less free space. GetRegion() reports them as not packed.
+	mPending.swap(failed);
+	mDirty = true;
+
+	mStats.fillRatio = (float)((double)mImageTexels / ((double)mWidth * mHeight));
+	mStats.efficiency = mStats.usedHeight > 0 ? (float)((double)mImageTexels / ((double)mWidth * mStats.usedHeight)) : 0.0f;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.lastBuildMs = std::chrono::duration<double, std::milli>(end - start).count();
+	mStats.totalBuildMs += mStats.lastBuildMs;
+
+	return allPacked;
+}
+
+void TextureAtlas::RemapUV(int id, float u, float v, float* outU, float* outV) const
+{
+	const AtlasRegion& region = mRegions[id];
+	*outU = u * region.uvScale[0] + region.uvOffset[0];
+	*outV = v * region.uvScale[1] + region.uvOffset[1];
+}
+
+// Copies the image to (x,y) and repeats its edge texels into the gutter,
+// so bilinear filtering and lower mips at the border only see the image itself.
+void TextureAtlas::Blit(const PendingImage& image, int x, int y)
+{
+	if (image.width <= 0 || image.height <= 0)
+		return;
+
+	int x0 = x - mGutter < 0 ? 0 : x - mGutter;
+	int y0 = y - mGutter < 0 ? 0 : y - mGutter;
+	int x1 = x + image.width + mGutter > mWidth ? mWidth : x + image.width + mGutter;
+	int y1 = y + image.height + mGutter > mHeight ? mHeight : y + image.height + mGutter;
+
+	for (int dy = y0; dy < y1; dy++)
+	{
+		int sy = dy - y;
+		sy = sy < 0 ? 0 : (sy >= image.height ? image.height - 1 : sy);
+		const unsigned char* srcRow = &image.rgba[(size_t)sy * image.width * 4];
+		unsigned char* dstRow = &mPixels[((size_t)dy * mWidth) * 4];
+
+		// left gutter, image row, right gutter
+		for (int dx = x0; dx < x; dx++)
+			memcpy(dstRow + dx * 4, srcRow, 4);
+		memcpy(dstRow + x * 4, srcRow, (size_t)image.width * 4);
+		for (int dx = x + image.width; dx < x1; dx++)
+			memcpy(dstRow + dx * 4, srcRow + (image.width - 1) * 4, 4);
+	}
+}
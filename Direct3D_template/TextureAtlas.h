@@ -0,0 +1,96 @@
+//--------------------------------------------------------------------------------------
+// TextureAtlas - packs many small RGBA8 images into one texture so they can share
+// a single ID3D11ShaderResourceView (one bind instead of one per sprite).
+//
+// Packing is done with the skyline packer in imgui/imstb_rectpack.h (the same one
+// ImFontAtlas uses). Images can be added at any time; Build() packs everything
+// added since the last Build() into the space that is still free.
+//--------------------------------------------------------------------------------------
+#pragma once
+
+#include <vector>
+
+// Where an image ended up in the atlas.
+// To sample the image with its original [0,1] UVs: uv' = uv * uvScale + uvOffset
+struct AtlasRegion
+{
+	int x, y;			// top-left texel of the image (gutter excluded)
+	int width, height;
+	float uvOffset[2];
+	float uvScale[2];
+	bool packed;
+};
+
+struct AtlasStats
+{
+	int imageCount;			// images added
+	int packedCount;		// images that found room
+	int usedHeight;			// lowest row touched by any packed rect (gutter included)
+	float efficiency;		// image texels / (atlas width * usedHeight)
+	float fillRatio;		// image texels / (atlas width * atlas height)
+	double lastBuildMs;		// time spent in the last Build()
+	double totalBuildMs;	// time spent in all Build() calls
+};
+
+class TextureAtlas
+{
+public:
+	// padding: empty texels around each image at mip 0.
+	// mipLevels: number of mips the atlas will be sampled with. Images are aligned
+	// to 2^(mipLevels-1) texels and the gutter is scaled by the same amount so that
+	// no mip level blends two neighbouring images.
+	TextureAtlas(int width, int height, int padding = 1, int mipLevels = 1);
+
+	// Copies the image, returns an id used with GetRegion(). Nothing is packed until Build().
+	int Add(const unsigned char* rgba, int width, int height);
+
+	// Packs all images added since the last call. Returns false if any of them did not fit:
+	// those keep packed == false and won't fit this atlas later either. The size is fixed, so
+	// the caller has to create a bigger TextureAtlas and Add() its images to that one again.
+	bool Build();
+
+	// Forget every image, packed or not, and start over with an empty atlas of the same size.
+	void Reset();
+
+	const AtlasRegion& GetRegion(int id) const { return mRegions[id]; }
+	void RemapUV(int id, float u, float v, float* outU, float* outV) const;
+
+	const unsigned char* GetPixels() const { return mPixels.data(); }
+	int GetWidth() const { return mWidth; }
+	int GetHeight() const { return mHeight; }
+	int GetMipLevels() const { return mMipLevels; }
+	const AtlasStats& GetStats() const { return mStats; }
+
+	// Set by Build() when pixels changed, cleared by the caller after uploading.
+	bool IsDirty() const { return mDirty; }
+	void ClearDirty() { mDirty = false; }
+
+private:
+	struct PendingImage
+	{
+		int id;
+		int width, height;
+		std::vector<unsigned char> rgba;
+	};
+
+	void Blit(const PendingImage& image, int x, int y);
+
+	int mWidth, mHeight;
+	int mPadding;
+	int mMipLevels;
+	int mAlign;		// 2^(mipLevels-1), packing happens in units of this many texels
+	int mGutter;	// padding * mAlign
+
+	std::vector<unsigned char> mPixels;
+	std::vector<AtlasRegion> mRegions;
+	std::vector<PendingImage> mPending;
+
+	// Skyline state is kept between Build() calls so insertion is incremental.
+	// Stored opaque to keep imstb_rectpack.h out of this header.
+	std::vector<unsigned char> mPackContext;
+	std::vector<unsigned char> mPackNodes;
+
+	long long mImageTexels;
+	AtlasStats mStats;
+	bool mDirty;
+};
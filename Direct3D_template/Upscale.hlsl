@@ -0,0 +1,36 @@
+// Draws the scene of a dynamic resolution frame over the whole back buffer. The scene
+// fills the top-left part of sceneTexture, see UpscaleScene() in main.cpp. Also blends
+// the UI layer over it unscaled, see CompositeUi().
+Texture2D sceneTexture : register(t0);
+SamplerState sceneSampler : register(s0);
+
+cbuffer UPSCALE_CONSTANT_BUFFER : register(b0)
+{
+	float2 uvScale;		// drawn size / texture size
+	float2 uvMax;		// half a texel inside the drawn part, nothing past it bleeds in
+};
+
+struct VS_OUT
+{
+	float4 Pos : SV_POSITION;
+	float2 Tex : TEXCOORD;
+};
+
+//-----------------------------------------------------------------------------------------
+// VertexShader: one triangle covering the screen, from SV_VertexID alone (Draw(3, 0))
+//-----------------------------------------------------------------------------------------
+VS_OUT VS_upscale(uint vertexID : SV_VertexID)
+{
+	VS_OUT output;
+	output.Tex = float2((vertexID << 1) & 2, vertexID & 2);
+	output.Pos = float4(output.Tex * float2(2, -2) + float2(-1, 1), 0, 1);
+	return output;
+}
+
+//-----------------------------------------------------------------------------------------
+// PixelShader: bilinear upscale
+//-----------------------------------------------------------------------------------------
+float4 PS_upscale(VS_OUT input) : SV_Target
+{
+	return sceneTexture.Sample(sceneSampler, min(input.Tex * uvScale, uvMax));
+}
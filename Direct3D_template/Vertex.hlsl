@@ -2,12 +2,14 @@ struct VS_IN
 {
 	float3 Pos : POSITION;
 	float2 Tex : TEXCOORD;
+	uint InstanceID : SV_InstanceID;
 };
 
 struct VS_OUT
 {
 	float4 Pos : SV_POSITION;
 	float2 Tex : TEXCOORD;
+	nointerpolation uint Instance : INSTANCE;
 };
 //-----------------------------------------------------------------------------------------
 // VertexShader: VSScene
@@ -18,6 +20,7 @@ VS_OUT VS_main(VS_IN input)
 
 	output.Pos = float4(input.Pos, 1);
 	output.Tex = input.Tex;
+	output.Instance = input.InstanceID;
 
 	return output;
 }
\ No newline at end of file
@@ -35,6 +35,10 @@
 //#define IMGUI_DISABLE_FORMAT_STRING_FUNCTIONS             // Don't implement ImFormatString/ImFormatStringV so you can implement them yourself if you don't want to link with vsnprintf.
 //#define IMGUI_DISABLE_MATH_FUNCTIONS                      // Don't implement ImFabs/ImSqrt/ImPow/ImFmod/ImCos/ImSin/ImAcos/ImAtan2 wrapper so you can implement them yourself. Declare your prototypes in imconfig.h.
 //#define IMGUI_DISABLE_DEFAULT_ALLOCATORS                  // Don't implement default allocators calling malloc()/free() to avoid linking with them. You will need to call ImGui::SetAllocatorFunctions().
+//#define IMGUI_DISABLE_POOL_ALLOCATORS                     // Make the default allocators call malloc()/free() for every block instead of using size class pools and a scratch arena. Needed if several threads allocate through ImGui at the same time.
+//#define IMGUI_DISABLE_SSE                                 // Don't use SSE2 intrinsics (the text rendering and measuring fast paths), even when the target has them.
+//#define IMGUI_USE_CRC32_HASH                              // Compute IDs with the original CRC32 ImHash() instead of the faster multiply-xorshift one. IDs differ between the two, the .ini file only stores names.
+//#define IMGUI_USE_SORTED_STORAGE                          // Keep ImGuiStorage pairs in a sorted buffer (binary search, costly insertion) instead of the open-addressing hash table.
 
 //---- Include imgui_user.h at the end of imgui.h as a convenience
 //#define IMGUI_INCLUDE_IMGUI_USER_H
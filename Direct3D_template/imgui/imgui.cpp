@@ -906,6 +906,19 @@ static const float NAV_WINDOWING_LIST_APPEAR_DELAY          = 0.15f;    // Time
 static const float RESIZE_WINDOWS_FROM_EDGES_HALF_THICKNESS = 4.0f;     // Extend outside and inside windows. Affect FindHoveredWindow().
 static const float RESIZE_WINDOWS_FROM_EDGES_FEEDBACK_TIMER = 0.04f;    // Reduce visual noise by only highlighting the border after a certain time.
 
+// Damage tracking (when io.ConfigDamageTracking = true)
+static const int   DAMAGE_MAX_RECTS                         = 8;        // Closest rectangles are merged beyond this, each one costs the renderer a pass over the draw commands
+static const float DAMAGE_FULL_SCREEN_RATIO                 = 0.60f;    // Damage covering more of the display becomes a single full display rectangle
+
+// Text size cache (when io.ConfigTextSizeCache = true)
+static const int   TEXT_SIZE_CACHE_CAPACITY                 = 8192;     // Least recently used entries are evicted beyond this. A UI measuring more different texts per frame than this gets no hits.
+static const int   TEXT_SIZE_CACHE_BUCKETS_LOG2             = 14;       // 2^14 hash buckets, twice the capacity
+static const int   TEXT_SIZE_CACHE_MAX_TEXT_LENGTH          = 256;      // Longer texts aren't cached: hashing them costs about as much as measuring
+
+// Default allocators (unless IMGUI_DISABLE_POOL_ALLOCATORS is defined)
+static const int   ALLOC_POOL_PAGE_SIZE                     = 16 * 1024; // Size class pools carve their blocks from pages of this size
+static const int   ALLOC_ARENA_CHUNK_SIZE                   = 64 * 1024; // ImGuiAllocTag_Temp blocks are stacked in chunks of this size, a bigger block gets a chunk of its own
+
 //-------------------------------------------------------------------------
 // [SECTION] FORWARD DECLARATIONS
 //-------------------------------------------------------------------------
@@ -932,6 +945,7 @@ static void             SettingsHandlerWindow_WriteAll(ImGuiContext* imgui_ctx,
 
 // Platform Dependents default implementation for IO functions
 static const char*      GetClipboardTextFn_DefaultImpl(void* user_data);
+static int              CaptureCallStack(void** frames, int frames_max);
 static void             SetClipboardTextFn_DefaultImpl(void* user_data, const char* text);
 static void             ImeSetInputScreenPosFn_DefaultImpl(int x, int y);
 
@@ -954,6 +968,9 @@ static ImGuiWindow*     NavRestoreLastChildNavWindow(ImGuiWindow* window);
 // Misc
 static void             UpdateMouseInputs();
 static void             UpdateMouseWheel();
+static void             UpdateIdleInputs();
+static void             UpdateIdleOutputs();
+static void             UpdateDamageRects();
 static void             UpdateManualResize(ImGuiWindow* window, const ImVec2& size_auto_fit, int* border_held, int resize_grip_count, ImU32 resize_grip_col[4]);
 }
 
@@ -983,17 +1000,184 @@ ImGuiContext*   GImGui = NULL;
 // If you use DLL hotreloading you might need to call SetAllocatorFunctions() after reloading code from this file.
 // Otherwise, you probably don't want to modify them mid-program, and if you use global/static e.g. ImVector<> instances you may need to keep them accessible during program destruction.
 #ifndef IMGUI_DISABLE_DEFAULT_ALLOCATORS
-static void*   MallocWrapper(size_t size, void* user_data)    { (void)user_data; return malloc(size); }
-static void    FreeWrapper(void* ptr, void* user_data)        { (void)user_data; free(ptr); }
+#ifdef IMGUI_DISABLE_POOL_ALLOCATORS
+static void*   MallocWrapper(size_t size, ImGuiAllocTag tag, void* user_data)   { (void)user_data; (void)tag; return malloc(size); }
+static void    FreeWrapper(void* ptr, ImGuiAllocTag tag, void* user_data)       { (void)user_data; (void)tag; free(ptr); }
 #else
-static void*   MallocWrapper(size_t size, void* user_data)    { (void)user_data; (void)size; IM_ASSERT(0); return NULL; }
-static void    FreeWrapper(void* ptr, void* user_data)        { (void)user_data; (void)ptr; IM_ASSERT(0); }
+// The default allocators stack ImGuiAllocTag_Temp blocks in arena chunks: a freed block is reclaimed once every block allocated after
+// it is freed too, which suits scratch buffers. Small ImGuiAllocTag_Default blocks come from one free list per size class, carved from
+// pages. Anything else comes from malloc(). Each block starts with a header telling FreeWrapper() where it came from, and all pages and
+// chunks go back to the heap whenever no block is left (e.g. after DestroyContext()). Like the rest of ImGui, this isn't thread-safe.
+struct ImAllocBlockHeader
+{
+    int                 Kind;           // Index in ImAllocSizeClasses[], or ImAllocKind_Heap/ImAllocKind_Arena
+    int                 Freed;          // Arena: reclaimed once the blocks stacked after it are freed too
+    int                 PrevOffset;     // Arena: offset of the previous block in the chunk, -1 for the first one
+    int                 Padding;        // Keep blocks aligned like malloc() ones
+};
+
+struct ImAllocArenaChunk
+{
+    ImAllocArenaChunk*  Prev;
+    int                 Size;           // Bytes available after the chunk header
+    int                 Top;            // Bytes used
+    int                 LastOffset;     // Offset of the last block, -1 when the chunk is empty
+};
+
+struct ImAllocPool
+{
+    void*               FreeList;       // Freed blocks, linked through their first bytes
+    char*               CarvePtr;       // Unused end of the last page
+    char*               CarveEnd;
+};
+
+enum { ImAllocKind_Heap = -1, ImAllocKind_Arena = -2 };
+static const int        ImAllocSizeClasses[] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024 };
+static const int        ImAllocChunkHeaderSize = (int)((sizeof(ImAllocArenaChunk) + 15) & ~(size_t)15);
+
+static struct ImAllocState
+{
+    ImAllocPool         Pools[IM_ARRAYSIZE(ImAllocSizeClasses)];
+    void*               Pages;          // Pool pages, linked through their first bytes
+    ImAllocArenaChunk*  Arena;          // Top chunk of the arena stack
+    int                 LiveBlocks;
+} GImAllocState;
+
+static inline ImAllocBlockHeader* ArenaBlock(ImAllocArenaChunk* chunk, int offset) { return (ImAllocBlockHeader*)((char*)chunk + ImAllocChunkHeaderSize + offset); }
+
+static void* MallocWrapper(size_t size, ImGuiAllocTag tag, void* user_data)
+{
+    (void)user_data;
+    ImAllocState& st = GImAllocState;
+    ImAllocBlockHeader* block;
+    if (tag == ImGuiAllocTag_Temp)
+    {
+        const int block_size = (int)((sizeof(ImAllocBlockHeader) + size + 15) & ~(size_t)15);
+        ImAllocArenaChunk* chunk = st.Arena;
+        if (chunk == NULL || chunk->Top + block_size > chunk->Size)
+        {
+            const int chunk_size = ImMax(ALLOC_ARENA_CHUNK_SIZE, block_size);
+            if ((chunk = (ImAllocArenaChunk*)malloc((size_t)(ImAllocChunkHeaderSize + chunk_size))) == NULL)
+                return NULL;
+            chunk->Prev = st.Arena;
+            chunk->Size = chunk_size;
+            chunk->Top = 0;
+            chunk->LastOffset = -1;
+            st.Arena = chunk;
+        }
+        block = ArenaBlock(chunk, chunk->Top);
+        block->Kind = ImAllocKind_Arena;
+        block->Freed = 0;
+        block->PrevOffset = chunk->LastOffset;
+        chunk->LastOffset = chunk->Top;
+        chunk->Top += block_size;
+    }
+    else if (size <= (size_t)ImAllocSizeClasses[IM_ARRAYSIZE(ImAllocSizeClasses) - 1])
+    {
+        int kind = 0;
+        while ((size_t)ImAllocSizeClasses[kind] < size)
+            kind++;
+        ImAllocPool& pool = st.Pools[kind];
+        if (pool.FreeList)
+        {
+            block = (ImAllocBlockHeader*)pool.FreeList;
+            pool.FreeList = *(void**)pool.FreeList;
+        }
+        else
+        {
+            const int block_size = (int)sizeof(ImAllocBlockHeader) + ImAllocSizeClasses[kind];
+            if (pool.CarveEnd - pool.CarvePtr < block_size)
+            {
+                char* page = (char*)malloc((size_t)ALLOC_POOL_PAGE_SIZE);
+                if (page == NULL)
+                    return NULL;
+                *(void**)page = st.Pages;
+                st.Pages = page;
+                pool.CarvePtr = page + sizeof(ImAllocBlockHeader);
+                pool.CarveEnd = page + ALLOC_POOL_PAGE_SIZE;
+            }
+            block = (ImAllocBlockHeader*)pool.CarvePtr;
+            pool.CarvePtr += block_size;
+        }
+        block->Kind = kind;
+    }
+    else
+    {
+        if ((block = (ImAllocBlockHeader*)malloc(sizeof(ImAllocBlockHeader) + size)) == NULL)
+            return NULL;
+        block->Kind = ImAllocKind_Heap;
+    }
+    st.LiveBlocks++;
+    return block + 1;
+}
+
+static void FreeWrapper(void* ptr, ImGuiAllocTag tag, void* user_data)
+{
+    (void)user_data; (void)tag;
+    if (ptr == NULL)
+        return;
+    ImAllocState& st = GImAllocState;
+    ImAllocBlockHeader* block = (ImAllocBlockHeader*)ptr - 1;
+    IM_ASSERT(st.LiveBlocks > 0 && (tag == ImGuiAllocTag_Temp) == (block->Kind == ImAllocKind_Arena));
+    if (block->Kind == ImAllocKind_Arena)
+    {
+        // Pop the freed blocks off the top of the stack. Emptied chunks go back to the heap, but the bottom one which is kept for the next scratch buffers.
+        block->Freed = 1;
+        while (ImAllocArenaChunk* chunk = st.Arena)
+        {
+            while (chunk->LastOffset >= 0 && ArenaBlock(chunk, chunk->LastOffset)->Freed)
+            {
+                chunk->Top = chunk->LastOffset;
+                chunk->LastOffset = ArenaBlock(chunk, chunk->LastOffset)->PrevOffset;
+            }
+            if (chunk->LastOffset >= 0 || chunk->Prev == NULL)
+                break;
+            st.Arena = chunk->Prev;
+            free(chunk);
+        }
+    }
+    else if (block->Kind == ImAllocKind_Heap)
+    {
+        free(block);
+    }
+    else
+    {
+        ImAllocPool& pool = st.Pools[block->Kind];
+        *(void**)block = pool.FreeList;
+        pool.FreeList = block;
+    }
+
+    if (--st.LiveBlocks == 0)
+    {
+        while (void* page = st.Pages)
+        {
+            st.Pages = *(void**)page;
+            free(page);
+        }
+        while (ImAllocArenaChunk* chunk = st.Arena)
+        {
+            st.Arena = chunk->Prev;
+            free(chunk);
+        }
+        memset(st.Pools, 0, sizeof(st.Pools));
+    }
+}
+#endif // #ifdef IMGUI_DISABLE_POOL_ALLOCATORS
+#else
+static void*   MallocWrapper(size_t size, ImGuiAllocTag tag, void* user_data)   { (void)user_data; (void)tag; (void)size; IM_ASSERT(0); return NULL; }
+static void    FreeWrapper(void* ptr, ImGuiAllocTag tag, void* user_data)       { (void)user_data; (void)tag; (void)ptr; IM_ASSERT(0); }
 #endif
 
-static void*  (*GImAllocatorAllocFunc)(size_t size, void* user_data) = MallocWrapper;
-static void   (*GImAllocatorFreeFunc)(void* ptr, void* user_data) = FreeWrapper;
+static void*  (*GImAllocatorAllocFunc)(size_t size, ImGuiAllocTag tag, void* user_data) = MallocWrapper;
+static void   (*GImAllocatorFreeFunc)(void* ptr, ImGuiAllocTag tag, void* user_data) = FreeWrapper;
 static void*    GImAllocatorUserData = NULL;
 
+// Functions set with the untagged SetAllocatorFunctions()
+static void*  (*GImAllocatorUntaggedAllocFunc)(size_t size, void* user_data) = NULL;
+static void   (*GImAllocatorUntaggedFreeFunc)(void* ptr, void* user_data) = NULL;
+static void*   UntaggedMallocWrapper(size_t size, ImGuiAllocTag tag, void* user_data)   { (void)tag; return GImAllocatorUntaggedAllocFunc(size, user_data); }
+static void    UntaggedFreeWrapper(void* ptr, ImGuiAllocTag tag, void* user_data)       { (void)tag; GImAllocatorUntaggedFreeFunc(ptr, user_data); }
+
 //-----------------------------------------------------------------------------
 // [SECTION] MAIN USER FACING STRUCTURES (ImGuiStyle, ImGuiIO)
 //-----------------------------------------------------------------------------
@@ -1095,6 +1279,13 @@ ImGuiIO::ImGuiIO()
 #endif
     ConfigInputTextCursorBlink = true;
     ConfigResizeWindowsFromEdges = false;
+    ConfigIdleDetection = false;
+    ConfigDamageTracking = false;
+    ConfigTextSizeCache = true;
+    ConfigDebugAllocCheckFrames = -1;
+    ConfigDebugAllocCheckAssert = false;
+    FrameChanged = true;
+    IdleTimeout = 0.0f;
 
     // Settings (User Functions)
     GetClipboardTextFn = GetClipboardTextFn_DefaultImpl;   // Platform dependent default implementations
@@ -1321,7 +1512,61 @@ int ImFormatStringV(char* buf, size_t buf_size, const char* fmt, va_list args)
 #endif // #ifdef IMGUI_DISABLE_FORMAT_STRING_FUNCTIONS
 
 // Pass data_size==0 for zero-terminated strings
-// FIXME-OPT: Replace with e.g. FNV1a hash? CRC32 pretty much randomly access 1KB. Need to do proper measurements.
+// We support a syntax of "label###id" in zero-terminated strings, where only "###id" is included in the hash, and only "label" gets displayed.
+#ifndef IMGUI_USE_CRC32_HASH
+// Multiply-xorshift over 8 bytes at a time, with MurmurHash3's finalizer. Several times faster than the CRC32 below on labels.
+static ImU32 ImHashBlocks(const unsigned char* data, size_t size, ImU32 seed)
+{
+    // 4 bytes (PushID(int) and the like): a bijection of the value for a given seed, so different values never collide
+    if (size == 4)
+    {
+        ImU32 value;
+        memcpy(&value, data, 4);
+        value ^= seed * 0x9E3779B9u;
+        value ^= value >> 16;
+        value *= 0x85EBCA6Bu;
+        value ^= value >> 13;
+        value *= 0xC2B2AE35u;
+        value ^= value >> 16;
+        return value;
+    }
+
+    ImU64 hash = (((ImU64)seed << 32) | seed) ^ ((ImU64)size * 0x9E3779B97F4A7C15ULL);
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        ImU64 word;
+        memcpy(&word, data, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    if (size > 0)
+    {
+        ImU64 word = 0;
+        memcpy(&word, data, size);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return (ImU32)hash ^ (ImU32)(hash >> 32);
+}
+
+ImU32 ImHash(const void* data, int data_size, ImU32 seed)
+{
+    if (data_size > 0)
+        return ImHashBlocks((const unsigned char*)data, (size_t)data_size, seed);
+
+    // Zero-terminated string: hash it from its last "###" on, like the CRC32 version which resets to the seed there
+    const char* str = (const char*)data;
+    const char* str_end = str + strlen(str);
+    for (const char* p = str; str_end - p >= 3 && (p = (const char*)memchr(p, '#', (size_t)(str_end - p - 2))) != NULL; p++)
+        if (p[1] == '#' && p[2] == '#')
+            str = p;
+    return ImHashBlocks((const unsigned char*)str, (size_t)(str_end - str), seed);
+}
+#else
+// CRC32 (IMGUI_USE_CRC32_HASH). Pretty much randomly accesses 1KB.
 ImU32 ImHash(const void* data, int data_size, ImU32 seed)
 {
     static ImU32 crc32_lut[256] = { 0 };
@@ -1363,6 +1608,7 @@ ImU32 ImHash(const void* data, int data_size, ImU32 seed)
     }
     return ~crc;
 }
+#endif
 
 FILE* ImFileOpen(const char* filename, const char* mode)
 {
@@ -1718,6 +1964,8 @@ ImU32 ImGui::GetColorU32(ImU32 col)
 // Helper: Key->value storage
 //-----------------------------------------------------------------------------
 
+#ifdef IMGUI_USE_SORTED_STORAGE
+
 // std::lower_bound but without the bullshit
 static ImVector<ImGuiStorage::Pair>::iterator LowerBound(ImVector<ImGuiStorage::Pair>& data, ImGuiID key)
 {
@@ -1862,6 +2110,200 @@ void ImGuiStorage::SetAllInt(int v)
         Data[i].val_i = v;
 }
 
+#else // #ifdef IMGUI_USE_SORTED_STORAGE
+
+// Open addressing with Robin Hood linear probing: a pair sits at or after its home slot, and on insertion a pair further from
+// its home takes the slot of one closer to its own. Probe sequences stay short and sorted by distance, so a lookup stops as soon
+// as it reaches a pair closer to its home than the key would be. Pairs are never erased, so no tombstones are needed.
+static inline ImU32 StorageHomeSlot(ImGuiID key, ImU32 mask)
+{
+    ImU32 h = key * 0x9E3779B1u;    // IDs are already hashed, but user keys may be small sequential integers
+    return (h ^ (h >> 15)) & mask;
+}
+
+static ImGuiStorage::Pair* StorageFind(const ImGuiStorage* storage, ImGuiID key)
+{
+    if (key == 0)
+        return storage->ZeroKeyUsed ? const_cast<ImGuiStorage::Pair*>(&storage->ZeroKey) : NULL;
+    if (storage->Data.Size == 0)
+        return NULL;
+    const ImU32 mask = (ImU32)storage->Data.Size - 1;
+    ImGuiStorage::Pair* slots = const_cast<ImGuiStorage::Pair*>(storage->Data.Data);
+    for (ImU32 slot = StorageHomeSlot(key, mask), dist = 0; ; slot = (slot + 1) & mask, dist++)
+    {
+        const ImGuiID slot_key = slots[slot].key;
+        if (slot_key == key)
+            return &slots[slot];
+        if (slot_key == 0 || ((slot - StorageHomeSlot(slot_key, mask)) & mask) < dist)
+            return NULL;
+    }
+}
+
+// Insert a pair whose key is known to be missing. Data must have a free slot (see StorageInsert).
+static ImGuiStorage::Pair* StorageInsertNoGrow(ImGuiStorage* storage, ImGuiStorage::Pair pair)
+{
+    const ImU32 mask = (ImU32)storage->Data.Size - 1;
+    ImGuiStorage::Pair* inserted = NULL;
+    storage->Count++;
+    for (ImU32 slot = StorageHomeSlot(pair.key, mask), dist = 0; ; slot = (slot + 1) & mask, dist++)
+    {
+        ImGuiStorage::Pair& slot_pair = storage->Data.Data[slot];
+        if (slot_pair.key == 0)
+        {
+            slot_pair = pair;
+            return inserted ? inserted : &slot_pair;
+        }
+        const ImU32 slot_dist = (slot - StorageHomeSlot(slot_pair.key, mask)) & mask;
+        if (slot_dist < dist)
+        {
+            // Take the slot and carry on inserting the pair we displaced
+            ImSwap(slot_pair, pair);
+            if (!inserted)
+                inserted = &slot_pair;
+            dist = slot_dist;
+        }
+    }
+}
+
+static void StorageRehash(ImGuiStorage* storage, int capacity)
+{
+    ImVector<ImGuiStorage::Pair> old_data;
+    old_data.swap(storage->Data);
+    storage->Data.resize(capacity, ImGuiStorage::Pair(0, 0));
+    storage->Count = 0;
+    for (int i = 0; i < old_data.Size; i++)
+        if (old_data[i].key != 0)
+            StorageInsertNoGrow(storage, old_data[i]);
+}
+
+// Insert a pair whose key is known to be missing. Returns its slot, valid until the next insertion.
+static ImGuiStorage::Pair* StorageInsert(ImGuiStorage* storage, const ImGuiStorage::Pair& pair)
+{
+    if (pair.key == 0)
+    {
+        storage->ZeroKeyUsed = true;
+        storage->ZeroKey = pair;
+        return &storage->ZeroKey;
+    }
+    if ((storage->Count + 1) * 4 > storage->Data.Size * 3)
+        StorageRehash(storage, storage->Data.Size ? storage->Data.Size * 2 : 16);
+    return StorageInsertNoGrow(storage, pair);
+}
+
+// For quicker full rebuild of a storage (instead of an incremental one), you may add all your contents and then sort once.
+// Here Data may hold the current slots followed by the pushed pairs: rehash everything into a table sized for it in one go.
+void ImGuiStorage::BuildSortByKey()
+{
+    ImVector<Pair> pairs;
+    pairs.swap(Data);
+    Count = 0;
+    int capacity = 16;
+    while (capacity * 3 < pairs.Size * 4)
+        capacity *= 2;
+    Data.resize(capacity, Pair(0, 0));
+    for (int i = 0; i < pairs.Size; i++)
+        if (pairs[i].key != 0)
+        {
+            if (Pair* p = StorageFind(this, pairs[i].key))
+                *p = pairs[i];
+            else
+                StorageInsertNoGrow(this, pairs[i]);
+        }
+}
+
+int ImGuiStorage::GetInt(ImGuiID key, int default_val) const
+{
+    const Pair* p = StorageFind(this, key);
+    return p ? p->val_i : default_val;
+}
+
+bool ImGuiStorage::GetBool(ImGuiID key, bool default_val) const
+{
+    return GetInt(key, default_val ? 1 : 0) != 0;
+}
+
+float ImGuiStorage::GetFloat(ImGuiID key, float default_val) const
+{
+    const Pair* p = StorageFind(this, key);
+    return p ? p->val_f : default_val;
+}
+
+void* ImGuiStorage::GetVoidPtr(ImGuiID key) const
+{
+    const Pair* p = StorageFind(this, key);
+    return p ? p->val_p : NULL;
+}
+
+// References are only valid until a new value is added to the storage. Calling a Set***() function or a Get***Ref() function invalidates the pointer.
+int* ImGuiStorage::GetIntRef(ImGuiID key, int default_val)
+{
+    Pair* p = StorageFind(this, key);
+    if (!p)
+        p = StorageInsert(this, Pair(key, default_val));
+    return &p->val_i;
+}
+
+bool* ImGuiStorage::GetBoolRef(ImGuiID key, bool default_val)
+{
+    return (bool*)GetIntRef(key, default_val ? 1 : 0);
+}
+
+float* ImGuiStorage::GetFloatRef(ImGuiID key, float default_val)
+{
+    Pair* p = StorageFind(this, key);
+    if (!p)
+        p = StorageInsert(this, Pair(key, default_val));
+    return &p->val_f;
+}
+
+void** ImGuiStorage::GetVoidPtrRef(ImGuiID key, void* default_val)
+{
+    Pair* p = StorageFind(this, key);
+    if (!p)
+        p = StorageInsert(this, Pair(key, default_val));
+    return &p->val_p;
+}
+
+void ImGuiStorage::SetInt(ImGuiID key, int val)
+{
+    if (Pair* p = StorageFind(this, key))
+        p->val_i = val;
+    else
+        StorageInsert(this, Pair(key, val));
+}
+
+void ImGuiStorage::SetBool(ImGuiID key, bool val)
+{
+    SetInt(key, val ? 1 : 0);
+}
+
+void ImGuiStorage::SetFloat(ImGuiID key, float val)
+{
+    if (Pair* p = StorageFind(this, key))
+        p->val_f = val;
+    else
+        StorageInsert(this, Pair(key, val));
+}
+
+void ImGuiStorage::SetVoidPtr(ImGuiID key, void* val)
+{
+    if (Pair* p = StorageFind(this, key))
+        p->val_p = val;
+    else
+        StorageInsert(this, Pair(key, val));
+}
+
+void ImGuiStorage::SetAllInt(int v)
+{
+    // Values of empty slots are never read, no need to skip them
+    for (int i = 0; i < Data.Size; i++)
+        Data[i].val_i = v;
+    if (ZeroKeyUsed)
+        ZeroKey.val_i = v;
+}
+
+#endif // #ifdef IMGUI_USE_SORTED_STORAGE
+
 //-----------------------------------------------------------------------------
 // [SECTION] ImGuiTextFilter
 //-----------------------------------------------------------------------------
@@ -2777,19 +3219,34 @@ float ImGui::CalcWrapWidthForPos(const ImVec2& pos, float wrap_pos_x)
     return ImMax(wrap_pos_x - pos.x, 1.0f);
 }
 
-void* ImGui::MemAlloc(size_t size)
+// Record an allocation made in a frame that should have been in a steady state (io.ConfigDebugAllocCheckFrames)
+static void ReportAllocation(ImGuiContext* ctx, size_t size, ImGuiAllocTag tag)
+{
+    ImGuiAllocReport& report = ctx->AllocReports[ctx->AllocReportsCount++ % IM_ARRAYSIZE(ctx->AllocReports)];
+    report.Frame = ctx->FrameCount;
+    report.Size = size;
+    report.Tag = tag;
+    report.CallStackSize = CaptureCallStack(report.CallStack, IM_ARRAYSIZE(report.CallStack));
+    IM_ASSERT(!ctx->IO.ConfigDebugAllocCheckAssert && "MemAlloc() call in a steady state frame, see io.ConfigDebugAllocCheckFrames");
+}
+
+void* ImGui::MemAlloc(size_t size, ImGuiAllocTag tag)
 {
     if (ImGuiContext* ctx = GImGui)
+    {
         ctx->IO.MetricsActiveAllocations++;
-    return GImAllocatorAllocFunc(size, GImAllocatorUserData);
+        if (ctx->AllocCheckActive)
+            ReportAllocation(ctx, size, tag);
+    }
+    return GImAllocatorAllocFunc(size, tag, GImAllocatorUserData);
 }
 
-void ImGui::MemFree(void* ptr)
+void ImGui::MemFree(void* ptr, ImGuiAllocTag tag)
 {
     if (ptr) 
         if (ImGuiContext* ctx = GImGui)
             ctx->IO.MetricsActiveAllocations--;
-    return GImAllocatorFreeFunc(ptr, GImAllocatorUserData);
+    return GImAllocatorFreeFunc(ptr, tag, GImAllocatorUserData);
 }
 
 const char* ImGui::GetClipboardText()
@@ -2839,6 +3296,13 @@ bool ImGui::DebugCheckVersionAndDataLayout(const char* version, size_t sz_io, si
 }
 
 void ImGui::SetAllocatorFunctions(void* (*alloc_func)(size_t sz, void* user_data), void(*free_func)(void* ptr, void* user_data), void* user_data)
+{
+    GImAllocatorUntaggedAllocFunc = alloc_func;
+    GImAllocatorUntaggedFreeFunc = free_func;
+    SetAllocatorFunctions(UntaggedMallocWrapper, UntaggedFreeWrapper, user_data);
+}
+
+void ImGui::SetAllocatorFunctions(void* (*alloc_func)(size_t sz, ImGuiAllocTag tag, void* user_data), void(*free_func)(void* ptr, ImGuiAllocTag tag, void* user_data), void* user_data)
 {
     GImAllocatorAllocFunc = alloc_func;
     GImAllocatorFreeFunc = free_func;
@@ -3180,7 +3644,12 @@ void ImGui::NewFrame()
     g.Time += g.IO.DeltaTime;
     g.FrameScopeActive = true;
     g.FrameCount += 1;
+    g.AllocCheckActive = g.IO.ConfigDebugAllocCheckFrames >= 0 && g.FrameCount > g.IO.ConfigDebugAllocCheckFrames;
     g.TooltipOverrideCount = 0;
+    g.TextSizeCacheHitsLastFrame = g.TextSizeCacheHits;
+    g.TextSizeCacheMissesLastFrame = g.TextSizeCacheMisses;
+    g.TextSizeCacheEvictionsLastFrame = g.TextSizeCacheEvictions;
+    g.TextSizeCacheHits = g.TextSizeCacheMisses = g.TextSizeCacheEvictions = 0;
     g.WindowsActiveCount = 0;
 
     // Setup current font and draw list
@@ -3234,6 +3703,10 @@ void ImGui::NewFrame()
     g.DragDropAcceptIdCurrRectSurface = FLT_MAX;
     g.DragDropWithinSourceOrTarget = false;
 
+    // Compare the inputs with the last frame's before they are consumed
+    if (g.IO.ConfigIdleDetection)
+        UpdateIdleInputs();
+
     // Update keyboard input state
     memcpy(g.IO.KeysDownDurationPrev, g.IO.KeysDownDuration, sizeof(g.IO.KeysDownDuration));
     for (int i = 0; i < IM_ARRAYSIZE(g.IO.KeysDown); i++)
@@ -3371,6 +3844,12 @@ void ImGui::Shutdown(ImGuiContext* context)
     g.CurrentPopupStack.clear();
     g.DrawDataBuilder.ClearFreeMemory();
     g.OverlayDrawList.ClearFreeMemory();
+    g.DamageLists.clear();
+    g.DamageListsPrev.clear();
+    g.TextSizeCache.clear();
+    g.TextSizeCacheBuckets.clear();
+    g.TextSizeCacheLruHead = g.TextSizeCacheLruTail = -1;
+    g.DamageRects.clear();
     g.PrivateClipboard.clear();
     g.InputTextState.TextW.clear();
     g.InputTextState.InitialText.clear();
@@ -3524,6 +4003,305 @@ void ImGui::PopClipRect()
     window->ClipRect = window->DrawList->_ClipRectStack.back();
 }
 
+//-----------------------------------------------------------------------------
+// Idle detection (io.ConfigIdleDetection)
+//-----------------------------------------------------------------------------
+
+ImGuiIdleInputs::ImGuiIdleInputs()
+{
+    DisplaySize = MousePos = ImVec2(0.0f, 0.0f);
+    for (int n = 0; n < IM_ARRAYSIZE(NavInputs); n++)
+        NavInputs[n] = 0.0f;
+    memset(MouseDown, 0, sizeof(MouseDown));
+    KeyCtrl = KeyShift = KeyAlt = KeySuper = false;
+    memset(KeysDown, 0, sizeof(KeysDown));
+}
+
+bool ImGuiIdleInputs::operator==(const ImGuiIdleInputs& rhs) const
+{
+    if (DisplaySize.x != rhs.DisplaySize.x || DisplaySize.y != rhs.DisplaySize.y || MousePos.x != rhs.MousePos.x || MousePos.y != rhs.MousePos.y)
+        return false;
+    for (int n = 0; n < IM_ARRAYSIZE(NavInputs); n++)
+        if (NavInputs[n] != rhs.NavInputs[n])
+            return false;
+    if (KeyCtrl != rhs.KeyCtrl || KeyShift != rhs.KeyShift || KeyAlt != rhs.KeyAlt || KeySuper != rhs.KeySuper)
+        return false;
+    return memcmp(MouseDown, rhs.MouseDown, sizeof(MouseDown)) == 0 && memcmp(KeysDown, rhs.KeysDown, sizeof(KeysDown)) == 0;
+}
+
+void ImGui::UpdateIdleInputs()
+{
+    ImGuiContext& g = *GImGui;
+    ImGuiIdleInputs inputs;
+    inputs.DisplaySize = g.IO.DisplaySize;
+    inputs.MousePos = g.IO.MousePos;
+    memcpy(inputs.NavInputs, g.IO.NavInputs, sizeof(inputs.NavInputs));
+    memcpy(inputs.MouseDown, g.IO.MouseDown, sizeof(inputs.MouseDown));
+    inputs.KeyCtrl = g.IO.KeyCtrl;
+    inputs.KeyShift = g.IO.KeyShift;
+    inputs.KeyAlt = g.IO.KeyAlt;
+    inputs.KeySuper = g.IO.KeySuper;
+    memcpy(inputs.KeysDown, g.IO.KeysDown, sizeof(inputs.KeysDown));
+
+    // The wheel and characters are events rather than state, any of them is a change
+    const bool events = g.IO.MouseWheel != 0.0f || g.IO.MouseWheelH != 0.0f || g.IO.InputCharacters[0] != 0;
+    g.IdleInputsChanged = events || !(inputs == g.IdleInputs);
+    g.IdleInputs = inputs;
+}
+
+// Multiply-xorshift over 8 bytes at a time, with 64 bits of state: the draw data is often a megabyte, so this is kept cheaper than ImHash()
+static ImU64 HashBytes64(const void* data, size_t size, ImU64 hash)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (; size >= 8; size -= 8, bytes += 8)
+    {
+        ImU64 word;
+        memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 32;
+    }
+    for (; size > 0; size--, bytes++)
+        hash = (hash ^ *bytes) * 0x9E3779B97F4A7C15ULL;
+    return hash;
+}
+
+static ImU64 HashDrawList(const ImDrawList* draw_list, ImU64 hash)
+{
+    hash = HashBytes64(draw_list->VtxBuffer.Data, (size_t)draw_list->VtxBuffer.Size * sizeof(ImDrawVert), hash);
+    hash = HashBytes64(draw_list->IdxBuffer.Data, (size_t)draw_list->IdxBuffer.Size * sizeof(ImDrawIdx), hash);
+    for (const ImDrawCmd* cmd = draw_list->CmdBuffer.begin(); cmd != draw_list->CmdBuffer.end(); cmd++)
+    {
+        // Field by field, ImDrawCmd has padding
+        hash = HashBytes64(&cmd->ElemCount, sizeof(cmd->ElemCount), hash);
+        hash = HashBytes64(&cmd->ClipRect, sizeof(cmd->ClipRect), hash);
+        hash = HashBytes64(&cmd->TextureId, sizeof(cmd->TextureId), hash);
+        hash = HashBytes64(&cmd->UserCallback, sizeof(cmd->UserCallback), hash);
+        hash = HashBytes64(&cmd->UserCallbackData, sizeof(cmd->UserCallbackData), hash);
+    }
+    return hash;
+}
+
+// Reuses the draw list hashes of UpdateDamageRects() when it ran this frame
+static ImU64 HashDrawData(const ImDrawData* draw_data)
+{
+    ImGuiContext& g = *GImGui;
+    ImU64 hash = HashBytes64(&draw_data->DisplaySize, sizeof(draw_data->DisplaySize), 0xCBF29CE484222325ULL);
+    if (g.IO.ConfigDamageTracking)
+    {
+        for (int n = 0; n < g.DamageLists.Size; n++)
+            hash = HashBytes64(&g.DamageLists[n].Hash, sizeof(ImU64), hash);
+        return hash;
+    }
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+        hash = HashDrawList(draw_data->CmdLists[n], hash);
+    return hash;
+}
+
+// Time until something changes without input, once the frames settled
+static float CalcIdleTimeout()
+{
+    ImGuiContext& g = *GImGui;
+
+    // Animations
+    if ((g.DimBgRatio > 0.0f && g.DimBgRatio < 1.0f) || g.NavWindowingTargetAnim != NULL || g.DragDropActive)
+        return 0.0f;
+
+    // Appearing windows are hidden for a frame or two while they size themselves
+    for (int n = 0; n < g.Windows.Size; n++)
+        if (g.Windows[n]->Active && (g.Windows[n]->HiddenFramesRegular > 0 || g.Windows[n]->HiddenFramesForResize > 0))
+            return 0.0f;
+
+    float timeout = FLT_MAX;
+
+    // Held buttons and keys repeat
+    bool held = false;
+    for (int n = 0; n < IM_ARRAYSIZE(g.IO.MouseDown) && !held; n++)
+        held = g.IO.MouseDown[n];
+    for (int n = 0; n < IM_ARRAYSIZE(g.IO.KeysDown) && !held; n++)
+        held = g.IO.KeysDown[n];
+    for (int n = 0; n < IM_ARRAYSIZE(g.IO.NavInputs) && !held; n++)
+        held = g.IO.NavInputs[n] > 0.0f;
+    if (held)
+        timeout = ImMin(timeout, g.IO.KeyRepeatRate);
+
+    // Text cursor blink, see InputTextEx(): visible while CursorAnim <= 0.0f, then 0.80f on and 0.40f off
+    if (g.ActiveId != 0 && g.InputTextState.ID == g.ActiveId && g.IO.ConfigInputTextCursorBlink)
+    {
+        const float anim = g.InputTextState.CursorAnim;
+        const float phase = ImFmod(ImMax(anim, 0.0f), 1.20f);
+        timeout = ImMin(timeout, anim < 0.0f ? 0.80f - anim : (phase <= 0.80f ? 0.80f - phase : 1.20f - phase));
+    }
+
+    // Pending .ini save
+    if (g.SettingsDirtyTimer > 0.0f)
+        timeout = ImMin(timeout, g.SettingsDirtyTimer);
+
+    return timeout;
+}
+
+void ImGui::UpdateIdleOutputs()
+{
+    ImGuiContext& g = *GImGui;
+    const ImU64 hash = HashDrawData(&g.DrawData);
+    g.IO.FrameChanged = hash != g.IdleDrawDataHash;
+    g.IdleDrawDataHash = hash;
+
+    // Some requests take effect a frame late (scrolling, focus, appearing windows), one quiet frame isn't enough
+    if (g.IO.FrameChanged || g.IdleInputsChanged)
+        g.IdleFrames = 0;
+    else
+        g.IdleFrames++;
+    g.IO.IdleTimeout = g.IdleFrames >= 2 ? CalcIdleTimeout() : 0.0f;
+}
+
+//-----------------------------------------------------------------------------
+// Damage tracking (io.ConfigDamageTracking)
+//-----------------------------------------------------------------------------
+
+static void AddDamage(ImVector<ImRect>* rects, const ImRect& rect, const ImRect& display)
+{
+    if (rect.IsInverted())
+        return;
+    ImRect r = rect;
+    r.ClipWithFull(display);
+
+    // Whole pixels: scissor rectangles are integers, and a partly covered pixel changes too
+    r = ImRect(ImFloor(r.Min), ImVec2(ImFloor(r.Max.x + 0.999f), ImFloor(r.Max.y + 0.999f)));
+    if (r.Min.x < r.Max.x && r.Min.y < r.Max.y)
+        rects->push_back(r);
+}
+
+static float DamageArea(const ImRect& r)
+{
+    return r.GetWidth() * r.GetHeight();
+}
+
+// Merges overlapping rectangles, then the pairs that cost the least extra area while there are too many.
+// The renderer draws everything once per rectangle, so the result must not overlap: translucent pixels would be blended twice.
+static void MergeDamage(ImVector<ImRect>* rects)
+{
+    for (;;)
+    {
+        // A merged rectangle can overlap others which didn't overlap either of its parts, so look again after every merge
+        int merge_a = -1, merge_b = -1;
+        for (int a = 0; a < rects->Size && merge_a < 0; a++)
+            for (int b = a + 1; b < rects->Size; b++)
+                if ((*rects)[a].Overlaps((*rects)[b]))
+                {
+                    merge_a = a;
+                    merge_b = b;
+                    break;
+                }
+
+        if (merge_a < 0)
+        {
+            float best_cost = FLT_MAX;
+            for (int a = 0; a < rects->Size; a++)
+                for (int b = a + 1; b < rects->Size; b++)
+                {
+                    ImRect u = (*rects)[a];
+                    u.Add((*rects)[b]);
+                    const float cost = DamageArea(u) - DamageArea((*rects)[a]) - DamageArea((*rects)[b]);
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        merge_a = a;
+                        merge_b = b;
+                    }
+                }
+            if (merge_a < 0 || (best_cost > 0.0f && rects->Size <= DAMAGE_MAX_RECTS))
+                break;
+        }
+        (*rects)[merge_a].Add((*rects)[merge_b]);
+        rects->erase(rects->Data + merge_b);
+    }
+}
+
+static const ImGuiDamageList* FindDamageList(const ImVector<ImGuiDamageList>& lists, const ImDrawList* draw_list, int hint)
+{
+    if (hint < lists.Size && lists[hint].DrawList == draw_list)
+        return &lists[hint];
+    for (int n = 0; n < lists.Size; n++)
+        if (lists[n].DrawList == draw_list)
+            return &lists[n];
+    return NULL;
+}
+
+void ImGui::UpdateDamageRects()
+{
+    ImGuiContext& g = *GImGui;
+    ImDrawData* draw_data = &g.DrawData;
+    g.DamageListsPrev.swap(g.DamageLists);
+    g.DamageLists.resize(0);
+
+    const ImVec2 display_max = draw_data->DisplayPos + draw_data->DisplaySize;
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* draw_list = draw_data->CmdLists[n];
+        ImGuiDamageList list;
+        list.DrawList = draw_list;
+        list.Below = n > 0 ? draw_data->CmdLists[n - 1] : NULL;
+        list.Hash = HashDrawList(draw_list, 0xCBF29CE484222325ULL);
+        list.Volatile = false;
+
+        ImRect clip(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (const ImDrawCmd* cmd = draw_list->CmdBuffer.begin(); cmd != draw_list->CmdBuffer.end(); cmd++)
+        {
+            clip.Add(ImRect(cmd->ClipRect));
+            list.Volatile |= cmd->UserCallback != NULL;
+        }
+        list.Bounds = ImRect(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (const ImDrawVert* vtx = draw_list->VtxBuffer.begin(); vtx != draw_list->VtxBuffer.end(); vtx++)
+            list.Bounds.Add(vtx->pos);
+        if (!list.Bounds.IsInverted())
+            list.Bounds.ClipWithFull(clip);
+        if (list.Volatile)
+            list.Bounds = clip;
+        g.DamageLists.push_back(list);
+    }
+
+    ImVector<ImRect> rects;
+    const ImRect display(draw_data->DisplayPos, display_max);
+    if (draw_data->DisplaySize.x != g.DamageDisplaySize.x || draw_data->DisplaySize.y != g.DamageDisplaySize.y)
+    {
+        rects.push_back(display);
+    }
+    else
+    {
+        for (int n = 0; n < g.DamageLists.Size; n++)
+        {
+            const ImGuiDamageList& list = g.DamageLists[n];
+            const ImGuiDamageList* prev = FindDamageList(g.DamageListsPrev, list.DrawList, n);
+            if (prev && prev->Hash == list.Hash && prev->Below == list.Below && !list.Volatile)
+                continue;
+            AddDamage(&rects, list.Bounds, display);
+            if (prev)
+                AddDamage(&rects, prev->Bounds, display);
+        }
+        for (int n = 0; n < g.DamageListsPrev.Size; n++)
+            if (!FindDamageList(g.DamageLists, g.DamageListsPrev[n].DrawList, n))
+                AddDamage(&rects, g.DamageListsPrev[n].Bounds, display);
+        MergeDamage(&rects);
+
+        float area = 0.0f;
+        for (int n = 0; n < rects.Size; n++)
+            area += DamageArea(rects[n]);
+        if (area > DamageArea(display) * DAMAGE_FULL_SCREEN_RATIO)
+        {
+            rects.resize(0);
+            rects.push_back(display);
+        }
+    }
+    g.DamageDisplaySize = draw_data->DisplaySize;
+
+    g.DamageRects.reserve(DAMAGE_MAX_RECTS);  // Non-NULL when empty, NULL means untracked
+    g.DamageRects.resize(0);
+    for (int n = 0; n < rects.Size; n++)
+        g.DamageRects.push_back(ImVec4(rects[n].Min.x, rects[n].Min.y, rects[n].Max.x, rects[n].Max.y));
+    draw_data->DamageRects = g.DamageRects.Data;
+    draw_data->DamageRectsCount = g.DamageRects.Size;
+}
+
 // This is normally called by Render(). You may want to call it directly if you want to avoid calling Render() but the gain will be very minimal.
 void ImGui::EndFrame()
 {
@@ -3641,6 +4419,11 @@ void ImGui::Render()
         EndFrame();
     g.FrameCountRendered = g.FrameCount;
 
+    // Finish the draw lists that recorded their calls: reuse last frame's geometry or build it now
+    for (int n = 0; n != g.Windows.Size; n++)
+        if (g.Windows[n]->DrawListCache.Active)
+            DrawListCacheEndFrame(g.Windows[n]->DrawList, &g.Windows[n]->DrawListCache);
+
     // Gather ImDrawList to render (for each active window)
     g.IO.MetricsRenderVertices = g.IO.MetricsRenderIndices = g.IO.MetricsRenderWindows = 0;
     g.DrawDataBuilder.Clear();
@@ -3670,6 +4453,29 @@ void ImGui::Render()
     g.IO.MetricsRenderVertices = g.DrawData.TotalVtxCount;
     g.IO.MetricsRenderIndices = g.DrawData.TotalIdxCount;
 
+    // Tell the application which parts of the frame changed
+    if (g.IO.ConfigDamageTracking)
+    {
+        UpdateDamageRects();
+    }
+    else
+    {
+        g.DamageLists.resize(0);
+        g.DamageDisplaySize = ImVec2(FLT_MAX, FLT_MAX);
+    }
+
+    // Tell the application whether this frame needs presenting, and how long it may sleep
+    if (g.IO.ConfigIdleDetection)
+    {
+        UpdateIdleOutputs();
+    }
+    else
+    {
+        g.IO.FrameChanged = true;
+        g.IO.IdleTimeout = 0.0f;
+    }
+    g.AllocCheckActive = false;
+
     // Render. If user hasn't set a callback then they may retrieve the draw data via GetDrawData()
 #ifndef IMGUI_DISABLE_OBSOLETE_FUNCTIONS
     if (g.DrawData.CmdListsCount > 0 && g.IO.RenderDrawListsFn != NULL)
@@ -3677,12 +4483,121 @@ void ImGui::Render()
 #endif
 }
 
+//-----------------------------------------------------------------------------
+// Text size cache (io.ConfigTextSizeCache)
+//-----------------------------------------------------------------------------
+
+// Sizes returned by CalcTextSize() for short texts, found through hash buckets and evicted least recently used first
+
+static void TextSizeCacheUnlink(int idx)
+{
+    ImGuiContext& g = *GImGui;
+    ImGuiTextSizeCacheEntry& entry = g.TextSizeCache[idx];
+    if (entry.LruPrev != -1) g.TextSizeCache[entry.LruPrev].LruNext = entry.LruNext; else g.TextSizeCacheLruHead = entry.LruNext;
+    if (entry.LruNext != -1) g.TextSizeCache[entry.LruNext].LruPrev = entry.LruPrev; else g.TextSizeCacheLruTail = entry.LruPrev;
+}
+
+static void TextSizeCachePushFront(int idx)
+{
+    ImGuiContext& g = *GImGui;
+    ImGuiTextSizeCacheEntry& entry = g.TextSizeCache[idx];
+    entry.LruPrev = -1;
+    entry.LruNext = g.TextSizeCacheLruHead;
+    if (g.TextSizeCacheLruHead != -1) g.TextSizeCache[g.TextSizeCacheLruHead].LruPrev = idx; else g.TextSizeCacheLruTail = idx;
+    g.TextSizeCacheLruHead = idx;
+}
+
+// Entries of fonts that were rebuilt since don't match their Generation anymore, and get evicted as they age
+static ImGuiTextSizeCacheEntry* FindTextSizeCacheEntry(const ImGuiTextSizeCacheEntry& key)
+{
+    ImGuiContext& g = *GImGui;
+    if (g.TextSizeCacheBuckets.empty())
+        return NULL;
+    for (int idx = g.TextSizeCacheBuckets[(int)(key.TextHash >> (64 - TEXT_SIZE_CACHE_BUCKETS_LOG2))]; idx != -1; idx = g.TextSizeCache[idx].BucketNext)
+    {
+        ImGuiTextSizeCacheEntry& entry = g.TextSizeCache[idx];
+        if (entry.TextHash == key.TextHash && entry.Font == key.Font && entry.FontGeneration == key.FontGeneration && entry.FontSize == key.FontSize && entry.WrapWidth == key.WrapWidth && entry.HideTextAfterDoubleHash == key.HideTextAfterDoubleHash)
+        {
+            if (idx != g.TextSizeCacheLruHead)
+            {
+                TextSizeCacheUnlink(idx);
+                TextSizeCachePushFront(idx);
+            }
+            return &entry;
+        }
+    }
+    return NULL;
+}
+
+static void AddTextSizeCacheEntry(const ImGuiTextSizeCacheEntry& key, const ImVec2& size)
+{
+    ImGuiContext& g = *GImGui;
+    if (g.TextSizeCacheBuckets.empty())
+    {
+        // Allocate it whole, growing it by push_back() would allocate every so often for as long as new texts appear (e.g. a frame time display)
+        g.TextSizeCacheBuckets.resize(1 << TEXT_SIZE_CACHE_BUCKETS_LOG2, -1);
+        g.TextSizeCache.reserve(TEXT_SIZE_CACHE_CAPACITY);
+    }
+
+    int idx;
+    if (g.TextSizeCache.Size < TEXT_SIZE_CACHE_CAPACITY)
+    {
+        idx = g.TextSizeCache.Size;
+        g.TextSizeCache.push_back(key);
+    }
+    else
+    {
+        // Evict the least recently used entry
+        idx = g.TextSizeCacheLruTail;
+        TextSizeCacheUnlink(idx);
+        int* link = &g.TextSizeCacheBuckets[(int)(g.TextSizeCache[idx].TextHash >> (64 - TEXT_SIZE_CACHE_BUCKETS_LOG2))];
+        while (*link != idx)
+            link = &g.TextSizeCache[*link].BucketNext;
+        *link = g.TextSizeCache[idx].BucketNext;
+        g.TextSizeCache[idx] = key;
+        g.TextSizeCacheEvictions++;
+    }
+
+    ImGuiTextSizeCacheEntry& entry = g.TextSizeCache[idx];
+    int& bucket = g.TextSizeCacheBuckets[(int)(key.TextHash >> (64 - TEXT_SIZE_CACHE_BUCKETS_LOG2))];
+    entry.Size = size;
+    entry.BucketNext = bucket;
+    bucket = idx;
+    TextSizeCachePushFront(idx);
+}
+
 // Calculate text size. Text can be multi-line. Optionally ignore text after a ## marker.
 // CalcTextSize("") should return ImVec2(0.0f, GImGui->FontSize)
 ImVec2 ImGui::CalcTextSize(const char* text, const char* text_end, bool hide_text_after_double_hash, float wrap_width)
 {
     ImGuiContext& g = *GImGui;
 
+    // Look the whole text up first, so that a hit skips FindRenderedTextEnd() too
+    ImGuiTextSizeCacheEntry cache_key;
+    bool use_cache = false;
+    if (g.IO.ConfigTextSizeCache)
+    {
+        if (!text_end)
+            text_end = text + strlen(text);
+        const int text_len = (int)(text_end - text);
+        if (text_len <= TEXT_SIZE_CACHE_MAX_TEXT_LENGTH)
+        {
+            use_cache = true;
+            cache_key.TextHash = HashBytes64(text, (size_t)text_len, 0xCBF29CE484222325ULL ^ (ImU64)text_len);
+            cache_key.Font = g.Font;
+            cache_key.FontGeneration = g.Font->Generation;
+            cache_key.FontSize = g.FontSize;
+            cache_key.WrapWidth = wrap_width;
+            cache_key.HideTextAfterDoubleHash = hide_text_after_double_hash;
+            if (const ImGuiTextSizeCacheEntry* entry = FindTextSizeCacheEntry(cache_key))
+            {
+                g.TextSizeCacheHits++;
+                return entry->Size;
+            }
+            g.TextSizeCacheMisses++;
+        }
+    }
+
     const char* text_display_end;
     if (hide_text_after_double_hash)
         text_display_end = FindRenderedTextEnd(text, text_end);      // Hide anything after a '##' string
@@ -3692,7 +4607,11 @@ ImVec2 ImGui::CalcTextSize(const char* text, const char* text_end, bool hide_tex
     ImFont* font = g.Font;
     const float font_size = g.FontSize;
     if (text == text_display_end)
+    {
+        if (use_cache)
+            AddTextSizeCacheEntry(cache_key, ImVec2(0.0f, font_size));
         return ImVec2(0.0f, font_size);
+    }
     ImVec2 text_size = font->CalcTextSizeA(font_size, FLT_MAX, wrap_width, text, text_display_end, NULL);
 
     // Cancel out character spacing for the last character of a line (it is baked into glyph->AdvanceX field)
@@ -3702,6 +4621,8 @@ ImVec2 ImGui::CalcTextSize(const char* text, const char* text_end, bool hide_tex
         text_size.x -= character_spacing_x;
     text_size.x = (float)(int)(text_size.x + 0.95f);
 
+    if (use_cache)
+        AddTextSizeCacheEntry(cache_key, text_size);
     return text_size;
 }
 
@@ -4878,8 +5799,22 @@ bool ImGui::Begin(const char* name, bool* p_open, ImGuiWindowFlags flags)
 
         // DRAWING
 
+        // Modal and window list backgrounds darken the whole viewport, outside of what a cached draw list can record
+        const bool dim_bg_for_modal = (flags & ImGuiWindowFlags_Modal) && window == GetFrontMostPopupModal() && window->HiddenFramesForResize <= 0;
+        const bool dim_bg_for_window_list = g.NavWindowingTargetAnim && (window == g.NavWindowingTargetAnim->RootWindow);
+
         // Setup draw list and outer clipping rectangle
-        window->DrawList->Clear();
+        if ((flags & ImGuiWindowFlags_CacheDrawList) && !dim_bg_for_modal && !dim_bg_for_window_list)
+        {
+            ImRect draw_bounds = window->Rect();
+            draw_bounds.Expand(g.FontSize * 2.0f);  // Borders and the windowing highlight reach a little outside the window
+            DrawListCacheBeginFrame(window->DrawList, &window->DrawListCache, window->Pos, draw_bounds);
+        }
+        else
+        {
+            window->DrawList->Clear();
+            window->DrawListCache.PrevValid = false;
+        }
         window->DrawList->Flags = (g.Style.AntiAliasedLines ? ImDrawListFlags_AntiAliasedLines : 0) | (g.Style.AntiAliasedFill ? ImDrawListFlags_AntiAliasedFill : 0);
         window->DrawList->PushTextureID(g.Font->ContainerAtlas->TexID);
         ImRect viewport_rect(GetViewportRect());
@@ -4889,8 +5824,6 @@ bool ImGui::Begin(const char* name, bool* p_open, ImGuiWindowFlags flags)
             PushClipRect(viewport_rect.Min, viewport_rect.Max, true);
 
         // Draw modal window background (darkens what is behind them, all viewports)
-        const bool dim_bg_for_modal = (flags & ImGuiWindowFlags_Modal) && window == GetFrontMostPopupModal() && window->HiddenFramesForResize <= 0;
-        const bool dim_bg_for_window_list = g.NavWindowingTargetAnim && (window == g.NavWindowingTargetAnim->RootWindow);
         if (dim_bg_for_modal || dim_bg_for_window_list)
         {
             const ImU32 dim_bg_col = GetColorU32(dim_bg_for_modal ? ImGuiCol_ModalWindowDimBg : ImGuiCol_NavWindowingDimBg, g.DimBgRatio);
@@ -8096,7 +9029,7 @@ void ImGui::ClearDragDrop()
     g.DragDropAcceptIdCurrRectSurface = FLT_MAX;
     g.DragDropAcceptFrameCount = -1;
 
-    g.DragDropPayloadBufHeap.clear();
+    g.DragDropPayloadBufHeap.resize(0);
     memset(&g.DragDropPayloadBufLocal, 0, sizeof(g.DragDropPayloadBufLocal));
 }
 
@@ -8513,7 +9446,7 @@ void ImGui::LogFinish()
     if (g.LogClipboard.size() > 1)
     {
         SetClipboardText(g.LogClipboard.begin());
-        g.LogClipboard.clear();
+        g.LogClipboard.reset();
     }
     g.LogEnabled = false;
 }
@@ -8612,7 +9545,7 @@ void ImGui::LoadIniSettingsFromMemory(const char* ini_data, size_t ini_size)
     // For our convenience and to make the code simpler, we'll also write zero-terminators within the buffer. So let's create a writable copy..
     if (ini_size == 0)
         ini_size = strlen(ini_data);
-    char* buf = (char*)ImGui::MemAlloc(ini_size + 1);
+    char* buf = (char*)ImGui::MemAlloc(ini_size + 1, ImGuiAllocTag_Temp);
     char* buf_end = buf + ini_size;
     memcpy(buf, ini_data, ini_size);
     buf[ini_size] = 0;
@@ -8659,7 +9592,7 @@ void ImGui::LoadIniSettingsFromMemory(const char* ini_data, size_t ini_size)
             entry_handler->ReadLineFn(&g, entry_handler, entry_data, line);
         }
     }
-    ImGui::MemFree(buf);
+    ImGui::MemFree(buf, ImGuiAllocTag_Temp);
     g.SettingsLoaded = true;
 }
 
@@ -8780,7 +9713,7 @@ static void SettingsHandlerWindow_WriteAll(ImGuiContext* imgui_ctx, ImGuiSetting
 static const char* GetClipboardTextFn_DefaultImpl(void*)
 {
     static ImVector<char> buf_local;
-    buf_local.clear();
+    buf_local.resize(0);
     if (!::OpenClipboard(NULL))
         return NULL;
     HANDLE wbuf_handle = ::GetClipboardData(CF_UNICODETEXT);
@@ -8797,7 +9730,7 @@ static const char* GetClipboardTextFn_DefaultImpl(void*)
     }
     ::GlobalUnlock(wbuf_handle);
     ::CloseClipboard();
-    return buf_local.Data;
+    return buf_local.empty() ? NULL : buf_local.Data;
 }
 
 static void SetClipboardTextFn_DefaultImpl(void*, const char* text)
@@ -8833,7 +9766,6 @@ static const char* GetClipboardTextFn_DefaultImpl(void*)
 static void SetClipboardTextFn_DefaultImpl(void*, const char* text)
 {
     ImGuiContext& g = *GImGui;
-    g.PrivateClipboard.clear();
     const char* text_end = text + strlen(text);
     g.PrivateClipboard.resize((int)(text_end - text) + 1);
     memcpy(&g.PrivateClipboard[0], text, (size_t)(text_end - text));
@@ -8871,6 +9803,29 @@ static void ImeSetInputScreenPosFn_DefaultImpl(int, int) {}
 
 #endif
 
+// Call stacks of the allocations reported with io.ConfigDebugAllocCheckFrames
+#if defined(_WIN32) && defined(_WINDOWS_)
+
+static int CaptureCallStack(void** frames, int frames_max)
+{
+    return (int)::CaptureStackBackTrace(1, (DWORD)frames_max, frames, NULL);
+}
+
+#elif defined(__GLIBC__)
+
+#include <execinfo.h>   // backtrace()
+
+static int CaptureCallStack(void** frames, int frames_max)
+{
+    return backtrace(frames, frames_max);
+}
+
+#else
+
+static int CaptureCallStack(void**, int) { return 0; }
+
+#endif
+
 //-----------------------------------------------------------------------------
 // [SECTION] METRICS/DEBUG WINDOW
 //-----------------------------------------------------------------------------
@@ -8987,6 +9942,8 @@ void ImGui::ShowMetricsWindow(bool* p_open)
                 (flags & ImGuiWindowFlags_Modal)        ? "Modal " : "",      (flags & ImGuiWindowFlags_ChildMenu)   ? "ChildMenu " : "",  (flags & ImGuiWindowFlags_NoSavedSettings) ? "NoSavedSettings " : "",
                 (flags & ImGuiWindowFlags_NoMouseInputs)? "NoMouseInputs":"", (flags & ImGuiWindowFlags_NoNavInputs) ? "NoNavInputs" : "", (flags & ImGuiWindowFlags_AlwaysAutoResize) ? "AlwaysAutoResize" : "");
             ImGui::BulletText("Scroll: (%.2f/%.2f,%.2f/%.2f)", window->Scroll.x, GetWindowScrollMaxX(window), window->Scroll.y, GetWindowScrollMaxY(window));
+            if (flags & ImGuiWindowFlags_CacheDrawList)
+                ImGui::BulletText("DrawListCache: %d reused, %d rebuilt, %d not recorded", window->DrawListCache.HitCount, window->DrawListCache.MissCount, window->DrawListCache.FlushCount);
             ImGui::BulletText("Active: %d/%d, WriteAccessed: %d, BeginOrderWithinContext: %d", window->Active, window->WasActive, window->WriteAccessed, (window->Active || window->WasActive) ? window->BeginOrderWithinContext : -1);
             ImGui::BulletText("Appearing: %d, Hidden: %d (Reg %d Resize %d), SkipItems: %d", window->Appearing, window->Hidden, window->HiddenFramesRegular, window->HiddenFramesForResize, window->SkipItems);
             ImGui::BulletText("NavLastIds: 0x%08X,0x%08X, NavLayerActiveMask: %X", window->NavLastIds[0], window->NavLastIds[1], window->DC.NavLayerActiveMask);
@@ -9027,6 +9984,32 @@ void ImGui::ShowMetricsWindow(bool* p_open)
             Funcs::NodeDrawList(NULL, g.DrawDataBuilder.Layers[0][i], "DrawList");
         ImGui::TreePop();
     }
+    if (ImGui::TreeNode("TextSizeCache", "Text size cache (%d/%d entries)", g.TextSizeCache.Size, TEXT_SIZE_CACHE_CAPACITY))
+    {
+        const int lookups = g.TextSizeCacheHitsLastFrame + g.TextSizeCacheMissesLastFrame;
+        ImGui::BulletText("Last frame: %d lookups, %d hits (%.1f%%), %d misses, %d evictions", lookups, g.TextSizeCacheHitsLastFrame, lookups > 0 ? 100.0f * g.TextSizeCacheHitsLastFrame / lookups : 0.0f, g.TextSizeCacheMissesLastFrame, g.TextSizeCacheEvictionsLastFrame);
+        ImGui::BulletText("Enabled: %d (io.ConfigTextSizeCache), texts up to %d bytes", g.IO.ConfigTextSizeCache, TEXT_SIZE_CACHE_MAX_TEXT_LENGTH);
+        ImGui::TreePop();
+    }
+    if (ImGui::TreeNode("AllocCheck", "Steady state allocations (%d)", g.AllocReportsCount))
+    {
+        if (g.IO.ConfigDebugAllocCheckFrames < 0)
+            ImGui::BulletText("Disabled, set io.ConfigDebugAllocCheckFrames to the number of warm-up frames");
+        else
+            ImGui::BulletText("Checking frames after %d (io.ConfigDebugAllocCheckFrames)", g.IO.ConfigDebugAllocCheckFrames);
+        const int reports_count = ImMin(g.AllocReportsCount, IM_ARRAYSIZE(g.AllocReports));
+        for (int n = 0; n < reports_count; n++)
+        {
+            const ImGuiAllocReport& report = g.AllocReports[(g.AllocReportsCount - 1 - n) % IM_ARRAYSIZE(g.AllocReports)];
+            if (ImGui::TreeNode((void*)(intptr_t)n, "Frame %d: %d bytes%s", report.Frame, (int)report.Size, report.Tag == ImGuiAllocTag_Temp ? " (temp)" : ""))
+            {
+                for (int i = 0; i < report.CallStackSize; i++)
+                    ImGui::BulletText("%p", report.CallStack[i]);
+                ImGui::TreePop();
+            }
+        }
+        ImGui::TreePop();
+    }
     if (ImGui::TreeNode("Popups", "Popups (%d)", g.OpenPopupStack.Size))
     {
         for (int i = 0; i < g.OpenPopupStack.Size; i++)
@@ -65,6 +65,7 @@ struct ImDrawCmd;                   // A single draw command within a parent ImD
 struct ImDrawData;                  // All draw command lists required to render the frame
 struct ImDrawList;                  // A single draw command list (generally one per window, conceptually you may see this as a dynamic "mesh" builder)
 struct ImDrawListSharedData;        // Data shared among multiple draw lists (typically owned by parent ImGui context, but you may create one yourself)
+struct ImDrawListCache;             // Last frame's output of a draw list, reused while the same calls come in (see ImGuiWindowFlags_CacheDrawList)
 struct ImDrawVert;                  // A single vertex (20 bytes by default, override layout with IMGUI_OVERRIDE_DRAWVERT_STRUCT_LAYOUT)
 struct ImFont;                      // Runtime data for a single font within a parent ImFontAtlas
 struct ImFontAtlas;                 // Runtime data for multiple fonts, bake multiple fonts into a single texture, TTF/OTF font loader
@@ -89,6 +90,7 @@ struct ImGuiTextBuffer;             // Helper to hold and append into a text buf
 // Use your programming IDE "Go to definition" facility on the names of the center columns to find the actual flags/enum lists.
 typedef unsigned int ImGuiID;       // Unique ID used by widgets (typically hashed from a stack of string)
 typedef unsigned short ImWchar;     // Character for keyboard input/display
+typedef int ImGuiAllocTag;          // -> enum ImGuiAllocTag_        // Enum: A lifetime hint for MemAlloc()/MemFree()
 typedef int ImGuiCol;               // -> enum ImGuiCol_             // Enum: A color identifier for styling
 typedef int ImGuiCond;              // -> enum ImGuiCond_            // Enum: A condition for Set*()
 typedef int ImGuiDataType;          // -> enum ImGuiDataType_        // Enum: A primary data type
@@ -603,9 +605,12 @@ namespace ImGui
     // Memory Utilities
     // All those functions are not reliant on the current context.
     // If you reload the contents of imgui.cpp at runtime, you may need to call SetCurrentContext() + SetAllocatorFunctions() again.
+    // The tagged version lets your functions route blocks by lifetime (see ImGuiAllocTag_). free_func receives the tag the block was allocated with.
+    // The default functions serve ImGuiAllocTag_Temp blocks from a scratch arena and small ImGuiAllocTag_Default blocks from size class pools, so MemFree() only accepts memory from MemAlloc().
     IMGUI_API void          SetAllocatorFunctions(void* (*alloc_func)(size_t sz, void* user_data), void(*free_func)(void* ptr, void* user_data), void* user_data = NULL);
-    IMGUI_API void*         MemAlloc(size_t size);
-    IMGUI_API void          MemFree(void* ptr);
+    IMGUI_API void          SetAllocatorFunctions(void* (*alloc_func)(size_t sz, ImGuiAllocTag tag, void* user_data), void(*free_func)(void* ptr, ImGuiAllocTag tag, void* user_data), void* user_data = NULL);
+    IMGUI_API void*         MemAlloc(size_t size, ImGuiAllocTag tag = 0);
+    IMGUI_API void          MemFree(void* ptr, ImGuiAllocTag tag = 0);      // pass the tag given to MemAlloc()
 
 } // namespace ImGui
 
@@ -632,6 +637,7 @@ enum ImGuiWindowFlags_
     ImGuiWindowFlags_AlwaysUseWindowPadding = 1 << 16,  // Ensure child windows without border uses style.WindowPadding (ignored by default for non-bordered child windows, because more convenient)
     ImGuiWindowFlags_NoNavInputs            = 1 << 18,  // No gamepad/keyboard navigation within the window
     ImGuiWindowFlags_NoNavFocus             = 1 << 19,  // No focusing toward this window with gamepad/keyboard navigation (e.g. skipped by CTRL+TAB)
+    ImGuiWindowFlags_CacheDrawList          = 1 << 20,  // Reuse last frame's vertices when the window draws exactly the same, moved or not. Only draws inside its bounds (the window's rectangle expanded by 2*FontSize): anything further out is clipped. Not cached on frames dimming the background for a modal or the window list (see ImDrawListCache)
     ImGuiWindowFlags_NoNav                  = ImGuiWindowFlags_NoNavInputs | ImGuiWindowFlags_NoNavFocus,
     ImGuiWindowFlags_NoDecoration           = ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoCollapse,
     ImGuiWindowFlags_NoInputs               = ImGuiWindowFlags_NoMouseInputs | ImGuiWindowFlags_NoNavInputs | ImGuiWindowFlags_NoNavFocus,
@@ -1046,6 +1052,14 @@ enum ImGuiCond_
 #endif
 };
 
+// Lifetime hint for ImGui::MemAlloc()/MemFree(), passed to the allocator functions (see SetAllocatorFunctions())
+enum ImGuiAllocTag_
+{
+    ImGuiAllocTag_Default   = 0,        // Block of unknown lifetime: ImVector<> buffers, windows, font data, strings...
+    ImGuiAllocTag_Temp      = 1,        // Scratch block freed by the function that allocated it, e.g. while building the font atlas or parsing the .ini data
+    ImGuiAllocTag_COUNT
+};
+
 // You may modify the ImGui::GetStyle() main instance during initialization and before NewFrame().
 // During the frame, use ImGui::PushStyleVar(ImGuiStyleVar_XXXX)/PopStyleVar() to alter the main style values, and ImGui::PushStyleColor(ImGuiCol_XXX)/PopStyleColor() for colors.
 struct ImGuiStyle
@@ -1121,6 +1135,11 @@ struct ImGuiIO
     bool          ConfigMacOSXBehaviors;        // = defined(__APPLE__) // OS X style: Text editing cursor movement using Alt instead of Ctrl, Shortcuts using Cmd/Super instead of Ctrl, Line/Text Start and End using Cmd+Arrows instead of Home/End, Double click selects by word instead of selecting whole text, Multi-selection in lists uses Cmd/Super instead of Ctrl (was called io.OptMacOSXBehaviors prior to 1.63)
     bool          ConfigInputTextCursorBlink;   // = true           // Set to false to disable blinking cursor, for users who consider it distracting. (was called: io.OptCursorBlink prior to 1.63)
     bool          ConfigResizeWindowsFromEdges; // = false          // [BETA] Enable resizing of windows from their edges and from the lower-left corner. This requires (io.BackendFlags & ImGuiBackendFlags_HasMouseCursors) because it needs mouse cursor feedback. (This used to be the ImGuiWindowFlags_ResizeFromAnySide flag)
+    bool          ConfigIdleDetection;          // = false          // Set io.FrameChanged and io.IdleTimeout in Render(), for applications that stop rendering while nothing changes. Costs a hash of the draw data every frame.
+    bool          ConfigDamageTracking;         // = false          // Fill ImDrawData::DamageRects in Render(), for renderers that keep the previous frame's pixels. Costs a hash of the draw data every frame (shared with io.ConfigIdleDetection).
+    bool          ConfigTextSizeCache;          // = true           // Remember the sizes CalcTextSize() returned for short texts (labels), keyed by font, size, wrap width and a hash of the text. See the Metrics window for its hit rate.
+    int           ConfigDebugAllocCheckFrames;  // = -1             // Once this many frames have passed, record every MemAlloc() made between NewFrame() and the end of Render() with its call stack, and list them in the Metrics window. A UI in a steady state shouldn't allocate. -1 to disable.
+    bool          ConfigDebugAllocCheckAssert;  // = false          // With io.ConfigDebugAllocCheckFrames: also assert on each of those allocations, to break in the debugger.
 
     //------------------------------------------------------------------
     // Settings (User Functions)
@@ -1185,6 +1204,8 @@ struct ImGuiIO
     int         MetricsActiveWindows;       // Number of active windows
     int         MetricsActiveAllocations;   // Number of active allocations, updated by MemAlloc/MemFree based on current context. May be off if you have multiple imgui contexts.
     ImVec2      MouseDelta;                 // Mouse delta. Note that this is zero if either current or previous position are invalid (-FLT_MAX,-FLT_MAX), so a disappearing/reappearing mouse won't have a huge delta.
+    bool        FrameChanged;               // With io.ConfigIdleDetection: the draw data of the last Render() differs from the frame before. When false you may skip rendering and presenting it. Always true otherwise.
+    float       IdleTimeout;                // With io.ConfigIdleDetection: seconds you may wait for input before the next NewFrame(). 0.0f while anything is changing, the time to the next timed change (text cursor blink, key repeat, .ini saving) once it settled, FLT_MAX when only input can change anything. Always 0.0f otherwise.
 
     //------------------------------------------------------------------
     // [Internal] ImGui will maintain those fields. Forward compatibility not guaranteed!
@@ -1378,13 +1399,14 @@ struct ImGuiTextBuffer
 
     ImGuiTextBuffer()   { }
     inline char         operator[](int i)       { IM_ASSERT(Buf.Data != NULL); return Buf.Data[i]; }
-    const char*         begin() const           { return Buf.Data ? &Buf.front() : EmptyString; }
-    const char*         end() const             { return Buf.Data ? &Buf.back() : EmptyString; }   // Buf is zero-terminated, so end() will point on the zero-terminator
-    int                 size() const            { return Buf.Data ? Buf.Size - 1 : 0; }
+    const char*         begin() const           { return Buf.Size ? &Buf.front() : EmptyString; }
+    const char*         end() const             { return Buf.Size ? &Buf.back() : EmptyString; }   // Buf is zero-terminated, so end() will point on the zero-terminator
+    int                 size() const            { return Buf.Size ? Buf.Size - 1 : 0; }
     bool                empty()                 { return Buf.Size <= 1; }
     void                clear()                 { Buf.clear(); }
+    void                reset()                 { Buf.resize(0); }  // Empty it but keep the memory, for a buffer which is filled again later
     void                reserve(int capacity)   { Buf.reserve(capacity); }
-    const char*         c_str() const           { return Buf.Data ? Buf.Data : EmptyString; }
+    const char*         c_str() const           { return Buf.Size ? Buf.Data : EmptyString; }
     IMGUI_API void      appendf(const char* fmt, ...) IM_FMTARGS(2);
     IMGUI_API void      appendfv(const char* fmt, va_list args) IM_FMTLIST(2);
 };
@@ -1392,7 +1414,8 @@ struct ImGuiTextBuffer
 // Helper: Key->Value storage
 // Typically you don't have to worry about this since a storage is held within each Window.
 // We use it to e.g. store collapse state for a tree (Int 0/1)
-// This is optimized for efficient lookup (dichotomy into a contiguous buffer) and rare insertion (typically tied to user interactions aka max once a frame)
+// This is optimized for efficient lookup: an open-addressing hash table in a contiguous buffer (Robin Hood linear probing), so lookups and insertions are O(1).
+// Define IMGUI_USE_SORTED_STORAGE in imconfig.h to get the original sorted buffer (dichotomy lookup, insertion moves the pairs after it).
 // You can use it as custom user storage for temporary values. Declare your own storage if, for example:
 // - You want to manipulate the open/close state of a particular sub-tree in your interface (tree node uses Int 0/1 to store their state).
 // - You want to store custom debug data easily without adding or editing structures in your code (probably not efficient, but convenient)
@@ -1407,12 +1430,26 @@ struct ImGuiStorage
         Pair(ImGuiID _key, float _val_f) { key = _key; val_f = _val_f; }
         Pair(ImGuiID _key, void* _val_p) { key = _key; val_p = _val_p; }
     };
-    ImVector<Pair>      Data;
+#ifdef IMGUI_USE_SORTED_STORAGE
+    ImVector<Pair>      Data;           // Sorted by key
 
     // - Get***() functions find pair, never add/allocate. Pairs are sorted so a query is O(log N)
     // - Set***() functions find pair, insertion on demand if missing.
     // - Sorted insertion is costly, paid once. A typical frame shouldn't need to insert any new pair.
     void                Clear() { Data.clear(); }
+#else
+    ImVector<Pair>      Data;           // Hash table slots, Size is 0 or a power of 2. Key 0 marks an empty slot
+    int                 Count;          // Number of used slots in Data (ZeroKey not included)
+    bool                ZeroKeyUsed;    // Key 0 can't live in Data, its pair is ZeroKey
+    Pair                ZeroKey;
+
+    ImGuiStorage() : Count(0), ZeroKeyUsed(false), ZeroKey(0, 0) {}
+
+    // - Get***() functions find pair, never add/allocate. A query hashes the key then probes a few neighbouring slots: O(1)
+    // - Set***() functions find pair, insertion on demand if missing. The table doubles when 3/4 full.
+    // - Iteration order of Data is unspecified, skip the pairs with key 0.
+    void                Clear() { Data.clear(); Count = 0; ZeroKeyUsed = false; }
+#endif
     IMGUI_API int       GetInt(ImGuiID key, int default_val = 0) const;
     IMGUI_API void      SetInt(ImGuiID key, int val);
     IMGUI_API bool      GetBool(ImGuiID key, bool default_val = false) const;
@@ -1435,6 +1472,7 @@ struct ImGuiStorage
     IMGUI_API void      SetAllInt(int val);
 
     // For quicker full rebuild of a storage (instead of an incremental one), you may add all your contents and then sort once.
+    // With the hash table this rehashes every non-zero key pushed into Data. Use SetInt() & co for key 0.
     IMGUI_API void      BuildSortByKey();
 };
 
@@ -1677,6 +1715,7 @@ struct ImDrawList
     int                     _ChannelsCurrent;   // [Internal] current channel number (0)
     int                     _ChannelsCount;     // [Internal] number of active channels (1+)
     ImVector<ImDrawChannel> _Channels;          // [Internal] draw channels for columns API (not resized down so _ChannelsCount may be smaller than _Channels.Size)
+    ImDrawListCache*        _Recording;         // [Internal] when set, primitives are recorded into it instead of building geometry (see ImGuiWindowFlags_CacheDrawList)
 
     // If you want to create ImDrawList instances, pass them ImGui::GetDrawListSharedData() or create and use your own ImDrawListSharedData (so you can use ImDrawList without ImGui)
     ImDrawList(const ImDrawListSharedData* shared_data) { _Data = shared_data; _OwnerName = NULL; Clear(); }
@@ -1758,11 +1797,13 @@ struct ImDrawData
     int             TotalVtxCount;          // For convenience, sum of all ImDrawList's VtxBuffer.Size
     ImVec2          DisplayPos;             // Upper-left position of the viewport to render (== upper-left of the orthogonal projection matrix to use)
     ImVec2          DisplaySize;            // Size of the viewport to render (== io.DisplaySize for the main viewport) (DisplayPos + DisplaySize == lower-right of the orthogonal projection matrix to use)
+    ImVec4*         DamageRects;            // With io.ConfigDamageTracking: where the output differs from the previous Render()'s (x1,y1,x2,y2 in whole pixels, not overlapping). A renderer that kept the previous frame's pixels only has to clear and draw these. NULL without tracking: draw everything.
+    int             DamageRectsCount;       // Number of DamageRects, 0 when nothing changed
 
     // Functions
     ImDrawData()    { Valid = false; Clear(); }
     ~ImDrawData()   { Clear(); }
-    void Clear()    { Valid = false; CmdLists = NULL; CmdListsCount = TotalVtxCount = TotalIdxCount = 0; DisplayPos = DisplaySize = ImVec2(0.f, 0.f); } // The ImDrawList are owned by ImGuiContext!
+    void Clear()    { Valid = false; CmdLists = NULL; CmdListsCount = TotalVtxCount = TotalIdxCount = 0; DisplayPos = DisplaySize = ImVec2(0.f, 0.f); DamageRects = NULL; DamageRectsCount = 0; } // The ImDrawList are owned by ImGuiContext!
     IMGUI_API void  DeIndexAllBuffers();                // Helper to convert all buffers from indexed to non-indexed, in case you cannot render indexed. Note: this is slow and most likely a waste of resources. Always prefer indexed rendering!
     IMGUI_API void  ScaleClipRects(const ImVec2& sc);   // Helper to scale the ClipRect field of each ImDrawCmd. Use if your final output buffer is at a different scale than ImGui expects, or if there is a difference between your window resolution and framebuffer resolution.
 };
@@ -1943,6 +1984,9 @@ struct ImFont
     const ImFontGlyph*          FallbackGlyph;      // == FindGlyph(FontFallbackChar)
     float                       FallbackAdvanceX;   // == FallbackGlyph->AdvanceX
     ImWchar                     FallbackChar;       // = '?'        // Replacement glyph if one isn't found. Only set via SetFallbackChar()
+    ImVector<float>             AsciiQuads;         //              // With SSE2: glyphs 0x20..0x7E laid out for RenderText()'s fast path, 32 floats each (see BuildAsciiTables())
+    bool                        IntegerAsciiAdvances;//             // IndexAdvanceX[0..0x7F] are all small integers: CalcTextSizeA() and CalcWordWrapPositionA() can sum them several at a time, exactly.
+    float                       MinGlyphX0;         //              // Lowest X0 of all glyphs: RenderText() skips the rest of a line once it's further past the clip rectangle. -FLT_MAX when an AdvanceX is negative.
 
     // Members: Cold ~18/26 bytes
     short                       ConfigDataCount;    // ~ 1          // Number of ImFontConfig involved in creating this font. Bigger than 1 when merging multiple font sources into one ImFont.
@@ -1950,6 +1994,7 @@ struct ImFont
     ImFontAtlas*                ContainerAtlas;     //              // What we has been loaded into
     float                       Ascent, Descent;    //              // Ascent: distance from top to bottom of e.g. 'A' [0..FontSize]
     bool                        DirtyLookupTables;
+    ImU32                       Generation;         //              // Changes whenever the font may measure text differently (lookup tables built, characters remapped): keys ImGui::CalcTextSize()'s cache.
     int                         MetricsTotalSurface;//              // Total surface in pixels to get an idea of the font rasterization/texture cost (not exact, we approximate the cost of padding between glyphs)
 
     // Methods
@@ -1957,6 +2002,7 @@ struct ImFont
     IMGUI_API ~ImFont();
     IMGUI_API void              ClearOutputData();
     IMGUI_API void              BuildLookupTable();
+    IMGUI_API void              BuildAsciiTables();
     IMGUI_API const ImFontGlyph*FindGlyph(ImWchar c) const;
     IMGUI_API const ImFontGlyph*FindGlyphNoFallback(ImWchar c) const;
     IMGUI_API void              SetFallbackChar(ImWchar c);
@@ -8,6 +8,7 @@ Index of this file:
 // [SECTION] STB libraries implementation
 // [SECTION] Style functions
 // [SECTION] ImDrawList
+// [SECTION] ImDrawList recording (ImGuiWindowFlags_CacheDrawList)
 // [SECTION] ImDrawData
 // [SECTION] Helpers ShadeVertsXXX functions
 // [SECTION] ImFontConfig
@@ -125,8 +126,8 @@ namespace IMGUI_STB_NAMESPACE
 
 #ifndef STB_TRUETYPE_IMPLEMENTATION                         // in case the user already have an implementation in the _same_ compilation unit (e.g. unity builds)
 #ifndef IMGUI_DISABLE_STB_TRUETYPE_IMPLEMENTATION
-#define STBTT_malloc(x,u)   ((void)(u), ImGui::MemAlloc(x))
-#define STBTT_free(x,u)     ((void)(u), ImGui::MemFree(x))
+#define STBTT_malloc(x,u)   ((void)(u), ImGui::MemAlloc(x, ImGuiAllocTag_Temp))  // stb_truetype frees all its allocations before ImFontAtlasBuildWithStbTruetype() returns
+#define STBTT_free(x,u)     ((void)(u), ImGui::MemFree(x, ImGuiAllocTag_Temp))
 #define STBTT_assert(x)     IM_ASSERT(x)
 #define STBTT_fmod(x,y)     ImFmod(x,y)
 #define STBTT_sqrt(x)       ImSqrt(x)
@@ -351,6 +352,7 @@ void ImDrawList::Clear()
     _Path.resize(0);
     _ChannelsCurrent = 0;
     _ChannelsCount = 1;
+    _Recording = NULL;
     // NB: Do not clear channels so our allocations are re-used after the first frame.
 }
 
@@ -367,6 +369,7 @@ void ImDrawList::ClearFreeMemory()
     _Path.clear();
     _ChannelsCurrent = 0;
     _ChannelsCount = 1;
+    _Recording = NULL;
     for (int i = 0; i < _Channels.Size; i++)
     {
         if (i == 0) memset(&_Channels[0], 0, sizeof(_Channels[0]));  // channel 0 is a copy of CmdBuffer/IdxBuffer, don't destruct again
@@ -386,12 +389,77 @@ ImDrawList* ImDrawList::CloneOutput() const
     return dst;
 }
 
+// Recorded calls, see ImDrawListCache. Each one is an ImDrawListOpHeader followed by its arguments and then its data (points,
+// text), both padded to 8 bytes. Records are zeroed first so that padding compares equal from one frame to the next.
+enum ImDrawListOp_
+{
+    ImDrawListOp_PushClipRect,
+    ImDrawListOp_PopClipRect,
+    ImDrawListOp_PushTextureID,
+    ImDrawListOp_PopTextureID,
+    ImDrawListOp_Polyline,
+    ImDrawListOp_ConvexPolyFilled,
+    ImDrawListOp_RectFilled,
+    ImDrawListOp_Text,
+    ImDrawListOp_Flags                              // Last, the settings the geometry depends on
+};
+
+struct ImDrawListOpHeader       { int Op; int Size; };
+struct ImDrawListOpClipRect     { ImVec4 ClipRect; };
+struct ImDrawListOpTextureID    { ImTextureID TextureId; };
+struct ImDrawListOpPoly         { ImU32 Col; int Closed; float Thickness; int PointsCount; };   // + ImVec2[PointsCount]
+struct ImDrawListOpRectFilled   { ImVec2 A, B; ImU32 Col; float Rounding; int RoundingCorners; };
+struct ImDrawListOpText         { const ImFont* Font; ImU32 FontGeneration; float FontSize; ImVec2 Pos; ImU32 Col; float WrapWidth; ImVec4 FineClipRect; int HasFineClipRect; int TextLength; }; // + char[TextLength]
+struct ImDrawListOpFlags        { ImDrawListFlags Flags; ImVec2 TexUvWhitePixel; };
+
+#define IM_DRAWLIST_OP_ALIGN(_SIZE) (((_SIZE) + 7) & ~7)
+
+static void* RecordOp(ImDrawListCache* cache, int op, int args_size, int data_size = 0, void** out_data = NULL)
+{
+    const int data_offset = (int)sizeof(ImDrawListOpHeader) + IM_DRAWLIST_OP_ALIGN(args_size);
+    const int size = data_offset + IM_DRAWLIST_OP_ALIGN(data_size);
+    const int start = cache->Ops.Size;
+    cache->Ops.resize(start + size);
+    char* record = cache->Ops.Data + start;
+    memset(record, 0, (size_t)size);
+    ((ImDrawListOpHeader*)record)->Op = op;
+    ((ImDrawListOpHeader*)record)->Size = size;
+    if (out_data)
+        *out_data = record + data_offset;
+    return record + sizeof(ImDrawListOpHeader);
+}
+
+// Relative to the origin and clamped to the bounds, so that a window moving around the screen records the same rectangles
+static void RecordClipRect(ImDrawListCache* cache, const ImVec4& cr)
+{
+    const ImVec2 o = cache->Origin;
+    const ImRect& b = cache->Bounds;
+    ImDrawListOpClipRect* op = (ImDrawListOpClipRect*)RecordOp(cache, ImDrawListOp_PushClipRect, sizeof(ImDrawListOpClipRect));
+    op->ClipRect = ImVec4(ImClamp(cr.x - o.x, b.Min.x, b.Max.x), ImClamp(cr.y - o.y, b.Min.y, b.Max.y), ImClamp(cr.z - o.x, b.Min.x, b.Max.x), ImClamp(cr.w - o.y, b.Min.y, b.Max.y));
+}
+
+static void RecordPoly(ImDrawListCache* cache, int op_type, const ImVec2* points, int points_count, ImU32 col, bool closed, float thickness)
+{
+    ImVec2* out_points;
+    ImDrawListOpPoly* op = (ImDrawListOpPoly*)RecordOp(cache, op_type, sizeof(ImDrawListOpPoly), points_count * (int)sizeof(ImVec2), (void**)&out_points);
+    op->Col = col;
+    op->Closed = closed ? 1 : 0;
+    op->Thickness = thickness;
+    op->PointsCount = points_count;
+    const ImVec2 o = cache->Origin;
+    for (int i = 0; i < points_count; i++)
+        out_points[i] = ImVec2(points[i].x - o.x, points[i].y - o.y);
+}
+
 // Using macros because C++ is a terrible language, we want guaranteed inline, no code in header, and no overhead in Debug builds
 #define GetCurrentClipRect()    (_ClipRectStack.Size ? _ClipRectStack.Data[_ClipRectStack.Size-1]  : _Data->ClipRectFullscreen)
 #define GetCurrentTextureId()   (_TextureIdStack.Size ? _TextureIdStack.Data[_TextureIdStack.Size-1] : NULL)
 
 void ImDrawList::AddDrawCmd()
 {
+    if (_Recording)
+        ImGui::DrawListCacheFlush(this);
+
     ImDrawCmd draw_cmd;
     draw_cmd.ClipRect = GetCurrentClipRect();
     draw_cmd.TextureId = GetCurrentTextureId();
@@ -402,6 +470,9 @@ void ImDrawList::AddDrawCmd()
 
 void ImDrawList::AddCallback(ImDrawCallback callback, void* callback_data)
 {
+    if (_Recording)
+        ImGui::DrawListCacheFlush(this);
+
     ImDrawCmd* current_cmd = CmdBuffer.Size ? &CmdBuffer.back() : NULL;
     if (!current_cmd || current_cmd->ElemCount != 0 || current_cmd->UserCallback != NULL)
     {
@@ -418,6 +489,9 @@ void ImDrawList::AddCallback(ImDrawCallback callback, void* callback_data)
 // The cost of figuring out if a new command has to be added or if we can merge is paid in those Update** functions only.
 void ImDrawList::UpdateClipRect()
 {
+    if (_Recording)
+        ImGui::DrawListCacheFlush(this);
+
     // If current command is used with different settings we need to add a new command
     const ImVec4 curr_clip_rect = GetCurrentClipRect();
     ImDrawCmd* curr_cmd = CmdBuffer.Size > 0 ? &CmdBuffer.Data[CmdBuffer.Size-1] : NULL;
@@ -437,6 +511,9 @@ void ImDrawList::UpdateClipRect()
 
 void ImDrawList::UpdateTextureID()
 {
+    if (_Recording)
+        ImGui::DrawListCacheFlush(this);
+
     // If current command is used with different settings we need to add a new command
     const ImTextureID curr_texture_id = GetCurrentTextureId();
     ImDrawCmd* curr_cmd = CmdBuffer.Size ? &CmdBuffer.back() : NULL;
@@ -473,7 +550,10 @@ void ImDrawList::PushClipRect(ImVec2 cr_min, ImVec2 cr_max, bool intersect_with_
     cr.w = ImMax(cr.y, cr.w);
 
     _ClipRectStack.push_back(cr);
-    UpdateClipRect();
+    if (_Recording)
+        RecordClipRect(_Recording, cr);
+    else
+        UpdateClipRect();
 }
 
 void ImDrawList::PushClipRectFullScreen()
@@ -485,24 +565,35 @@ void ImDrawList::PopClipRect()
 {
     IM_ASSERT(_ClipRectStack.Size > 0);
     _ClipRectStack.pop_back();
-    UpdateClipRect();
+    if (_Recording)
+        RecordOp(_Recording, ImDrawListOp_PopClipRect, 0);
+    else
+        UpdateClipRect();
 }
 
 void ImDrawList::PushTextureID(ImTextureID texture_id)
 {
     _TextureIdStack.push_back(texture_id);
-    UpdateTextureID();
+    if (_Recording)
+        ((ImDrawListOpTextureID*)RecordOp(_Recording, ImDrawListOp_PushTextureID, sizeof(ImDrawListOpTextureID)))->TextureId = texture_id;
+    else
+        UpdateTextureID();
 }
 
 void ImDrawList::PopTextureID()
 {
     IM_ASSERT(_TextureIdStack.Size > 0);
     _TextureIdStack.pop_back();
-    UpdateTextureID();
+    if (_Recording)
+        RecordOp(_Recording, ImDrawListOp_PopTextureID, 0);
+    else
+        UpdateTextureID();
 }
 
 void ImDrawList::ChannelsSplit(int channels_count)
 {
+    if (_Recording)
+        ImGui::DrawListCacheFlush(this);
     IM_ASSERT(_ChannelsCurrent == 0 && _ChannelsCount == 1);
     int old_channels_count = _Channels.Size;
     if (old_channels_count < channels_count)
@@ -583,6 +674,10 @@ void ImDrawList::ChannelsSetCurrent(int idx)
 // NB: this can be called with negative count for removing primitives (as long as the result does not underflow)
 void ImDrawList::PrimReserve(int idx_count, int vtx_count)
 {
+    // Writing vertices directly can't be recorded
+    if (_Recording)
+        ImGui::DrawListCacheFlush(this);
+
     ImDrawCmd& draw_cmd = CmdBuffer.Data[CmdBuffer.Size-1];
     draw_cmd.ElemCount += idx_count;
 
@@ -645,6 +740,11 @@ void ImDrawList::AddPolyline(const ImVec2* points, const int points_count, ImU32
 {
     if (points_count < 2)
         return;
+    if (_Recording)
+    {
+        RecordPoly(_Recording, ImDrawListOp_Polyline, points, points_count, col, closed, thickness);
+        return;
+    }
 
     const ImVec2 uv = _Data->TexUvWhitePixel;
 
@@ -824,6 +924,11 @@ void ImDrawList::AddConvexPolyFilled(const ImVec2* points, const int points_coun
 {
     if (points_count < 3)
         return;
+    if (_Recording)
+    {
+        RecordPoly(_Recording, ImDrawListOp_ConvexPolyFilled, points, points_count, col, false, 0.0f);
+        return;
+    }
 
     const ImVec2 uv = _Data->TexUvWhitePixel;
 
@@ -1034,6 +1139,16 @@ void ImDrawList::AddRectFilled(const ImVec2& a, const ImVec2& b, ImU32 col, floa
 {
     if ((col & IM_COL32_A_MASK) == 0)
         return;
+    if (_Recording)
+    {
+        ImDrawListOpRectFilled* op = (ImDrawListOpRectFilled*)RecordOp(_Recording, ImDrawListOp_RectFilled, sizeof(ImDrawListOpRectFilled));
+        op->A = a - _Recording->Origin;
+        op->B = b - _Recording->Origin;
+        op->Col = col;
+        op->Rounding = rounding;
+        op->RoundingCorners = rounding_corners_flags;
+        return;
+    }
     if (rounding > 0.0f)
     {
         PathRect(a, b, rounding, rounding_corners_flags);
@@ -1155,6 +1270,27 @@ void ImDrawList::AddText(const ImFont* font, float font_size, const ImVec2& pos,
 
     IM_ASSERT(font->ContainerAtlas->TexID == _TextureIdStack.back());  // Use high-level ImGui::PushFont() or low-level ImDrawList::PushTextureId() to change font.
 
+    if (_Recording)
+    {
+        const ImVec2 o = _Recording->Origin;
+        char* out_text;
+        ImDrawListOpText* op = (ImDrawListOpText*)RecordOp(_Recording, ImDrawListOp_Text, sizeof(ImDrawListOpText), (int)(text_end - text_begin), (void**)&out_text);
+        op->Font = font;
+        op->FontGeneration = font->Generation;  // A rebuilt atlas can reuse the font's address, with different glyphs
+        op->FontSize = font_size;
+        op->Pos = pos - o;
+        op->Col = col;
+        op->WrapWidth = wrap_width;
+        if (cpu_fine_clip_rect)
+        {
+            op->FineClipRect = ImVec4(cpu_fine_clip_rect->x - o.x, cpu_fine_clip_rect->y - o.y, cpu_fine_clip_rect->z - o.x, cpu_fine_clip_rect->w - o.y);
+            op->HasFineClipRect = 1;
+        }
+        op->TextLength = (int)(text_end - text_begin);
+        memcpy(out_text, text_begin, (size_t)(text_end - text_begin));
+        return;
+    }
+
     ImVec4 clip_rect = _ClipRectStack.back();
     if (cpu_fine_clip_rect)
     {
@@ -1213,6 +1349,8 @@ void ImDrawList::AddImageRounded(ImTextureID user_texture_id, const ImVec2& a, c
         AddImage(user_texture_id, a, b, uv_a, uv_b, col);
         return;
     }
+    if (_Recording)
+        ImGui::DrawListCacheFlush(this);  // ShadeVertsLinearUV() below reads the vertices back
 
     const bool push_texture_id = _TextureIdStack.empty() || user_texture_id != _TextureIdStack.back();
     if (push_texture_id)
@@ -1228,6 +1366,157 @@ void ImDrawList::AddImageRounded(ImTextureID user_texture_id, const ImVec2& a, c
         PopTextureID();
 }
 
+//-----------------------------------------------------------------------------
+// [SECTION] ImDrawList recording (ImGuiWindowFlags_CacheDrawList)
+//-----------------------------------------------------------------------------
+
+// Builds the geometry of the recorded calls, from empty stacks
+static void ReplayOps(ImDrawList* draw_list, ImDrawListCache* cache)
+{
+    const ImVec2 o = cache->Origin;
+    draw_list->_ClipRectStack.resize(0);
+    draw_list->_TextureIdStack.resize(0);
+    for (const char* record = cache->Ops.Data; record < cache->Ops.Data + cache->Ops.Size; record += ((const ImDrawListOpHeader*)record)->Size)
+    {
+        const int op_type = ((const ImDrawListOpHeader*)record)->Op;
+        const char* args = record + sizeof(ImDrawListOpHeader);
+        switch (op_type)
+        {
+        case ImDrawListOp_PushClipRect:
+        {
+            const ImVec4& cr = ((const ImDrawListOpClipRect*)args)->ClipRect;
+            draw_list->PushClipRect(ImVec2(cr.x + o.x, cr.y + o.y), ImVec2(cr.z + o.x, cr.w + o.y));
+            break;
+        }
+        case ImDrawListOp_PopClipRect:
+            draw_list->PopClipRect();
+            break;
+        case ImDrawListOp_PushTextureID:
+            draw_list->PushTextureID(((const ImDrawListOpTextureID*)args)->TextureId);
+            break;
+        case ImDrawListOp_PopTextureID:
+            draw_list->PopTextureID();
+            break;
+        case ImDrawListOp_Polyline:
+        case ImDrawListOp_ConvexPolyFilled:
+        {
+            const ImDrawListOpPoly* op = (const ImDrawListOpPoly*)args;
+            const ImVec2* points = (const ImVec2*)(args + IM_DRAWLIST_OP_ALIGN(sizeof(ImDrawListOpPoly)));
+            cache->TempPath.resize(op->PointsCount);
+            for (int i = 0; i < op->PointsCount; i++)
+                cache->TempPath[i] = points[i] + o;
+            if (op_type == ImDrawListOp_Polyline)
+                draw_list->AddPolyline(cache->TempPath.Data, op->PointsCount, op->Col, op->Closed != 0, op->Thickness);
+            else
+                draw_list->AddConvexPolyFilled(cache->TempPath.Data, op->PointsCount, op->Col);
+            break;
+        }
+        case ImDrawListOp_RectFilled:
+        {
+            const ImDrawListOpRectFilled* op = (const ImDrawListOpRectFilled*)args;
+            draw_list->AddRectFilled(op->A + o, op->B + o, op->Col, op->Rounding, op->RoundingCorners);
+            break;
+        }
+        case ImDrawListOp_Text:
+        {
+            const ImDrawListOpText* op = (const ImDrawListOpText*)args;
+            const char* text = args + IM_DRAWLIST_OP_ALIGN(sizeof(ImDrawListOpText));
+            const ImVec4 fine_clip_rect(op->FineClipRect.x + o.x, op->FineClipRect.y + o.y, op->FineClipRect.z + o.x, op->FineClipRect.w + o.y);
+            draw_list->AddText(op->Font, op->FontSize, op->Pos + o, op->Col, text, text + op->TextLength, op->WrapWidth, op->HasFineClipRect ? &fine_clip_rect : NULL);
+            break;
+        }
+        case ImDrawListOp_Flags:
+            break;
+        }
+    }
+}
+
+void ImGui::DrawListCacheBeginFrame(ImDrawList* draw_list, ImDrawListCache* cache, const ImVec2& origin, const ImRect& bounds)
+{
+    // Render() wasn't called for the last frame
+    if (cache->Active)
+        DrawListCacheEndFrame(draw_list, cache);
+
+    // Last frame's geometry goes to the cache, the draw list records into the cache's old buffers
+    if (cache->PrevValid)
+    {
+        draw_list->CmdBuffer.swap(cache->CmdBuffer);
+        draw_list->IdxBuffer.swap(cache->IdxBuffer);
+        draw_list->VtxBuffer.swap(cache->VtxBuffer);
+    }
+    draw_list->Clear();
+    cache->Ops.resize(0);
+    cache->Origin = origin;
+    cache->Bounds = ImRect(bounds.Min - origin, bounds.Max - origin);
+    cache->Active = true;
+    draw_list->_Recording = cache;
+}
+
+void ImGui::DrawListCacheEndFrame(ImDrawList* draw_list, ImDrawListCache* cache)
+{
+    IM_ASSERT(cache->Active);
+    cache->Active = false;
+    if (draw_list->_Recording != cache)
+    {
+        // Flushed during the frame: the draw list holds this frame's geometry, but not all of its calls were recorded
+        cache->PrevValid = false;
+        cache->FlushCount++;
+        return;
+    }
+    draw_list->_Recording = NULL;
+
+    // Anti-aliasing turns the same calls into different geometry
+    ImDrawListOpFlags* flags_op = (ImDrawListOpFlags*)RecordOp(cache, ImDrawListOp_Flags, sizeof(ImDrawListOpFlags));
+    flags_op->Flags = draw_list->Flags;
+    flags_op->TexUvWhitePixel = draw_list->_Data->TexUvWhitePixel;
+
+    if (cache->PrevValid && cache->Ops.Size == cache->PrevOps.Size && memcmp(cache->Ops.Data, cache->PrevOps.Data, (size_t)cache->Ops.Size) == 0)
+    {
+        draw_list->CmdBuffer.swap(cache->CmdBuffer);
+        draw_list->IdxBuffer.swap(cache->IdxBuffer);
+        draw_list->VtxBuffer.swap(cache->VtxBuffer);
+        const ImVec2 offset = cache->Origin - cache->PrevOrigin;
+        if (offset.x != 0.0f || offset.y != 0.0f)
+        {
+            for (ImDrawVert* vtx = draw_list->VtxBuffer.begin(); vtx < draw_list->VtxBuffer.end(); vtx++)
+                vtx->pos += offset;
+            for (ImDrawCmd* cmd = draw_list->CmdBuffer.begin(); cmd < draw_list->CmdBuffer.end(); cmd++)
+                cmd->ClipRect = ImVec4(cmd->ClipRect.x + offset.x, cmd->ClipRect.y + offset.y, cmd->ClipRect.z + offset.x, cmd->ClipRect.w + offset.y);
+        }
+        draw_list->_VtxCurrentIdx = (unsigned int)draw_list->VtxBuffer.Size;
+        draw_list->_VtxWritePtr = draw_list->VtxBuffer.Data + draw_list->VtxBuffer.Size;
+        draw_list->_IdxWritePtr = draw_list->IdxBuffer.Data + draw_list->IdxBuffer.Size;
+        cache->HitCount++;
+    }
+    else
+    {
+        ReplayOps(draw_list, cache);
+        cache->PrevOps.swap(cache->Ops);
+        cache->MissCount++;
+    }
+    cache->PrevOrigin = cache->Origin;
+    cache->PrevValid = true;
+}
+
+void ImGui::DrawListCacheFlush(ImDrawList* draw_list)
+{
+    ImDrawListCache* cache = draw_list->_Recording;
+    if (!cache)
+        return;
+    draw_list->_Recording = NULL;
+
+    // The replay rebuilds the stacks from the clamped rectangles, keep the exact ones
+    ImVector<ImVec4> clip_rect_stack;
+    ImVector<ImTextureID> texture_id_stack;
+    clip_rect_stack.swap(draw_list->_ClipRectStack);
+    texture_id_stack.swap(draw_list->_TextureIdStack);
+    ReplayOps(draw_list, cache);
+    draw_list->_ClipRectStack.swap(clip_rect_stack);
+    draw_list->_TextureIdStack.swap(texture_id_stack);
+    draw_list->UpdateTextureID();
+    draw_list->UpdateClipRect();
+}
+
 //-----------------------------------------------------------------------------
 // [SECTION] ImDrawData
 //-----------------------------------------------------------------------------
@@ -1272,6 +1561,7 @@ void ImDrawData::ScaleClipRects(const ImVec2& scale)
 // Generic linear color gradient, write to RGB fields, leave A untouched.
 void ImGui::ShadeVertsLinearColorGradientKeepAlpha(ImDrawList* draw_list, int vert_start_idx, int vert_end_idx, ImVec2 gradient_p0, ImVec2 gradient_p1, ImU32 col0, ImU32 col1)
 {
+    IM_ASSERT(draw_list->_Recording == NULL);   // Call DrawListCacheFlush() before adding the vertices
     ImVec2 gradient_extent = gradient_p1 - gradient_p0;
     float gradient_inv_length2 = 1.0f / ImLengthSqr(gradient_extent);
     ImDrawVert* vert_start = draw_list->VtxBuffer.Data + vert_start_idx;
@@ -1290,6 +1580,7 @@ void ImGui::ShadeVertsLinearColorGradientKeepAlpha(ImDrawList* draw_list, int ve
 // Distribute UV over (a, b) rectangle
 void ImGui::ShadeVertsLinearUV(ImDrawList* draw_list, int vert_start_idx, int vert_end_idx, const ImVec2& a, const ImVec2& b, const ImVec2& uv_a, const ImVec2& uv_b, bool clamp)
 {
+    IM_ASSERT(draw_list->_Recording == NULL);   // Call DrawListCacheFlush() before adding the vertices
     const ImVec2 size = b - a;
     const ImVec2 uv_size = uv_b - uv_a;
     const ImVec2 scale = ImVec2(
@@ -1616,10 +1907,10 @@ ImFont* ImFontAtlas::AddFontFromMemoryCompressedTTF(const void* compressed_ttf_d
 ImFont* ImFontAtlas::AddFontFromMemoryCompressedBase85TTF(const char* compressed_ttf_data_base85, float size_pixels, const ImFontConfig* font_cfg, const ImWchar* glyph_ranges)
 {
     int compressed_ttf_size = (((int)strlen(compressed_ttf_data_base85) + 4) / 5) * 4;
-    void* compressed_ttf = ImGui::MemAlloc((size_t)compressed_ttf_size);
+    void* compressed_ttf = ImGui::MemAlloc((size_t)compressed_ttf_size, ImGuiAllocTag_Temp);
     Decode85((const unsigned char*)compressed_ttf_data_base85, (unsigned char*)compressed_ttf);
     ImFont* font = AddFontFromMemoryCompressedTTF(compressed_ttf, compressed_ttf_size, size_pixels, font_cfg, glyph_ranges);
-    ImGui::MemFree(compressed_ttf);
+    ImGui::MemFree(compressed_ttf, ImGuiAllocTag_Temp);
     return font;
 }
 
@@ -1753,7 +2044,7 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
         stbtt_pack_range*   Ranges;
         int                 RangesCount;
     };
-    ImFontTempBuildData* tmp_array = (ImFontTempBuildData*)ImGui::MemAlloc((size_t)atlas->ConfigData.Size * sizeof(ImFontTempBuildData));
+    ImFontTempBuildData* tmp_array = (ImFontTempBuildData*)ImGui::MemAlloc((size_t)atlas->ConfigData.Size * sizeof(ImFontTempBuildData), ImGuiAllocTag_Temp);
     for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
     {
         ImFontConfig& cfg = atlas->ConfigData[input_i];
@@ -1765,16 +2056,16 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
         if (!stbtt_InitFont(&tmp.FontInfo, (unsigned char*)cfg.FontData, font_offset))
         {
             atlas->TexWidth = atlas->TexHeight = 0; // Reset output on failure
-            ImGui::MemFree(tmp_array);
+            ImGui::MemFree(tmp_array, ImGuiAllocTag_Temp);
             return false;
         }
     }
 
     // Allocate packing character data and flag packed characters buffer as non-packed (x0=y0=x1=y1=0)
     int buf_packedchars_n = 0, buf_rects_n = 0, buf_ranges_n = 0;
-    stbtt_packedchar* buf_packedchars = (stbtt_packedchar*)ImGui::MemAlloc(total_glyphs_count * sizeof(stbtt_packedchar));
-    stbrp_rect* buf_rects = (stbrp_rect*)ImGui::MemAlloc(total_glyphs_count * sizeof(stbrp_rect));
-    stbtt_pack_range* buf_ranges = (stbtt_pack_range*)ImGui::MemAlloc(total_ranges_count * sizeof(stbtt_pack_range));
+    stbtt_packedchar* buf_packedchars = (stbtt_packedchar*)ImGui::MemAlloc(total_glyphs_count * sizeof(stbtt_packedchar), ImGuiAllocTag_Temp);
+    stbrp_rect* buf_rects = (stbrp_rect*)ImGui::MemAlloc(total_glyphs_count * sizeof(stbrp_rect), ImGuiAllocTag_Temp);
+    stbtt_pack_range* buf_ranges = (stbtt_pack_range*)ImGui::MemAlloc(total_ranges_count * sizeof(stbtt_pack_range), ImGuiAllocTag_Temp);
     memset(buf_packedchars, 0, total_glyphs_count * sizeof(stbtt_packedchar));
     memset(buf_rects, 0, total_glyphs_count * sizeof(stbrp_rect));              // Unnecessary but let's clear this for the sake of sanity.
     memset(buf_ranges, 0, total_ranges_count * sizeof(stbtt_pack_range));
@@ -1865,7 +2156,7 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
 
     // End packing
     stbtt_PackEnd(&spc);
-    ImGui::MemFree(buf_rects);
+    ImGui::MemFree(buf_rects, ImGuiAllocTag_Temp);
     buf_rects = NULL;
 
     // Third pass: setup ImFont and glyphs for runtime
@@ -1915,9 +2206,9 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
     }
 
     // Cleanup temporaries
-    ImGui::MemFree(buf_packedchars);
-    ImGui::MemFree(buf_ranges);
-    ImGui::MemFree(tmp_array);
+    ImGui::MemFree(buf_packedchars, ImGuiAllocTag_Temp);
+    ImGui::MemFree(buf_ranges, ImGuiAllocTag_Temp);
+    ImGui::MemFree(tmp_array, ImGuiAllocTag_Temp);
 
     ImFontAtlasBuildFinish(atlas);
 
@@ -2288,6 +2579,9 @@ ImFont::~ImFont()
     ClearOutputData();
 }
 
+// Shared by all fonts, so that a font created where a destroyed one was can't match its generations
+static ImU32 FontGenerationCounter = 0;
+
 void    ImFont::ClearOutputData()
 {
     FontSize = 0.0f;
@@ -2296,6 +2590,10 @@ void    ImFont::ClearOutputData()
     IndexLookup.clear();
     FallbackGlyph = NULL;
     FallbackAdvanceX = 0.0f;
+    AsciiQuads.clear();
+    IntegerAsciiAdvances = false;
+    MinGlyphX0 = -FLT_MAX;
+    Generation = ++FontGenerationCounter;
     ConfigDataCount = 0;
     ConfigData = NULL;
     ContainerAtlas = NULL;
@@ -2341,6 +2639,50 @@ void ImFont::BuildLookupTable()
     for (int i = 0; i < max_codepoint + 1; i++)
         if (IndexAdvanceX[i] < 0.0f)
             IndexAdvanceX[i] = FallbackAdvanceX;
+
+    Generation = ++FontGenerationCounter;
+    MinGlyphX0 = FLT_MAX;
+    for (int i = 0; i < Glyphs.Size; i++)
+        MinGlyphX0 = (Glyphs[i].AdvanceX < 0.0f) ? -FLT_MAX : ImMin(MinGlyphX0, Glyphs[i].X0);
+    BuildAsciiTables();
+}
+
+// Builds the data of the ASCII fast paths:
+// - IntegerAsciiAdvances, for CalcTextSizeA() and CalcWordWrapPositionA()
+// - AsciiQuads, glyphs 0x20..0x7E laid out the way RenderText()'s fast path consumes them, 32 floats per character:
+//   - [0..19]  the 4 vertices of the glyph's quad (pos, uv, col) at position (0,0) and scale 1, with 0.0f for the colors: 5 ready made 16-byte vectors
+//   - [20..23] X0, Y0, X1, Y1, for the clipping test
+//   - [24]     AdvanceX, 0.0f without a glyph
+//   - [25]     1.0f: draws a quad, 0.0f: only advances (space, no glyph), -1.0f: left to the generic path (empty quad)
+void ImFont::BuildAsciiTables()
+{
+    // Below 2^10, sums of advances stay exact whatever the order they are added in (until they reach 2^24, see CalcAsciiRunWidth())
+    IntegerAsciiAdvances = (IndexAdvanceX.Size >= 0x80);
+    for (int c = 0; c < 0x80 && IntegerAsciiAdvances; c++)
+        IntegerAsciiAdvances = (ImFabs(IndexAdvanceX[c]) < 1024.0f && IndexAdvanceX[c] == (float)(int)IndexAdvanceX[c]);
+
+    AsciiQuads.clear();
+#if defined(IMGUI_ENABLE_SSE) && !defined(IMGUI_OVERRIDE_DRAWVERT_STRUCT_LAYOUT)
+    AsciiQuads.resize(0x5F * 32, 0.0f);
+    for (int c = 0x20; c < 0x7F; c++)
+    {
+        float* q = &AsciiQuads[(c - 0x20) * 32];
+        const ImFontGlyph* glyph = FindGlyph((ImWchar)c);
+        if (!glyph)
+            continue;
+        const float quad[20] =
+        {
+            glyph->X0, glyph->Y0, glyph->U0, glyph->V0, 0.0f,
+            glyph->X1, glyph->Y0, glyph->U1, glyph->V0, 0.0f,
+            glyph->X1, glyph->Y1, glyph->U1, glyph->V1, 0.0f,
+            glyph->X0, glyph->Y1, glyph->U0, glyph->V1, 0.0f,
+        };
+        memcpy(q, quad, sizeof(quad));
+        q[20] = glyph->X0; q[21] = glyph->Y0; q[22] = glyph->X1; q[23] = glyph->Y1;
+        q[24] = glyph->AdvanceX;
+        q[25] = (c == ' ') ? 0.0f : (glyph->X0 < glyph->X1 && glyph->Y0 < glyph->Y1) ? 1.0f : -1.0f;
+    }
+#endif
 }
 
 void ImFont::SetFallbackChar(ImWchar c)
@@ -2396,6 +2738,9 @@ void ImFont::AddRemapChar(ImWchar dst, ImWchar src, bool overwrite_dst)
     GrowIndex(dst + 1);
     IndexLookup[dst] = (src < index_size) ? IndexLookup.Data[src] : (ImWchar)-1;
     IndexAdvanceX[dst] = (src < index_size) ? IndexAdvanceX.Data[src] : 1.0f;
+    Generation = ++FontGenerationCounter;
+    if (dst < 0x80)
+        BuildAsciiTables();
 }
 
 const ImFontGlyph* ImFont::FindGlyph(ImWchar c) const
@@ -2418,6 +2763,103 @@ const ImFontGlyph* ImFont::FindGlyphNoFallback(ImWchar c) const
     return &Glyphs.Data[i];
 }
 
+#ifdef IMGUI_ENABLE_SSE
+// CalcTextSizeA() and CalcWordWrapPositionA() fast paths, over runs of ASCII characters: they need no decoding, and their advances are in
+// IndexAdvanceX[0..0x7F] when IndexAdvanceX.Size >= 0x80. With IntegerAsciiAdvances, sums of advances below 2^24 are exact whatever the order
+// they are added in, so they are computed 4 characters at a time with prefix sums.
+
+// Returns the end of the run starting at 's' of characters that CalcTextSizeA() measures by their advance alone: anything but '\n', '\r' and UTF-8.
+static const char* FindAsciiRunEnd(const char* s, const char* s_end)
+{
+    const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    for (; s_end - s >= 16; s += 16)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)s);
+        if (_mm_movemask_epi8(_mm_or_si128(v, _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)))) != 0)
+            break;
+    }
+    while (s < s_end && *s != '\n' && *s != '\r' && !(*s & 0x80))
+        s++;
+    return s;
+}
+
+static inline __m128 LoadAsciiAdvancePrefixSums(const float* advances, const char* s)
+{
+    __m128 sums = _mm_setr_ps(advances[(unsigned char)s[0]], advances[(unsigned char)s[1]], advances[(unsigned char)s[2]], advances[(unsigned char)s[3]]);
+    sums = _mm_add_ps(sums, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sums), 4)));
+    return _mm_add_ps(sums, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sums), 8)));
+}
+
+// Adds the advances of the characters of [s, s_end), times 'scale', to 'width' in order, and stops before the first one for which it would reach 'limit'.
+// Returns where it stopped.
+static const char* CalcAsciiRunWidth(const ImFont* font, float scale, const char* s, const char* s_end, float* width_io, float limit)
+{
+    const float* advances = font->IndexAdvanceX.Data;
+    float width = *width_io;
+    if (font->IntegerAsciiAdvances && scale == 1.0f && ImFabs(width) < 4194304.0f && width == (float)(int)width)
+    {
+        const __m128 limit4 = _mm_set1_ps(limit);
+        while (s_end - s >= 4 && ImFabs(width) < 4194304.0f)
+        {
+            const __m128 sums = _mm_add_ps(LoadAsciiAdvancePrefixSums(advances, s), _mm_set1_ps(width));
+            if (_mm_movemask_ps(_mm_cmpge_ps(sums, limit4)) != 0)
+                break; // Left to the loop below to find which one
+            width = _mm_cvtss_f32(_mm_shuffle_ps(sums, sums, _MM_SHUFFLE(3, 3, 3, 3)));
+            s += 4;
+        }
+    }
+    for (; s < s_end; s++)
+    {
+        const float char_width = advances[(unsigned char)*s] * scale;
+        if (width + char_width >= limit)
+            break;
+        width += char_width;
+    }
+    *width_io = width;
+    return s;
+}
+
+// With IntegerAsciiAdvances, CalcWordWrapPositionA()'s line_width + word_width + blank_width is exactly the sum of the advances since the start
+// of the line, and over printable ASCII and tabs its test value line_width + word_width is that sum minus the blanks since the last nonblank
+// character. So it can only stop at the first nonblank character for which 'total' plus the advances up to it reaches 'wrap_width'. Returns
+// that character, or the end of the run, or where the sums would stop being exact. 'total_io' receives the sum before it.
+static const char* FindWordWrapCandidate(const float* advances, const char* s, const char* s_end, float wrap_width, float* total_io)
+{
+    float total = *total_io;
+    const __m128i first = _mm_set1_epi8(0x20), tab = _mm_set1_epi8('\t'), space = _mm_set1_epi8(' ');
+    const __m128 wrap_width4 = _mm_set1_ps(wrap_width);
+    for (; s_end - s >= 16 && ImFabs(total) < 4194304.0f; s += 16)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)s);
+        const __m128i blanks = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+        if (_mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(v, tab), _mm_cmplt_epi8(v, first))) != 0) // Signed: also the bytes >= 0x80
+            break;
+        const int nonblank_mask = ~_mm_movemask_epi8(blanks);
+        __m128 sums = _mm_set1_ps(total);
+        int reached_mask = 0;
+        for (int n = 0; n < 16 && reached_mask == 0; n += 4)
+        {
+            sums = _mm_add_ps(LoadAsciiAdvancePrefixSums(advances, s + n), _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(3, 3, 3, 3)));
+            reached_mask = (_mm_movemask_ps(_mm_cmpge_ps(sums, wrap_width4)) << n) & nonblank_mask;
+        }
+        if (reached_mask != 0)
+            break; // Left to the loop below to find which one
+        total = _mm_cvtss_f32(_mm_shuffle_ps(sums, sums, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+    for (; s < s_end && ImFabs(total) < 4194304.0f; s++)
+    {
+        const unsigned char c = (unsigned char)*s;
+        if ((c < 0x20 && c != '\t') || c >= 0x80)
+            break;
+        if (c != ' ' && c != '\t' && total + advances[c] >= wrap_width)
+            break;
+        total += advances[c];
+    }
+    *total_io = total;
+    return s;
+}
+#endif
+
 const char* ImFont::CalcWordWrapPositionA(float scale, const char* text, const char* text_end, float wrap_width) const
 {
     // Simple word-wrapping for English, not full-featured. Please submit failing cases!
@@ -2443,10 +2885,46 @@ const char* ImFont::CalcWordWrapPositionA(float scale, const char* text, const c
     const char* word_end = text;
     const char* prev_word_end = NULL;
     bool inside_word = true;
+#ifdef IMGUI_ENABLE_SSE
+    const char* candidate = text;
+#endif
 
     const char* s = text;
     while (s < text_end)
     {
+#ifdef IMGUI_ENABLE_SSE
+        // Skip to the last word start before the next place we could stop, see FindWordWrapCandidate(), and carry on from there
+        if (s >= candidate && IntegerAsciiAdvances && ImFabs(line_width) + ImFabs(word_width) + ImFabs(blank_width) < 4194304.0f && line_width == (float)(int)line_width && word_width == (float)(int)word_width && blank_width == (float)(int)blank_width)
+        {
+            float total = line_width + word_width + blank_width;
+            candidate = FindWordWrapCandidate(IndexAdvanceX.Data, s, text_end, wrap_width, &total);
+
+            // A word start is a nonblank character following a blank or a punctuation (after which inside_word is false)
+            #define IS_BLANK_OR_PUNCTUATION(_C) ((_C) == ' ' || (_C) == '\t' || (_C) == '.' || (_C) == ',' || (_C) == ';' || (_C) == '!' || (_C) == '?' || (_C) == '\"')
+            const char* word_start = candidate - 1;
+            while (word_start > s && !(*word_start != ' ' && *word_start != '\t' && IS_BLANK_OR_PUNCTUATION(word_start[-1])))
+                word_start--;
+            if (word_start > s || (word_start == s && candidate > s && !inside_word && *s != ' ' && *s != '\t'))
+            {
+                // The blanks and punctuations before it start with the character where word_end was last set
+                const char* gap = word_start;
+                while (gap > s && IS_BLANK_OR_PUNCTUATION(gap[-1]))
+                    gap--;
+                if (gap > s || inside_word)
+                    word_end = (*gap == ' ' || *gap == '\t') ? gap : gap + 1;
+                prev_word_end = word_end;
+                for (const char* tail = word_start + 1; tail < candidate; tail++)
+                    total -= IndexAdvanceX.Data[(unsigned char)*tail];
+                line_width = total;
+                word_width = blank_width = 0.0f;
+                inside_word = !(*word_start == '.' || *word_start == ',' || *word_start == ';' || *word_start == '!' || *word_start == '?' || *word_start == '\"');
+                s = word_start + 1;
+                continue;
+            }
+            #undef IS_BLANK_OR_PUNCTUATION
+        }
+#endif
+
         unsigned int c = (unsigned int)*s;
         const char* next_s;
         if (c < 0x80)
@@ -2530,6 +3008,9 @@ ImVec2 ImFont::CalcTextSizeA(float size, float max_width, float wrap_width, cons
 
     const bool word_wrap_enabled = (wrap_width > 0.0f);
     const char* word_wrap_eol = NULL;
+#ifdef IMGUI_ENABLE_SSE
+    const bool ascii_runs = (IndexAdvanceX.Size >= 0x80);
+#endif
 
     const char* s = text_begin;
     while (s < text_end)
@@ -2562,6 +3043,17 @@ ImVec2 ImFont::CalcTextSizeA(float size, float max_width, float wrap_width, cons
             }
         }
 
+#ifdef IMGUI_ENABLE_SSE
+        // Characters measured by their advance alone, see CalcAsciiRunWidth()
+        if (ascii_runs)
+        {
+            const char* run_begin = s;
+            s = CalcAsciiRunWidth(this, scale, s, FindAsciiRunEnd(s, word_wrap_enabled ? ImMin(word_wrap_eol, text_end) : text_end), &line_width, max_width);
+            if (s != run_begin)
+                continue;
+        }
+#endif
+
         // Decode and advance source
         const char* prev_s = s;
         unsigned int c = (unsigned int)*s;
@@ -2625,6 +3117,92 @@ void ImFont::RenderChar(ImDrawList* draw_list, float size, ImVec2 pos, ImU32 col
     }
 }
 
+#if defined(IMGUI_ENABLE_SSE) && !defined(IMGUI_OVERRIDE_DRAWVERT_STRUCT_LAYOUT)
+// RenderText() fast path: emits printable ASCII characters from 's' while their glyphs are entirely inside the clip rectangle, so that
+// they need no clipping. The vertices are the glyph's quad from ImFont::AsciiQuads plus the position (and the color OR-ed in), written
+// with 16-byte stores, and the arithmetic is the generic path's so the output is identical. Returns where it stopped.
+static const char* RenderTextAsciiRun(const ImFont* font, float scale, float* x_io, float y, ImU32 col, const ImVec4& clip_rect, const char* s, const char* s_end,
+    ImDrawVert** vtx_write_io, ImDrawIdx** idx_write_io, unsigned int* vtx_current_idx_io)
+{
+    // The 4 vertices of a quad are 5 vectors: [x1 y1 u1 v1] [col x2 y1 u2] [v1 col x2 y2] [u2 v2 col x1] [y2 u1 v2 col]
+    const __m128i lane0 = _mm_setr_epi32(-1, 0, 0, 0), lane1 = _mm_setr_epi32(0, -1, 0, 0), lane2 = _mm_setr_epi32(0, 0, -1, 0), lane3 = _mm_setr_epi32(0, 0, 0, -1), none = _mm_setzero_si128();
+    const __m128 x_lanes[5] = { _mm_castsi128_ps(lane0), _mm_castsi128_ps(lane1), _mm_castsi128_ps(lane2), _mm_castsi128_ps(lane3), _mm_castsi128_ps(none) };
+    const __m128 y_lanes[5] = { _mm_castsi128_ps(lane1), _mm_castsi128_ps(lane2), _mm_castsi128_ps(lane3), _mm_castsi128_ps(none), _mm_castsi128_ps(lane0) };
+    const __m128i col_lanes[5] = { none, lane0, lane1, lane2, lane3 };
+
+    const bool scaled = (scale != 1.0f);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 one4 = _mm_set1_ps(1.0f);
+    const __m128 y4 = _mm_set1_ps(y);
+    const __m128i col4 = _mm_set1_epi32((int)col);
+    __m128 scales[5], offsets_y[5], cols[5];
+    for (int k = 0; k < 5; k++)
+    {
+        const __m128 pos_lanes = _mm_or_ps(x_lanes[k], y_lanes[k]);
+        scales[k] = _mm_or_ps(_mm_and_ps(pos_lanes, scale4), _mm_andnot_ps(pos_lanes, one4));
+        offsets_y[k] = _mm_and_ps(y_lanes[k], y4);
+        cols[k] = _mm_castsi128_ps(_mm_and_si128(col_lanes[k], col4));
+    }
+    const __m128 clip_min = _mm_setr_ps(clip_rect.x, clip_rect.y, -FLT_MAX, -FLT_MAX);
+    const __m128 clip_max = _mm_setr_ps(FLT_MAX, FLT_MAX, clip_rect.z, clip_rect.w);
+    const __m128i quad_indices = _mm_setr_epi16(0, 1, 2, 0, 2, 3, 0, 0);
+
+    float x = *x_io;
+    ImDrawVert* vtx_write = *vtx_write_io;
+    ImDrawIdx* idx_write = *idx_write_io;
+    unsigned int vtx_current_idx = *vtx_current_idx_io;
+    const float* quads = font->AsciiQuads.Data;
+    for (; s < s_end; s++)
+    {
+        const unsigned int c = (unsigned char)*s;
+        if (c - 0x20 >= 0x5F)
+            break;
+        const float* q = quads + (c - 0x20) * 32;
+        if (q[25] != 0.0f)
+        {
+            if (q[25] < 0.0f)
+                break;
+            const __m128 origin = _mm_setr_ps(x, y, x, y);
+            const __m128 rect = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(q + 20), scale4), origin);
+            if (_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(rect, clip_min), _mm_cmple_ps(rect, clip_max))) != 0x0F)
+                break;
+
+            const __m128 x4 = _mm_set1_ps(x);
+            float* dst = (float*)vtx_write;
+            for (int k = 0; k < 5; k++)
+            {
+                __m128 v = _mm_loadu_ps(q + k * 4);
+                if (scaled)
+                    v = _mm_mul_ps(v, scales[k]);
+                v = _mm_add_ps(v, _mm_or_ps(_mm_and_ps(x_lanes[k], x4), offsets_y[k]));
+                _mm_storeu_ps(dst + k * 4, _mm_or_ps(v, cols[k]));
+            }
+            if (sizeof(ImDrawIdx) == 2)
+            {
+                const __m128i indices = _mm_add_epi16(quad_indices, _mm_set1_epi16((short)vtx_current_idx));
+                _mm_storel_epi64((__m128i*)idx_write, indices);
+                const int last_two = _mm_cvtsi128_si32(_mm_srli_si128(indices, 8));
+                memcpy(idx_write + 4, &last_two, 4);
+            }
+            else
+            {
+                idx_write[0] = (ImDrawIdx)(vtx_current_idx); idx_write[1] = (ImDrawIdx)(vtx_current_idx+1); idx_write[2] = (ImDrawIdx)(vtx_current_idx+2);
+                idx_write[3] = (ImDrawIdx)(vtx_current_idx); idx_write[4] = (ImDrawIdx)(vtx_current_idx+2); idx_write[5] = (ImDrawIdx)(vtx_current_idx+3);
+            }
+            vtx_write += 4;
+            vtx_current_idx += 4;
+            idx_write += 6;
+        }
+        x += q[24] * scale;
+    }
+    *x_io = x;
+    *vtx_write_io = vtx_write;
+    *idx_write_io = idx_write;
+    *vtx_current_idx_io = vtx_current_idx;
+    return s;
+}
+#endif
+
 void ImFont::RenderText(ImDrawList* draw_list, float size, ImVec2 pos, ImU32 col, const ImVec4& clip_rect, const char* text_begin, const char* text_end, float wrap_width, bool cpu_fine_clip) const
 {
     if (!text_end)
@@ -2662,7 +3240,7 @@ void ImFont::RenderText(ImDrawList* draw_list, float size, ImVec2 pos, ImU32 col
         while (y_end < clip_rect.w && s_end < text_end)
         {
             s_end = (const char*)memchr(s_end, '\n', text_end - s_end);
-            s = s ? s + 1 : text_end;
+            s_end = s_end ? s_end + 1 : text_end;
             y_end += line_height;
         }
         text_end = s_end;
@@ -2708,6 +3286,37 @@ void ImFont::RenderText(ImDrawList* draw_list, float size, ImVec2 pos, ImU32 col
             }
         }
 
+        // Nothing more of this line can be visible: skip to its end, decoding like below so that multi-byte and malformed UTF-8 end it at the same place
+        if (!word_wrap_enabled && x + MinGlyphX0 * scale > clip_rect.z && *s != '\n')
+        {
+            while (s < text_end && *s != '\n')
+            {
+                if (!(*s & 0x80))
+                {
+                    s++;
+                    continue;
+                }
+                unsigned int c;
+                s += ImTextCharFromUtf8(&c, s, text_end);
+                if (c == 0)
+                    break;
+            }
+            if (s < text_end && *s != '\n') // Malformed UTF-8?
+                break;
+            continue;
+        }
+
+#if defined(IMGUI_ENABLE_SSE) && !defined(IMGUI_OVERRIDE_DRAWVERT_STRUCT_LAYOUT)
+        // Printable ASCII that needs no clipping
+        if (!AsciiQuads.empty())
+        {
+            const char* run_begin = s;
+            s = RenderTextAsciiRun(this, scale, &x, y, col, clip_rect, s, word_wrap_enabled ? ImMin(word_wrap_eol, text_end) : text_end, &vtx_write, &idx_write, &vtx_current_idx);
+            if (s != run_begin)
+                continue;
+        }
+#endif
+
         // Decode and advance source
         unsigned int c = (unsigned int)*s;
         if (c < 0x80)
@@ -211,7 +211,7 @@ void ImGui_ImplDX11_RenderDrawData(ImDrawData* draw_data)
                 // User callback (registered via ImDrawList::AddCallback)
                 pcmd->UserCallback(cmd_list, pcmd);
             }
-            else
+            else if (draw_data->DamageRects == NULL)
             {
                 // Apply scissor/clipping rectangle
                 const D3D11_RECT r = { (LONG)(pcmd->ClipRect.x - pos.x), (LONG)(pcmd->ClipRect.y - pos.y), (LONG)(pcmd->ClipRect.z - pos.x), (LONG)(pcmd->ClipRect.w - pos.y) };
@@ -222,6 +222,23 @@ void ImGui_ImplDX11_RenderDrawData(ImDrawData* draw_data)
                 ctx->PSSetShaderResources(0, 1, &texture_srv);
                 ctx->DrawIndexed(pcmd->ElemCount, idx_offset, vtx_offset);
             }
+            else
+            {
+                // Damage tracking (io.ConfigDamageTracking): the render target kept the previous frame, draw once per damaged rectangle the command touches
+                ID3D11ShaderResourceView* texture_srv = (ID3D11ShaderResourceView*)pcmd->TextureId;
+                ctx->PSSetShaderResources(0, 1, &texture_srv);
+                for (int damage_i = 0; damage_i < draw_data->DamageRectsCount; damage_i++)
+                {
+                    const ImVec4& damage = draw_data->DamageRects[damage_i];
+                    const ImVec4 clip(pcmd->ClipRect.x > damage.x ? pcmd->ClipRect.x : damage.x, pcmd->ClipRect.y > damage.y ? pcmd->ClipRect.y : damage.y,
+                                      pcmd->ClipRect.z < damage.z ? pcmd->ClipRect.z : damage.z, pcmd->ClipRect.w < damage.w ? pcmd->ClipRect.w : damage.w);
+                    const D3D11_RECT r = { (LONG)(clip.x - pos.x), (LONG)(clip.y - pos.y), (LONG)(clip.z - pos.x), (LONG)(clip.w - pos.y) };
+                    if (r.left >= r.right || r.top >= r.bottom)
+                        continue;
+                    ctx->RSSetScissorRects(1, &r);
+                    ctx->DrawIndexed(pcmd->ElemCount, idx_offset, vtx_offset);
+                }
+            }
             idx_offset += pcmd->ElemCount;
         }
         vtx_offset += cmd_list->VtxBuffer.Size;
@@ -410,8 +427,8 @@ bool    ImGui_ImplDX11_CreateDeviceObjects()
         desc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
         desc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
         desc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
-        desc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
-        desc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+        desc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+        desc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
         desc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
         desc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
         g_pd3dDevice->CreateBlendState(&desc, &g_pBlendState);
@@ -17,6 +17,12 @@
 #include <math.h>       // sqrtf, fabsf, fmodf, powf, floorf, ceilf, cosf, sinf
 #include <limits.h>     // INT_MIN, INT_MAX
 
+// Enable SSE2 intrinsics where the target always has them (x64, or x86 built with /arch:SSE2)
+#if (defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(IMGUI_DISABLE_SSE)
+#define IMGUI_ENABLE_SSE
+#include <emmintrin.h>
+#endif
+
 #ifdef _MSC_VER
 #pragma warning (push)
 #pragma warning (disable: 4251) // class 'xxx' needs to have dll-interface to be used by clients of struct 'xxx' // when IMGUI_API is set to__declspec(dllexport)
@@ -40,7 +46,9 @@ struct ImGuiColorMod;               // Stacked color modifier, backup of modifie
 struct ImGuiColumnData;             // Storage data for a single column
 struct ImGuiColumnsSet;             // Storage data for a columns set
 struct ImGuiContext;                // Main imgui context
+struct ImGuiDamageList;             // A draw list's output last frame, for io.ConfigDamageTracking
 struct ImGuiGroupData;              // Stacked storage data for BeginGroup()/EndGroup()
+struct ImGuiIdleInputs;             // Input state compared from frame to frame for io.ConfigIdleDetection
 struct ImGuiInputTextState;         // Internal state of the currently focused/edited text input box
 struct ImGuiItemHoveredDataBackup;  // Backup and restore IsItemHovered() internal data
 struct ImGuiMenuColumns;            // Simple column measurement, currently used for MenuItem() only
@@ -49,6 +57,8 @@ struct ImGuiNextWindowData;         // Storage for SetNexWindow** functions
 struct ImGuiPopupRef;               // Storage for current popup stack
 struct ImGuiSettingsHandler;        // Storage for one type registered in the .ini file
 struct ImGuiStyleMod;               // Stacked style modifier, backup of modified data so we can restore it
+struct ImGuiTextSizeCacheEntry;     // A size returned by CalcTextSize(), for io.ConfigTextSizeCache
+struct ImGuiAllocReport;            // A MemAlloc() call made in a steady state frame, for io.ConfigDebugAllocCheckFrames
 struct ImGuiWindow;                 // Storage for one window
 struct ImGuiWindowTempData;         // Temporary storage for one window (that's the data which in theory we could ditch at the end of the frame)
 struct ImGuiWindowSettings;         // Storage for window settings stored in .ini file (we keep one of those even if the actual window wasn't instanced during this session)
@@ -229,7 +239,11 @@ struct IMGUI_API ImPool
     T*          GetByIndex(ImPoolIdx n)             { return &Data[n]; }
     ImPoolIdx   GetIndex(const T* p) const          { IM_ASSERT(p >= Data.Data && p < Data.Data + Data.Size); return (ImPoolIdx)(p - Data.Data); }
     T*          GetOrAddByKey(ImGuiID key)          { int* p_idx = Map.GetIntRef(key, -1); if (*p_idx != -1) return &Data[*p_idx]; *p_idx = FreeIdx; return Add(); }
+#ifdef IMGUI_USE_SORTED_STORAGE
     void        Clear()                             { for (int n = 0; n < Map.Data.Size; n++) { int idx = Map.Data[n].val_i; if (idx != -1) Data[idx].~T(); }  Map.Clear(); Data.clear(); FreeIdx = 0; }
+#else
+    void        Clear()                             { for (int n = 0; n < Map.Data.Size; n++) { int idx = Map.Data[n].val_i; if (idx != -1 && Map.Data[n].key != 0) Data[idx].~T(); }  if (Map.ZeroKeyUsed && Map.ZeroKey.val_i != -1) Data[Map.ZeroKey.val_i].~T();  Map.Clear(); Data.clear(); FreeIdx = 0; }   // Skip the empty slots of the hash table
+#endif
     T*          Add()                               { int idx = FreeIdx; if (idx == Data.Size) { Data.resize(Data.Size + 1); FreeIdx++; } else { FreeIdx = *(int*)&Data[idx]; } IM_PLACEMENT_NEW(&Data[idx]) T(); return &Data[idx]; }
     void        Remove(ImGuiID key, const T* p)     { Remove(key, GetIndex(p)); }
     void        Remove(ImGuiID key, ImPoolIdx idx)  { Data[idx].~T(); *(int*)&Data[idx] = FreeIdx; FreeIdx = idx; Map.SetInt(key, -1); }
@@ -602,6 +616,54 @@ struct IMGUI_API ImDrawListSharedData
     ImDrawListSharedData();
 };
 
+struct ImGuiIdleInputs
+{
+    ImVec2      DisplaySize;
+    ImVec2      MousePos;
+    float       NavInputs[ImGuiNavInput_COUNT];
+    bool        MouseDown[5];
+    bool        KeyCtrl, KeyShift, KeyAlt, KeySuper;
+    bool        KeysDown[512];
+
+    ImGuiIdleInputs();
+    bool        operator==(const ImGuiIdleInputs& rhs) const;
+};
+
+// A draw list in the draw data, compared with the previous frame's for io.ConfigDamageTracking
+struct ImGuiDamageList
+{
+    const ImDrawList*   DrawList;
+    const ImDrawList*   Below;      // Previous draw list in the draw data, a change means the order changed
+    ImU64               Hash;       // Of the vertices, indices and commands
+    ImRect              Bounds;     // Of the vertices, within the clip rectangles
+    bool                Volatile;   // Has callbacks, which may draw anything
+};
+
+// A size returned by CalcTextSize() and what it was measured with, for io.ConfigTextSizeCache
+struct ImGuiTextSizeCacheEntry
+{
+    ImU64               TextHash;       // Of the text, seeded with its length
+    const ImFont*       Font;
+    ImU32               FontGeneration; // Font->Generation, a rebuilt font doesn't match its old entries
+    float               FontSize;
+    float               WrapWidth;
+    bool                HideTextAfterDoubleHash;
+    ImVec2              Size;
+    int                 BucketNext;     // Next entry in the same hash bucket, -1 at the end
+    int                 LruPrev;        // More recently used entry, -1 at the head
+    int                 LruNext;        // Less recently used entry, -1 at the tail
+};
+
+// A MemAlloc() call made between NewFrame() and the end of Render() once io.ConfigDebugAllocCheckFrames frames have passed
+struct ImGuiAllocReport
+{
+    int                 Frame;
+    size_t              Size;
+    ImGuiAllocTag       Tag;
+    int                 CallStackSize;
+    void*               CallStack[12];  // Return addresses, innermost first (starting in MemAlloc()). Empty on platforms without a stack walker.
+};
+
 struct ImDrawDataBuilder
 {
     ImVector<ImDrawList*>   Layers[2];           // Global layers for: regular, tooltip
@@ -611,6 +673,34 @@ struct ImDrawDataBuilder
     IMGUI_API void FlattenIntoSingleLayer();
 };
 
+// Draw list caching for windows with ImGuiWindowFlags_CacheDrawList.
+// - While recording, the draw list's primitives append their arguments to Ops instead of building vertices, with positions
+//   relative to Origin. Clip rectangles are stored relative and clamped to the window's Bounds, as nothing is drawn outside.
+// - At the end of the frame the recorded calls are compared with the previous frame's. When they match, last frame's buffers
+//   are swapped back in and offset by how much the window moved. Otherwise the calls are replayed to build new geometry.
+// - Anything that can't be recorded (PrimReserve() from outside, channels, callbacks, ...) replays what was recorded so far and
+//   carries on drawing normally. That frame isn't cached.
+// The comparison is exact (byte for byte), not a hash, so a collision can never show a stale frame.
+struct ImDrawListCache
+{
+    bool                    Active;             // Between DrawListCacheBeginFrame() and DrawListCacheEndFrame()
+    bool                    PrevValid;          // CmdBuffer/IdxBuffer/VtxBuffer hold the geometry of PrevOps, drawn at PrevOrigin
+    ImVec2                  Origin;
+    ImVec2                  PrevOrigin;
+    ImRect                  Bounds;             // Relative to Origin
+    ImVector<char>          Ops;
+    ImVector<char>          PrevOps;
+    ImVector<ImDrawCmd>     CmdBuffer;          // Swapped with the draw list's while it records
+    ImVector<ImDrawIdx>     IdxBuffer;
+    ImVector<ImDrawVert>    VtxBuffer;
+    ImVector<ImVec2>        TempPath;           // Absolute points while replaying
+    int                     HitCount;           // Frames reusing the cached geometry
+    int                     MissCount;          // Frames replaying the recorded calls
+    int                     FlushCount;         // Frames that stopped recording
+
+    ImDrawListCache()       { Active = PrevValid = false; HitCount = MissCount = FlushCount = 0; }
+};
+
 struct ImGuiNavMoveResult
 {
     ImGuiID       ID;           // Best candidate
@@ -784,7 +874,7 @@ struct ImGuiContext
     ImGuiID                 DragDropAcceptIdPrev;               // Target item id from previous frame (we need to store this to allow for overlapping drag and drop targets)
     int                     DragDropAcceptFrameCount;           // Last time a target expressed a desire to accept the source
     ImVector<unsigned char> DragDropPayloadBufHeap;             // We don't expose the ImVector<> directly
-    unsigned char           DragDropPayloadBufLocal[8];         // Local buffer for small payloads
+    unsigned char           DragDropPayloadBufLocal[16];        // Local buffer for small payloads (a color is 12 or 16 bytes)
 
     // Widget state
     ImGuiInputTextState     InputTextState;
@@ -814,6 +904,31 @@ struct ImGuiContext
     int                     LogStartDepth;
     int                     LogAutoExpandMaxDepth;
 
+    // Idle detection (io.ConfigIdleDetection)
+    ImGuiIdleInputs         IdleInputs;                         // Last frame's
+    bool                    IdleInputsChanged;                  // This frame's differ from the last, or came with events (wheel, characters)
+    ImU64                   IdleDrawDataHash;                   // Last frame's
+    int                     IdleFrames;                         // Consecutive frames without input changes and with the same draw data
+
+    // Damage tracking (io.ConfigDamageTracking)
+    ImVector<ImGuiDamageList> DamageLists;                      // This frame's, in draw order
+    ImVector<ImGuiDamageList> DamageListsPrev;
+    ImVector<ImVec4>        DamageRects;                        // Pointed to by DrawData.DamageRects
+    ImVec2                  DamageDisplaySize;                  // Last frame's, FLT_MAX after the tracking was off
+
+    // Text size cache (io.ConfigTextSizeCache)
+    ImVector<ImGuiTextSizeCacheEntry> TextSizeCache;            // Up to TEXT_SIZE_CACHE_CAPACITY entries
+    ImVector<int>           TextSizeCacheBuckets;               // First entry of each hash bucket, -1 when empty
+    int                     TextSizeCacheLruHead;               // Most recently used entry
+    int                     TextSizeCacheLruTail;               // Least recently used entry, the next one evicted
+    int                     TextSizeCacheHits, TextSizeCacheMisses, TextSizeCacheEvictions;    // This frame's
+    int                     TextSizeCacheHitsLastFrame, TextSizeCacheMissesLastFrame, TextSizeCacheEvictionsLastFrame;
+
+    // Allocation checking (io.ConfigDebugAllocCheckFrames)
+    bool                    AllocCheckActive;                   // Set by NewFrame() past the warm-up frames, cleared at the end of Render()
+    ImGuiAllocReport        AllocReports[16];                   // Last reports, in a ring: recording them mustn't allocate
+    int                     AllocReportsCount;                  // Total, the last report is AllocReports[(AllocReportsCount - 1) % 16]
+
     // Misc
     float                   FramerateSecPerFrame[120];          // Calculate estimate of framerate for user over the last 2 seconds.
     int                     FramerateSecPerFrameIdx;
@@ -921,6 +1036,18 @@ struct ImGuiContext
         LogStartDepth = 0;
         LogAutoExpandMaxDepth = 2;
 
+        IdleInputs = ImGuiIdleInputs();
+        IdleInputsChanged = true;
+        IdleDrawDataHash = 0;
+        IdleFrames = 0;
+        DamageDisplaySize = ImVec2(FLT_MAX, FLT_MAX);
+        TextSizeCacheLruHead = TextSizeCacheLruTail = -1;
+        TextSizeCacheHits = TextSizeCacheMisses = TextSizeCacheEvictions = 0;
+        TextSizeCacheHitsLastFrame = TextSizeCacheMissesLastFrame = TextSizeCacheEvictionsLastFrame = 0;
+        AllocCheckActive = false;
+        memset(AllocReports, 0, sizeof(AllocReports));
+        AllocReportsCount = 0;
+
         memset(FramerateSecPerFrame, 0, sizeof(FramerateSecPerFrame));
         FramerateSecPerFrameIdx = 0;
         FramerateSecPerFrameAccum = 0.0f;
@@ -1084,6 +1211,7 @@ struct IMGUI_API ImGuiWindow
 
     ImDrawList*             DrawList;                           // == &DrawListInst (for backward compatibility reason with code using imgui_internal.h we keep this a pointer)
     ImDrawList              DrawListInst;
+    ImDrawListCache         DrawListCache;                      // With ImGuiWindowFlags_CacheDrawList
     ImGuiWindow*            ParentWindow;                       // If we are a child _or_ popup window, this is pointing to our parent. Otherwise NULL.
     ImGuiWindow*            RootWindow;                         // Point to ourself or first ancestor that is not a child window.
     ImGuiWindow*            RootWindowForTitleBarHighlight;     // Point to ourself or first ancestor which will display TitleBgActive color when this window is active.
@@ -1311,6 +1439,11 @@ namespace ImGui
     IMGUI_API void          ShadeVertsLinearColorGradientKeepAlpha(ImDrawList* draw_list, int vert_start_idx, int vert_end_idx, ImVec2 gradient_p0, ImVec2 gradient_p1, ImU32 col0, ImU32 col1);
     IMGUI_API void          ShadeVertsLinearUV(ImDrawList* draw_list, int vert_start_idx, int vert_end_idx, const ImVec2& a, const ImVec2& b, const ImVec2& uv_a, const ImVec2& uv_b, bool clamp);
 
+    // Draw list caching (see ImDrawListCache)
+    IMGUI_API void          DrawListCacheBeginFrame(ImDrawList* draw_list, ImDrawListCache* cache, const ImVec2& origin, const ImRect& bounds); // Instead of draw_list->Clear()
+    IMGUI_API void          DrawListCacheEndFrame(ImDrawList* draw_list, ImDrawListCache* cache);
+    IMGUI_API void          DrawListCacheFlush(ImDrawList* draw_list);      // Replay what was recorded and stop recording, before touching the buffers directly
+
 } // namespace ImGui
 
 // ImFontAtlas internals
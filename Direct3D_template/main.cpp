@@ -8,11 +8,31 @@
 #include "imgui/imgui_impl_win32.h"
 #include "imgui/imgui_impl_dx11.h"
 #include "bth_image.h"
+#include "ClusteredLighting.h"
+#include "CommandRecorder.h"
+#include "CpuRasterizer.h"
+#include "DynamicResolution.h"
+#include "HotReload.h"
+#include "JobPool.h"
+#include "MeshLod.h"
+#include "OcclusionCulling.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "SceneSystems.h"
+#include "ShaderCache.h"
+#include "ShaderPermutations.h"
+#include "ShadowMaps.h"
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
 using namespace DirectX;
 
 #pragma comment (lib, "d3d11.lib")
@@ -23,6 +43,7 @@ LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 
 HRESULT CreateDirect3DContext(HWND wndHandle);
 
+// The window's initial client size, the back buffer follows the window (gBackbufferWidth)
 #define WIDTH 768.0f
 #define HEIGHT 768.0f
 
@@ -40,6 +61,57 @@ ID3D11DeviceContext* gDeviceContext = nullptr;
 ID3D11RenderTargetView* gBackbufferRTV = nullptr;
 
 ID3D11DepthStencilView* gDSV = nullptr;
+ID3D11DepthStencilState* gDepthStencilState = nullptr;
+// Transparent draws test depth without writing it, overlays ignore it; both blend by alpha
+ID3D11DepthStencilState* gDepthReadOnlyState = nullptr;
+ID3D11DepthStencilState* gDepthDisabledState = nullptr;
+ID3D11BlendState* gAlphaBlend = nullptr;
+
+// The scene is drawn into gSceneRTV: the back buffer, or with MSAA a multisampled
+// texture that ResolveScene() averages into the back buffer before ImGui draws.
+// gDSV has the same sample count.
+ID3D11RenderTargetView* gSceneRTV = nullptr;
+ID3D11Texture2D* gMsaaTexture = nullptr;
+ID3D11RenderTargetView* gMsaaRTV = nullptr;
+UINT gMsaaSamples = 1;
+int gMsaaMode = 0;	// the UI's choice, 1 << gMsaaMode samples
+
+// The back buffer follows the window's client area, see ResizeBackbuffer(). The scene
+// targets have the same size, but with dynamic resolution the scene only fills their
+// top-left gRenderWidth x gRenderHeight, which UpscaleScene() stretches over the back
+// buffer.
+UINT gBackbufferWidth = (UINT)WIDTH;
+UINT gBackbufferHeight = (UINT)HEIGHT;
+UINT gRenderWidth = (UINT)WIDTH;
+UINT gRenderHeight = (UINT)HEIGHT;
+UINT gPendingWidth = 0, gPendingHeight = 0;	// from WM_SIZE, applied at the start of a frame
+
+// Lowers the render resolution when the GPU frame time goes over the budget
+bool gDynamicResolution = false;
+DynamicResolution gResolutionScaler;
+ID3D11Texture2D* gScaledTexture = nullptr;	// the single sample scene, upscaled from
+ID3D11RenderTargetView* gScaledRTV = nullptr;
+ID3D11ShaderResourceView* gScaledView = nullptr;
+ID3D11VertexShader* gUpscaleVS = nullptr;
+ID3D11PixelShader* gUpscalePS = nullptr;
+ID3D11Buffer* gUpscaleConstantBuffer = nullptr;
+
+// With the UI layer ImGui draws into gUiTexture instead of the back buffer. The layer keeps
+// its pixels, so only the rectangles in ImDrawData::DamageRects are cleared and drawn again,
+// then CompositeUi() blends it over the back buffer.
+bool gUiLayer = false;
+bool gUiLayerValid = false;	// false: the next frame clears and draws all of it
+ID3D11Texture2D* gUiTexture = nullptr;
+ID3D11RenderTargetView* gUiRTV = nullptr;
+ID3D11ShaderResourceView* gUiView = nullptr;
+ID3D11BlendState* gPremultipliedBlend = nullptr;
+ID3D11DeviceContext1* gDeviceContext1 = nullptr;	// for ClearView(), D3D 11.1
+float gUiDrawnPercent = 0.0f;	// of the back buffer ImGui draws, averaged
+
+float GetAspectRatio()
+{
+	return (float)gBackbufferWidth / gBackbufferHeight;
+}
 
 ID3D11ShaderResourceView *gTextureView = nullptr;
 ID3D11SamplerState *gSamplerState = nullptr;
@@ -53,61 +125,171 @@ ID3D11InputLayout* gVertexLayout = nullptr;
 
 // resources that represent shaders
 ID3D11VertexShader* gVertexShader = nullptr;
-ID3D11PixelShader* gPixelShader = nullptr;
-ID3D11GeometryShader* gGeometryShader = nullptr;
+// geometry and pixel shaders are owned by gGSPermutations/gPSPermutations
+
+// Compiled at startup, used while the selected permutation is still compiling.
+// Same as the shaders compiled without any defines.
+const ShaderKey DEFAULT_SHADER_KEY = MakeShaderKey(true, true, LIGHTING_LAMBERT, 1);
+ShaderKey gShaderKey = DEFAULT_SHADER_KEY;
+
+bool gExtrude = true;
+bool gTextured = true;
+int gLightingModel = LIGHTING_LAMBERT;
+int gLightCount = 1;
+bool gClustered = false;
+bool gShadows = false;
+int gPointLightCount = 1024;
 
 float gFloat = 1.0f;
 float gDist = 0.0f;
-float gRotation = 0.0f;
 float gIncrement = 0;
 float gClearColour[3] = {};
 
 struct PerFrameMatrices {
-	XMMATRIX World, WorldViewProj;
+	XMMATRIX ViewProj;
+	UINT InstanceOffset;	// set per batch by D3D11Backend::DrawInstanced()
+	UINT Padding[3];
 };
 PerFrameMatrices gMatricesPerFrame;
+XMMATRIX gView;		// not transposed, for moving lights into view space
+XMMATRIX gViewProj;	// not transposed
+
+// Scene state: entities with their components, updated by gSceneSystems.
+// Entities with a SceneNode component get their world matrix through gScene.
+EntityWorld gEntities;
+SceneSystems gSceneSystems;
+Entity gQuadEntity = INVALID_ENTITY;
+Entity gSphereEntity = INVALID_ENTITY;
+LodBenchmarkResult gLodBenchmark = {};
+
+SceneGraph gScene;
+NodeId gSceneRoot = gScene.AddNode(INVALID_NODE);
+NodeId gQuadNode = gScene.AddNode(gSceneRoot);
+double gSceneBenchmarkMs[2] = {};	// 100k nodes, 1% and 100% dirty
+EcsBenchmarkResult gEcsBenchmark = {};
 ID3D11Buffer* gMatrixPerFrameBuffer = NULL;
 
-HRESULT CreateShaders()
+// Compiles through d3dcompiler, used by gShaderCache on a cache miss.
+bool D3DCompileShader(const ShaderDesc& desc, const std::string& source, std::vector<char>& bytecode, std::string& errors)
 {
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const ShaderMacro& define : desc.defines)
+		macros.push_back({ define.name.c_str(), define.definition.c_str() });
+	macros.push_back({ nullptr, nullptr });
+
 	// Binary Large OBject (BLOB), for compiled shader, and errors.
-	ID3DBlob* pVS = nullptr;
+	ID3DBlob* pBlob = nullptr;
 	ID3DBlob* errorBlob = nullptr;
 
-	// https://msdn.microsoft.com/en-us/library/windows/desktop/hh968107(v=vs.85).aspx
-	HRESULT result = D3DCompileFromFile(
-		L"Vertex.hlsl", // filename
-		nullptr,		// optional macros
-		nullptr,		// optional include files
-		"VS_main",		// entry point
-		"vs_5_0",		// shader model (target)
-		D3DCOMPILE_DEBUG,	// shader compile options (DEBUGGING)
-		0,				// IGNORE...DEPRECATED.
-		&pVS,			// double pointer to ID3DBlob		
-		&errorBlob		// pointer for Error Blob messages.
+	// https://docs.microsoft.com/en-us/windows/desktop/api/d3dcompiler/nf-d3dcompiler-d3dcompile
+	HRESULT result = D3DCompile(
+		source.data(),			// source already read (and hashed) by the cache
+		source.size(),
+		desc.path.c_str(),		// name used in error messages and to resolve #include
+		macros.data(),			// optional macros
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		desc.entryPoint.c_str(),	// entry point
+		desc.target.c_str(),	// shader model (target)
+		desc.flags,				// shader compile options
+		0,						// IGNORE...DEPRECATED.
+		&pBlob,					// double pointer to ID3DBlob
+		&errorBlob				// pointer for Error Blob messages.
 	);
-	
-	// compilation failed?
+
+	if (errorBlob)
+	{
+		errors.assign((char*)errorBlob->GetBufferPointer(), errorBlob->GetBufferSize());
+		errorBlob->Release();
+	}
 	if (FAILED(result))
 	{
-		if (errorBlob)
-		{
-			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-			// release "reference" to errorBlob interface object
-			errorBlob->Release();
-		}
-		if (pVS)
-			pVS->Release();
-		return result;
+		if (pBlob)
+			pBlob->Release();
+		return false;
 	}
 
+	bytecode.assign((char*)pBlob->GetBufferPointer(), (char*)pBlob->GetBufferPointer() + pBlob->GetBufferSize());
+	pBlob->Release();
+	return true;
+}
+
+// Compiled shaders are kept in ShaderCache/ next to the executable's working directory,
+// so only shaders whose source, includes, defines or flags changed get recompiled.
+ShaderCache gShaderCache("ShaderCache", D3DCompileShader, "d3dcompiler_" + std::to_string(D3D_COMPILER_VERSION));
+
+// Worker threads for startup work (shader compilation and resource creation).
+JobPool gJobPool;
+
+// Called on gJobPool right after a permutation compiled (ID3D11Device is free-threaded).
+void* CreateGeometryShaderObject(const std::vector<char>& bytecode)
+{
+	ID3D11GeometryShader* shader = nullptr;
+	gDevice->CreateGeometryShader(bytecode.data(), bytecode.size(), nullptr, &shader);
+	return shader;
+}
+
+void* CreatePixelShaderObject(const std::vector<char>& bytecode)
+{
+	ID3D11PixelShader* shader = nullptr;
+	gDevice->CreatePixelShader(bytecode.data(), bytecode.size(), nullptr, &shader);
+	return shader;
+}
+
+void ReleaseShaderObject(void* shader)
+{
+	((IUnknown*)shader)->Release();
+}
+
+// Geometry and pixel shader permutations, compiled on gJobPool the first time a key is used.
+ShaderPermutations gGSPermutations(gShaderCache, gJobPool, { "GeometryShader.hlsl", "GS_main", "gs_5_0", {}, D3DCOMPILE_DEBUG }, SHADER_KEY_GS_MASK,
+	CreateGeometryShaderObject, ReleaseShaderObject);
+ShaderPermutations gPSPermutations(gShaderCache, gJobPool, { "Fragment.hlsl", "PS_main", "ps_5_0", {}, D3DCOMPILE_DEBUG }, SHADER_KEY_PS_MASK,
+	CreatePixelShaderObject, ReleaseShaderObject);
+
+// Returns nullptr while the permutation is compiling (the first call starts the compile).
+ID3D11GeometryShader* GetGeometryShader(ShaderKey key)
+{
+	return (ID3D11GeometryShader*)gGSPermutations.GetShader(key);
+}
+
+ID3D11PixelShader* GetPixelShader(ShaderKey key)
+{
+	return (ID3D11PixelShader*)gPSPermutations.GetShader(key);
+}
+
+// Recompiles shaders edited while the app is running, see ApplyHotReloads().
+HotReloader gHotReloader;
+
+// The shaders that aren't permutations
+const ShaderDesc SCENE_VS_DESC = { "Vertex.hlsl", "VS_main", "vs_5_0", {}, D3DCOMPILE_DEBUG };
+const ShaderDesc UPSCALE_VS_DESC = { "Upscale.hlsl", "VS_upscale", "vs_5_0", {}, D3DCOMPILE_DEBUG };
+const ShaderDesc UPSCALE_PS_DESC = { "Upscale.hlsl", "PS_upscale", "ps_5_0", {}, D3DCOMPILE_DEBUG };
+
+// Frame boundary: starts recompiles for edited shaders and swaps in the ones that finished.
+// Returns true when anything was swapped in.
+bool ApplyHotReloads()
+{
+	int swapped = gHotReloader.Update();
+
+	std::string errors;
+	swapped += gGSPermutations.ApplyReloads(&errors);
+	swapped += gPSPermutations.ApplyReloads(&errors);
+	if (!errors.empty())
+		OutputDebugStringA(errors.c_str());
+	return swapped > 0;
+}
+
+// The scene vertex shader and its input layout (verified against the vertex shader).
+// Called on gJobPool workers, ID3D11Device is free-threaded.
+void CreateSceneVertexShader(const std::vector<char>& bytecode, ID3D11VertexShader** shader, ID3D11InputLayout** layout)
+{
 	gDevice->CreateVertexShader(
-		pVS->GetBufferPointer(), 
-		pVS->GetBufferSize(), 
+		bytecode.data(), 
+		bytecode.size(), 
 		nullptr, 
-		&gVertexShader
+		shader
 	);
-	
+
 	// create input layout (verified using vertex shader)
 	// Press F1 in Visual Studio with the cursor over the datatype to jump
 	// to the documentation online!
@@ -134,89 +316,158 @@ HRESULT CreateShaders()
 		},
 	};
 
-	gDevice->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), pVS->GetBufferPointer(), pVS->GetBufferSize(), &gVertexLayout);
-
-	// we do not need anymore this COM object, so we release it.
-	pVS->Release();
-
-
-	////GeometryShader
-	ID3DBlob* pGS = nullptr;
-	if (errorBlob) errorBlob->Release();
-	errorBlob = nullptr;
+	gDevice->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), bytecode.data(), bytecode.size(), layout);
+}
 
-	result = D3DCompileFromFile(
-		L"GeometryShader.hlsl", // filename
-		nullptr,		// optional macros
-		nullptr,		// optional include files
-		"GS_main",		// entry point
-		"gs_5_0",		// shader model (target)
-		D3DCOMPILE_DEBUG,	// shader compile options (DEBUGGING)
-		0,				// IGNORE...DEPRECATED.
-		&pGS,			// double pointer to ID3DBlob		
-		&errorBlob		// pointer for Error Blob messages.
-	);
+HRESULT CreateShaders()
+{
+	// All shaders compile as independent jobs. Only the vertex shader and the
+	// input layout (verified against the vertex shader) have to wait on each other.
+	ShaderCompileJob vs;
+	vs.desc = SCENE_VS_DESC;
+
+	gJobPool.ClearTimeline();
+	SubmitShaderCompile(gJobPool, gShaderCache, vs);
+	// queue the default permutations
+	GetGeometryShader(DEFAULT_SHADER_KEY);
+	GetPixelShader(DEFAULT_SHADER_KEY);
+
+	// ID3D11Device is free-threaded, so objects can be created on the workers
+	JobId vsCreate = gJobPool.Submit("CreateVertexShader + CreateInputLayout", [&vs]
+	{
+		if (vs.succeeded)
+			CreateSceneVertexShader(vs.bytecode, &gVertexShader, &gVertexLayout);
+	}, { vs.job });
+
+	// the dynamic resolution upscale, a separate shader pair
+	ShaderCompileJob upscaleVS;
+	upscaleVS.desc = UPSCALE_VS_DESC;
+	SubmitShaderCompile(gJobPool, gShaderCache, upscaleVS);
+	ShaderCompileJob upscalePS;
+	upscalePS.desc = UPSCALE_PS_DESC;
+	SubmitShaderCompile(gJobPool, gShaderCache, upscalePS);
+	JobId upscaleCreate = gJobPool.Submit("Create upscale shaders", [&upscaleVS, &upscalePS]
+	{
+		if (upscaleVS.succeeded)
+			gDevice->CreateVertexShader(upscaleVS.bytecode.data(), upscaleVS.bytecode.size(), nullptr, &gUpscaleVS);
+		if (upscalePS.succeeded)
+			gDevice->CreatePixelShader(upscalePS.bytecode.data(), upscalePS.bytecode.size(), nullptr, &gUpscalePS);
+	}, { upscaleVS.job, upscalePS.job });
+
+	gJobPool.Wait(vsCreate);
+	gJobPool.Wait(upscaleCreate);
+	gGSPermutations.GetBlocking(DEFAULT_SHADER_KEY);
+	gPSPermutations.GetBlocking(DEFAULT_SHADER_KEY);
+
+	// startup timeline, shows which compiles overlapped
+	ShaderCacheStats stats = gShaderCache.GetStats();
+	char message[128];
+	sprintf_s(message, "ShaderCache: %d hits, %d misses, %.2f ms compiling\n", stats.hits, stats.misses, stats.compileMs);
+	OutputDebugStringA(message);
+	OutputDebugStringA(gJobPool.TimelineReport().c_str());
+	// the pool runs jobs every frame from here on
+	gJobPool.SetTimelineEnabled(false);
 
 	// compilation failed?
-	if (FAILED(result))
+	HRESULT result = S_OK;
+	if (!vs.succeeded)
 	{
-		if (errorBlob)
-		{
-			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-			// release "reference" to errorBlob interface object
-			errorBlob->Release();
-		}
-		if (pGS)
-			pGS->Release();
-		return result;
+		OutputDebugStringA(vs.errors.c_str());
+		result = E_FAIL;
 	}
+	if (!upscaleVS.succeeded || !upscalePS.succeeded)
+	{
+		OutputDebugStringA(upscaleVS.errors.c_str());
+		OutputDebugStringA(upscalePS.errors.c_str());
+		result = E_FAIL;
+	}
+	if (!GetGeometryShader(DEFAULT_SHADER_KEY))
+	{
+		OutputDebugStringA(gGSPermutations.GetErrors(DEFAULT_SHADER_KEY).c_str());
+		result = E_FAIL;
+	}
+	if (!GetPixelShader(DEFAULT_SHADER_KEY))
+	{
+		OutputDebugStringA(gPSPermutations.GetErrors(DEFAULT_SHADER_KEY).c_str());
+		result = E_FAIL;
+	}
+	return result;
+}
 
-	gDevice->CreateGeometryShader(
-		pGS->GetBufferPointer(),
-		pGS->GetBufferSize(),
-		nullptr,
-		&gGeometryShader
-	);
-
-	// we do not need anymore this COM object, so we release it.
-	pGS->Release();
-
-	////create pixel shader
-	ID3DBlob* pPS = nullptr;
-	if (errorBlob) errorBlob->Release();
-	errorBlob = nullptr;
-
-	result = D3DCompileFromFile(
-		L"Fragment.hlsl", // filename
-		nullptr,		// optional macros
-		nullptr,		// optional include files
-		"PS_main",		// entry point
-		"ps_5_0",		// shader model (target)
-		D3DCOMPILE_DEBUG,	// shader compile options
-		0,				// effect compile options
-		&pPS,			// double pointer to ID3DBlob		
-		&errorBlob			// pointer for Error Blob messages.
-	);
-
-	// compilation failed?
-	if (FAILED(result))
+// Hot reload of the vertex shader and the upscale shaders. They compile and get created on
+// gJobPool like at startup, then gHotReloader swaps them in at the next frame boundary
+// (ApplyHotReloads()). One that fails keeps its old version.
+void ReloadSceneVertexShader()
+{
+	std::shared_ptr<ShaderCompileJob> vs = std::make_shared<ShaderCompileJob>();
+	vs->desc = SCENE_VS_DESC;
+	SubmitShaderCompile(gJobPool, gShaderCache, *vs);
+	gJobPool.Submit("Reload " + vs->desc.path, [vs]
 	{
-		if (errorBlob)
+		ID3D11VertexShader* shader = nullptr;
+		ID3D11InputLayout* layout = nullptr;
+		if (vs->succeeded)
+			CreateSceneVertexShader(vs->bytecode, &shader, &layout);
+		if (!shader || !layout)
 		{
-			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-			// release "reference" to errorBlob interface object
-			errorBlob->Release();
+			// e.g. the input signature no longer matches the vertex buffer
+			OutputDebugStringA(vs->succeeded ? "Vertex.hlsl: CreateInputLayout failed\n" : vs->errors.c_str());
+			if (shader)
+				shader->Release();
+			return;
 		}
-		if (pPS)
-			pPS->Release();
-		return result;
-	}
-
-	gDevice->CreatePixelShader(pPS->GetBufferPointer(), pPS->GetBufferSize(), nullptr, &gPixelShader);
-	// we do not need anymore this COM object, so we release it.
-	pPS->Release();
+		gHotReloader.QueueSwap([shader, layout]
+		{
+			// null when they failed at startup, an edit can fix that
+			if (gVertexShader)
+				gVertexShader->Release();
+			if (gVertexLayout)
+				gVertexLayout->Release();
+			gVertexShader = shader;
+			gVertexLayout = layout;
+		});
+	}, { vs->job });
+}
 
-	return S_OK;
+void ReloadUpscaleShaders()
+{
+	std::shared_ptr<ShaderCompileJob> vs = std::make_shared<ShaderCompileJob>();
+	std::shared_ptr<ShaderCompileJob> ps = std::make_shared<ShaderCompileJob>();
+	vs->desc = UPSCALE_VS_DESC;
+	ps->desc = UPSCALE_PS_DESC;
+	SubmitShaderCompile(gJobPool, gShaderCache, *vs);
+	SubmitShaderCompile(gJobPool, gShaderCache, *ps);
+	gJobPool.Submit("Reload " + vs->desc.path, [vs, ps]
+	{
+		// both or neither, the pair shares its interface
+		if (!vs->succeeded || !ps->succeeded)
+		{
+			OutputDebugStringA(vs->errors.c_str());
+			OutputDebugStringA(ps->errors.c_str());
+			return;
+		}
+		ID3D11VertexShader* vertexShader = nullptr;
+		ID3D11PixelShader* pixelShader = nullptr;
+		gDevice->CreateVertexShader(vs->bytecode.data(), vs->bytecode.size(), nullptr, &vertexShader);
+		gDevice->CreatePixelShader(ps->bytecode.data(), ps->bytecode.size(), nullptr, &pixelShader);
+		if (!vertexShader || !pixelShader)
+		{
+			if (vertexShader)
+				vertexShader->Release();
+			if (pixelShader)
+				pixelShader->Release();
+			return;
+		}
+		gHotReloader.QueueSwap([vertexShader, pixelShader]
+		{
+			if (gUpscaleVS)
+				gUpscaleVS->Release();
+			if (gUpscalePS)
+				gUpscalePS->Release();
+			gUpscaleVS = vertexShader;
+			gUpscalePS = pixelShader;
+		});
+	}, { vs->job, ps->job });
 }
 
 struct TriangleVertex
@@ -225,6 +476,27 @@ struct TriangleVertex
 	float u, v;
 };
 
+// Mesh ids of Renderable: ranges of gVertexBuffer
+struct MeshRange
+{
+	UINT firstVertex;
+	UINT vertexCount;
+};
+std::vector<MeshRange> gMeshes;
+// The same meshes indexed, for drawing on the CPU
+std::vector<IndexedMesh> gCpuMeshes;
+
+// LOD chains of the meshes made in CreateTriangleData(); chain 0 is the sphere, its
+// levels are meshes gSphereMesh, gSphereMesh + 1, ...
+std::vector<LodChain> gLodChains;
+UINT gSphereMesh = 0;
+
+// Occluder meshes for gSceneSystems, only the quad. The CPU depth buffer they are
+// drawn into is a third of the screen's size.
+std::vector<IndexedMesh> gOccluderMeshes;
+OcclusionCuller gOcclusionCuller((int)WIDTH / 3, (int)HEIGHT / 3);
+bool gOcclusionCulling = true;
+
 void CreateTriangleData()
 {
 	// Array of Structs (AoS)
@@ -248,6 +520,35 @@ void CreateTriangleData()
 		0.5f, -0.5f, 0.0f,	//v5 pos
 		1.0f, 1.0f			//v5 tex
 	};
+	std::vector<TriangleVertex> vertices(triangleVertices, triangleVertices + 6);
+	gMeshes.push_back({ 0, 6 });
+
+	IndexedMesh quad;
+	for (int i = 0; i < 6; i++)
+	{
+		const TriangleVertex& vertex = triangleVertices[i];
+		quad.vertices.push_back({ { vertex.x, vertex.y, vertex.z }, vertex.u, vertex.v });
+		quad.indices.push_back(i);
+	}
+	gOccluderMeshes.push_back(quad);
+	gCpuMeshes.push_back(quad);
+
+	// a sphere and its simplified levels, unindexed after the quad
+	IndexedMesh sphere = MakeSphereMesh(32, 64);
+	for (MeshVertex& vertex : sphere.vertices)
+		vertex.position = vertex.position * 0.4f;
+	BuildLodChains({ &sphere }, gLodChains, &gJobPool);
+	gSphereMesh = (UINT)gMeshes.size();
+	for (const LodLevel& level : gLodChains[0].levels)
+	{
+		gMeshes.push_back({ (UINT)vertices.size(), (UINT)level.mesh.indices.size() });
+		gCpuMeshes.push_back(level.mesh);
+		for (unsigned int index : level.mesh.indices)
+		{
+			const MeshVertex& vertex = level.mesh.vertices[index];
+			vertices.push_back({ vertex.position.x, vertex.position.y, vertex.position.z, vertex.u, vertex.v });
+		}
+	}
 
 	// Describe the Vertex Buffer
 	D3D11_BUFFER_DESC bufferDesc;
@@ -257,21 +558,22 @@ void CreateTriangleData()
 	// what type of usage (press F1, read the docs)
 	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
 	// how big in bytes each element in the buffer is.
-	bufferDesc.ByteWidth = sizeof(triangleVertices);
+	bufferDesc.ByteWidth = (UINT)(vertices.size() * sizeof(TriangleVertex));
 
 	// this struct is created just to set a pointer to the
 	// data containing the vertices.
 	D3D11_SUBRESOURCE_DATA data;
-	data.pSysMem = triangleVertices;
+	data.pSysMem = vertices.data();
 
 	// create a Vertex Buffer
 	gDevice->CreateBuffer(&bufferDesc, &data, &gVertexBuffer);
 }
 
+// Matches FS_CONSTANT_BUFFER, the pixel shader permutation decides how many lights are used
 struct Lights
 {
-	XMVECTOR lightPos = {0.0f, 0.0f, -2.0f};
-	XMVECTOR lightCol = {1.0f, 1.0f, 1.0f};
+	XMVECTOR lightPos[SHADER_MAX_LIGHTS] = { {0.0f, 0.0f, -2.0f}, {1.5f, 0.0f, -1.0f}, {-1.5f, 0.0f, -1.0f}, {0.0f, 1.5f, -1.0f} };
+	XMVECTOR lightCol[SHADER_MAX_LIGHTS] = { {1.0f, 1.0f, 1.0f}, {1.0f, 0.2f, 0.2f}, {0.2f, 1.0f, 0.2f}, {0.2f, 0.2f, 1.0f} };
 };
 Lights gLight;
 
@@ -315,37 +617,490 @@ void createConstantBuffer()
 	gDevice->CreateBuffer(&cbDesc, &InitData, &gConstantBufferLight);
 }
 
-void transform(float increment)
+// Clustered lighting: many small point lights circling the quad, assigned to clusters
+// on the CPU every frame and read by the CLUSTERED pixel shader permutations
+const int MAX_POINT_LIGHTS = 4096;
+ClusteredLighting gClusters;
+std::vector<PointLight> gPointLights;	// world space
+std::vector<PointLight> gViewLights;	// view space copies for AssignLights()
+
+ID3D11Buffer* gPointLightBuffer = nullptr;
+ID3D11ShaderResourceView* gPointLightView = nullptr;
+ID3D11Buffer* gClusterGridBuffer = nullptr;
+ID3D11ShaderResourceView* gClusterGridView = nullptr;
+ID3D11Buffer* gClusterIndexBuffer = nullptr;
+ID3D11ShaderResourceView* gClusterIndexView = nullptr;
+UINT gClusterIndexCapacity = 0;
+ID3D11Buffer* gClusterConstantBuffer = nullptr;
+
+// Dynamic structured buffer, rewritten with Map(WRITE_DISCARD) every frame
+HRESULT CreateStructuredBuffer(UINT stride, UINT count, ID3D11Buffer** buffer, ID3D11ShaderResourceView** view)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = stride * count;
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bufferDesc.StructureByteStride = stride;
+	HRESULT hr = gDevice->CreateBuffer(&bufferDesc, nullptr, buffer);
+	if (FAILED(hr))
+		return hr;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	viewDesc.Buffer.FirstElement = 0;
+	viewDesc.Buffer.NumElements = count;
+	return gDevice->CreateShaderResourceView(*buffer, &viewDesc, view);
+}
+
+void UploadBuffer(ID3D11Buffer* buffer, const void* data, size_t size, ID3D11DeviceContext* context = gDeviceContext)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedMemory;
+	if (size == 0 || FAILED(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedMemory)))
+		return;
+	memcpy(mappedMemory.pData, data, size);
+	context->Unmap(buffer, 0);
+}
+
+// The cluster grid covers the back buffer, so it's set up again when that is resized
+void configureClusters()
+{
+	// same projection as transform()
+	gClusters.Configure((int)gBackbufferWidth, (int)gBackbufferHeight, 64, 24, 0.45f * DirectX::XM_PI, GetAspectRatio(), 0.1f, 20.0f);
+
+	if (gClusterGridView)
+	{
+		gClusterGridView->Release();
+		gClusterGridBuffer->Release();
+	}
+	CreateStructuredBuffer(sizeof(ClusterRange), gClusters.GetClusterCount(), &gClusterGridBuffer, &gClusterGridView);
+}
+
+void createClusterBuffers()
+{
+	configureClusters();
+
+	// lights on rings around the quad, each ring turns at its own speed in UpdateClusters()
+	gPointLights.resize(MAX_POINT_LIGHTS);
+	for (int i = 0; i < MAX_POINT_LIGHTS; i++)
+	{
+		float angle = i * 2.39996f;		// golden angle, spreads the lights evenly
+		float height = ((i * 7919) % 1000) / 1000.0f * 2.0f - 1.0f;
+		float distance = 0.4f + ((i * 104729) % 1000) / 1000.0f * 0.8f;
+		PointLight& light = gPointLights[i];
+		light.position[0] = cosf(angle) * distance;
+		light.position[1] = height;
+		light.position[2] = sinf(angle) * distance;
+		light.radius = 0.15f + (i % 5) * 0.05f;
+		light.color[0] = 0.5f + 0.5f * cosf(angle);
+		light.color[1] = 0.5f + 0.5f * cosf(angle + 2.094f);
+		light.color[2] = 0.5f + 0.5f * cosf(angle + 4.189f);
+		light.padding = 0.0f;
+	}
+	gViewLights.resize(MAX_POINT_LIGHTS);
+
+	CreateStructuredBuffer(sizeof(PointLight), MAX_POINT_LIGHTS, &gPointLightBuffer, &gPointLightView);
+
+	// uploaded by UpdateClusters(), the render scale changes with dynamic resolution
+	D3D11_BUFFER_DESC cbDesc = {};
+	cbDesc.ByteWidth = sizeof(ClusterConstants);
+	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	gDevice->CreateBuffer(&cbDesc, nullptr, &gClusterConstantBuffer);
+}
+
+// Moves the lights, assigns them to clusters and uploads the lists
+void UpdateClusters(float time)
+{
+	// gViewLights first holds this frame's world positions for the shader...
+	for (int i = 0; i < gPointLightCount; i++)
+	{
+		const PointLight& light = gPointLights[i];
+		float turn = time * (0.2f + (i % 7) * 0.1f);
+		XMVECTOR position = XMVector3Transform(XMVectorSet(light.position[0], light.position[1], light.position[2], 1.0f), XMMatrixRotationY(turn));
+
+		gViewLights[i] = light;
+		XMStoreFloat3((XMFLOAT3*)gViewLights[i].position, position);
+	}
+	UploadBuffer(gPointLightBuffer, gViewLights.data(), gPointLightCount * sizeof(PointLight));
+
+	// ...and is then moved into view space for the cluster tests
+	for (int i = 0; i < gPointLightCount; i++)
+	{
+		XMVECTOR position = XMVector3TransformCoord(XMLoadFloat3((XMFLOAT3*)gViewLights[i].position), gView);
+		XMStoreFloat3((XMFLOAT3*)gViewLights[i].position, position);
+	}
+	gClusters.AssignLights(gViewLights.data(), gPointLightCount, &gJobPool);
+
+	const std::vector<unsigned int>& indices = gClusters.GetLightIndices();
+	if (indices.size() > gClusterIndexCapacity)
+	{
+		if (gClusterIndexView)
+			gClusterIndexView->Release();
+		if (gClusterIndexBuffer)
+			gClusterIndexBuffer->Release();
+		gClusterIndexCapacity = (UINT)indices.size() * 2;
+		CreateStructuredBuffer(sizeof(unsigned int), gClusterIndexCapacity, &gClusterIndexBuffer, &gClusterIndexView);
+	}
+	UploadBuffer(gClusterGridBuffer, gClusters.GetGrid().data(), gClusters.GetGrid().size() * sizeof(ClusterRange));
+	UploadBuffer(gClusterIndexBuffer, indices.data(), indices.size() * sizeof(unsigned int));
+	UploadBuffer(gClusterConstantBuffer, &gClusters.GetConstants(), sizeof(ClusterConstants));
+}
+
+// Shadows of light 0 (SHADOWS permutations): cascaded shadow maps, one slice of
+// gShadowTexture per cascade, drawn by RenderShadowMaps() before the scene
+ShadowSettings gShadowSettings;
+ShadowConstants gShadowConstants = {};
+ID3D11Texture2D* gShadowTexture = nullptr;
+ID3D11DepthStencilView* gShadowDSVs[SHADOW_MAX_CASCADES] = {};
+ID3D11ShaderResourceView* gShadowView = nullptr;
+ID3D11SamplerState* gShadowSampler = nullptr;
+ID3D11Buffer* gShadowConstantBuffer = nullptr;
+
+// The same maps drawn on the CPU, to compare and profile
+CpuShadowMaps gCpuShadowMaps;
+
+void createShadowMaps()
+{
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = gShadowSettings.mapSize;
+	textureDesc.Height = gShadowSettings.mapSize;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = SHADOW_MAX_CASCADES;
+	textureDesc.Format = DXGI_FORMAT_R32_TYPELESS;	// D32 to draw into, R32 to sample
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	gDevice->CreateTexture2D(&textureDesc, nullptr, &gShadowTexture);
+
+	for (int cascade = 0; cascade < SHADOW_MAX_CASCADES; cascade++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		dsvDesc.Texture2DArray.FirstArraySlice = cascade;
+		dsvDesc.Texture2DArray.ArraySize = 1;
+		gDevice->CreateDepthStencilView(gShadowTexture, &dsvDesc, &gShadowDSVs[cascade]);
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	viewDesc.Texture2DArray.MipLevels = 1;
+	viewDesc.Texture2DArray.ArraySize = SHADOW_MAX_CASCADES;
+	gDevice->CreateShaderResourceView(gShadowTexture, &viewDesc, &gShadowView);
+
+	// bilinear comparison, outside the map counts as lit
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+	for (int i = 0; i < 4; i++)
+		samplerDesc.BorderColor[i] = 1.0f;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	gDevice->CreateSamplerState(&samplerDesc, &gShadowSampler);
+
+	D3D11_BUFFER_DESC cbDesc = {};
+	cbDesc.ByteWidth = sizeof(ShadowConstants);
+	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	gDevice->CreateBuffer(&cbDesc, nullptr, &gShadowConstantBuffer);
+}
+
+// For the camera of transform(), light 0 shining from lightPos[0] towards the origin
+void UpdateShadowCascades()
+{
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, gView);
+	XMFLOAT3 lightPos;
+	XMStoreFloat3(&lightPos, gLight.lightPos[0]);
+	ComputeShadowCascades(*(const Float4x4*)&view, 0.45f * DirectX::XM_PI, GetAspectRatio(), 0.1f, 20.0f,
+		{ -lightPos.x, -lightPos.y, -lightPos.z }, gShadowSettings, gShadowConstants);
+	UploadBuffer(gShadowConstantBuffer, &gShadowConstants, sizeof(gShadowConstants));
+}
+
+// This frame for CpuRasterizer: the draw list with the current permutation, lights,
+// clusters and (once drawn on the CPU) shadow maps
+std::vector<MsaaTiming> gMsaaBenchmark;
+
+CpuScene GetCpuScene()
+{
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, gViewProj);
+	const std::vector<DrawItem>& drawList = gSceneSystems.GetDrawList();
+
+	CpuScene scene = {};
+	scene.viewProj = *(const Float4x4*)&viewProj;
+	scene.items = drawList.data();
+	scene.itemCount = (int)drawList.size();
+	scene.meshes = &gCpuMeshes;
+	scene.key = gShaderKey;
+	for (int i = 0; i < SHADER_MAX_LIGHTS; i++)
+	{
+		XMStoreFloat3((XMFLOAT3*)&scene.lights.pos[i], gLight.lightPos[i]);
+		XMStoreFloat3((XMFLOAT3*)&scene.lights.col[i], gLight.lightCol[i]);
+	}
+	scene.lights.clusterLights = gPointLights.data();
+	scene.lights.clusterGrid = gClusters.GetGrid().data();
+	scene.lights.clusterLightIndices = gClusters.GetLightIndices().data();
+	scene.lights.clusterConstants = gClusters.GetConstants();
+	scene.lights.clusterConstants.pixelScale = 1.0f;	// drawn at the back buffer's size
+	scene.lights.shadowConstants = &gShadowConstants;
+	scene.lights.shadowMaps = &gCpuShadowMaps;
+	scene.texture = { BTH_IMAGE_DATA, (int)BTH_IMAGE_WIDTH, (int)BTH_IMAGE_HEIGHT };
+	return scene;
+}
+
+// Every visible entity goes through gRenderQueue, which sorts the draws and merges the
+// ones sharing shader, texture and mesh into instanced draws
+RenderQueue gRenderQueue;
+RenderQueueBenchmark gRenderQueueBenchmark = {};
+
+// World matrices of all instances of the frame, read by the geometry shader (t0)
+ID3D11Buffer* gInstanceBuffer = nullptr;
+ID3D11ShaderResourceView* gInstanceView = nullptr;
+UINT gInstanceCapacity = 0;
+
+// Shader objects of the keys drawn this frame. ShaderPermutations may only be asked from
+// the render thread, so ResolveFrameShaders() looks them up before any recording starts.
+ID3D11GeometryShader* gFrameGeometryShaders[SHADER_KEY_COUNT] = {};
+ID3D11PixelShader* gFramePixelShaders[SHADER_KEY_COUNT] = {};
+
+// Keeps drawing with the default permutation until the selected one has compiled
+void ResolveFrameShaders(const RenderQueue& queue)
+{
+	unsigned int previous = ~0u;
+	for (const RenderBatch& batch : queue.GetBatches())
+	{
+		if (batch.shader == previous)
+			continue;
+		previous = batch.shader;
+		ID3D11GeometryShader* geometryShader = GetGeometryShader(batch.shader);
+		ID3D11PixelShader* pixelShader = GetPixelShader(batch.shader);
+		gFrameGeometryShaders[batch.shader % SHADER_KEY_COUNT] = geometryShader ? geometryShader : GetGeometryShader(DEFAULT_SHADER_KEY);
+		gFramePixelShaders[batch.shader % SHADER_KEY_COUNT] = pixelShader ? pixelShader : GetPixelShader(DEFAULT_SHADER_KEY);
+	}
+}
+
+// Draws through 'context', the immediate one or a deferred one on a gJobPool worker.
+// Each deferred context needs its own 'constantBuffer' for the per batch offset.
+// 'depthOnly' leaves out the pixel shader, for the shadow pass.
+class D3D11Backend : public RenderBackend
+{
+public:
+	D3D11Backend(ID3D11DeviceContext* context, ID3D11Buffer* constantBuffer, bool depthOnly = false)
+		: mContext(context), mConstantBuffer(constantBuffer), mMatrices(gMatricesPerFrame), mDepthOnly(depthOnly)
+	{
+	}
+
+	// The shadow pass keeps the depth state it set up, and draws nothing but opaque
+	void SetPass(int pass) override
+	{
+		if (mDepthOnly)
+			return;
+		mContext->OMSetBlendState(pass == PASS_OPAQUE ? nullptr : gAlphaBlend, nullptr, 0xffffffff);
+		mContext->OMSetDepthStencilState(pass == PASS_OPAQUE ? gDepthStencilState
+			: (pass == PASS_TRANSPARENT ? gDepthReadOnlyState : gDepthDisabledState), 1);
+	}
+
+	void SetShader(unsigned int shader) override
+	{
+		mContext->GSSetShader(gFrameGeometryShaders[shader % SHADER_KEY_COUNT], nullptr, 0);
+		mContext->PSSetShader(mDepthOnly ? nullptr : gFramePixelShaders[shader % SHADER_KEY_COUNT], nullptr, 0);
+	}
+
+	// There is only the one texture so far
+	void SetTexture(unsigned int) override
+	{
+		mContext->PSSetShaderResources(0, 1, &gTextureView);
+	}
+
+	void SetMesh(unsigned int mesh) override
+	{
+		mMesh = gMeshes[mesh];
+	}
+
+	// Immediate context only, deferred contexts bind the buffer uploaded before recording
+	void SetInstances(const Float4x4* worlds, int count) override
+	{
+		if ((UINT)count > gInstanceCapacity)
+		{
+			if (gInstanceView)
+				gInstanceView->Release();
+			if (gInstanceBuffer)
+				gInstanceBuffer->Release();
+			gInstanceCapacity = (UINT)count * 2;
+			CreateStructuredBuffer(sizeof(Float4x4), gInstanceCapacity, &gInstanceBuffer, &gInstanceView);
+		}
+		UploadBuffer(gInstanceBuffer, worlds, count * sizeof(Float4x4), mContext);
+		mContext->GSSetShaderResources(0, 1, &gInstanceView);
+	}
+
+	void DrawInstanced(int firstInstance, int instanceCount) override
+	{
+		mMatrices.InstanceOffset = (UINT)firstInstance;
+		UploadBuffer(mConstantBuffer, &mMatrices, sizeof(mMatrices), mContext);
+		mContext->DrawInstanced(mMesh.vertexCount, instanceCount, mMesh.firstVertex, 0);
+	}
+
+private:
+	ID3D11DeviceContext* mContext;
+	ID3D11Buffer* mConstantBuffer;
+	PerFrameMatrices mMatrices;
+	bool mDepthOnly;
+	MeshRange mMesh = {};
+};
+
+// Parallel recording: the render queue's batches are split over deferred contexts,
+// recorded on gJobPool and executed on the immediate context in list order
+struct DeferredList
+{
+	ID3D11DeviceContext* context;
+	ID3D11Buffer* constantBuffer;
+	ID3D11CommandList* commands;
+};
+std::vector<DeferredList> gDeferredLists;
+bool gParallelRecording = false;
+double gRecordMs = 0.0;
+
+// 50 panels that draw the same every frame, to measure ImGui's CPU time with and without
+// ImGuiWindowFlags_CacheDrawList
+bool gStaticWindows = false;
+bool gCacheStaticWindows = true;
+double gImGuiMs = 0.0;	// NewFrame() to Render(), averaged
+
+void ShowStaticWindows()
+{
+	ImGuiWindowFlags flags = gCacheStaticWindows ? ImGuiWindowFlags_CacheDrawList : 0;
+	for (int i = 0; i < 50; i++)
+	{
+		char name[32];
+		sprintf_s(name, "Static %d", i);
+		ImGui::SetNextWindowPos(ImVec2(20.0f + (i % 10) * 150.0f, 300.0f + (i / 10) * 90.0f), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowSize(ImVec2(140.0f, 80.0f), ImGuiCond_FirstUseEver);
+		ImGui::Begin(name, nullptr, flags);
+		ImGui::Text("Panel %d", i);
+		ImGui::BulletText("Nothing changes here");
+		ImGui::ProgressBar(i / 49.0f);
+		ImGui::End();
+	}
+}
+
+// Idle frame skipping: with the scene paused, a frame is only drawn and presented when the UI
+// changed (io.FrameChanged), and the loop sleeps until the next message or the deadline ImGui
+// reports in io.IdleTimeout. The readouts of the frames being drawn change with every frame that
+// is drawn, so a UI change on its own only counts shortly after a message or a deadline.
+#define IDLE_MAX_WAIT 0.25f		// seconds, so that shaders recompiled by the hot reloader get swapped in
+#define IDLE_SETTLE_TIME 0.2f	// seconds UI changes are presented after a message, covers ImGui's fades
+bool gAnimateScene = true;
+bool gSkipIdleFrames = false;
+bool gRedrawRequested = false;	// WM_PAINT
+bool gMessagesPumped = false;
+float gIdleTimeout = 0.0f;
+double gUiActiveUntil = 0.0;	// ImGui::GetTime()
+float gSceneTime = 0.0f;		// only advances while the scene animates
+int gPresentedFrames = 0;
+int gSkippedFrames = 0;
+int gSkippedShown = 0;			// gSkippedFrames at the last present, the UI showing the live count would never be idle
+double gFrameMs = 0.0;			// between presented frames, averaged
+std::chrono::high_resolution_clock::time_point gLastPresent;
+
+// Sleeps while nothing can change, returns false when a message arrived before the deadline
+bool WaitForIdleTimeout()
+{
+	float seconds = gIdleTimeout < IDLE_MAX_WAIT ? gIdleTimeout : IDLE_MAX_WAIT;
+	gIdleTimeout = 0.0f;
+	return MsgWaitForMultipleObjects(0, nullptr, FALSE, (DWORD)(seconds * 1000.0f) + 1, QS_ALLINPUT) == WAIT_TIMEOUT;
+}
+std::vector<CommandRecordingTiming> gRecordingBenchmark;
+
+void createDeferredContexts()
+{
+	gDeferredLists.resize(gJobPool.GetThreadCount() + 1);
+	for (DeferredList& list : gDeferredLists)
+	{
+		list = {};
+		gDevice->CreateDeferredContext(0, &list.context);
+
+		D3D11_BUFFER_DESC cbDesc = {};
+		cbDesc.ByteWidth = sizeof(PerFrameMatrices);
+		cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+		cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		gDevice->CreateBuffer(&cbDesc, nullptr, &list.constantBuffer);
+	}
+}
+
+void CreateScene()
+{
+	gQuadEntity = gEntities.Create<Spin, Position, SceneNode, WorldTransform, BoundingSphere, Visible, Renderable, Occluder>();
+	gEntities.Get<Spin>(gQuadEntity)->speed = 1.0f / 0.8f;
+	gEntities.Get<SceneNode>(gQuadEntity)->node = gQuadNode;
+	*gEntities.Get<BoundingSphere>(gQuadEntity) = { { 0.0f, 0.0f, 0.0f }, 0.87f };	// the quad and its extruded copy
+	*gEntities.Get<Renderable>(gQuadEntity) = { 0, 0 };
+	gEntities.Get<Occluder>(gQuadEntity)->mesh = 0;
+
+	// picks its level from the screen space error, see SceneSystems
+	gSphereEntity = gEntities.Create<Position, WorldTransform, BoundingSphere, Visible, Renderable, LodGroup>();
+	gEntities.Get<Position>(gSphereEntity)->value = { 1.0f, 0.0f, 2.0f };
+	*gEntities.Get<BoundingSphere>(gSphereEntity) = { { 0.0f, 0.0f, 0.0f }, 0.9f };	// with the extruded copy
+	*gEntities.Get<Renderable>(gSphereEntity) = { gSphereMesh, 0 };
+	*gEntities.Get<LodGroup>(gSphereEntity) = { 0, gSphereMesh, 0 };
+	gSceneSystems.SetLodChains(&gLodChains, MakeLodProjection(0.45f * DirectX::XM_PI, (float)gBackbufferHeight));	// same as transform()
+
+	// a wall of spheres behind the quad for it to hide
+	for (int y = 0; y < 12; y++)
+	{
+		for (int x = 0; x < 12; x++)
+		{
+			Entity sphere = gEntities.Create<Position, WorldTransform, BoundingSphere, Visible, Renderable, LodGroup>();
+			gEntities.Get<Position>(sphere)->value = { (x - 5.5f) * 0.8f, (y - 5.5f) * 0.8f, 10.0f };
+			*gEntities.Get<BoundingSphere>(sphere) = { { 0.0f, 0.0f, 0.0f }, 0.9f };
+			*gEntities.Get<Renderable>(sphere) = { gSphereMesh, 0 };
+			*gEntities.Get<LodGroup>(sphere) = { 0, gSphereMesh, 0 };
+		}
+	}
+	gSceneSystems.SetOcclusion(&gOcclusionCuller, &gOccluderMeshes);
+}
+
+void transform()
 {
 	XMVECTOR CamPos = XMVectorSet(0.0, 0.0, -2.0, 0.0);
 	XMVECTOR LookAt = XMVectorSet(0.0, 0.0, 0.0, 0.0);
 	XMVECTOR Up = XMVectorSet(0.0, 1.0, 0.0, 0.0);
 	
-	XMMATRIX World = DirectX::XMMatrixRotationY(gRotation);
 	XMMATRIX View = XMMatrixLookAtLH(CamPos, LookAt, Up);
-	XMMATRIX Projection = XMMatrixPerspectiveFovLH(0.45f * DirectX::XM_PI, WIDTH/HEIGHT, 0.1, 20.0f);
-	
-	View = XMMatrixTranspose(View);
-	Projection = XMMatrixTranspose(Projection);
-
-	XMMATRIX WorldView = XMMatrixMultiply(View, World);
-	XMMATRIX WorldViewProj = XMMatrixMultiply(Projection, WorldView);
+	XMMATRIX Projection = XMMatrixPerspectiveFovLH(0.45f * DirectX::XM_PI, GetAspectRatio(), 0.1, 20.0f);
+	gView = View;
+	gViewProj = XMMatrixMultiply(View, Projection);
+}
 
-	gMatricesPerFrame.WorldViewProj = WorldViewProj;
-	gMatricesPerFrame.World = World;
+// Runs the scene systems: spin, transforms, culling and the draw list for Render()
+void UpdateScene(float deltaTime)
+{
+	transform();
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, gViewProj);
+	gSceneSystems.Update(gEntities, gScene, deltaTime, *(const Float4x4*)&viewProj, &gJobPool);
 }
 
-void createDepthStencil()
+void createDepthStencil(UINT sampleCount)
 {
 	//DepthStencil
 	ID3D11Texture2D* pDepthStencil = NULL;
 	D3D11_TEXTURE2D_DESC descDepth;
-	descDepth.Width = WIDTH;
-	descDepth.Height = HEIGHT;
+	descDepth.Width = gBackbufferWidth;
+	descDepth.Height = gBackbufferHeight;
 	descDepth.MipLevels = 1;
 	descDepth.ArraySize = 1;
 	descDepth.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-	descDepth.SampleDesc.Count = 1;
+	descDepth.SampleDesc.Count = sampleCount;
 	descDepth.SampleDesc.Quality = 0;
 	descDepth.Usage = D3D11_USAGE_DEFAULT;
 	descDepth.BindFlags = D3D11_BIND_DEPTH_STENCIL;
@@ -353,7 +1108,22 @@ void createDepthStencil()
 	descDepth.MiscFlags = 0;
 	HRESULT hr = gDevice->CreateTexture2D(&descDepth, NULL, &pDepthStencil);
 
-	D3D11_DEPTH_STENCIL_DESC dsDesc;
+	D3D11_DEPTH_STENCIL_VIEW_DESC descDSV;
+	descDSV.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	descDSV.ViewDimension = sampleCount > 1 ? D3D11_DSV_DIMENSION_TEXTURE2DMS : D3D11_DSV_DIMENSION_TEXTURE2D;
+	descDSV.Flags = 0;
+	descDSV.Texture2D.MipSlice = 0;
+
+	// Create the depth stencil view
+	hr = gDevice->CreateDepthStencilView(pDepthStencil, // Depth stencil texture
+		&descDSV, // Depth stencil desc
+		&gDSV);  // [out] Depth stencil view
+	pDepthStencil->Release();
+}
+
+void createDepthStencilState()
+{
+	D3D11_DEPTH_STENCIL_DESC dsDesc = {};
 
 	// Depth test parameters
 	dsDesc.DepthEnable = true;
@@ -361,21 +1131,365 @@ void createDepthStencil()
 	dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
 
 	// Create depth stencil state
-	ID3D11DepthStencilState * pDSState;
-	gDevice->CreateDepthStencilState(&dsDesc, &pDSState);
+	gDevice->CreateDepthStencilState(&dsDesc, &gDepthStencilState);
+
+	// the states of the other render passes, see D3D11Backend::SetPass()
+	dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	gDevice->CreateDepthStencilState(&dsDesc, &gDepthReadOnlyState);
+	dsDesc.DepthEnable = false;
+	gDevice->CreateDepthStencilState(&dsDesc, &gDepthDisabledState);
+
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.RenderTarget[0].BlendEnable = TRUE;
+	blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	gDevice->CreateBlendState(&blendDesc, &gAlphaBlend);
 
 	// Bind depth stencil state
-	gDeviceContext->OMSetDepthStencilState(pDSState, 1);
+	gDeviceContext->OMSetDepthStencilState(gDepthStencilState, 1);
+}
 
-	D3D11_DEPTH_STENCIL_VIEW_DESC descDSV;
-	descDSV.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-	descDSV.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	descDSV.Texture2D.MipSlice = 0;
+void ReleaseSceneTargets()
+{
+	if (gMsaaRTV)
+	{
+		gMsaaRTV->Release();
+		gMsaaRTV = nullptr;
+		gMsaaTexture->Release();
+		gMsaaTexture = nullptr;
+	}
+	if (gScaledRTV)
+	{
+		gScaledRTV->Release();
+		gScaledRTV = nullptr;
+		gScaledView->Release();
+		gScaledView = nullptr;
+		gScaledTexture->Release();
+		gScaledTexture = nullptr;
+	}
+	if (gDSV)
+	{
+		gDSV->Release();
+		gDSV = nullptr;
+	}
+	gSceneRTV = nullptr;
+}
 
-	// Create the depth stencil view
-	hr = gDevice->CreateDepthStencilView(pDepthStencil, // Depth stencil texture
-		&descDSV, // Depth stencil desc
-		&gDSV);  // [out] Depth stencil view
+// Recreates the scene's colour and depth targets at the back buffer's size with
+// 'sampleCount' samples, or the most below it the device supports for both formats.
+// Dynamic resolution adds a single sample texture to upscale from.
+void SetMsaaSamples(UINT sampleCount)
+{
+	UINT colourLevels = 0, depthLevels = 0;
+	while (sampleCount > 1 &&
+		(FAILED(gDevice->CheckMultisampleQualityLevels(DXGI_FORMAT_R8G8B8A8_UNORM, sampleCount, &colourLevels)) || colourLevels == 0 ||
+		FAILED(gDevice->CheckMultisampleQualityLevels(DXGI_FORMAT_D24_UNORM_S8_UINT, sampleCount, &depthLevels)) || depthLevels == 0))
+		sampleCount /= 2;
+
+	ReleaseSceneTargets();
+	if (gDynamicResolution)
+	{
+		D3D11_TEXTURE2D_DESC textureDesc = {};
+		textureDesc.Width = gBackbufferWidth;
+		textureDesc.Height = gBackbufferHeight;
+		textureDesc.MipLevels = 1;
+		textureDesc.ArraySize = 1;
+		textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.Usage = D3D11_USAGE_DEFAULT;
+		textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		gDevice->CreateTexture2D(&textureDesc, nullptr, &gScaledTexture);
+		gDevice->CreateRenderTargetView(gScaledTexture, nullptr, &gScaledRTV);
+		gDevice->CreateShaderResourceView(gScaledTexture, nullptr, &gScaledView);
+	}
+	if (sampleCount > 1)
+	{
+		D3D11_TEXTURE2D_DESC textureDesc = {};
+		textureDesc.Width = gBackbufferWidth;
+		textureDesc.Height = gBackbufferHeight;
+		textureDesc.MipLevels = 1;
+		textureDesc.ArraySize = 1;
+		textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;	// same as the back buffer, to resolve into it
+		textureDesc.SampleDesc.Count = sampleCount;
+		textureDesc.Usage = D3D11_USAGE_DEFAULT;
+		textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+		gDevice->CreateTexture2D(&textureDesc, nullptr, &gMsaaTexture);
+		gDevice->CreateRenderTargetView(gMsaaTexture, nullptr, &gMsaaRTV);
+	}
+	createDepthStencil(sampleCount);
+
+	gMsaaSamples = sampleCount;
+	if (sampleCount > 1)
+		gSceneRTV = gMsaaRTV;
+	else
+		gSceneRTV = gDynamicResolution ? gScaledRTV : gBackbufferRTV;
+}
+
+// The scene's size this frame: the back buffer's, or the scaler's share of it
+void UpdateRenderSize()
+{
+	gRenderWidth = gBackbufferWidth;
+	gRenderHeight = gBackbufferHeight;
+	if (gDynamicResolution)
+	{
+		int width, height;
+		gResolutionScaler.GetRenderSize((int)gBackbufferWidth, (int)gBackbufferHeight, width, height);
+		gRenderWidth = (UINT)width;
+		gRenderHeight = (UINT)height;
+	}
+	gClusters.SetRenderScale((float)gRenderWidth / gBackbufferWidth);
+}
+
+// Creates the UI layer at the back buffer's size, or releases it
+void SetUiLayer(bool enable)
+{
+	if (gUiTexture)
+	{
+		gUiRTV->Release();
+		gUiRTV = nullptr;
+		gUiView->Release();
+		gUiView = nullptr;
+		gUiTexture->Release();
+		gUiTexture = nullptr;
+	}
+	gUiLayer = enable;
+	gUiLayerValid = false;
+	if (!enable)
+		return;
+
+	if (!gPremultipliedBlend)
+	{
+		// ImGui_ImplDX11 leaves premultiplied colour and coverage in the layer
+		D3D11_BLEND_DESC blendDesc = {};
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		gDevice->CreateBlendState(&blendDesc, &gPremultipliedBlend);
+	}
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = gBackbufferWidth;
+	textureDesc.Height = gBackbufferHeight;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	gDevice->CreateTexture2D(&textureDesc, nullptr, &gUiTexture);
+	gDevice->CreateRenderTargetView(gUiTexture, nullptr, &gUiRTV);
+	gDevice->CreateShaderResourceView(gUiTexture, nullptr, &gUiView);
+}
+
+// Everything sized after the window: the swap chain, the scene targets, and what
+// depends on the aspect ratio or the size in pixels
+void ResizeBackbuffer(UINT width, UINT height)
+{
+	// the swap chain's buffers can only be resized once nothing refers to them
+	gDeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+	ReleaseSceneTargets();
+	gBackbufferRTV->Release();
+	gSwapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0);
+	ID3D11Texture2D* backBuffer = nullptr;
+	gSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&backBuffer);
+	gDevice->CreateRenderTargetView(backBuffer, NULL, &gBackbufferRTV);
+	backBuffer->Release();
+
+	gBackbufferWidth = width;
+	gBackbufferHeight = height;
+	SetMsaaSamples(gMsaaSamples);
+	SetUiLayer(gUiLayer);
+	transform();
+	configureClusters();
+	gSceneSystems.SetLodChains(&gLodChains, MakeLodProjection(0.45f * DirectX::XM_PI, (float)height));
+	// a different number of pixels, the old frame times don't apply
+	gResolutionScaler.Reset(gResolutionScaler.GetScale());
+}
+
+// Mirrors UPSCALE_CONSTANT_BUFFER in Upscale.hlsl
+struct UpscaleConstants
+{
+	float uvScale[2];
+	float uvMax[2];
+};
+
+// Draws 'view' over the back buffer, which has to be bound, with the upscale shaders
+void DrawOverBackbuffer(ID3D11ShaderResourceView* view, const UpscaleConstants& constants)
+{
+	UploadBuffer(gUpscaleConstantBuffer, &constants, sizeof(constants));
+
+	D3D11_VIEWPORT viewport = { 0.0f, 0.0f, (float)gBackbufferWidth, (float)gBackbufferHeight, 0.0f, 1.0f };
+	gDeviceContext->RSSetViewports(1, &viewport);
+	gDeviceContext->IASetInputLayout(nullptr);
+	gDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	gDeviceContext->VSSetShader(gUpscaleVS, nullptr, 0);
+	gDeviceContext->GSSetShader(nullptr, nullptr, 0);
+	gDeviceContext->PSSetShader(gUpscalePS, nullptr, 0);
+	gDeviceContext->PSSetShaderResources(0, 1, &view);
+	gDeviceContext->PSSetSamplers(0, 1, &gSamplerState);
+	gDeviceContext->PSSetConstantBuffers(0, 1, &gUpscaleConstantBuffer);
+	gDeviceContext->Draw(3, 0);
+
+	// the texture is drawn into again next frame
+	ID3D11ShaderResourceView* noView = nullptr;
+	gDeviceContext->PSSetShaderResources(0, 1, &noView);
+}
+
+// Stretches the top-left gRenderWidth x gRenderHeight of gScaledTexture over the back
+// buffer, which has to be bound
+void UpscaleScene()
+{
+	UpscaleConstants constants;
+	constants.uvScale[0] = (float)gRenderWidth / gBackbufferWidth;
+	constants.uvScale[1] = (float)gRenderHeight / gBackbufferHeight;
+	constants.uvMax[0] = (gRenderWidth - 0.5f) / gBackbufferWidth;
+	constants.uvMax[1] = (gRenderHeight - 0.5f) / gBackbufferHeight;
+	DrawOverBackbuffer(gScaledView, constants);
+}
+
+// Blends the UI layer over the back buffer, which has to be bound
+void CompositeUi()
+{
+	UpscaleConstants constants = { { 1.0f, 1.0f }, { 1.0f, 1.0f } };
+	gDeviceContext->OMSetBlendState(gPremultipliedBlend, nullptr, 0xffffffff);
+	DrawOverBackbuffer(gUiView, constants);
+	gDeviceContext->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+}
+
+// ImGui over the back buffer, which has to be bound. With the UI layer only the damaged
+// rectangles are cleared and drawn, unless the layer lost its contents or ClearView() is
+// missing.
+void DrawUi(ImDrawData* drawData)
+{
+	if (!gUiLayer)
+	{
+		ImGui_ImplDX11_RenderDrawData(drawData);
+		return;
+	}
+
+	const float transparent[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	D3D11_RECT rects[16];
+	bool full = !gUiLayerValid || !gDeviceContext1 || !drawData->DamageRects || drawData->DamageRectsCount > (int)ARRAYSIZE(rects);
+	float drawnPixels = drawData->DisplaySize.x * drawData->DisplaySize.y;
+	gDeviceContext->OMSetRenderTargets(1, &gUiRTV, nullptr);
+	if (full)
+	{
+		gDeviceContext->ClearRenderTargetView(gUiRTV, transparent);
+		drawData->DamageRects = nullptr;
+		drawData->DamageRectsCount = 0;
+	}
+	else
+	{
+		drawnPixels = 0.0f;
+		for (int i = 0; i < drawData->DamageRectsCount; i++)
+		{
+			const ImVec4& damage = drawData->DamageRects[i];
+			rects[i] = { (LONG)damage.x, (LONG)damage.y, (LONG)damage.z, (LONG)damage.w };
+			drawnPixels += (damage.z - damage.x) * (damage.w - damage.y);
+		}
+		if (drawData->DamageRectsCount > 0)
+			gDeviceContext1->ClearView(gUiRTV, transparent, rects, drawData->DamageRectsCount);
+	}
+	if (full || drawData->DamageRectsCount > 0)
+		ImGui_ImplDX11_RenderDrawData(drawData);
+	gUiLayerValid = true;
+	gUiDrawnPercent += (100.0f * drawnPixels / (gBackbufferWidth * gBackbufferHeight) - gUiDrawnPercent) * 0.05f;
+
+	gDeviceContext->OMSetRenderTargets(1, &gBackbufferRTV, nullptr);
+	CompositeUi();
+}
+
+// With MSAA the samples of each pixel are averaged, into the back buffer or, with
+// dynamic resolution, into the texture that is then upscaled. Either way ImGui then
+// draws straight into the back buffer, without depth.
+void ResolveScene()
+{
+	if (gMsaaSamples > 1)
+	{
+		// only the drawn part matters, but D3D11 resolves whole subresources
+		ID3D11Resource* backBuffer = nullptr;
+		gBackbufferRTV->GetResource(&backBuffer);
+		gDeviceContext->ResolveSubresource(gDynamicResolution ? gScaledTexture : backBuffer, 0, gMsaaTexture, 0, DXGI_FORMAT_R8G8B8A8_UNORM);
+		backBuffer->Release();
+	}
+	gDeviceContext->OMSetRenderTargets(1, &gBackbufferRTV, nullptr);
+	if (gDynamicResolution)
+		UpscaleScene();
+}
+
+// GPU time of whole frames for gResolutionScaler. A timer is read back when its slot
+// comes round again, GPU_TIMER_FRAMES frames later, so the CPU never waits on it.
+const int GPU_TIMER_FRAMES = 4;
+
+struct GpuFrameTimer
+{
+	ID3D11Query* disjoint;
+	ID3D11Query* begin;
+	ID3D11Query* end;
+	float scale;		// the frame was drawn at
+	bool pending;
+};
+GpuFrameTimer gGpuTimers[GPU_TIMER_FRAMES] = {};
+int gGpuTimerFrame = 0;
+float gGpuFrameMs = 0.0f;
+
+void createGpuTimers()
+{
+	D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+	D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+	for (GpuFrameTimer& timer : gGpuTimers)
+	{
+		gDevice->CreateQuery(&disjointDesc, &timer.disjoint);
+		gDevice->CreateQuery(&timestampDesc, &timer.begin);
+		gDevice->CreateQuery(&timestampDesc, &timer.end);
+	}
+
+	D3D11_BUFFER_DESC cbDesc = {};
+	cbDesc.ByteWidth = sizeof(UpscaleConstants);
+	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	gDevice->CreateBuffer(&cbDesc, nullptr, &gUpscaleConstantBuffer);
+}
+
+// Reads the timer of GPU_TIMER_FRAMES frames ago, if the GPU is done with it, into the
+// scaler, and starts timing this frame in its slot
+void BeginGpuTimer()
+{
+	GpuFrameTimer& timer = gGpuTimers[gGpuTimerFrame % GPU_TIMER_FRAMES];
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	UINT64 begin, end;
+	if (timer.pending &&
+		gDeviceContext->GetData(timer.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK && !disjoint.Disjoint &&
+		gDeviceContext->GetData(timer.begin, &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+		gDeviceContext->GetData(timer.end, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+	{
+		gGpuFrameMs = (float)((end - begin) * 1000.0 / disjoint.Frequency);
+		if (gDynamicResolution)
+			gResolutionScaler.Update(gGpuFrameMs, timer.scale);
+	}
+
+	gDeviceContext->Begin(timer.disjoint);
+	gDeviceContext->End(timer.begin);
+	timer.scale = (float)gRenderWidth / gBackbufferWidth;
+	timer.pending = true;
+}
+
+void EndGpuTimer()
+{
+	GpuFrameTimer& timer = gGpuTimers[gGpuTimerFrame % GPU_TIMER_FRAMES];
+	gDeviceContext->End(timer.end);
+	gDeviceContext->End(timer.disjoint);
+	gGpuTimerFrame++;
 }
 
 void textureSetUp()
@@ -427,54 +1541,160 @@ void textureSetUp()
 	hr = gDevice->CreateSamplerState(&sampDesc, &gSamplerState);
 }
 
-void SetViewport()
+void SetViewport(ID3D11DeviceContext* context)
 {
 	D3D11_VIEWPORT vp;
-	vp.Width = (float)WIDTH;
-	vp.Height = (float)HEIGHT;
+	vp.Width = (float)gRenderWidth;
+	vp.Height = (float)gRenderHeight;
 	vp.MinDepth = 0.0f;
 	vp.MaxDepth = 1.0f;
 	vp.TopLeftX = 0;
 	vp.TopLeftY = 0;
-	gDeviceContext->RSSetViewports(1, &vp);
+	context->RSSetViewports(1, &vp);
 }
 
-void Render()
+// Everything the draws need except pass states, shaders, textures and meshes, which D3D11Backend
+// sets. Deferred contexts start from default state so they call this too.
+void SetPipelineState(ID3D11DeviceContext* context, ID3D11Buffer* constantBuffer)
 {
-	// clear the back buffer to a deep blue
-	//float clearColor[] = { 0, 0, 0, 1 };
-	gClearColour[3] = 1.0;
+	SetViewport(context);
+	context->OMSetRenderTargets(1, &gSceneRTV, gDSV);
+	context->OMSetDepthStencilState(gDepthStencilState, 1);
 
-	// use DeviceContext to talk to the API
-	gDeviceContext->ClearRenderTargetView(gBackbufferRTV, gClearColour);
-	gDeviceContext->ClearDepthStencilView(gDSV, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 	// specifying NULL or nullptr we are disabling that stage
 	// in the pipeline
-	gDeviceContext->VSSetShader(gVertexShader, nullptr, 0);
-	gDeviceContext->HSSetShader(nullptr, nullptr, 0);
-	gDeviceContext->DSSetShader(nullptr, nullptr, 0);
-	gDeviceContext->GSSetShader(gGeometryShader, nullptr, 0);
-	gDeviceContext->PSSetShader(gPixelShader, nullptr, 0);
-	gDeviceContext->PSSetShaderResources(0, 1, &gTextureView);
+	context->VSSetShader(gVertexShader, nullptr, 0);
+	context->HSSetShader(nullptr, nullptr, 0);
+	context->DSSetShader(nullptr, nullptr, 0);
 
 	UINT32 vertexSize = sizeof(TriangleVertex);
 	UINT32 offset = 0;
 	// specify which vertex buffer to use next.
-	gDeviceContext->IASetVertexBuffers(0, 1, &gVertexBuffer, &vertexSize, &offset);
+	context->IASetVertexBuffers(0, 1, &gVertexBuffer, &vertexSize, &offset);
 
 	// specify the topology to use when drawing
-	gDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	// specify the IA Layout (how is data passed)
-	gDeviceContext->IASetInputLayout(gVertexLayout);
+	context->IASetInputLayout(gVertexLayout);
 
 	//ConstantBuffer
-	gDeviceContext->GSSetConstantBuffers(0, 1, &gConstantBuffer);
-	gDeviceContext->PSSetConstantBuffers(0, 1, &gConstantBufferLight);
+	context->GSSetConstantBuffers(0, 1, &constantBuffer);
+	context->GSSetShaderResources(0, 1, &gInstanceView);
+	context->PSSetConstantBuffers(0, 1, &gConstantBufferLight);
+	if (KeyClustered(gShaderKey))
+	{
+		ID3D11ShaderResourceView* clusterViews[3] = { gPointLightView, gClusterGridView, gClusterIndexView };
+		context->PSSetShaderResources(1, 3, clusterViews);
+		context->PSSetConstantBuffers(1, 1, &gClusterConstantBuffer);
+	}
+	if (KeyShadowed(gShaderKey))
+	{
+		context->PSSetShaderResources(4, 1, &gShadowView);
+		context->PSSetSamplers(1, 1, &gShadowSampler);
+		context->PSSetConstantBuffers(2, 1, &gShadowConstantBuffer);
+	}
 
-	gDeviceContext->PSSetSamplers(0, 1, &gSamplerState);
+	context->PSSetSamplers(0, 1, &gSamplerState);
+}
 
-	// issue a draw call of 3 vertices (similar to OpenGL)
-	gDeviceContext->Draw(6, 0);
+// Every shadow caster, drawn into each cascade with the scene's geometry shader and no
+// pixel shader. Runs before the scene pass, which samples the maps.
+RenderQueue gShadowQueue;
+
+void RenderShadowMaps()
+{
+	UpdateShadowCascades();
+
+	// depth doesn't need the texture, so casters only differ by mesh
+	gShadowQueue.Clear();
+	for (const DrawItem& item : gSceneSystems.GetShadowCasters())
+		gShadowQueue.Add(PASS_OPAQUE, gShaderKey, 0, item.mesh, 0.0f, item.world);
+	gShadowQueue.Sort(&gJobPool);
+	ResolveFrameShaders(gShadowQueue);
+
+	SetPipelineState(gDeviceContext, gConstantBuffer);
+	// last frame's maps are still bound for sampling, they can't be drawn into meanwhile
+	ID3D11ShaderResourceView* noView = nullptr;
+	gDeviceContext->PSSetShaderResources(4, 1, &noView);
+	D3D11_VIEWPORT viewport = { 0.0f, 0.0f, (float)gShadowSettings.mapSize, (float)gShadowSettings.mapSize, 0.0f, 1.0f };
+	gDeviceContext->RSSetViewports(1, &viewport);
+
+	for (UINT cascade = 0; cascade < gShadowConstants.cascadeCount; cascade++)
+	{
+		gDeviceContext->ClearDepthStencilView(gShadowDSVs[cascade], D3D11_CLEAR_DEPTH, 1.0f, 0);
+		gDeviceContext->OMSetRenderTargets(0, nullptr, gShadowDSVs[cascade]);
+		gMatricesPerFrame.ViewProj = XMMatrixTranspose(XMLoadFloat4x4((const XMFLOAT4X4*)&gShadowConstants.cascades[cascade].viewProj));
+		D3D11Backend backend(gDeviceContext, gConstantBuffer, true);
+		// the first cascade uploads the instances, the others reuse them
+		if (cascade == 0)
+			gShadowQueue.Submit(backend);
+		else
+			gShadowQueue.SubmitBatches(backend, 0, (int)gShadowQueue.GetBatches().size());
+	}
+
+	// back to the scene's targets
+	gDeviceContext->OMSetRenderTargets(1, &gSceneRTV, gDSV);
+	SetViewport(gDeviceContext);
+}
+
+void Render()
+{
+	// clear the back buffer to a deep blue
+	//float clearColor[] = { 0, 0, 0, 1 };
+	gClearColour[3] = 1.0;
+
+	// use DeviceContext to talk to the API
+	gDeviceContext->ClearRenderTargetView(gSceneRTV, gClearColour);
+	gDeviceContext->ClearDepthStencilView(gDSV, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+
+	if (KeyShadowed(gShaderKey))
+		RenderShadowMaps();
+
+	// HLSL reads the matrix column-major, the instance matrices are declared row_major
+	gMatricesPerFrame.ViewProj = XMMatrixTranspose(gViewProj);
+
+	// sorted by state and front to back (view space z of the entity's origin)
+	gRenderQueue.Clear();
+	for (const DrawItem& item : gSceneSystems.GetDrawList())
+	{
+		XMVECTOR origin = XMVector3TransformCoord(XMVectorSet(item.world.m[3][0], item.world.m[3][1], item.world.m[3][2], 1.0f), gView);
+		gRenderQueue.Add(PASS_OPAQUE, gShaderKey, item.texture, item.mesh, XMVectorGetZ(origin), item.world);
+	}
+	gRenderQueue.Sort(&gJobPool);
+	ResolveFrameShaders(gRenderQueue);
+
+	D3D11Backend backend(gDeviceContext, gConstantBuffer);
+	if (!gParallelRecording)
+	{
+		SetPipelineState(gDeviceContext, gConstantBuffer);
+		gRenderQueue.Submit(backend);
+		return;
+	}
+
+	// the instances are uploaded before recording, the lists only bind the buffer
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	const std::vector<Float4x4>& instances = gRenderQueue.GetInstances();
+	if (!instances.empty())
+		backend.SetInstances(instances.data(), (int)instances.size());
+	RecordCommandLists(gRenderQueue, (int)gDeferredLists.size(), &gJobPool, [](int list, int firstBatch, int endBatch)
+	{
+		DeferredList& deferred = gDeferredLists[list];
+		SetPipelineState(deferred.context, deferred.constantBuffer);
+		D3D11Backend listBackend(deferred.context, deferred.constantBuffer);
+		gRenderQueue.SubmitBatches(listBackend, firstBatch, endBatch);
+		deferred.context->FinishCommandList(FALSE, &deferred.commands);
+	});
+	gRecordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// in list order, so the frame comes out the same whichever worker recorded what
+	for (DeferredList& deferred : gDeferredLists)
+	{
+		if (!deferred.commands)
+			continue;
+		gDeviceContext->ExecuteCommandList(deferred.commands, TRUE);
+		deferred.commands->Release();
+		deferred.commands = nullptr;
+	}
 }
 
 int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow )
@@ -486,15 +1706,28 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 	{
 		CreateDirect3DContext(wndHandle); //2. Skapa och koppla SwapChain, Device och Device Context
 
-		SetViewport(); //3. Stt viewport
+		SetViewport(gDeviceContext); //3. Stt viewport
 
 		CreateShaders(); //4. Skapa vertex- och pixel-shaders
 
+		// a shader saved from now on is recompiled (only the permutations in use, unchanged ones hit the cache)
+		gHotReloader.Watch("GeometryShader.hlsl", [](const std::string&) { gGSPermutations.Reload(); });
+		gHotReloader.Watch("Fragment.hlsl", [](const std::string&) { gPSPermutations.Reload(); });
+		gHotReloader.Watch("Vertex.hlsl", [](const std::string&) { ReloadSceneVertexShader(); });
+		gHotReloader.Watch("Upscale.hlsl", [](const std::string&) { ReloadUpscaleShaders(); });
+		gHotReloader.Start(".");
+
 		CreateTriangleData(); //5. Definiera triangelvertiser, 6. Skapa vertex buffer, 7. Skapa input layout
 		
 		textureSetUp();
-		transform(gRotation);
+		CreateScene();
+		transform();
 		createConstantBuffer();
+		createClusterBuffers();
+		createShadowMaps();
+		createGpuTimers();
+		createDeferredContexts();
+		gRenderQueue.SetDepthRange(0.1f, 20.0f);	// same as transform()
 
 		ShowWindow(wndHandle, nCmdShow);
 
@@ -505,45 +1738,234 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 		ImGui_ImplDX11_Init(gDevice, gDeviceContext);
 		ImGui::StyleColorsDark();
 
+		gLastPresent = std::chrono::high_resolution_clock::now();
 		while (WM_QUIT != msg.message)
 		{
 			if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
 			{
 				TranslateMessage(&msg);
 				DispatchMessage(&msg);
+				gMessagesPumped = true;
 			}
 			else
 			{
-				Render(); //8. Rendera
-				gDeviceContext->GSSetShader(nullptr, nullptr, 0);
-
+				bool deadline = false;
+				if (gSkipIdleFrames && gIdleTimeout > 0.0f)
+				{
+					deadline = WaitForIdleTimeout();
+					if (!deadline)
+						continue;
+				}
+				bool sceneChanged = gAnimateScene || gRedrawRequested;
+				gRedrawRequested = false;
+				if (gPendingWidth && (gPendingWidth != gBackbufferWidth || gPendingHeight != gBackbufferHeight))
+				{
+					ResizeBackbuffer(gPendingWidth, gPendingHeight);
+					sceneChanged = true;
+				}
+				if (ApplyHotReloads())
+					sceneChanged = true;
+
+				// The UI comes first, what it edits is drawn in the same frame
+				std::chrono::high_resolution_clock::time_point imguiStart = std::chrono::high_resolution_clock::now();
+				io.ConfigIdleDetection = gSkipIdleFrames;
+				io.ConfigDamageTracking = gUiLayer;
 				ImGui_ImplDX11_NewFrame();
 				ImGui_ImplWin32_NewFrame();
 				ImGui::NewFrame();
+				if (gMessagesPumped || deadline)
+					gUiActiveUntil = ImGui::GetTime() + (gMessagesPumped ? IDLE_SETTLE_TIME : 0.0f);
+				gMessagesPumped = false;
 
 				ImGui::Begin("Hello, world!");                          // Create a window called "Hello, world!" and append into it.
 				ImGui::Text("This is some useful text.");               // Display some text (you can use a format strings too)
 				ImGui::SliderFloat("float", &gFloat, 0.0f, 2*3.1415);            // Edit 1 float using a slider from 0.0f to 1.0f    
-				ImGui::SliderFloat("dist", &gRotation, 0.0f, 10.0f);
+				ImGui::SliderFloat("dist", &gEntities.Get<Spin>(gQuadEntity)->angle, 0.0f, 10.0f);
 				ImGui::ColorEdit3("clear color", (float*)&gClearColour); // Edit 3 floats representing a color
-				ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+				ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", gFrameMs, gFrameMs > 0.0 ? 1000.0 / gFrameMs : 0.0);
+				ImGui::Checkbox("animate scene", &gAnimateScene);
+				ImGui::SameLine();
+				ImGui::Checkbox("skip idle frames", &gSkipIdleFrames);
+				ImGui::SameLine();
+				ImGui::Text("%d presented, %d skipped", gPresentedFrames, gSkippedShown);
+				if (ImGui::Checkbox("redraw changed UI only", &gUiLayer))
+					SetUiLayer(gUiLayer);
+				if (gUiLayer)
+				{
+					ImGui::SameLine();
+					ImGui::Text("%.1f%% of the screen drawn by ImGui%s", gUiDrawnPercent, gDeviceContext1 ? "" : " (no ClearView, always all of it)");
+				}
+				ImGui::Checkbox("extrude", &gExtrude);
+				ImGui::SameLine();
+				ImGui::Checkbox("textured", &gTextured);
+				ImGui::Combo("lighting", &gLightingModel, "Unlit\0Lambert\0Half-Lambert\0");
+				ImGui::Checkbox("clustered", &gClustered);
+				ImGui::SameLine();
+				if (gClustered)
+					ImGui::SliderInt("lights", &gPointLightCount, 0, MAX_POINT_LIGHTS);
+				else
+					ImGui::SliderInt("lights", &gLightCount, 0, SHADER_MAX_LIGHTS);
+				ImGui::Checkbox("shadows", &gShadows);
+				if (gShadows)
+				{
+					ImGui::SameLine();
+					ImGui::SliderInt("cascades", &gShadowSettings.cascadeCount, 1, SHADOW_MAX_CASCADES);
+					if (ImGui::SliderFloat3("light 0", (float*)&gLight.lightPos[0], -4.0f, 4.0f))
+						UploadBuffer(gConstantBufferLight, &gLight, sizeof(gLight));
+					const std::vector<DrawItem>& casters = gSceneSystems.GetShadowCasters();
+					if (ImGui::Button("Draw shadow maps on the CPU"))
+						gCpuShadowMaps.Render(gShadowConstants, gShadowSettings.mapSize, casters.data(), (int)casters.size(), gCpuMeshes, gShaderKey, &gJobPool);
+					ImGui::SameLine();
+					ImGui::Text("%d casters, %d triangles: %.2f ms", (int)casters.size(), gCpuShadowMaps.GetTriangleCount(), gCpuShadowMaps.GetRenderMs());
+				}
+				gShaderKey = MakeShaderKey(gExtrude, gTextured, gLightingModel, gLightCount, gClustered, gShadows);
+				if (ImGui::Combo("MSAA", &gMsaaMode, "Off\0" "2x\0" "4x\0" "8x\0"))
+					SetMsaaSamples(1u << gMsaaMode);
+				if (gMsaaSamples != 1u << gMsaaMode)
+				{
+					ImGui::SameLine();
+					ImGui::Text("not supported, %ux", gMsaaSamples);
+				}
+				if (ImGui::Checkbox("dynamic resolution", &gDynamicResolution))
+				{
+					gResolutionScaler.Reset();
+					SetMsaaSamples(gMsaaSamples);
+				}
+				if (gDynamicResolution)
+				{
+					DynamicResolutionSettings settings = gResolutionScaler.GetSettings();
+					if (ImGui::SliderFloat("GPU budget (ms)", &settings.budgetMs, 1.0f, 50.0f))
+						gResolutionScaler.SetSettings(settings);
+					ImGui::Text("scale %.3f, %ux%u of %ux%u, GPU %.2f ms (average %.2f), %d changes", gResolutionScaler.GetScale(),
+						gRenderWidth, gRenderHeight, gBackbufferWidth, gBackbufferHeight, gGpuFrameMs, gResolutionScaler.GetAverageMs(),
+						gResolutionScaler.GetChangeCount());
+				}
+				if (ImGui::Button("Benchmark CPU MSAA"))
+				{
+					if (KeyShadowed(gShaderKey))
+					{
+						const std::vector<DrawItem>& casters = gSceneSystems.GetShadowCasters();
+						gCpuShadowMaps.Render(gShadowConstants, gShadowSettings.mapSize, casters.data(), (int)casters.size(), gCpuMeshes, gShaderKey, &gJobPool);
+					}
+					Float3 clearColour = { gClearColour[0], gClearColour[1], gClearColour[2] };
+					gMsaaBenchmark = BenchmarkMsaa(GetCpuScene(), (int)gBackbufferWidth, (int)gBackbufferHeight, clearColour, &gJobPool);
+				}
+				for (const MsaaTiming& timing : gMsaaBenchmark)
+				{
+					ImGui::Text("%dx: %.1f ms, %.1f ns/sample (%.1f per extra sample), %lld shaded, edge error %.3f", timing.samples, timing.drawMs,
+						timing.nsPerSample, timing.nsPerExtraSample, timing.shadedPixels, timing.edgeError);
+				}
+				if (gClustered)
+				{
+					const ClusterStats& clusterStats = gClusters.GetStats();
+					ImGui::Text("Clusters: %d/%d in use, %d light refs, max %d per cluster, %.2f ms",
+						clusterStats.occupiedClusters, gClusters.GetClusterCount(), clusterStats.lightReferences, clusterStats.maxLightsPerCluster, clusterStats.assignMs);
+				}
+				if (ImGui::Button("Benchmark scene graph"))
+				{
+					gSceneBenchmarkMs[0] = BenchmarkSceneGraph(100000, 0.01f, &gJobPool);
+					gSceneBenchmarkMs[1] = BenchmarkSceneGraph(100000, 1.0f, &gJobPool);
+				}
+				ImGui::SameLine();
+				ImGui::Text("100k nodes: %.2f ms (1%% dirty), %.2f ms (all dirty)", gSceneBenchmarkMs[0], gSceneBenchmarkMs[1]);
+				ImGui::Text("Entities: %d in %d chunks, %d drawn, %d culled", gEntities.GetEntityCount(), gEntities.GetChunkCount(),
+					(int)gSceneSystems.GetDrawList().size(), gSceneSystems.GetCulledCount());
+				if (ImGui::Checkbox("occlusion culling", &gOcclusionCulling))
+					gSceneSystems.SetOcclusion(gOcclusionCulling ? &gOcclusionCuller : nullptr, &gOccluderMeshes);
+				if (gOcclusionCulling)
+				{
+					const OcclusionStats& occlusionStats = gOcclusionCuller.GetStats();
+					ImGui::SameLine();
+					ImGui::Text("%d of %d culled (%.0f%%), %d triangles: %.3f ms raster, %.3f ms hi-z, %.3f ms tests",
+						occlusionStats.culledBoxes, occlusionStats.testedBoxes, occlusionStats.testedBoxes ? 100.0f * occlusionStats.culledBoxes / occlusionStats.testedBoxes : 0.0f,
+						occlusionStats.occluderTriangles, occlusionStats.rasterMs, occlusionStats.hiZMs, occlusionStats.testMs);
+				}
+				if (ImGui::Button("Benchmark ECS"))
+					gEcsBenchmark = BenchmarkEcs(100000);
+				ImGui::SameLine();
+				ImGui::Text("100k entities: %.1f/us SoA chunks, %.1f/us AoS", gEcsBenchmark.ecsPerUs, gEcsBenchmark.aosPerUs);
+				ImGui::SliderFloat("sphere distance", &gEntities.Get<Position>(gSphereEntity)->value.z, 0.0f, 40.0f);
+				int sphereLevel = gEntities.Get<LodGroup>(gSphereEntity)->level;
+				ImGui::SameLine();
+				ImGui::Text("LOD %d, %d triangles", sphereLevel, gLodChains[0].levels[sphereLevel].mesh.GetTriangleCount());
+				if (ImGui::Button("Benchmark LOD"))
+					gLodBenchmark = BenchmarkLod(1000000, 4, &gJobPool);
+				ImGui::SameLine();
+				ImGui::Text("%d x %d triangles, %d levels: %.0f ms serial, %.0f ms parallel", gLodBenchmark.meshCount, gLodBenchmark.trianglesPerMesh,
+					gLodBenchmark.levels, gLodBenchmark.serialMs, gLodBenchmark.parallelMs);
+				const RenderQueueStats& queueStats = gRenderQueue.GetStats();
+				ImGui::Text("Render queue: %d draws in %d batches, %d state changes, %.3f ms sort, %.3f ms submit", queueStats.draws, queueStats.batches,
+					queueStats.passChanges + queueStats.shaderChanges + queueStats.textureChanges + queueStats.meshChanges, queueStats.sortMs, queueStats.submitMs);
+				ImGui::Checkbox("record on worker threads", &gParallelRecording);
+				if (gParallelRecording)
+				{
+					ImGui::SameLine();
+					ImGui::Text("%d deferred contexts, %.3f ms recording", (int)gDeferredLists.size(), gRecordMs);
+				}
+				if (ImGui::Button("Benchmark recording"))
+					gRecordingBenchmark = BenchmarkCommandRecording(100000);
+				for (const CommandRecordingTiming& timing : gRecordingBenchmark)
+				{
+					ImGui::SameLine();
+					ImGui::Text("%d: %.2f ms", timing.threads, timing.recordMs);
+				}
+				if (ImGui::Button("Benchmark render queue"))
+					gRenderQueueBenchmark = BenchmarkRenderQueue(100000, &gJobPool);
+				ImGui::SameLine();
+				ImGui::Text("100k draws: %.1fM/s, %d batches, %lld state changes sorted (%lld unsorted)", gRenderQueueBenchmark.drawsPerSecond / 1e6,
+					gRenderQueueBenchmark.batches, gRenderQueueBenchmark.sortedStateChanges, gRenderQueueBenchmark.unsortedStateChanges);
+				ShaderCacheStats shaderStats = gShaderCache.GetStats();
+				ImGui::Text("Shader cache: %d hits, %d misses (%.1f ms compiling)", shaderStats.hits, shaderStats.misses, shaderStats.compileMs);
+				ImGui::Checkbox("50 static windows", &gStaticWindows);
+				ImGui::SameLine();
+				ImGui::Checkbox("cache their draw lists", &gCacheStaticWindows);
+				ImGui::SameLine();
+				ImGui::Text("ImGui: %.3f ms/frame", gImGuiMs);
 				ImGui::End();
+				if (gStaticWindows)
+					ShowStaticWindows();
 
 				if (gDist == 0.0f)
 					gDist += 0.0001f;
 
-				gRotation += ImGui::GetIO().DeltaTime / 0.8;
-
-				transform(gRotation);
-				D3D11_MAPPED_SUBRESOURCE mappedMemory;
-				gDeviceContext->Map(gConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedMemory);
-				memcpy(mappedMemory.pData, &gMatricesPerFrame, sizeof(gMatricesPerFrame));
-				gDeviceContext->Unmap(gConstantBuffer, 0);
-
 				ImGui::Render();
-				ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+				double imguiMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - imguiStart).count();
+
+				gIdleTimeout = gAnimateScene ? 0.0f : io.IdleTimeout;
+				bool uiChanged = io.FrameChanged && (!gSkipIdleFrames || ImGui::GetTime() <= gUiActiveUntil);
+				if (!sceneChanged && !uiChanged)
+				{
+					// the damage was against this frame, which the layer never got
+					if (ImGui::GetDrawData()->DamageRectsCount > 0)
+						gUiLayerValid = false;
+					gSkippedFrames++;
+					continue;
+				}
+
+				BeginGpuTimer();
+				UpdateRenderSize();
+				float deltaTime = gAnimateScene ? io.DeltaTime : 0.0f;
+				gSceneTime += deltaTime;
+				UpdateScene(deltaTime);
+				if (KeyClustered(gShaderKey))
+					UpdateClusters(gSceneTime);
+				Render(); //8. Rendera
+				gDeviceContext->GSSetShader(nullptr, nullptr, 0);
+				ResolveScene();
+
+				DrawUi(ImGui::GetDrawData());
+				EndGpuTimer();
 
 				gSwapChain->Present(0, 0); //9. Vxla front- och back-buffer
+
+				// per presented frame, so the readouts stay put while frames are skipped
+				std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+				double frameMs = std::chrono::duration<double, std::milli>(now - gLastPresent).count();
+				gFrameMs = gPresentedFrames == 0 ? frameMs : gFrameMs + (frameMs - gFrameMs) * 0.05;
+				gImGuiMs += (imguiMs - gImGuiMs) * 0.05;
+				gLastPresent = now;
+				gPresentedFrames++;
+				gSkippedShown = gSkippedFrames;
 			}
 		}
 
@@ -551,17 +1973,64 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 		ImGui_ImplWin32_Shutdown();
 		ImGui::DestroyContext();
 
+		gHotReloader.Stop();
+		// reloads still compiling swap in now, so that their objects are released below
+		gJobPool.WaitAll();
+		gHotReloader.Update();
+
 		gVertexBuffer->Release();
 		gConstantBuffer->Release();
+		for (DeferredList& deferred : gDeferredLists)
+		{
+			deferred.constantBuffer->Release();
+			deferred.context->Release();
+		}
+		gDepthStencilState->Release();
+		gDepthReadOnlyState->Release();
+		gDepthDisabledState->Release();
+		gAlphaBlend->Release();
+		if (gInstanceView)
+			gInstanceView->Release();
+		if (gInstanceBuffer)
+			gInstanceBuffer->Release();
+		gPointLightView->Release();
+		gPointLightBuffer->Release();
+		gClusterGridView->Release();
+		gClusterGridBuffer->Release();
+		if (gClusterIndexView)
+			gClusterIndexView->Release();
+		if (gClusterIndexBuffer)
+			gClusterIndexBuffer->Release();
+		gClusterConstantBuffer->Release();
+		for (ID3D11DepthStencilView* shadowDSV : gShadowDSVs)
+			shadowDSV->Release();
+		gShadowView->Release();
+		gShadowTexture->Release();
+		gShadowSampler->Release();
+		gShadowConstantBuffer->Release();
+		for (GpuFrameTimer& timer : gGpuTimers)
+		{
+			timer.disjoint->Release();
+			timer.begin->Release();
+			timer.end->Release();
+		}
+		gUpscaleConstantBuffer->Release();
+		gUpscaleVS->Release();
+		gUpscalePS->Release();
+		SetUiLayer(false);
+		if (gPremultipliedBlend)
+			gPremultipliedBlend->Release();
+		if (gDeviceContext1)
+			gDeviceContext1->Release();
 		gTextureView->Release();
 		gSamplerState->Release();
 
 		gVertexLayout->Release();
 		gVertexShader->Release();
-		gGeometryShader->Release();
-		gPixelShader->Release();
+		gGSPermutations.ReleaseShaders();
+		gPSPermutations.ReleaseShaders();
 
-		gDSV->Release();
+		ReleaseSceneTargets();
 		gBackbufferRTV->Release();
 		gSwapChain->Release();
 		gDevice->Release();
@@ -611,6 +2080,18 @@ LRESULT CALLBACK WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam
 
 	switch (message) 
 	{
+	case WM_PAINT:
+		// redrawn by the next frame, DefWindowProc validates the window
+		gRedrawRequested = true;
+		break;
+	case WM_SIZE:
+		// minimized windows keep their buffers
+		if (wParam != SIZE_MINIMIZED && LOWORD(lParam) > 0 && HIWORD(lParam) > 0)
+		{
+			gPendingWidth = LOWORD(lParam);
+			gPendingHeight = HIWORD(lParam);
+		}
+		break;
 	case WM_DESTROY:
 		PostQuitMessage(0);
 		break;		
@@ -651,6 +2132,9 @@ HRESULT CreateDirect3DContext(HWND wndHandle)
 
 	if (SUCCEEDED(hr))
 	{
+		// only there from D3D 11.1, the UI layer clears all of itself without it
+		gDeviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&gDeviceContext1);
+
 		// get the address of the back buffer
 		ID3D11Texture2D* pBackBuffer = nullptr;
 		gSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
@@ -660,7 +2144,8 @@ HRESULT CreateDirect3DContext(HWND wndHandle)
 		pBackBuffer->Release();
 
 		//DepthBuffer
-		createDepthStencil();
+		createDepthStencilState();
+		SetMsaaSamples(1);
 
 		// set the render target as the back buffer
 		gDeviceContext->OMSetRenderTargets(1, &gBackbufferRTV, gDSV);